@@ -1,16 +1,412 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "apbr_dsi"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fb.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+/* fbdev nodes tried when -d is not given, Android first */
+#define FB_DEV_ANDROID "/dev/graphics/fb0"
+#define FB_DEV_LINUX   "/dev/fb0"
+/* Default load sweep, percent of the screen redrawn every frame */
+#define DEFAULT_LOADS "10,25,50,75,100"
+/* Default run time of each sweep point, in seconds */
+#define DEFAULT_DURATION 10
+/* Vblank periods measured to estimate the refresh rate without timings */
+#define CALIBRATE_FRAMES 60
+
+struct dsi_info {
+    int case_id;
+    char dev[PATH_MAX];
+    int duration;
+    int allow_miss;
+    struct sweep loads;
+};
+
+struct fb_ctx {
+    int fd;
+    uint8_t *mem;
+    size_t mem_len;
+    size_t frame_len;
+    struct fb_var_screeninfo var;
+    struct fb_var_screeninfo saved;
+    struct fb_fix_screeninfo fix;
+    /* FBIO_WAITFORVSYNC works, else the pan itself waits for vsync */
+    int has_waitvsync;
+    int back;
+    /* nominal vblank period */
+    uint64_t period_ns;
+};
+
+/* one sweep point */
+struct dsi_run {
+    uint64_t frames;
+    uint64_t missed;
+    uint64_t bytes;
+    uint64_t ns;
+    struct stats_hist interval;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d fbdev] [-l loads] [-t seconds] [-a] "
+            "[-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -d: framebuffer of the APBridge DSI panel "
+            "(default %s\n        or %s).\n", FB_DEV_ANDROID, FB_DEV_LINUX);
+    fprintf(stdout, "    -l: comma separated percentages of the screen "
+            "redrawn every\n        frame (default %s).\n", DEFAULT_LOADS);
+    fprintf(stdout, "    -t: run time of each point in seconds "
+            "(default %d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -a: report missed vblanks without failing the "
+            "test.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Frames are drawn into the back buffer and flipped on "
+            "every vblank.\n");
+    fprintf(stdout, "Example: %s -d /dev/graphics/fb0 -l 50,100 -t 30\n",
+            APP_NAME);
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Nominal vblank period from the video mode timings.
+ *
+ * @param var The video mode.
+ * @return the period in ns, 0 if the driver does not report timings.
+ */
+static uint64_t mode_period_ns(const struct fb_var_screeninfo *var)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    uint64_t htotal = var->xres + var->left_margin + var->right_margin +
+                      var->hsync_len;
+    uint64_t vtotal = var->yres + var->upper_margin + var->lower_margin +
+                      var->vsync_len;
+
+    /* pixclock is in ps */
+    return var->pixclock ? htotal * vtotal * var->pixclock / 1000 : 0;
+}
+
+/**
+ * @brief Show a buffer and wait for the vblank that scans it out.
+ *
+ * @param fb The framebuffer.
+ * @param index The buffer to show, 0 or 1.
+ * @return 0 on success, -errno on failure.
+ */
+static int flip(struct fb_ctx *fb, int index)
+{
+    uint32_t crtc = 0;
+
+    fb->var.yoffset = index * fb->var.yres;
+    if (ioctl(fb->fd, FBIOPAN_DISPLAY, &fb->var) < 0) {
+        return -errno;
+    }
+
+    if (fb->has_waitvsync && ioctl(fb->fd, FBIO_WAITFORVSYNC, &crtc) < 0) {
+        return -errno;
+    }
+
     return 0;
 }
+
+/**
+ * @brief Open the framebuffer and set up two buffers.
+ *
+ * The virtual screen is made twice the panel height, the second half is
+ * the back buffer.
+ *
+ * @param fb Returns the framebuffer.
+ * @param dev The fbdev node.
+ * @return 0 on success, -errno on failure.
+ */
+static int fb_open(struct fb_ctx *fb, const char *dev)
+{
+    struct stats_hist hist;
+    uint32_t crtc = 0;
+    uint64_t t0 = 0, t1 = 0;
+    int i = 0, ret = 0;
+
+    fb->fd = open(dev, O_RDWR);
+    if (fb->fd < 0) {
+        return -errno;
+    }
+
+    if (ioctl(fb->fd, FBIOGET_VSCREENINFO, &fb->var) < 0) {
+        return -errno;
+    }
+    fb->saved = fb->var;
+
+    fb->var.yres_virtual = fb->var.yres * 2;
+    fb->var.yoffset = 0;
+    fb->var.activate = FB_ACTIVATE_NOW;
+    if (ioctl(fb->fd, FBIOPUT_VSCREENINFO, &fb->var) < 0 ||
+        ioctl(fb->fd, FBIOGET_VSCREENINFO, &fb->var) < 0 ||
+        ioctl(fb->fd, FBIOGET_FSCREENINFO, &fb->fix) < 0) {
+        return -errno;
+    }
+    /* no room for a back buffer, page flips cannot be tested */
+    if (fb->var.yres_virtual < fb->var.yres * 2) {
+        return -EOPNOTSUPP;
+    }
+
+    fb->frame_len = (size_t)fb->fix.line_length * fb->var.yres;
+    fb->mem_len = fb->frame_len * 2;
+    fb->mem = mmap(NULL, fb->mem_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fb->fd, 0);
+    if (fb->mem == MAP_FAILED) {
+        fb->mem = NULL;
+        return -errno;
+    }
+
+    fb->has_waitvsync = ioctl(fb->fd, FBIO_WAITFORVSYNC, &crtc) == 0;
+
+    fb->period_ns = mode_period_ns(&fb->var);
+    if (fb->period_ns) {
+        return 0;
+    }
+
+    /* no timings, measure idle flips */
+    stats_hist_init(&hist);
+    t0 = stats_now_ns();
+    for (i = 0; i < CALIBRATE_FRAMES && !ret; i++) {
+        ret = flip(fb, i & 1);
+        t1 = stats_now_ns();
+        stats_hist_record(&hist, t1 - t0);
+        t0 = t1;
+    }
+    fb->period_ns = stats_hist_percentile(&hist, 50.0);
+    fb->back = 0;
+
+    return ret ? ret : (fb->period_ns ? 0 : -EIO);
+}
+
+/**
+ * @brief Restore the video mode and close the framebuffer.
+ *
+ * @param fb The framebuffer.
+ */
+static void fb_close(struct fb_ctx *fb)
+{
+    if (fb->mem != NULL) {
+        munmap(fb->mem, fb->mem_len);
+    }
+    if (fb->fd >= 0 && fb->saved.xres) {
+        fb->saved.activate = FB_ACTIVATE_NOW;
+        ioctl(fb->fd, FBIOPUT_VSCREENINFO, &fb->saved);
+    }
+    if (fb->fd >= 0) {
+        close(fb->fd);
+    }
+}
+
+/**
+ * @brief Run one load point.
+ *
+ * Each frame redraws the first load percent of the back buffer's lines
+ * with a new pattern, then flips. A flip that lands more than half a
+ * period late missed one vblank per extra period, the panel showed the
+ * old frame again.
+ *
+ * @param info The DSI info.
+ * @param fb The framebuffer.
+ * @param load Percent of the screen redrawn.
+ * @param run Returns the measurements.
+ * @return 0 on success, -errno on failure.
+ */
+static int run_point(const struct dsi_info *info, struct fb_ctx *fb,
+                     int load, struct dsi_run *run)
+{
+    size_t len = fb->frame_len * load / 100;
+    uint64_t start = 0, end = 0, prev = 0, now = 0, interval = 0;
+    uint64_t periods = 0;
+    int ret = 0;
+
+    /* pattern_fill() writes whole 64 bit words */
+    len &= ~(size_t)7;
+
+    ret = flip(fb, fb->back);
+    start = prev = stats_now_ns();
+    end = start + (uint64_t)info->duration * 1000000000ULL;
+
+    while (!ret && prev < end) {
+        fb->back ^= 1;
+        pattern_fill(fb->mem + fb->back * fb->frame_len, len, 0,
+                     run->frames);
+        ret = flip(fb, fb->back);
+        now = stats_now_ns();
+
+        interval = now - prev;
+        stats_hist_record(&run->interval, interval);
+        periods = (interval + fb->period_ns / 2) / fb->period_ns;
+        if (periods > 1) {
+            run->missed += periods - 1;
+        }
+        run->frames++;
+        run->bytes += len;
+        prev = now;
+    }
+    run->ns = prev - start;
+
+    return ret;
+}
+
+/**
+ * @brief Print the result of one load point.
+ *
+ * @param info The DSI info.
+ * @param fb The framebuffer.
+ * @param load Percent of the screen redrawn.
+ * @param run The measurements.
+ */
+static void print_result(const struct dsi_info *info,
+                         const struct fb_ctx *fb, int load,
+                         const struct dsi_run *run)
+{
+    double secs = run->ns / 1e9;
+    double fps = secs > 0 ? run->frames / secs : 0.0;
+    double mb_s = secs > 0 ? run->bytes / secs / 1e6 : 0.0;
+    char metric[48];
+
+    printf("\n%s: %ux%u bpp=%u load=%d%% frames=%llu fps=%.2f "
+           "nominal_fps=%.2f missed_vblanks=%llu MB_per_s=%.1f\n",
+           APP_NAME, fb->var.xres, fb->var.yres, fb->var.bits_per_pixel,
+           load, (unsigned long long)run->frames, fps,
+           1e9 / fb->period_ns, (unsigned long long)run->missed, mb_s);
+
+    snprintf(metric, sizeof(metric), "load%d_refresh", load);
+    print_test_case_perf(info->case_id, metric, fps, "Hz");
+    snprintf(metric, sizeof(metric), "load%d_missed_vblanks", load);
+    print_test_case_perf(info->case_id, metric, run->missed, "vblanks");
+    snprintf(metric, sizeof(metric), "load%d_bandwidth", load);
+    print_test_case_perf(info->case_id, metric, mb_s, "MB/s");
+    snprintf(metric, sizeof(metric), "load%d_flip_interval", load);
+    stats_hist_report(info->case_id, metric, &run->interval);
+}
+
+int main(int argc, char **argv)
+{
+    struct dsi_info info;
+    struct fb_ctx fb;
+    static struct dsi_run run;
+    double mb_s = 0.0, sustained = 0.0, first_miss = 0.0;
+    int options = 0, i = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    memset(&fb, 0, sizeof(fb));
+    fb.fd = -1;
+    info.duration = DEFAULT_DURATION;
+    sweep_parse(&info.loads, DEFAULT_LOADS, 1, 100);
+
+    while ((options = getopt(argc, argv, "ac:d:l:t:")) != -1) {
+        switch (options) {
+            case 'a':
+                info.allow_miss = 1;
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                snprintf(info.dev, sizeof(info.dev), "%s", optarg);
+                break;
+            case 'l':
+                ret = sweep_parse(&info.loads, optarg, 1, 100);
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (!info.dev[0]) {
+        snprintf(info.dev, sizeof(info.dev), "%s",
+                 access(FB_DEV_ANDROID, F_OK) ? FB_DEV_LINUX :
+                 FB_DEV_ANDROID);
+    }
+
+    if (info.duration < 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    ret = fb_open(&fb, info.dev);
+
+    for (i = 0; i < info.loads.count && !ret; i++) {
+        memset(&run, 0, sizeof(run));
+        stats_hist_init(&run.interval);
+
+        ret = run_point(&info, &fb, info.loads.value[i], &run);
+        print_result(&info, &fb, info.loads.value[i], &run);
+
+        mb_s = run.ns ? run.bytes / (run.ns / 1e9) / 1e6 : 0.0;
+        if (!run.missed && mb_s > sustained) {
+            sustained = mb_s;
+        }
+        if (run.missed && first_miss == 0.0) {
+            first_miss = mb_s;
+        }
+        if (!ret && !info.allow_miss && run.missed) {
+            ret = -EIO;
+        }
+    }
+
+    if (sustained > 0.0) {
+        print_test_case_perf(info.case_id, "max_sustained_bandwidth",
+                             sustained, "MB/s");
+    }
+    if (first_miss > 0.0) {
+        print_test_case_perf(info.case_id, "first_drop_bandwidth",
+                             first_miss, "MB/s");
+    }
+
+    fb_close(&fb);
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
+}
@@ -1,16 +1,418 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "apbr_hsic"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+#define LOOPBACK_CLASS "/sys/class/gb_loopback"
+/* raw_latency_<bundle> files of the loopback driver */
+#define LOOPBACK_DEBUGFS "/sys/kernel/debug/gb_loopback"
+/* gb_loopback operation types */
+#define LOOPBACK_TYPE_PING     2
+#define LOOPBACK_TYPE_TRANSFER 3
+#define LOOPBACK_TYPE_SINK     4
+/* Default message size sweep, in bytes */
+#define DEFAULT_SIZES "16,256,1024"
+/* Default outstanding request sweep */
+#define DEFAULT_DEPTHS "1,4,16"
+/* Default operations per sweep point */
+#define DEFAULT_ITERATIONS 1000
+/* Default give up time of one sweep point, in seconds */
+#define DEFAULT_TIMEOUT 60
+/* Completion poll interval, in us */
+#define POLL_US 10000
+/* Device path length, leaves room for the attribute names */
+#define DEV_LEN (PATH_MAX / 2)
+
+struct hsic_info {
+    int case_id;
+    char dev[DEV_LEN];
+    char raw[PATH_MAX];
+    int type;
+    int iterations;
+    int timeout;
+    struct sweep sizes;
+    struct sweep depths;
+};
+
+/* one sweep point */
+struct hsic_run {
+    long completed;
+    long errors;
+    long timedout;
+    long throughput;
+    long requests_per_s;
+    long unipro_us;
+    long firmware_us;
+    long lat_min;
+    long lat_avg;
+    long lat_max;
+    struct stats_hist hist;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d device] [-m ping|transfer|sink] "
+            "[-s sizes] [-n depths]\n        [-i iterations] [-t seconds] "
+            "[-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -d: gb_loopback device, e.g. gb_loopback1 "
+            "(default the first).\n");
+    fprintf(stdout, "    -m: loopback operation, transfer echoes the "
+            "payload (default).\n");
+    fprintf(stdout, "    -s: comma separated payload sizes in bytes "
+            "(default %s).\n", DEFAULT_SIZES);
+    fprintf(stdout, "    -n: comma separated outstanding request depths, "
+            "1 is\n        synchronous (default %s).\n", DEFAULT_DEPTHS);
+    fprintf(stdout, "    -i: operations per point (default %d).\n",
+            DEFAULT_ITERATIONS);
+    fprintf(stdout, "    -t: give up on a point after this many seconds "
+            "(default %d).\n", DEFAULT_TIMEOUT);
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Round trip percentiles need debugfs, else only "
+            "min/avg/max print.\n");
+    fprintf(stdout, "Example: %s -s 64,2000 -n 1,32 -i 5000\n", APP_NAME);
+}
+
+/**
+ * @brief Write a loopback attribute.
+ *
+ * Every write resets the loopback statistics, a non zero type with a
+ * non zero iteration_max starts the test.
+ *
+ * @param info The HSIC info.
+ * @param attr The attribute.
+ * @param value The value.
+ * @return 0 on success, error code on failure.
+ */
+static int set_attr(struct hsic_info *info, const char *attr, long value)
+{
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%ld", value);
+    return debugfs_set_attr(info->dev, attr, buf, strlen(buf));
+}
+
+/**
+ * @brief Read a loopback attribute.
+ *
+ * @param info The HSIC info.
+ * @param attr The attribute.
+ * @param value Returns the value, 0 if the attribute does not exist.
+ * @return 0 on success, error code on failure.
+ */
+static int get_attr(struct hsic_info *info, const char *attr, long *value)
+{
+    char buf[32];
+    int ret = 0;
+
+    *value = 0;
+    ret = debugfs_get_attr(info->dev, attr, buf, sizeof(buf) - 1);
+    if (!ret) {
+        *value = strtol(buf, NULL, 10);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Find the raw latency file of the loopback device.
+ *
+ * The driver names it after the bundle, the parent of the device.
+ *
+ * @param info The HSIC info.
+ */
+static void find_raw_latency(struct hsic_info *info)
+{
+    char link[PATH_MAX], target[PATH_MAX];
+    ssize_t n;
+
+    snprintf(link, sizeof(link), "%s/device", info->dev);
+    n = readlink(link, target, sizeof(target) - 1);
+    if (n < 0) {
+        return;
+    }
+    target[n] = '\0';
+
+    snprintf(info->raw, sizeof(info->raw), "%s/raw_latency_%s",
+             LOOPBACK_DEBUGFS, basename(target));
+    if (access(info->raw, R_OK)) {
+        info->raw[0] = '\0';
+    }
+}
+
+/**
+ * @brief Drain the raw latency FIFO into a histogram.
+ *
+ * Each read of the file returns the next round trip time in us, an empty
+ * read ends the FIFO.
+ *
+ * @param info The HSIC info.
+ * @param hist The histogram.
+ */
+static void read_raw_latency(const struct hsic_info *info,
+                             struct stats_hist *hist)
+{
+    char buf[32];
+    int fd = -1, i = 0;
+    ssize_t n;
+
+    for (i = 0; i < info->iterations; i++) {
+        fd = open(info->raw, O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        n = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        if (n <= 0) {
+            return;
+        }
+        buf[n] = '\0';
+        stats_hist_record(hist, strtoull(buf, NULL, 10) * 1000ULL);
+    }
+}
+
+/**
+ * @brief Run one sweep point.
+ *
+ * Depth 1 runs synchronous operations, larger depths asynchronous ones
+ * with that many in flight.
+ *
+ * @param info The HSIC info.
+ * @param size Payload size in bytes.
+ * @param depth Outstanding requests.
+ * @param run Returns the measurements.
+ * @return 0 on success, error code on failure.
+ */
+static int run_point(struct hsic_info *info, int size, int depth,
+                     struct hsic_run *run)
+{
+    uint64_t end = 0;
+    long count = 0;
+    int ret = 0;
+
+    /* stop a test left running, then configure, type starts it */
+    ret = set_attr(info, "type", 0);
+    if (!ret) {
+        ret = set_attr(info, "size", size);
+    }
+    if (!ret) {
+        ret = set_attr(info, "iteration_max", info->iterations);
+    }
+    if (!ret) {
+        ret = set_attr(info, "async", depth > 1);
+    }
+    if (!ret && depth > 1) {
+        ret = set_attr(info, "outstanding_operations_max", depth);
+    }
+    if (!ret) {
+        ret = set_attr(info, "type", info->type);
+    }
+
+    end = stats_now_ns() + (uint64_t)info->timeout * 1000000000ULL;
+    while (!ret) {
+        ret = get_attr(info, "iteration_count", &count);
+        if (ret || count >= info->iterations) {
+            break;
+        }
+        if (stats_now_ns() > end) {
+            ret = -ETIMEDOUT;
+            break;
+        }
+        usleep(POLL_US);
+    }
+    set_attr(info, "type", 0);
+
+    get_attr(info, "requests_completed", &run->completed);
+    get_attr(info, "error", &run->errors);
+    get_attr(info, "requests_timedout", &run->timedout);
+    get_attr(info, "throughput_avg", &run->throughput);
+    get_attr(info, "requests_per_second_avg", &run->requests_per_s);
+    get_attr(info, "apbridge_unipro_latency_avg", &run->unipro_us);
+    get_attr(info, "gbphy_firmware_latency_avg", &run->firmware_us);
+    get_attr(info, "latency_min", &run->lat_min);
+    get_attr(info, "latency_avg", &run->lat_avg);
+    get_attr(info, "latency_max", &run->lat_max);
+
+    if (info->raw[0]) {
+        read_raw_latency(info, &run->hist);
+    }
+
+    if (!ret && (run->errors || run->timedout)) {
+        ret = -EIO;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Print the result of one sweep point.
+ *
+ * The APBridge UniPro and firmware latencies are what the bridge and
+ * module report spending, the rest of the round trip is the AP stack
+ * and the HSIC transport.
+ *
+ * @param info The HSIC info.
+ * @param size Payload size in bytes.
+ * @param depth Outstanding requests.
+ * @param run The measurements.
+ */
+static void print_result(const struct hsic_info *info, int size, int depth,
+                         const struct hsic_run *run)
+{
+    char metric[48];
+
+    printf("\n%s: size=%d depth=%d completed=%ld errors=%ld timedout=%ld "
+           "bytes_per_s=%ld requests_per_s=%ld latency_us=%ld/%ld/%ld "
+           "unipro_us=%ld firmware_us=%ld\n", APP_NAME, size, depth,
+           run->completed, run->errors, run->timedout, run->throughput,
+           run->requests_per_s, run->lat_min, run->lat_avg, run->lat_max,
+           run->unipro_us, run->firmware_us);
+
+    snprintf(metric, sizeof(metric), "s%d_d%d_bytes_per_s", size, depth);
+    print_test_case_perf(info->case_id, metric, run->throughput, "B/s");
+    snprintf(metric, sizeof(metric), "s%d_d%d_requests_per_s", size, depth);
+    print_test_case_perf(info->case_id, metric, run->requests_per_s,
+                         "ops/s");
+    snprintf(metric, sizeof(metric), "s%d_d%d_apbridge_unipro", size, depth);
+    print_test_case_perf(info->case_id, metric, run->unipro_us, "us");
+    snprintf(metric, sizeof(metric), "s%d_d%d_firmware", size, depth);
+    print_test_case_perf(info->case_id, metric, run->firmware_us, "us");
+    snprintf(metric, sizeof(metric), "s%d_d%d_round_trip", size, depth);
+    if (run->hist.count) {
+        stats_hist_report(info->case_id, metric, &run->hist);
+    } else {
+        print_test_case_perf(info->case_id, metric, run->lat_avg, "us");
+    }
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    struct hsic_info info;
+    static struct hsic_run run;
+    long peak = 0;
+    int options = 0, i = 0, j = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.type = LOOPBACK_TYPE_TRANSFER;
+    info.iterations = DEFAULT_ITERATIONS;
+    info.timeout = DEFAULT_TIMEOUT;
+    sweep_parse(&info.sizes, DEFAULT_SIZES, 0, INT32_MAX);
+    sweep_parse(&info.depths, DEFAULT_DEPTHS, 1, INT32_MAX);
+
+    while ((options = getopt(argc, argv, "c:d:i:m:n:s:t:")) != -1) {
+        switch (options) {
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                snprintf(info.dev, sizeof(info.dev), "%s/%s", LOOPBACK_CLASS,
+                         optarg);
+                break;
+            case 'i':
+                info.iterations = atoi(optarg);
+                break;
+            case 'm':
+                if (!strcmp(optarg, "ping")) {
+                    info.type = LOOPBACK_TYPE_PING;
+                } else if (!strcmp(optarg, "transfer")) {
+                    info.type = LOOPBACK_TYPE_TRANSFER;
+                } else if (!strcmp(optarg, "sink")) {
+                    info.type = LOOPBACK_TYPE_SINK;
+                } else {
+                    ret = -EINVAL;
+                }
+                break;
+            case 'n':
+                ret = sweep_parse(&info.depths, optarg, 1, INT32_MAX);
+                break;
+            case 's':
+                ret = sweep_parse(&info.sizes, optarg, 0, INT32_MAX);
+                break;
+            case 't':
+                info.timeout = atoi(optarg);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (!info.dev[0]) {
+        gb_find_loopback(0, info.dev, sizeof(info.dev));
+    }
+
+    if (!info.dev[0] || info.iterations < 1 || info.timeout < 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    find_raw_latency(&info);
+
+    for (i = 0; i < info.sizes.count && !ret; i++) {
+        for (j = 0; j < info.depths.count && !ret; j++) {
+            memset(&run, 0, sizeof(run));
+            stats_hist_init(&run.hist);
+
+            ret = run_point(&info, info.sizes.value[i], info.depths.value[j],
+                            &run);
+            print_result(&info, info.sizes.value[i], info.depths.value[j],
+                         &run);
+            if (run.throughput > peak) {
+                peak = run.throughput;
+            }
+        }
+    }
+
+    if (peak) {
+        print_test_case_perf(info.case_id, "peak_bytes_per_s", peak, "B/s");
+    }
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
 }
@@ -1,16 +1,691 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "apbr_init"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <poll.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+/* the first greybus host device, its USB parent is the APBridge */
+#define GB_HOST_DEVICE "/sys/bus/greybus/devices/greybus1"
+#define USB_DEVICES    "/sys/bus/usb/devices"
+#define KMSG           "/dev/kmsg"
+/* Default number of reset cycles */
+#define DEFAULT_CYCLES 5
+/* Default give up time of one cycle, in seconds */
+#define DEFAULT_TIMEOUT 30
+/* Default quiet time that ends an initialization, in ms */
+#define DEFAULT_SETTLE_MS 1000
+/* Max phases, built in and -k markers */
+#define MAX_PHASES 16
+#define MARKER_LEN 64
+#define DEV_LEN (PATH_MAX / 2)
+
+enum reset_method {
+    RESET_AUTHORIZED,
+    RESET_PORT,
+    RESET_COMMAND,
+};
+
+/* built in phases, in order */
+enum phase_id {
+    PHASE_DOWN,
+    PHASE_CONNECT,
+    PHASE_USB,
+    PHASE_PROBE,
+    PHASE_HOST,
+    PHASE_SVC,
+    PHASE_INTERFACE,
+    PHASE_BUNDLE,
+    PHASE_BIND,
+    PHASE_BUILTIN,
+};
+
+/* an initialization phase, seen on a uevent or a kernel log message */
+struct phase {
+    char name[16];
+    /* uevent of the phase, action NULL for a kernel log marker */
+    struct uevent_filter filter;
+    /* the uevent must come from the APBridge USB device */
+    int usb;
+    /* devices of the phase come more than once, the last one counts */
+    int last;
+    /* kernel log text of a marker, substring of the message */
+    char text[MARKER_LEN];
+};
+
+static struct phase phases[MAX_PHASES] = {
+    /* the old link is gone */
+    [PHASE_DOWN] = { "down",
+        { "remove", "greybus", "greybus_host_device", NULL, NULL }, 0, 0, "" },
+    /* the hub saw the bridge, enumeration starts */
+    [PHASE_CONNECT] = { "connect",
+        { NULL, NULL, NULL, NULL, NULL }, 0, 0, "USB device number" },
+    /* USB or HSIC enumeration done */
+    [PHASE_USB] = { "usb",
+        { "add", "usb", "usb_device", NULL, NULL }, 1, 0, "" },
+    /* greybus host driver probed */
+    [PHASE_PROBE] = { "probe",
+        { "bind", "usb", "usb_interface", NULL, NULL }, 1, 0, "" },
+    [PHASE_HOST] = { "host",
+        { "add", "greybus", "greybus_host_device", NULL, NULL }, 0, 0, "" },
+    /* SVC connection up */
+    [PHASE_SVC] = { "svc",
+        { "add", "greybus", "greybus_svc", NULL, NULL }, 0, 0, "" },
+    /* every interface answered on its control connection */
+    [PHASE_INTERFACE] = { "interface",
+        { "add", "greybus", "greybus_interface", NULL, NULL }, 0, 1, "" },
+    /* manifests fetched and parsed into bundles */
+    [PHASE_BUNDLE] = { "bundle",
+        { "add", "greybus", "greybus_bundle", NULL, NULL }, 0, 1, "" },
+    /* bundle drivers bound */
+    [PHASE_BIND] = { "bind",
+        { "bind", "greybus", NULL, NULL, NULL }, 0, 1, "" },
+};
+static int nphases = PHASE_BUILTIN;
+
+struct init_info {
+    int case_id;
+    char usb[DEV_LEN];
+    char usbname[32];
+    int method;
+    char *command;
+    int cycles;
+    int timeout;
+    int settle_ms;
+    int sock;
+    int kmsg;
+    int verbose;
+};
+
+/* phase times of one cycle, ns from the reset, 0 if not seen */
+struct cycle {
+    uint64_t phase[MAX_PHASES];
+    /* kernel log time of the reset, in us, 0 if our marker was not seen */
+    uint64_t kmsg_t0;
+};
+
+struct init_run {
+    struct stats_hist total;
+    struct stats_hist phase[MAX_PHASES];
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d usbdev] [-m method] [-r command] "
+            "[-n cycles] [-t seconds]\n        [-s settle_ms] "
+            "[-k name=text] [-v] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -d: APBridge USB device in %s, e.g. 1-1 "
+            "(default the\n        parent of greybus1).\n", USB_DEVICES);
+    fprintf(stdout, "    -m: reset by authorized (USB deauthorize and "
+            "authorize, default)\n        or port (port power off and "
+            "on).\n");
+    fprintf(stdout, "    -r: shell command that resets the APBridge, "
+            "e.g. through the SVC or\n        platform controls, instead "
+            "of -m.\n");
+    fprintf(stdout, "    -n: reset cycles (default %d).\n",
+            DEFAULT_CYCLES);
+    fprintf(stdout, "    -t: give up on a cycle after this many seconds "
+            "(default %d).\n", DEFAULT_TIMEOUT);
+    fprintf(stdout, "    -s: quiet time in ms that ends an initialization "
+            "(default %d).\n", DEFAULT_SETTLE_MS);
+    fprintf(stdout, "    -k: time a kernel log message containing text "
+            "as the phase name,\n        may be given up to %d times. "
+            "connect=text changes the built in one.\n",
+            MAX_PHASES - PHASE_BUILTIN);
+    fprintf(stdout, "    -v: print the phase times of each cycle.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Phases are down, connect, usb, probe, host, svc, "
+            "interface, bundle and\nbind, each reported as the time "
+            "since the previous one seen. -k markers\nare reported as "
+            "the time since the reset. Kernel log times are used when\n"
+            "%s can be written, uevent arrival times otherwise.\n", KMSG);
+    fprintf(stdout, "Example: %s -m port -n 20 -k manifest=\"manifest "
+            "parsed\"\n", APP_NAME);
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Find the APBridge USB device of the first greybus host.
+ *
+ * @param usb Returns the sysfs dir.
+ * @param len The usb buffer size.
+ * @return 0 on success, -ENODEV if there is none.
+ */
+static int find_usb_dev(char *usb, int len)
+{
+    char path[PATH_MAX], attr[PATH_MAX];
+
+    if (realpath(GB_HOST_DEVICE, path) == NULL || strlen(path) >= DEV_LEN) {
+        return -ENODEV;
+    }
+
+    /* USB interfaces have authorized too, only devices have devnum */
+    while (strcmp(path, "/sys/devices") && strcmp(path, "/")) {
+        snprintf(attr, sizeof(attr), "%.*s/devnum", DEV_LEN, path);
+        if (!access(attr, R_OK)) {
+            snprintf(usb, len, "%s", path);
+            return 0;
+        }
+        snprintf(path, sizeof(path), "%s", dirname(path));
+    }
+
+    return -ENODEV;
+}
+
+/**
+ * @brief Add a -k kernel log marker, or change a built in one.
+ *
+ * @param arg name=text from command line.
+ * @return 0 on success, -EINVAL on bad argument.
+ */
+static int add_marker(const char *arg)
+{
+    const char *eq = strchr(arg, '=');
+    struct phase *ph = NULL;
+    int i, len;
+
+    if (eq == NULL || eq == arg || !eq[1]) {
+        return -EINVAL;
+    }
+    len = eq - arg;
+    if (len >= (int)sizeof(ph->name)) {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < nphases; i++) {
+        if ((int)strlen(phases[i].name) == len &&
+            !strncmp(phases[i].name, arg, len)) {
+            ph = &phases[i];
+            break;
+        }
+    }
+    if (ph != NULL && ph->filter.action != NULL) {
+        /* a uevent phase */
+        return -EINVAL;
+    }
+    if (ph == NULL) {
+        if (nphases == MAX_PHASES) {
+            return -EINVAL;
+        }
+        ph = &phases[nphases++];
+        memcpy(ph->name, arg, len);
+        ph->name[len] = '\0';
+    }
+    snprintf(ph->text, sizeof(ph->text), "%s", eq + 1);
+
+    return 0;
+}
+
+/* true if devpath is the APBridge USB device or one of its children */
+static int in_usb(const struct init_info *info, const char *devpath)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    const char *p = strstr(devpath, info->usbname);
+    size_t len = strlen(info->usbname);
+
+    return p != NULL && p > devpath && p[-1] == '/' &&
+           (p[len] == '\0' || p[len] == '/' || p[len] == ':');
+}
+
+/**
+ * @brief Write a line to the kernel log.
+ *
+ * @param info The init info.
+ * @param msg The line, with the trailing newline.
+ * @return 0 on success, -errno on failure.
+ */
+static int kmsg_write(const struct init_info *info, const char *msg)
+{
+    return write(info->kmsg, msg, strlen(msg)) < 0 ? -errno : 0;
+}
+
+/**
+ * @brief Read one kernel log record.
+ *
+ * @param info The init info.
+ * @param ts_us Returns the kernel time of the record, in us.
+ * @param msg Returns the message.
+ * @param len The msg buffer size.
+ * @return 0 on a record, -EAGAIN if there is none, -errno on failure.
+ */
+static int kmsg_read(const struct init_info *info, uint64_t *ts_us,
+                     char *msg, int len)
+{
+    char buf[1024];
+    unsigned long long ts = 0;
+    char *text = NULL;
+    ssize_t n;
+
+    /* EPIPE is records overwritten before they were read, skip them */
+    do {
+        n = read(info->kmsg, buf, sizeof(buf) - 1);
+    } while (n < 0 && errno == EPIPE);
+    if (n < 0) {
+        return -errno;
+    }
+    buf[n] = '\0';
+
+    text = strchr(buf, ';');
+    if (text == NULL || sscanf(buf, "%*u,%*u,%llu", &ts) != 1) {
+        return -EAGAIN;
+    }
+    text++;
+    text[strcspn(text, "\n")] = '\0';
+
+    *ts_us = ts;
+    snprintf(msg, len, "%s", text);
     return 0;
 }
+
+/**
+ * @brief Record the time of a phase in the cycle.
+ *
+ * @param cyc The cycle.
+ * @param i The phase.
+ * @param t Time since the reset.
+ */
+static void set_phase(struct cycle *cyc, int i, uint64_t t)
+{
+    if (!t) {
+        t = 1;
+    }
+    if (!cyc->phase[i] || (phases[i].last && t > cyc->phase[i])) {
+        cyc->phase[i] = t;
+    }
+}
+
+/**
+ * @brief Match a kernel log record against the markers.
+ *
+ * @param info The init info.
+ * @param cyc The cycle.
+ * @param t0 Start of the cycle.
+ * @param marker The reset marker written to the kernel log.
+ * @return 1 if a phase was seen, else 0.
+ */
+static int kmsg_phase(struct init_info *info, struct cycle *cyc, uint64_t t0,
+                      const char *marker)
+{
+    char msg[512];
+    uint64_t ts = 0, t = 0;
+    int i, seen = 0;
+
+    while (!kmsg_read(info, &ts, msg, sizeof(msg))) {
+        if (strlen(msg) == strlen(marker) - 1 &&
+            !strncmp(marker, msg, strlen(msg))) {
+            cyc->kmsg_t0 = ts;
+            continue;
+        }
+
+        /* in kernel time from our marker, arrival time without it */
+        t = cyc->kmsg_t0 && ts >= cyc->kmsg_t0 ?
+            (ts - cyc->kmsg_t0) * 1000 : stats_now_ns() - t0;
+        for (i = 0; i < nphases; i++) {
+            if (phases[i].filter.action == NULL && phases[i].text[0] &&
+                strstr(msg, phases[i].text)) {
+                set_phase(cyc, i, t);
+                seen = 1;
+            }
+        }
+        if (info->verbose) {
+            printf("%s: +%.3f ms kmsg %s\n", APP_NAME, t / 1e6, msg);
+        }
+    }
+
+    return seen;
+}
+
+/**
+ * @brief Match a uevent against the phases.
+ *
+ * @param info The init info.
+ * @param cyc The cycle.
+ * @param t0 Start of the cycle.
+ * @param ev The uevent.
+ * @return 1 if a phase was seen, else 0.
+ */
+static int uevent_phase(struct init_info *info, struct cycle *cyc,
+                        uint64_t t0, const struct uevent *ev)
+{
+    int i, seen = 0;
+
+    for (i = 0; i < nphases; i++) {
+        if (phases[i].filter.action == NULL ||
+            !uevent_match(ev, &phases[i].filter) ||
+            (phases[i].usb && !in_usb(info, ev->devpath))) {
+            continue;
+        }
+        set_phase(cyc, i, ev->ts - t0);
+        seen = 1;
+    }
+    if (info->verbose) {
+        printf("%s: +%.3f ms uevent %s %s\n", APP_NAME,
+               (ev->ts - t0) / 1e6, ev->action, ev->devpath);
+    }
+
+    return seen;
+}
+
+/**
+ * @brief Wait for the uevents and kernel log messages of a cycle.
+ *
+ * @param info The init info.
+ * @param cyc The cycle.
+ * @param t0 Start of the cycle.
+ * @param marker The reset marker written to the kernel log.
+ * @param until Return once this phase was seen, -1 to wait for the end of
+ * the initialization: bind or bundle seen and quiet for the settle time.
+ * @return 0 on success, -ETIMEDOUT or -errno on failure.
+ */
+static int wait_phases(struct init_info *info, struct cycle *cyc, uint64_t t0,
+                       const char *marker, int until)
+{
+    static struct uevent ev;
+    struct pollfd fds[2];
+    uint64_t deadline = t0 + info->timeout * 1000000000ULL, now = 0;
+    int timeout_ms = 0, ready = 0, ret = 0;
+
+    fds[0].fd = info->sock;
+    fds[0].events = POLLIN;
+    fds[1].fd = info->kmsg;
+    fds[1].events = POLLIN;
+
+    while (1) {
+        ready = until < 0 && (cyc->phase[PHASE_BIND] ||
+                              cyc->phase[PHASE_BUNDLE]);
+        if (until >= 0 && cyc->phase[until]) {
+            return 0;
+        }
+
+        now = stats_now_ns();
+        if (now > deadline) {
+            return -ETIMEDOUT;
+        }
+        timeout_ms = ready ? info->settle_ms :
+                     (int)((deadline - now) / 1000000) + 1;
+
+        ret = poll(fds, info->kmsg >= 0 ? 2 : 1, timeout_ms);
+        if (ret < 0) {
+            return -errno;
+        }
+        if (!ret) {
+            if (ready) {
+                return 0;
+            }
+            continue;
+        }
+
+        if (info->kmsg >= 0 && (fds[1].revents & POLLIN)) {
+            kmsg_phase(info, cyc, t0, marker);
+        }
+        if (fds[0].revents & POLLIN) {
+            /* times out at once on messages that are not kernel uevents */
+            ret = uevent_recv(info->sock, &ev, 0);
+            if (!ret) {
+                uevent_phase(info, cyc, t0, &ev);
+            } else if (ret != -ETIMEDOUT) {
+                return ret;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Reset the APBridge and time the initialization phases.
+ *
+ * @param info The init info.
+ * @param n The cycle number.
+ * @param cyc Returns the phase times.
+ * @return 0 on success, error code on failure.
+ */
+static int reset_cycle(struct init_info *info, int n, struct cycle *cyc)
+{
+    static struct uevent ev;
+    char marker[64], value[4], path[PATH_MAX], dir[PATH_MAX];
+    const char *attr = NULL;
+    uint64_t t0 = 0;
+    int ret = 0;
+
+    memset(cyc, 0, sizeof(*cyc));
+
+    /* skip what came before the reset */
+    while (!uevent_recv(info->sock, &ev, 0)) {
+    }
+    if (info->kmsg >= 0) {
+        lseek(info->kmsg, 0, SEEK_END);
+    }
+
+    snprintf(marker, sizeof(marker), "%s: reset cycle %d\n", APP_NAME, n);
+    t0 = stats_now_ns();
+    if (info->kmsg >= 0) {
+        kmsg_write(info, marker);
+    }
+
+    switch (info->method) {
+        case RESET_COMMAND:
+            if (system(info->command)) {
+                return -ECHILD;
+            }
+            break;
+        case RESET_AUTHORIZED:
+        case RESET_PORT:
+            if (info->method == RESET_AUTHORIZED) {
+                snprintf(dir, sizeof(dir), "%s", info->usb);
+                attr = "authorized";
+            } else {
+                /*
+                 * disabling the port removes the USB device directory,
+                 * the hub port directory it links to stays
+                 */
+                snprintf(path, sizeof(path), "%s/port", info->usb);
+                if (realpath(path, dir) == NULL) {
+                    return -errno;
+                }
+                attr = "disable";
+            }
+
+            snprintf(value, sizeof(value), "%d",
+                     info->method == RESET_AUTHORIZED ? 0 : 1);
+            ret = debugfs_set_attr(dir, attr, value, strlen(value));
+            if (!ret) {
+                ret = wait_phases(info, cyc, t0, marker, PHASE_DOWN);
+            }
+            if (ret) {
+                return ret;
+            }
+            snprintf(value, sizeof(value), "%d",
+                     info->method == RESET_AUTHORIZED ? 1 : 0);
+            ret = debugfs_set_attr(dir, attr, value, strlen(value));
+            if (ret) {
+                return ret;
+            }
+            break;
+    }
+
+    return wait_phases(info, cyc, t0, marker, -1);
+}
+
+static void record_cycle(const struct init_info *info, struct init_run *run,
+                         const struct cycle *cyc)
+{
+    uint64_t prev = 0, total = 0;
+    int i;
+
+    for (i = 0; i < nphases; i++) {
+        if (!cyc->phase[i]) {
+            continue;
+        }
+        if (i >= PHASE_BUILTIN) {
+            stats_hist_record(&run->phase[i], cyc->phase[i]);
+        } else {
+            stats_hist_record(&run->phase[i], cyc->phase[i] > prev ?
+                              cyc->phase[i] - prev : 0);
+            prev = cyc->phase[i];
+        }
+        if (cyc->phase[i] > total) {
+            total = cyc->phase[i];
+        }
+    }
+    stats_hist_record(&run->total, total);
+
+    if (info->verbose) {
+        for (i = 0; i < nphases; i++) {
+            if (cyc->phase[i]) {
+                printf("%s: %s at %.3f ms\n", APP_NAME, phases[i].name,
+                       cyc->phase[i] / 1e6);
+            }
+        }
+        printf("%s: %s kernel log times, total %.3f ms\n", APP_NAME,
+               cyc->kmsg_t0 ? "with" : "without", total / 1e6);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct init_info info;
+    static struct init_run run;
+    struct cycle cyc;
+    char name[48];
+    int options = 0, i = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.cycles = DEFAULT_CYCLES;
+    info.timeout = DEFAULT_TIMEOUT;
+    info.settle_ms = DEFAULT_SETTLE_MS;
+    info.kmsg = -1;
+
+    while ((options = getopt(argc, argv, "c:d:k:m:n:r:s:t:v")) != -1) {
+        switch (options) {
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                snprintf(info.usb, sizeof(info.usb), "%s/%s", USB_DEVICES,
+                         optarg);
+                break;
+            case 'k':
+                ret = add_marker(optarg);
+                break;
+            case 'm':
+                if (!strcmp(optarg, "authorized")) {
+                    info.method = RESET_AUTHORIZED;
+                } else if (!strcmp(optarg, "port")) {
+                    info.method = RESET_PORT;
+                } else {
+                    ret = -EINVAL;
+                }
+                break;
+            case 'n':
+                info.cycles = atoi(optarg);
+                break;
+            case 'r':
+                info.command = optarg;
+                break;
+            case 's':
+                info.settle_ms = atoi(optarg);
+                break;
+            case 't':
+                info.timeout = atoi(optarg);
+                break;
+            case 'v':
+                info.verbose = 1;
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (info.command != NULL) {
+        info.method = RESET_COMMAND;
+    }
+    if (!info.usb[0]) {
+        find_usb_dev(info.usb, sizeof(info.usb));
+    }
+    if ((!info.usb[0] && info.method != RESET_COMMAND) || info.cycles < 1 ||
+        info.timeout < 1 || info.settle_ms < 1) {
+        usage();
+        return -EINVAL;
+    }
+    snprintf(info.usbname, sizeof(info.usbname), "%s",
+             info.usb[0] ? strrchr(info.usb, '/') + 1 : "");
+
+    stats_hist_init(&run.total);
+    for (i = 0; i < nphases; i++) {
+        stats_hist_init(&run.phase[i]);
+    }
+
+    info.sock = uevent_open();
+    if (info.sock < 0) {
+        ret = info.sock;
+    }
+    /* without it the markers are timed on arrival */
+    info.kmsg = open(KMSG, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (info.kmsg < 0) {
+        info.kmsg = open(KMSG, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    }
+
+    for (i = 0; i < info.cycles && !ret; i++) {
+        ret = reset_cycle(&info, i, &cyc);
+        if (!ret) {
+            record_cycle(&info, &run, &cyc);
+        }
+    }
+
+    uevent_close(info.sock);
+    if (info.kmsg >= 0) {
+        close(info.kmsg);
+    }
+
+    for (i = 0; i < nphases; i++) {
+        if (run.phase[i].count) {
+            snprintf(name, sizeof(name), "%s_%s",
+                     i < PHASE_BUILTIN ? "init" : "marker", phases[i].name);
+            stats_hist_report(info.case_id, name, &run.phase[i]);
+        }
+    }
+    stats_hist_report(info.case_id, "init_total", &run.total);
+
+    print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+
+    return ret;
+}
@@ -1,16 +1,544 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "apbr_power"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <dirent.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+/* the first greybus host device, its parents carry the runtime PM state */
+#define GB_HOST_DEVICE "/sys/bus/greybus/devices/greybus1"
+#define GPIO_CLASS     "/sys/class/gpio"
+#define HWMON_CLASS    "/sys/class/hwmon"
+/* Default runtime PM autosuspend delay, in ms */
+#define DEFAULT_DELAY_MS 100
+/* Default number of suspend/wake cycles */
+#define DEFAULT_CYCLES 20
+/* Default number of warm operations after each wake */
+#define DEFAULT_BURST 100
+/* Give up waiting for suspend this long after the delay, in ms */
+#define SUSPEND_TIMEOUT_MS 2000
+/* runtime_status and rail poll interval, in us */
+#define POLL_US 1000
+#define DEV_LEN (PATH_MAX / 2)
+
+enum rail_kind {
+    RAIL_NONE,
+    /* energyN_input, cumulative uJ */
+    RAIL_ENERGY,
+    /* powerN_input, uW */
+    RAIL_POWER,
+    /* currN_input mA times inN_input mV */
+    RAIL_CURRENT,
+};
+
+/* a power rail, read as an energy counter */
+struct rail {
+    int kind;
+    char dev[DEV_LEN];
+    int channel;
+    uint64_t last_ns;
+    double power_uw;
+    double energy_uj;
+};
+
+struct power_info {
+    int case_id;
+    char dev[DEV_LEN];
+    int delay_ms;
+    int cycles;
+    int burst;
+    int gpio;
+    struct rail rail;
+};
+
+struct power_run {
+    struct stats_hist wake;
+    struct stats_hist warm;
+    struct stats_hist suspend;
+    /* energy of the warm bursts */
+    double burst_uj;
+    long burst_ops;
+    double suspended_uj;
+    uint64_t suspended_ns;
+    /* energy of wake to suspended again, the suspended floor included */
+    double active_uj;
+    uint64_t active_ns;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d device] [-p pin] [-s delay_ms] "
+            "[-n cycles] [-k ops]\n        [-r hwmonN[:channel]] "
+            "[-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -d: sysfs device dir with the runtime PM power/ "
+            "files (default the\n        APBridge USB device of "
+            "greybus1).\n");
+    fprintf(stdout, "    -p: pin of the first greybus GPIO chip read as "
+            "the operation\n        (default 0).\n");
+    fprintf(stdout, "    -s: autosuspend delay in ms (default %d).\n",
+            DEFAULT_DELAY_MS);
+    fprintf(stdout, "    -n: suspend/wake cycles (default %d).\n",
+            DEFAULT_CYCLES);
+    fprintf(stdout, "    -k: warm operations after each wake (default "
+            "%d).\n", DEFAULT_BURST);
+    fprintf(stdout, "    -r: hwmon power rail (default the first with an "
+            "energy, power or\n        current input).\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Example: %s -s 50 -n 100 -r hwmon2:1\n", APP_NAME);
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Find the APBridge device that carries runtime PM.
+ *
+ * The first parent of the greybus host device with autosuspend support,
+ * the USB device of an ES2 bridge.
+ *
+ * @param dev Returns the sysfs dir.
+ * @param len The dev buffer size.
+ * @return 0 on success, -ENODEV if there is none.
+ */
+static int find_power_dev(char *dev, int len)
+{
+    char path[PATH_MAX], attr[PATH_MAX];
+
+    if (realpath(GB_HOST_DEVICE, path) == NULL || strlen(path) >= DEV_LEN) {
+        return -ENODEV;
+    }
+
+    while (strcmp(path, "/sys/devices") && strcmp(path, "/")) {
+        snprintf(attr, sizeof(attr), "%.*s/power/autosuspend_delay_ms",
+                 DEV_LEN, path);
+        if (!access(attr, W_OK)) {
+            snprintf(dev, len, "%s", path);
+            return 0;
+        }
+        snprintf(path, sizeof(path), "%s", dirname(path));
+    }
+
+    return -ENODEV;
+}
+
+static int get_power_attr(struct power_info *info, const char *attr,
+                          char *buf, int len)
+{
+    char name[64];
+    int ret = 0;
+
+    snprintf(name, sizeof(name), "power/%s", attr);
+    ret = debugfs_get_attr(info->dev, name, buf, len - 1);
+    buf[strcspn(buf, "\n")] = '\0';
+
+    return ret;
+}
+
+static int set_power_attr(struct power_info *info, const char *attr,
+                          const char *value)
+{
+    char name[64], buf[32];
+
+    snprintf(name, sizeof(name), "power/%s", attr);
+    snprintf(buf, sizeof(buf), "%s", value);
+    return debugfs_set_attr(info->dev, name, buf, strlen(buf));
+}
+
+static int read_hwmon(const char *dev, const char *input, int channel,
+                      double *value)
+{
+    char attr[32], buf[32];
+    int ret = 0;
+
+    snprintf(attr, sizeof(attr), "%s%d_input", input, channel);
+    ret = debugfs_get_attr((char *)dev, attr, buf, sizeof(buf) - 1);
+    if (!ret) {
+        *value = strtod(buf, NULL);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Pick the kind of a hwmon rail from its inputs.
+ *
+ * @param rail The rail, dev and channel set.
+ * @return 0 on success, -ENODEV if the channel has no usable input.
+ */
+static int probe_rail(struct rail *rail)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    double v = 0;
+
+    if (!read_hwmon(rail->dev, "energy", rail->channel, &v)) {
+        rail->kind = RAIL_ENERGY;
+    } else if (!read_hwmon(rail->dev, "power", rail->channel, &v)) {
+        rail->kind = RAIL_POWER;
+    } else if (!read_hwmon(rail->dev, "curr", rail->channel, &v) &&
+               !read_hwmon(rail->dev, "in", rail->channel, &v)) {
+        rail->kind = RAIL_CURRENT;
+    } else {
+        rail->kind = RAIL_NONE;
+        return -ENODEV;
+    }
+
     return 0;
 }
+
+/* the first hwmon device with a readable rail on channel 1 */
+static void find_rail(struct rail *rail)
+{
+    struct dirent *entry;
+    DIR *dir = NULL;
+
+    dir = opendir(HWMON_CLASS);
+    if (dir == NULL) {
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "hwmon", 5)) {
+            continue;
+        }
+        snprintf(rail->dev, sizeof(rail->dev), "%s/%s", HWMON_CLASS,
+                 entry->d_name);
+        rail->channel = 1;
+        if (!probe_rail(rail)) {
+            break;
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * @brief Sample a rail, integrating power into energy.
+ *
+ * Energy counters are read as is, power is held from the previous sample.
+ *
+ * @param rail The rail.
+ * @return the energy in uJ since an arbitrary start.
+ */
+static double rail_sample(struct rail *rail)
+{
+    uint64_t now = stats_now_ns();
+    double v = 0, mv = 0;
+
+    switch (rail->kind) {
+        case RAIL_ENERGY:
+            if (!read_hwmon(rail->dev, "energy", rail->channel, &v)) {
+                rail->energy_uj = v;
+            }
+            break;
+        case RAIL_POWER:
+        case RAIL_CURRENT:
+            if (rail->last_ns) {
+                rail->energy_uj += rail->power_uw *
+                                   (now - rail->last_ns) / 1e9;
+            }
+            if (rail->kind == RAIL_POWER &&
+                !read_hwmon(rail->dev, "power", rail->channel, &v)) {
+                rail->power_uw = v;
+            } else if (rail->kind == RAIL_CURRENT &&
+                       !read_hwmon(rail->dev, "curr", rail->channel, &v) &&
+                       !read_hwmon(rail->dev, "in", rail->channel, &mv)) {
+                rail->power_uw = v * mv;
+            }
+            break;
+        default:
+            break;
+    }
+    rail->last_ns = now;
+
+    return rail->energy_uj;
+}
+
+/**
+ * @brief Run the operation, a greybus GPIO value read.
+ *
+ * @param info The power info.
+ * @return the time of the operation in ns, 0 on failure.
+ */
+static uint64_t run_op(struct power_info *info)
+{
+    char value[8];
+    uint64_t t0 = stats_now_ns();
+
+    if (gpio_get_attr(info->gpio, GPIO_ATTR_VALUE, value,
+                      sizeof(value) - 1)) {
+        return 0;
+    }
+
+    return stats_now_ns() - t0;
+}
+
+/**
+ * @brief Wait for the bridge to runtime suspend.
+ *
+ * @param info The power info.
+ * @param wait_ns Returns the time to suspended.
+ * @return 0 on success, -ETIMEDOUT if it stays active.
+ */
+static int wait_suspended(struct power_info *info, uint64_t *wait_ns)
+{
+    char status[32];
+    uint64_t t0 = stats_now_ns(), end = 0;
+
+    end = t0 + (uint64_t)(info->delay_ms + SUSPEND_TIMEOUT_MS) * 1000000ULL;
+    while (stats_now_ns() < end) {
+        rail_sample(&info->rail);
+        if (!get_power_attr(info, "runtime_status", status, sizeof(status)) &&
+            !strcmp(status, "suspended")) {
+            *wait_ns = stats_now_ns() - t0;
+            return 0;
+        }
+        usleep(POLL_US);
+    }
+
+    return -ETIMEDOUT;
+}
+
+/**
+ * @brief Measure one suspend/wake cycle.
+ *
+ * Starts suspended: the first operation wakes the bridge, a burst of warm
+ * operations follows, then the bridge is left idle to suspend again. The
+ * suspended power is sampled over the autosuspend delay before the wake.
+ *
+ * @param info The power info.
+ * @param run Accumulates the measurements.
+ * @return 0 on success, error code on failure.
+ */
+static int run_cycle(struct power_info *info, struct power_run *run)
+{
+    uint64_t t0 = 0, t = 0, wait_ns = 0;
+    double e_idle = 0, e_wake = 0, e_burst = 0;
+    int i, ret = 0;
+
+    /* suspended baseline */
+    t0 = stats_now_ns();
+    e_idle = rail_sample(&info->rail);
+    usleep(info->delay_ms * 1000);
+    e_wake = rail_sample(&info->rail);
+    run->suspended_uj += e_wake - e_idle;
+    run->suspended_ns += stats_now_ns() - t0;
+
+    t0 = stats_now_ns();
+    t = run_op(info);
+    if (!t) {
+        return -EIO;
+    }
+    stats_hist_record(&run->wake, t);
+
+    e_burst = rail_sample(&info->rail);
+    for (i = 0; i < info->burst; i++) {
+        t = run_op(info);
+        if (!t) {
+            return -EIO;
+        }
+        stats_hist_record(&run->warm, t);
+    }
+    run->burst_uj += rail_sample(&info->rail) - e_burst;
+    run->burst_ops += info->burst;
+
+    ret = wait_suspended(info, &wait_ns);
+    if (ret) {
+        return ret;
+    }
+    stats_hist_record(&run->suspend, wait_ns);
+
+    /* wake to suspended again */
+    run->active_uj += rail_sample(&info->rail) - e_wake;
+    run->active_ns += stats_now_ns() - t0;
+
+    return 0;
+}
+
+static void print_result(struct power_info *info, struct power_run *run)
+{
+    double floor_uw = 0;
+    long cycles = run->wake.count;
+
+    stats_hist_report(info->case_id, "wake", &run->wake);
+    stats_hist_report(info->case_id, "warm", &run->warm);
+    stats_hist_report(info->case_id, "suspend", &run->suspend);
+    if (run->wake.count && run->warm.count) {
+        print_test_case_perf(info->case_id, "wake_penalty",
+                             ((double)stats_hist_percentile(&run->wake, 50) -
+                              (double)stats_hist_percentile(&run->warm, 50)) /
+                             1000.0, "us");
+    }
+
+    if (info->rail.kind == RAIL_NONE || !cycles || !run->suspended_ns) {
+        return;
+    }
+
+    floor_uw = run->suspended_uj * 1e9 / run->suspended_ns;
+    print_test_case_perf(info->case_id, "suspended_power", floor_uw / 1000.0,
+                         "mW");
+    print_test_case_perf(info->case_id, "cycle_energy",
+                         (run->active_uj -
+                          floor_uw * run->active_ns / 1e9) / cycles, "uJ");
+    if (run->burst_ops) {
+        print_test_case_perf(info->case_id, "op_energy",
+                             run->burst_uj / run->burst_ops, "uJ");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct power_info info;
+    static struct power_run run;
+    char saved_control[16] = "", saved_delay[16] = "";
+    char gpiostr[PATH_MAX], buf[16];
+    int have_control = 0, have_delay = 0;
+    uint64_t wait_ns = 0;
+    int options = 0, pin = 0, base = 0, ngpio = 0, i = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.delay_ms = DEFAULT_DELAY_MS;
+    info.cycles = DEFAULT_CYCLES;
+    info.burst = DEFAULT_BURST;
+
+    while ((options = getopt(argc, argv, "c:d:k:n:p:r:s:")) != -1) {
+        switch (options) {
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                snprintf(info.dev, sizeof(info.dev), "%s", optarg);
+                break;
+            case 'k':
+                info.burst = atoi(optarg);
+                break;
+            case 'n':
+                info.cycles = atoi(optarg);
+                break;
+            case 'p':
+                pin = atoi(optarg);
+                break;
+            case 'r':
+                info.rail.channel = 1;
+                if (sscanf(optarg, "hwmon%*d:%d", &info.rail.channel) < 0) {
+                    ret = -EINVAL;
+                }
+                snprintf(info.rail.dev, sizeof(info.rail.dev), "%s/%.*s",
+                         HWMON_CLASS, (int)strcspn(optarg, ":"), optarg);
+                break;
+            case 's':
+                info.delay_ms = atoi(optarg);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (!info.dev[0]) {
+        find_power_dev(info.dev, sizeof(info.dev));
+    }
+    if (!info.dev[0] || info.delay_ms < 0 || info.cycles < 1 ||
+        info.burst < 0 || pin < 0) {
+        usage();
+        return -EINVAL;
+    }
+
+    if (info.rail.dev[0]) {
+        ret = probe_rail(&info.rail);
+    } else {
+        find_rail(&info.rail);
+    }
+
+    if (!ret) {
+        ret = gb_find_gpio_chip(0, &base, &ngpio);
+    }
+    if (!ret && pin >= ngpio) {
+        ret = -EINVAL;
+    }
+    if (!ret) {
+        info.gpio = base + pin;
+        snprintf(gpiostr, sizeof(gpiostr), "%s/gpio%d", GPIO_CLASS,
+                 info.gpio);
+        if (access(gpiostr, F_OK)) {
+            ret = gpio_export(info.gpio);
+        }
+    }
+    if (!ret) {
+        snprintf(buf, sizeof(buf), "in");
+        ret = gpio_set_attr(info.gpio, GPIO_ATTR_DIRECTION, buf, strlen(buf));
+    }
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+        return ret;
+    }
+
+    /* runtime PM under our control, restored at the end */
+    have_control = !get_power_attr(&info, "control", saved_control,
+                                   sizeof(saved_control));
+    have_delay = !get_power_attr(&info, "autosuspend_delay_ms", saved_delay,
+                                 sizeof(saved_delay));
+    snprintf(buf, sizeof(buf), "%d", info.delay_ms);
+    ret = set_power_attr(&info, "autosuspend_delay_ms", buf);
+    if (!ret) {
+        ret = set_power_attr(&info, "control", "auto");
+    }
+
+    stats_hist_init(&run.wake);
+    stats_hist_init(&run.warm);
+    stats_hist_init(&run.suspend);
+    if (!ret) {
+        ret = wait_suspended(&info, &wait_ns);
+    }
+    for (i = 0; i < info.cycles && !ret; i++) {
+        ret = run_cycle(&info, &run);
+    }
+
+    /* only restore what could be read */
+    if (have_control) {
+        set_power_attr(&info, "control", saved_control);
+    }
+    if (have_delay) {
+        set_power_attr(&info, "autosuspend_delay_ms", saved_delay);
+    }
+    gpio_attr_release(info.gpio);
+
+    print_result(&info, &run);
+    print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+
+    return ret;
+}
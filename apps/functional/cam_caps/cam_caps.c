@@ -1,16 +1,108 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "cam_caps"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+/* Max number of modes one device lists */
+#define MAX_MODES 64
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d device] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -d: V4L2 capture node, defaults to the first "
+            "Greybus camera.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Lists the pixel formats and frame sizes cam_test "
+            "streams.\n");
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    static struct cam_mode modes[MAX_MODES];
+    struct gb_enum_dev video;
+    char dev[PATH_MAX] = "", fourcc[5];
+    int options = 0, case_id = 0, fd = -1, nmodes = 0, i = 0, ret = 0;
+
+    while ((options = getopt(argc, argv, "c:d:")) != -1) {
+        switch (options) {
+            case 'c':
+                case_id = atoi(optarg);
+                break;
+            case 'd':
+                snprintf(dev, sizeof(dev), "%s", optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (!dev[0] && gb_enum(GB_ENUM_MASK(GB_ENUM_VIDEO), &video, 1) == 1) {
+        snprintf(dev, sizeof(dev), "%s", video.node);
+    }
+    if (!dev[0]) {
+        usage();
+        return -EINVAL;
+    }
+
+    fd = open_video_dev(dev);
+    if (fd < 0) {
+        ret = -errno;
+    } else {
+        nmodes = cam_enum_modes(fd, modes, MAX_MODES);
+        ret = nmodes < 0 ? nmodes : (nmodes ? 0 : -ENODEV);
+        close(fd);
+    }
+
+    for (i = 0; i < nmodes; i++) {
+        printf("%s: %s %s %ux%u\n", APP_NAME, dev,
+               cam_fourcc(modes[i].pixelformat, fourcc), modes[i].width,
+               modes[i].height);
+    }
+    if (nmodes > 0) {
+        print_test_case_perf(case_id, "modes", nmodes, "modes");
+    }
+
+    if (ret) {
+        print_test_case_result(APP_NAME, case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(case_id, ret);
+    }
+
+    return ret;
 }
@@ -1,16 +1,652 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "cam_test"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/limits.h>
+#include <linux/videodev2.h>
+
 #include "libfwtest.h"
 
+/* Default number of queued capture buffers */
+#define DEFAULT_BUFFERS 4
+/* Default number of measured frames per mode */
+#define DEFAULT_FRAMES 120
+/* Default number of frames dropped before measuring, sensor settling */
+#define DEFAULT_WARMUP 10
+/* Default time to wait for one frame, in ms */
+#define DEFAULT_TIMEOUT_MS 2000
+/* Max number of capture buffers */
+#define MAX_BUFFERS 32
+/* Max number of modes one device lists */
+#define MAX_MODES 64
+
+struct cam_info {
+    int case_id;
+    char dev[PATH_MAX];
+    enum v4l2_memory memory;
+    int nbufs;
+    int frames;
+    int warmup;
+    int timeout_ms;
+    int allow_drops;
+    /* only stream this format and size, when set */
+    char fourcc[5];
+    uint32_t width;
+    uint32_t height;
+};
+
+struct cam_buf {
+    void *addr;
+    size_t len;
+    /* dmabuf exported from the buffer in DMABUF mode, else -1 */
+    int dmafd;
+};
+
+/* one streamed mode */
+struct cam_run {
+    struct cam_buf bufs[MAX_BUFFERS];
+    int nbufs;
+    /* buffers the driver granted, kept for the report */
+    int queued;
+    uint32_t width;
+    uint32_t height;
+    uint64_t frames;
+    uint64_t dropped;
+    uint64_t errors;
+    uint64_t prev_ts;
+    uint64_t prev_interval;
+    uint32_t prev_seq;
+    uint64_t jitter_sum;
+    uint64_t jitter_count;
+    double nominal_fps;
+    int monotonic;
+    struct stats_hist interval;
+    struct stats_hist latency;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d device] [-m mmap|dmabuf] [-n buffers] "
+            "[-f frames] [-w warmup]\n        [-p fourcc] [-s WxH] [-t ms] "
+            "[-a] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -d: V4L2 capture node, defaults to the first "
+            "Greybus camera.\n");
+    fprintf(stdout, "    -m: buffer memory, mmap or dmabuf (default mmap). "
+            "dmabuf queues\n        buffers exported from the device "
+            "itself.\n");
+    fprintf(stdout, "    -n: number of capture buffers (default %d).\n",
+            DEFAULT_BUFFERS);
+    fprintf(stdout, "    -f: measured frames per mode (default %d).\n",
+            DEFAULT_FRAMES);
+    fprintf(stdout, "    -w: frames skipped before measuring (default "
+            "%d).\n", DEFAULT_WARMUP);
+    fprintf(stdout, "    -p: only stream this pixel format, e.g. UYVY.\n");
+    fprintf(stdout, "    -s: only stream this frame size, e.g. 1920x1080.\n");
+    fprintf(stdout, "    -t: time to wait for one frame in ms (default "
+            "%d).\n", DEFAULT_TIMEOUT_MS);
+    fprintf(stdout, "    -a: report dropped frames without failing the "
+            "test.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "All modes listed by cam_caps are streamed one after "
+            "the other.\n");
+    fprintf(stdout, "Example: %s -d /dev/video0 -m dmabuf -n 6 -s 1280x720\n",
+            APP_NAME);
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Read a clock in nanoseconds.
+ *
+ * V4L2 buffer timestamps are CLOCK_MONOTONIC, stats_now_ns() is not.
+ *
+ * @param clock The clock.
+ * @return the clock time in ns.
+ */
+static uint64_t clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Release the capture buffers of a mode.
+ *
+ * @param fd The video device.
+ * @param memory The memory type of the queue.
+ * @param run The mode.
+ */
+static void free_buffers(int fd, uint32_t memory, struct cam_run *run)
+{
+    struct v4l2_requestbuffers req;
+    int i = 0;
+
+    for (i = 0; i < run->nbufs; i++) {
+        if (run->bufs[i].addr != NULL) {
+            munmap(run->bufs[i].addr, run->bufs[i].len);
+        }
+        if (run->bufs[i].dmafd >= 0) {
+            close(run->bufs[i].dmafd);
+        }
+    }
+    run->nbufs = 0;
+
+    memset(&req, 0, sizeof(req));
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = memory;
+    ioctl(fd, VIDIOC_REQBUFS, &req);
+}
+
+/**
+ * @brief Allocate and map the driver's capture buffers.
+ *
+ * @param fd The video device.
+ * @param run The mode.
+ * @param count Number of buffers to ask for.
+ * @param map Non zero to mmap the buffers.
+ * @return 0 on success, -errno on failure.
+ */
+static int alloc_mmap_buffers(int fd, struct cam_run *run, int count, int map)
+{
+    struct v4l2_requestbuffers req;
+    struct v4l2_buffer buf;
+    int i = 0;
+
+    memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0) {
+        return -errno;
+    }
+    if (req.count < 2 || req.count > MAX_BUFFERS) {
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < (int)req.count; i++) {
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (ioctl(fd, VIDIOC_QUERYBUF, &buf) < 0) {
+            return -errno;
+        }
+
+        run->bufs[i].len = buf.length;
+        run->bufs[i].addr = NULL;
+        run->bufs[i].dmafd = -1;
+        run->nbufs = i + 1;
+        if (map) {
+            run->bufs[i].addr = mmap(NULL, buf.length, PROT_READ, MAP_SHARED,
+                                     fd, buf.m.offset);
+            if (run->bufs[i].addr == MAP_FAILED) {
+                run->bufs[i].addr = NULL;
+                return -errno;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Set up the capture buffers of a mode.
+ *
+ * In DMABUF mode every driver buffer is exported as a dmabuf, the driver
+ * buffers are freed, and the dmabufs are imported back into the queue.
+ * The dmabufs keep the buffer memory alive, so the device captures into
+ * memory it did not allocate for this queue, as with buffers shared with
+ * a display or encoder.
+ *
+ * @param fd The video device.
+ * @param info The camera info.
+ * @param run The mode.
+ * @return 0 on success, -errno on failure.
+ */
+static int setup_buffers(int fd, const struct cam_info *info,
+                         struct cam_run *run)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    struct v4l2_requestbuffers req;
+    struct v4l2_exportbuffer exp;
+    int ret = 0, i = 0;
+
+    ret = alloc_mmap_buffers(fd, run, info->nbufs,
+                             info->memory == V4L2_MEMORY_MMAP);
+    if (info->memory == V4L2_MEMORY_MMAP) {
+        return ret;
+    }
+    if (ret) {
+        goto err_mmap;
+    }
+
+    for (i = 0; i < run->nbufs; i++) {
+        memset(&exp, 0, sizeof(exp));
+        exp.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        exp.index = i;
+        exp.flags = O_RDWR | O_CLOEXEC;
+        if (ioctl(fd, VIDIOC_EXPBUF, &exp) < 0) {
+            ret = -errno;
+            goto err_mmap;
+        }
+        run->bufs[i].dmafd = exp.fd;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0) {
+        ret = -errno;
+        goto err_mmap;
+    }
+
+    req.count = run->nbufs;
+    req.memory = V4L2_MEMORY_DMABUF;
+    if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0) {
+        return -errno;
+    }
+    if ((int)req.count < run->nbufs) {
+        return -ENOMEM;
+    }
+
     return 0;
+
+err_mmap:
+    /* the caller frees a DMABUF queue, this one is still MMAP */
+    free_buffers(fd, V4L2_MEMORY_MMAP, run);
+    return ret;
+}
+
+/**
+ * @brief Queue one capture buffer.
+ *
+ * @param fd The video device.
+ * @param info The camera info.
+ * @param run The mode.
+ * @param index The buffer index.
+ * @return 0 on success, -errno on failure.
+ */
+static int queue_buffer(int fd, const struct cam_info *info,
+                        const struct cam_run *run, int index)
+{
+    struct v4l2_buffer buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = info->memory;
+    buf.index = index;
+    if (info->memory == V4L2_MEMORY_DMABUF) {
+        buf.m.fd = run->bufs[index].dmafd;
+        buf.length = run->bufs[index].len;
+    }
+
+    return ioctl(fd, VIDIOC_QBUF, &buf) < 0 ? -errno : 0;
+}
+
+/**
+ * @brief Account one dequeued frame.
+ *
+ * Drops are gaps in the driver's frame sequence numbers. The capture
+ * latency is the time from the driver timestamp to the dequeue, only
+ * kept when the driver stamps frames with CLOCK_MONOTONIC.
+ *
+ * @param run The mode.
+ * @param buf The dequeued buffer.
+ * @param now_ns CLOCK_MONOTONIC time of the dequeue.
+ * @param measure Non zero once the warmup frames are done.
+ */
+static void account_frame(struct cam_run *run, const struct v4l2_buffer *buf,
+                          uint64_t now_ns, int measure)
+{
+    uint64_t ts = (uint64_t)buf->timestamp.tv_sec * 1000000000ULL +
+                  buf->timestamp.tv_usec * 1000ULL;
+    uint64_t interval = 0;
+
+    if (measure) {
+        run->frames++;
+        if (buf->flags & V4L2_BUF_FLAG_ERROR) {
+            run->errors++;
+        }
+        if (run->prev_ts && buf->sequence > run->prev_seq) {
+            run->dropped += buf->sequence - run->prev_seq - 1;
+        }
+        if (run->prev_ts && ts > run->prev_ts) {
+            interval = ts - run->prev_ts;
+            stats_hist_record(&run->interval, interval);
+            if (run->prev_interval) {
+                run->jitter_sum += interval > run->prev_interval ?
+                                   interval - run->prev_interval :
+                                   run->prev_interval - interval;
+                run->jitter_count++;
+            }
+        }
+        if (run->monotonic && now_ns > ts) {
+            stats_hist_record(&run->latency, now_ns - ts);
+        }
+    }
+
+    run->prev_interval = interval;
+    run->prev_ts = ts;
+    run->prev_seq = buf->sequence;
+}
+
+/**
+ * @brief Stream one mode and measure its frames.
+ *
+ * @param fd The video device.
+ * @param info The camera info.
+ * @param mode The mode to stream.
+ * @param run Returns the measurements.
+ * @return 0 on success, -errno on failure.
+ */
+static int stream_mode(int fd, const struct cam_info *info,
+                       const struct cam_mode *mode, struct cam_run *run)
+{
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    struct v4l2_format fmt;
+    struct v4l2_streamparm parm;
+    struct v4l2_buffer buf;
+    struct pollfd pfd;
+    uint64_t seen = 0, total = info->warmup + info->frames;
+    int ret = 0, i = 0, streaming = 0;
+
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = mode->width;
+    fmt.fmt.pix.height = mode->height;
+    fmt.fmt.pix.pixelformat = mode->pixelformat;
+    fmt.fmt.pix.field = V4L2_FIELD_ANY;
+    if (ioctl(fd, VIDIOC_S_FMT, &fmt) < 0) {
+        return -errno;
+    }
+    /* the driver may adjust the size, report what streams */
+    run->width = fmt.fmt.pix.width;
+    run->height = fmt.fmt.pix.height;
+
+    memset(&parm, 0, sizeof(parm));
+    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (!ioctl(fd, VIDIOC_G_PARM, &parm) &&
+        parm.parm.capture.timeperframe.numerator) {
+        run->nominal_fps = (double)parm.parm.capture.timeperframe.denominator /
+                           parm.parm.capture.timeperframe.numerator;
+    }
+
+    ret = setup_buffers(fd, info, run);
+    run->queued = run->nbufs;
+    for (i = 0; !ret && i < run->nbufs; i++) {
+        ret = queue_buffer(fd, info, run, i);
+    }
+    if (!ret) {
+        ret = ioctl(fd, VIDIOC_STREAMON, &type) < 0 ? -errno : 0;
+        streaming = !ret;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (!ret && seen < total) {
+        ret = poll(&pfd, 1, info->timeout_ms);
+        if (ret <= 0) {
+            ret = ret ? -errno : -ETIMEDOUT;
+            break;
+        }
+        ret = 0;
+
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = info->memory;
+        if (ioctl(fd, VIDIOC_DQBUF, &buf) < 0) {
+            if (errno != EAGAIN) {
+                ret = -errno;
+            }
+            continue;
+        }
+
+        run->monotonic = (buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) ==
+                         V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+        account_frame(run, &buf, clock_ns(CLOCK_MONOTONIC),
+                      seen >= (uint64_t)info->warmup);
+        seen++;
+
+        ret = queue_buffer(fd, info, run, buf.index);
+    }
+
+    if (streaming) {
+        ioctl(fd, VIDIOC_STREAMOFF, &type);
+    }
+    free_buffers(fd, info->memory, run);
+
+    return ret;
+}
+
+/**
+ * @brief Print the result of one mode.
+ *
+ * The achieved rate is the mean driver timestamp interval, so dropped
+ * frames lower it. Jitter is the mean change between consecutive frame
+ * intervals.
+ *
+ * @param info The camera info.
+ * @param mode The streamed mode.
+ * @param run The measurements.
+ */
+static void print_result(const struct cam_info *info,
+                         const struct cam_mode *mode,
+                         const struct cam_run *run)
+{
+    double mean = stats_hist_mean(&run->interval);
+    double fps = mean > 0 ? 1e9 / mean : 0.0;
+    double jitter = run->jitter_count ?
+                    run->jitter_sum / 1000.0 / run->jitter_count : 0.0;
+    char fourcc[5], name[32], metric[64];
+
+    cam_fourcc(mode->pixelformat, fourcc);
+    snprintf(name, sizeof(name), "%s_%ux%u", fourcc, run->width, run->height);
+
+    printf("\n%s: mode=%s memory=%s buffers=%d frames=%llu dropped=%llu "
+           "errors=%llu fps=%.2f nominal_fps=%.2f jitter_us=%.1f "
+           "p50_latency_us=%.1f p99_latency_us=%.1f\n",
+           APP_NAME, name,
+           info->memory == V4L2_MEMORY_MMAP ? "mmap" : "dmabuf",
+           run->queued,
+           (unsigned long long)run->frames,
+           (unsigned long long)run->dropped,
+           (unsigned long long)run->errors, fps, run->nominal_fps, jitter,
+           stats_hist_percentile(&run->latency, 50.0) / 1000.0,
+           stats_hist_percentile(&run->latency, 99.0) / 1000.0);
+
+    snprintf(metric, sizeof(metric), "%s_fps", name);
+    print_test_case_perf(info->case_id, metric, fps, "fps");
+    snprintf(metric, sizeof(metric), "%s_jitter", name);
+    print_test_case_perf(info->case_id, metric, jitter, "us");
+    snprintf(metric, sizeof(metric), "%s_dropped", name);
+    print_test_case_perf(info->case_id, metric, run->dropped, "frames");
+    snprintf(metric, sizeof(metric), "%s_frame_interval", name);
+    stats_hist_report(info->case_id, metric, &run->interval);
+    if (run->latency.count) {
+        snprintf(metric, sizeof(metric), "%s_latency", name);
+        stats_hist_report(info->case_id, metric, &run->latency);
+    }
+}
+
+/**
+ * @brief Check if a mode is selected with -p and -s.
+ *
+ * @param info The camera info.
+ * @param mode The mode.
+ * @return Non zero if the mode is streamed.
+ */
+static int mode_selected(const struct cam_info *info,
+                         const struct cam_mode *mode)
+{
+    char fourcc[5];
+
+    if (info->fourcc[0] &&
+        strcasecmp(cam_fourcc(mode->pixelformat, fourcc), info->fourcc)) {
+        return 0;
+    }
+    if (info->width &&
+        (mode->width != info->width || mode->height != info->height)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    struct cam_info info;
+    static struct cam_mode modes[MAX_MODES];
+    static struct cam_run run;
+    int options = 0, fd = -1, nmodes = 0, streamed = 0, i = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.memory = V4L2_MEMORY_MMAP;
+    info.nbufs = DEFAULT_BUFFERS;
+    info.frames = DEFAULT_FRAMES;
+    info.warmup = DEFAULT_WARMUP;
+    info.timeout_ms = DEFAULT_TIMEOUT_MS;
+
+    while ((options = getopt(argc, argv, "ac:d:f:m:n:p:s:t:w:")) != -1) {
+        switch (options) {
+            case 'a':
+                info.allow_drops = 1;
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                snprintf(info.dev, sizeof(info.dev), "%s", optarg);
+                break;
+            case 'f':
+                info.frames = atoi(optarg);
+                break;
+            case 'm':
+                if (!strcmp(optarg, "mmap")) {
+                    info.memory = V4L2_MEMORY_MMAP;
+                } else if (!strcmp(optarg, "dmabuf")) {
+                    info.memory = V4L2_MEMORY_DMABUF;
+                } else {
+                    ret = -EINVAL;
+                }
+                break;
+            case 'n':
+                info.nbufs = atoi(optarg);
+                break;
+            case 'p':
+                snprintf(info.fourcc, sizeof(info.fourcc), "%s", optarg);
+                break;
+            case 's':
+                if (sscanf(optarg, "%ux%u", &info.width, &info.height) != 2) {
+                    ret = -EINVAL;
+                }
+                break;
+            case 't':
+                info.timeout_ms = atoi(optarg);
+                break;
+            case 'w':
+                info.warmup = atoi(optarg);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (!info.dev[0]) {
+        gb_find_video_dev(0, info.dev, sizeof(info.dev));
+    }
+
+    if (!info.dev[0] || info.nbufs < 2 || info.nbufs > MAX_BUFFERS ||
+        info.frames < 2 || info.warmup < 0 || info.timeout_ms < 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    fd = open_video_dev(info.dev);
+    if (fd < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    nmodes = cam_enum_modes(fd, modes, MAX_MODES);
+    if (nmodes < 0) {
+        ret = nmodes;
+        goto out;
+    }
+
+    for (i = 0; i < nmodes && !ret; i++) {
+        if (!mode_selected(&info, &modes[i])) {
+            continue;
+        }
+
+        memset(&run, 0, sizeof(run));
+        stats_hist_init(&run.interval);
+        stats_hist_init(&run.latency);
+
+        ret = stream_mode(fd, &info, &modes[i], &run);
+        print_result(&info, &modes[i], &run);
+        if (!ret && !info.allow_drops && (run.dropped || run.errors)) {
+            ret = -EIO;
+        }
+        streamed++;
+    }
+
+    if (!ret && !streamed) {
+        ret = -ENODEV;
+    }
+
+out:
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
 }
@@ -1,16 +1,340 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "gpio_debounce"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+
 #include "libfwtest.h"
 
+/* Default pulse width sweep, in us */
+#define DEFAULT_WIDTHS "50,100,200,500,1000,2000,5000,10000,20000"
+/* Default pulses per width */
+#define DEFAULT_PULSES 50
+/* Default wait for the events of a pulse once it ends, in ms */
+#define DEFAULT_WINDOW_MS 100
+
+struct debounce_info {
+    int case_id;
+    int chipnum;
+    int out;
+    int in;
+    int pulses;
+    int window_ms;
+    struct sweep widths;
+    int out_fd;
+    int event_fd;
+    clockid_t ts_clock;
+    int clock_known;
+};
+
+/* the result of one pulse width */
+struct width_run {
+    int detected;
+    int falling;
+    int extra;
+    int spurious;
+    uint64_t width_sum;
+    struct stats_hist latency;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-p offset] [-l offset] [-w widths] "
+            "[-n pulses] [-t ms]\n        [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -p: output line offset within the first Greybus "
+            "GPIO\n        controller (default 0).\n");
+    fprintf(stdout, "    -l: input line offset wired back to the output "
+            "(default 1).\n");
+    fprintf(stdout, "    -w: comma separated pulse widths in us "
+            "(default %s).\n", DEFAULT_WIDTHS);
+    fprintf(stdout, "    -n: pulses per width (default %d).\n",
+            DEFAULT_PULSES);
+    fprintf(stdout, "    -t: wait for the events of a pulse once it ends, "
+            "in ms (default %d).\n", DEFAULT_WINDOW_MS);
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Pulses are driven through the chardev line handle, "
+            "the shortest width is\nbound by one greybus operation; "
+            "the achieved width is reported.\n");
+    fprintf(stdout, "Example: %s -p 8 -l 9 -w 100,1000,10000 -n 200\n",
+            APP_NAME);
+}
+
+static uint64_t clock_ns(clockid_t clk)
+{
+    struct timespec ts;
+
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t abs_diff(uint64_t a, uint64_t b)
+{
+    return a > b ? a - b : b - a;
+}
+
+static int set_output(struct debounce_info *info, uint8_t level)
+{
+    return gpio_cdev_set_values(info->out_fd, &level, 1);
+}
+
+/* the time of t in the clock of the kernel event timestamps */
+static uint64_t event_clock(struct debounce_info *info, uint64_t ts,
+                            uint64_t mono, uint64_t real)
+{
+    /* the event clock changed from realtime to monotonic in 5.7 */
+    if (!info->clock_known) {
+        info->ts_clock = abs_diff(ts, mono) < abs_diff(ts, real) ?
+                         CLOCK_MONOTONIC : CLOCK_REALTIME;
+        info->clock_known = 1;
+    }
+
+    return info->ts_clock == CLOCK_MONOTONIC ? mono : real;
+}
+
+/**
+ * @brief Drive one pulse and collect the input events it causes.
+ *
+ * The latency is from the completion of the rising drive, when the
+ * module has moved the line, to the kernel timestamp of the rising event:
+ * debounce plus the interrupt path.
+ *
+ * @param info The debounce info.
+ * @param width_us Pulse width.
+ * @param run Accumulates the result.
+ * @return 0 on success, error code on failure.
+ */
+static int run_pulse(struct debounce_info *info, int width_us,
+                     struct width_run *run)
+{
+    uint64_t t_mono = 0, t_real = 0, start = 0, end = 0, ts = 0, t = 0;
+    int edge = 0, rising = 0, events = 0, ret = 0;
+
+    /* events before the pulse are false triggers */
+    while (!gpio_cdev_read_event(info->event_fd, 0, &ts, &edge)) {
+        run->spurious++;
+    }
+
+    start = clock_ns(CLOCK_MONOTONIC);
+    ret = set_output(info, 1);
+    t_real = clock_ns(CLOCK_REALTIME);
+    t_mono = clock_ns(CLOCK_MONOTONIC);
+    if (ret) {
+        return ret;
+    }
+    while (clock_ns(CLOCK_MONOTONIC) - start < width_us * 1000ULL) {
+    }
+    end = clock_ns(CLOCK_MONOTONIC);
+    ret = set_output(info, 0);
+    if (ret) {
+        return ret;
+    }
+    run->width_sum += end - start;
+
+    while (!(ret = gpio_cdev_read_event(info->event_fd, info->window_ms, &ts,
+                                        &edge))) {
+        events++;
+        if (edge == GPIO_EDGE_FALLING) {
+            run->falling++;
+            /* the falling event of a full pulse ends it */
+            if (rising) {
+                break;
+            }
+            continue;
+        }
+        if (!rising++) {
+            run->detected++;
+            t = event_clock(info, ts, t_mono, t_real);
+            stats_hist_record(&run->latency, ts > t ? ts - t : 0);
+        }
+    }
+    if (events > 2) {
+        run->extra += events - 2;
+    }
+
+    return ret == -ETIMEDOUT ? 0 : ret;
+}
+
+static void print_width(struct debounce_info *info, int width_us,
+                        struct width_run *run)
+{
+    char name[48];
+
+    snprintf(name, sizeof(name), "w%d_detect", width_us);
+    print_test_case_perf(info->case_id, name,
+                         100.0 * run->detected / info->pulses, "%");
+    snprintf(name, sizeof(name), "w%d_achieved_width", width_us);
+    print_test_case_perf(info->case_id, name,
+                         run->width_sum / 1000.0 / info->pulses, "us");
+    if (run->extra || run->spurious) {
+        snprintf(name, sizeof(name), "w%d_false_events", width_us);
+        print_test_case_perf(info->case_id, name,
+                             run->extra + run->spurious, "events");
+    }
+    if (run->latency.count) {
+        snprintf(name, sizeof(name), "w%d_latency", width_us);
+        print_test_case_perf(info->case_id, name,
+                             stats_hist_percentile(&run->latency, 50) /
+                             1000.0, "us");
+    }
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    struct debounce_info info;
+    static struct width_run run;
+    static struct stats_hist latency;
+    const struct gb_discovery *disc = NULL;
+    int options = 0, i = 0, j = 0, ngpio = 0, ret = 0;
+    int pass_us = -1, reject_us = -1, false_events = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.in = 1;
+    info.pulses = DEFAULT_PULSES;
+    info.window_ms = DEFAULT_WINDOW_MS;
+    info.out_fd = info.event_fd = -1;
+    sweep_parse(&info.widths, DEFAULT_WIDTHS, 1, INT32_MAX);
+
+    while ((options = getopt(argc, argv, "c:l:n:p:t:w:")) != -1) {
+        switch (options) {
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'l':
+                info.in = atoi(optarg);
+                break;
+            case 'n':
+                info.pulses = atoi(optarg);
+                break;
+            case 'p':
+                info.out = atoi(optarg);
+                break;
+            case 't':
+                info.window_ms = atoi(optarg);
+                break;
+            case 'w':
+                ret = sweep_parse(&info.widths, optarg, 1, INT32_MAX);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (info.pulses < 1 || info.window_ms < 1 || info.out < 0 ||
+        info.in < 0 || info.out == info.in) {
+        usage();
+        return -EINVAL;
+    }
+
+    disc = gb_discover(0);
+    if (disc->ngpio_chips < 1) {
+        ret = -ENODEV;
+    } else {
+        info.chipnum = disc->gpio_chips[0].chipnum;
+        ngpio = disc->gpio_chips[0].ngpio;
+        if (info.out >= ngpio || info.in >= ngpio) {
+            ret = -EINVAL;
+        }
+    }
+
+    /* both lines on the chardev, the sysfs path is too slow for glitches */
+    if (!ret) {
+        info.out_fd = gpio_cdev_request(info.chipnum, &info.out, 1, 1, NULL,
+                                        APP_NAME);
+        if (info.out_fd < 0) {
+            ret = info.out_fd;
+        }
+    }
+    if (!ret) {
+        info.event_fd = gpio_cdev_request_event(info.chipnum, info.in,
+                                                GPIO_EDGE_BOTH, APP_NAME);
+        if (info.event_fd < 0) {
+            ret = info.event_fd;
+        }
+    }
+
+    stats_hist_init(&latency);
+    for (i = 0; i < info.widths.count && !ret; i++) {
+        memset(&run, 0, sizeof(run));
+        stats_hist_init(&run.latency);
+        for (j = 0; j < info.pulses && !ret; j++) {
+            ret = run_pulse(&info, info.widths.value[i], &run);
+        }
+        if (ret) {
+            break;
+        }
+
+        print_width(&info, info.widths.value[i], &run);
+        false_events += run.extra + run.spurious;
+        if (!run.detected) {
+            reject_us = info.widths.value[i];
+        } else if (run.detected == info.pulses) {
+            if (pass_us < 0) {
+                pass_us = info.widths.value[i];
+            }
+            stats_hist_merge(&latency, &run.latency);
+        }
+    }
+
+    if (info.out_fd >= 0) {
+        gpio_cdev_release(info.out_fd);
+    }
+    if (info.event_fd >= 0) {
+        gpio_cdev_release(info.event_fd);
+    }
+
+    if (!ret) {
+        if (reject_us >= 0) {
+            print_test_case_perf(info.case_id, "max_rejected_width",
+                                 reject_us, "us");
+        }
+        if (pass_us >= 0) {
+            print_test_case_perf(info.case_id, "min_detected_width",
+                                 pass_us, "us");
+            stats_hist_report(info.case_id, "added_latency", &latency);
+        }
+        print_test_case_perf(info.case_id, "false_events", false_events,
+                             "events");
+    }
+
+    print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+
+    return ret;
 }
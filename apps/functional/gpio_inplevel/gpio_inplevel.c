@@ -1,16 +1,495 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "gpio_inplevel"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+/* Default sampled lines, offsets within the first Greybus GPIO chip */
+#define DEFAULT_LINES "0"
+/* Default sampling time, in seconds */
+#define DEFAULT_DURATION 5
+/* Default sample buffer size, in samples */
+#define DEFAULT_SAMPLES (1024 * 1024)
+/* Max sampled lines, GPIOHANDLES_MAX of one line handle */
+#define MAX_LINES 64
+/* Sleep instead of spinning when the next sample is this far, in ns */
+#define SLEEP_NS 200000
+
+/* one sample, the levels of all lines read by one ioctl */
+struct inplevel_sample {
+    /* start of the read, ns from the start of the run */
+    uint64_t ts;
+    /* bit n is the level of line n of the set */
+    uint64_t levels;
+    /* time the read took */
+    uint32_t call_ns;
+    int32_t ret;
+};
+
+struct inplevel_info {
+    int case_id;
+    int chipnum;
+    int ngpio;
+    int nlines;
+    int offsets[MAX_LINES];
+    int duration;
+    int rate;
+    int max_samples;
+    char *vcd;
+};
+
+struct inplevel_result {
+    int count;
+    uint64_t errors;
+    uint64_t missed;
+    uint64_t elapsed_ns;
+    uint64_t transitions[MAX_LINES];
+    struct stats_hist interval;
+    struct stats_hist call;
+    struct stats_running jitter;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-p offsets] [-t seconds] [-r rate] "
+            "[-n samples] [-o file.vcd]\n        [-c case_id]\n",
+            APP_NAME);
+    fprintf(stdout, "    -p: comma separated input line offsets within "
+            "the first Greybus\n        GPIO controller, up to %d "
+            "(default %s).\n", MAX_LINES, DEFAULT_LINES);
+    fprintf(stdout, "    -t: sampling time in seconds (default %d).\n",
+            DEFAULT_DURATION);
+    fprintf(stdout, "    -r: sample rate in Hz (default 0, as fast as "
+            "possible).\n");
+    fprintf(stdout, "    -n: sample buffer size, sampling ends when it is "
+            "full\n        (default %d).\n", DEFAULT_SAMPLES);
+    fprintf(stdout, "    -o: write the samples as a value change dump.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "All lines are read by one GPIOHANDLE_GET_LINE_VALUES "
+            "ioctl per sample into\na buffer allocated up front; the "
+            "interval jitter is its standard deviation.\n");
+    fprintf(stdout, "Example: %s -p 0,1,2,3 -r 1000 -o /data/levels.vcd\n",
+            APP_NAME);
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Parse the comma separated line offsets.
+ *
+ * @param info The app info.
+ * @param list The list from command line.
+ * @return 0 on success, -EINVAL on bad list.
+ */
+static int parse_lines(struct inplevel_info *info, const char *list)
+{
+    char buf[256];
+    char *tok, *save = NULL;
+    int i;
+
+    snprintf(buf, sizeof(buf), "%s", list);
+    info->nlines = 0;
+
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        if (info->nlines == MAX_LINES || atoi(tok) < 0) {
+            return -EINVAL;
+        }
+        for (i = 0; i < info->nlines; i++) {
+            if (info->offsets[i] == atoi(tok)) {
+                return -EINVAL;
+            }
+        }
+        info->offsets[info->nlines++] = atoi(tok);
+    }
+
+    return info->nlines ? 0 : -EINVAL;
+}
+
+/**
+ * @brief Wait for the time of the next paced sample.
+ *
+ * @param next Time of the next sample, moved on when it was missed.
+ * @param period Sample period in ns.
+ * @param result Counts the missed samples.
+ */
+static void pace(uint64_t *next, uint64_t period,
+                 struct inplevel_result *result)
+{
+    uint64_t now = stats_now_ns();
+
+    if (now > *next + period) {
+        /* too late for one or more, start over from now */
+        result->missed += (now - *next) / period;
+        *next = now;
+        return;
+    }
+    if (*next > now + SLEEP_NS) {
+        usleep((*next - now - SLEEP_NS / 2) / 1000);
+    }
+    while (stats_now_ns() < *next) {
+    }
+}
+
+/**
+ * @brief Sample the input levels into the buffer.
+ *
+ * Only the read and its timestamps are done per sample, everything else
+ * is left to analyze() once the run is over.
+ *
+ * @param info The app info.
+ * @param fd The line handle of all lines.
+ * @param samples The sample buffer, max_samples long.
+ * @param result Returns the number of samples taken.
+ * @return 0 on success, error code if no read succeeded.
+ */
+static int sample(const struct inplevel_info *info, int fd,
+                  struct inplevel_sample *samples,
+                  struct inplevel_result *result)
+{
+    uint8_t values[MAX_LINES];
+    uint64_t start, end, next, period = 0, t0 = 0, t1 = 0, levels;
+    struct inplevel_sample *s = samples;
+    int i, ret = 0;
+
+    if (info->rate) {
+        period = 1000000000ULL / info->rate;
+    }
+
+    start = stats_now_ns();
+    end = start + (uint64_t)info->duration * 1000000000ULL;
+    next = start;
+
+    for (t1 = start; t1 < end && s < samples + info->max_samples; s++) {
+        if (period) {
+            pace(&next, period, result);
+            next += period;
+        }
+
+        t0 = stats_now_ns();
+        ret = gpio_cdev_get_values(fd, values, info->nlines);
+        t1 = stats_now_ns();
+
+        levels = 0;
+        for (i = 0; i < info->nlines; i++) {
+            levels |= (uint64_t)!!values[i] << i;
+        }
+        s->ts = t0 - start;
+        s->levels = levels;
+        s->call_ns = t1 - t0;
+        s->ret = ret;
+    }
+
+    result->count = s - samples;
+    result->elapsed_ns = t1 - start;
+
+    return ret;
+}
+
+/**
+ * @brief Compute the statistics of the buffer.
+ *
+ * @param info The app info.
+ * @param samples The sample buffer.
+ * @param result The result, count set.
+ */
+static void analyze(const struct inplevel_info *info,
+                    const struct inplevel_sample *samples,
+                    struct inplevel_result *result)
+{
+    const struct inplevel_sample *prev = NULL, *s = NULL;
+    uint64_t diff;
+    int i, n;
+
+    stats_hist_init(&result->interval);
+    stats_hist_init(&result->call);
+    stats_running_init(&result->jitter);
+
+    for (n = 0; n < result->count; n++) {
+        s = &samples[n];
+        if (s->ret) {
+            result->errors++;
+            continue;
+        }
+        stats_hist_record(&result->call, s->call_ns);
+        if (prev != NULL) {
+            stats_hist_record(&result->interval, s->ts - prev->ts);
+            stats_running_add(&result->jitter, s->ts - prev->ts);
+            diff = s->levels ^ prev->levels;
+            for (i = 0; diff && i < info->nlines; i++) {
+                result->transitions[i] += (diff >> i) & 1;
+            }
+        }
+        prev = s;
+    }
+}
+
+/**
+ * @brief Write the samples as a value change dump.
+ *
+ * One wire per line, named by its offset, in ns since the start.
+ *
+ * @param info The app info.
+ * @param samples The sample buffer.
+ * @param count Number of samples.
+ * @return 0 on success, -errno on failure.
+ */
+static int write_vcd(const struct inplevel_info *info,
+                     const struct inplevel_sample *samples, int count)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    uint64_t last = 0, diff;
+    int i, n, first = 1;
+    FILE *f = NULL;
+
+    f = fopen(info->vcd, "w");
+    if (f == NULL) {
+        return -errno;
+    }
+
+    fprintf(f, "$version %s $end\n$timescale 1ns $end\n"
+            "$scope module gpiochip%d $end\n", APP_NAME, info->chipnum);
+    for (i = 0; i < info->nlines; i++) {
+        /* identifier codes are printable characters from '!' */
+        fprintf(f, "$var wire 1 %c line%d $end\n", '!' + i,
+                info->offsets[i]);
+    }
+    fprintf(f, "$upscope $end\n$enddefinitions $end\n");
+
+    for (n = 0; n < count; n++) {
+        if (samples[n].ret) {
+            continue;
+        }
+        diff = first ? ~0ULL : samples[n].levels ^ last;
+        if (diff) {
+            fprintf(f, "#%llu\n", (unsigned long long)samples[n].ts);
+            for (i = 0; i < info->nlines; i++) {
+                if ((diff >> i) & 1) {
+                    fprintf(f, "%d%c\n",
+                            (int)((samples[n].levels >> i) & 1), '!' + i);
+                }
+            }
+        }
+        last = samples[n].levels;
+        first = 0;
+    }
+    if (count) {
+        fprintf(f, "#%llu\n", (unsigned long long)samples[count - 1].ts);
+    }
+
+    if (fclose(f)) {
+        return -errno;
+    }
     return 0;
 }
+
+/* integer square root, keeps the app free of libm */
+static uint64_t isqrt(uint64_t value)
+{
+    uint64_t root = 0, bit = 1ULL << 62;
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return root;
+}
+
+/**
+ * @brief Print the sampling result.
+ *
+ * @param info The app info.
+ * @param result The analyzed result.
+ */
+static void print_result(const struct inplevel_info *info,
+                         const struct inplevel_result *result)
+{
+    double secs = result->elapsed_ns / 1e9;
+    double rate = secs > 0 ? (result->count - result->errors) / secs : 0.0;
+    double jitter = isqrt(stats_running_variance(&result->jitter));
+    uint64_t transitions = 0;
+    char prefix[64];
+    int i;
+
+    printf("\n%s: lines=%d samples=%d errors=%llu missed=%llu "
+           "samples_per_s=%.1f interval_avg_us=%.1f jitter_us=%.1f "
+           "call_p50_us=%.1f call_p99_us=%.1f\n",
+           APP_NAME, info->nlines, result->count,
+           (unsigned long long)result->errors,
+           (unsigned long long)result->missed, rate,
+           stats_running_mean(&result->jitter) / 1000.0, jitter / 1000.0,
+           stats_hist_percentile(&result->call, 50.0) / 1000.0,
+           stats_hist_percentile(&result->call, 99.0) / 1000.0);
+    for (i = 0; i < info->nlines; i++) {
+        printf("%s: line%d transitions=%llu\n", APP_NAME, info->offsets[i],
+               (unsigned long long)result->transitions[i]);
+        transitions += result->transitions[i];
+    }
+
+    snprintf(prefix, sizeof(prefix), "%s: interval", APP_NAME);
+    stats_hist_dump(prefix, &result->interval);
+
+    print_test_case_perf(info->case_id, "samples_per_s", rate, "Hz");
+    print_test_case_perf(info->case_id, "jitter", jitter / 1000.0, "us");
+    print_test_case_perf(info->case_id, "missed", result->missed,
+                         "samples");
+    print_test_case_perf(info->case_id, "errors", result->errors,
+                         "samples");
+    print_test_case_perf(info->case_id, "transitions", transitions,
+                         "transitions");
+    stats_hist_report(info->case_id, "interval", &result->interval);
+    stats_hist_report(info->case_id, "call", &result->call);
+}
+
+int main(int argc, char **argv)
+{
+    struct inplevel_info info;
+    static struct inplevel_result result;
+    const struct gb_discovery *disc = NULL;
+    struct inplevel_sample *samples = NULL;
+    size_t size = 0;
+    int options = 0, fd = -1, i = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.duration = DEFAULT_DURATION;
+    info.max_samples = DEFAULT_SAMPLES;
+    parse_lines(&info, DEFAULT_LINES);
+
+    while ((options = getopt(argc, argv, "c:n:o:p:r:t:")) != -1) {
+        switch (options) {
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'n':
+                info.max_samples = atoi(optarg);
+                break;
+            case 'o':
+                info.vcd = optarg;
+                break;
+            case 'p':
+                ret = parse_lines(&info, optarg);
+                break;
+            case 'r':
+                info.rate = atoi(optarg);
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (info.duration < 1 || info.rate < 0 || info.rate > 1000000000 ||
+        info.max_samples < 2) {
+        usage();
+        return -EINVAL;
+    }
+
+    disc = gb_discover(0);
+    if (disc->ngpio_chips < 1 || disc->gpio_chips[0].chipnum < 0) {
+        ret = -ENODEV;
+        goto out;
+    }
+    info.chipnum = disc->gpio_chips[0].chipnum;
+    info.ngpio = disc->gpio_chips[0].ngpio;
+    for (i = 0; i < info.nlines; i++) {
+        if (info.offsets[i] >= info.ngpio) {
+            ret = -EINVAL;
+            goto out;
+        }
+    }
+
+    /* touch and lock every page so sampling takes no page fault */
+    size = (size_t)info.max_samples * sizeof(*samples);
+    samples = malloc(size);
+    if (samples == NULL) {
+        ret = -ENOMEM;
+        goto out;
+    }
+    memset(samples, 0, size);
+    mlock(samples, size);
+
+    fd = gpio_cdev_request(info.chipnum, info.offsets, info.nlines, 0, NULL,
+                           APP_NAME);
+    if (fd < 0) {
+        ret = fd;
+        goto out;
+    }
+
+    ret = sample(&info, fd, samples, &result);
+    analyze(&info, samples, &result);
+    print_result(&info, &result);
+
+    /* one failed read is reported as an error count, none read is fatal */
+    if (result.errors < (uint64_t)result.count) {
+        ret = 0;
+    }
+    if (!ret && info.vcd != NULL) {
+        ret = write_vcd(&info, samples, result.count);
+    }
+
+out:
+    if (fd >= 0) {
+        gpio_cdev_release(fd);
+    }
+    if (samples != NULL) {
+        munlock(samples, size);
+        free(samples);
+    }
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
+}
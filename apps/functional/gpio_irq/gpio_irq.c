@@ -1,16 +1,519 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "gpio_irq"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+
 #include "libfwtest.h"
 
+/* Default number of edges timed for the latency measurement */
+#define DEFAULT_EDGES 1000
+/* Max number of edges timed for the latency measurement */
+#define MAX_EDGES 100000
+/* Number of edges generated per step of the event rate sweep */
+#define BURST_EDGES 256
+/* Wait for one edge before it counts as lost, in milliseconds */
+#define EDGE_TIMEOUT_MS 1000
+/* Wait for late events after a burst, in milliseconds */
+#define DRAIN_TIMEOUT_MS 100
+
+enum irq_mode {
+    MODE_SYSFS,
+    MODE_CDEV,
+    MODE_MAX,
+};
+
+static const char *mode_name[MODE_MAX] = {
+    "sysfs",
+    "cdev",
+};
+
+/* edge spacing of the event rate sweep in microseconds, 0 is back to back */
+static const int burst_period_us[] = {
+    1000, 500, 200, 100, 50, 20, 10, 5, 0,
+};
+
+struct irq_info {
+    int case_id;
+    int base;
+    int ngpio;
+    int chipnum;
+    int out;
+    int in;
+    int edges;
+    int modes;
+};
+
+struct irq_ctx {
+    const struct irq_info *info;
+    enum irq_mode mode;
+    int out_fd;
+    int event_fd;
+    int level;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-p offset] [-l offset] [-n edges] "
+            "[-m mode] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -p: output line offset within the first Greybus "
+            "GPIO\n        controller (default 0).\n");
+    fprintf(stdout, "    -l: input line offset wired back to the output "
+            "(default 1).\n");
+    fprintf(stdout, "    -n: number of edges timed for latency "
+            "(default %d).\n", DEFAULT_EDGES);
+    fprintf(stdout, "    -m: sysfs, cdev or all (default all).\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Example: %s -p 8 -l 9 -m cdev -n 5000\n", APP_NAME);
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Read a clock.
+ *
+ * Unlike stats_now_ns() this takes the clock id, the wakeup time has to
+ * be in the clock of the kernel event timestamps.
+ *
+ * @param clk The clock id.
+ * @return current time in nanoseconds.
+ */
+static uint64_t clock_ns(clockid_t clk)
+{
+    struct timespec ts;
+
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t abs_diff(uint64_t a, uint64_t b)
+{
+    return a > b ? a - b : b - a;
+}
+
+/**
+ * @brief Request the output and arm both edges on the input.
+ *
+ * The output is always driven through a chardev line handle when the
+ * kernel has one, so both modes measure the same trigger path and only
+ * differ in how the interrupt reaches user space. When the chardev
+ * request fails the output falls back to sysfs.
+ *
+ * @param ctx The IRQ context.
+ * @return 0 on success, error code on failure.
+ */
+static int mode_setup(struct irq_ctx *ctx)
+{
+    const struct irq_info *info = ctx->info;
+    char value[8];
+    int ret = 0;
+
+    ctx->level = 0;
+    ctx->event_fd = -1;
+    ctx->out_fd = info->chipnum < 0 ? -ENODEV :
+                  gpio_cdev_request(info->chipnum, &info->out, 1, 1, NULL,
+                                    APP_NAME);
+    if (ctx->out_fd < 0) {
+        /* no usable chardev, sysfs mode still works */
+        ret = gpio_export(info->base + info->out);
+        if (!ret) {
+            ret = gpio_set_attr(info->base + info->out, GPIO_ATTR_DIRECTION,
+                                "low", 3);
+        }
+        if (ret) {
+            return ret;
+        }
+    }
+
+    if (ctx->mode == MODE_CDEV) {
+        ctx->event_fd = gpio_cdev_request_event(info->chipnum, info->in,
+                                                GPIO_EDGE_BOTH, APP_NAME);
+        return ctx->event_fd < 0 ? ctx->event_fd : 0;
+    }
+
+    ret = gpio_export(info->base + info->in);
+    if (!ret) {
+        ret = gpio_set_attr(info->base + info->in, GPIO_ATTR_DIRECTION,
+                            "in", 2);
+    }
+    if (!ret) {
+        ret = gpio_set_attr(info->base + info->in, GPIO_ATTR_EDGE,
+                            "both", 4);
+    }
+    if (!ret) {
+        /* clear the pending state left by arming the edge */
+        ret = gpio_get_attr(info->base + info->in, GPIO_ATTR_VALUE, value,
+                            sizeof(value));
+    }
+
+    return ret;
+}
+
+static void mode_teardown(struct irq_ctx *ctx)
+{
+    const struct irq_info *info = ctx->info;
+
+    if (ctx->out_fd >= 0) {
+        gpio_cdev_release(ctx->out_fd);
+    } else {
+        gpio_unexport(info->base + info->out);
+    }
+
+    if (ctx->mode == MODE_CDEV) {
+        gpio_cdev_release(ctx->event_fd);
+    } else {
+        gpio_set_attr(info->base + info->in, GPIO_ATTR_EDGE, "none", 4);
+        gpio_unexport(info->base + info->in);
+    }
+}
+
+/**
+ * @brief Flip the output level.
+ *
+ * @param ctx The IRQ context.
+ * @return 0 on success, error code on failure.
+ */
+static int toggle_output(struct irq_ctx *ctx)
+{
+    uint8_t val;
+
+    ctx->level = !ctx->level;
+    val = ctx->level;
+    if (ctx->out_fd >= 0) {
+        return gpio_cdev_set_values(ctx->out_fd, &val, 1);
+    }
+
+    return gpio_set_attr(ctx->info->base + ctx->info->out, GPIO_ATTR_VALUE,
+                         ctx->level ? "1" : "0", 1);
+}
+
+/**
+ * @brief Wait for one interrupt on the input.
+ *
+ * @param ctx The IRQ context.
+ * @param timeout_ms poll() timeout.
+ * @param timestamp Returns the kernel event time, 0 in sysfs mode.
+ * @return 0 on success, -ETIMEDOUT on timeout, error code on failure.
+ */
+static int wait_event(struct irq_ctx *ctx, int timeout_ms, uint64_t *timestamp)
+{
+    int ret = 0;
+
+    *timestamp = 0;
+    if (ctx->mode == MODE_CDEV) {
+        return gpio_cdev_read_event(ctx->event_fd, timeout_ms, timestamp,
+                                    NULL);
+    }
+
+    ret = gpio_wait_edge(ctx->info->base + ctx->info->in, timeout_ms);
+    return ret < 0 ? ret : 0;
+}
+
+/**
+ * @brief Time the delivery of single edges.
+ *
+ * Wakeup latency runs from just before the output is driven until the
+ * waiting poll() returns. In cdev mode the kernel event timestamp also
+ * splits that into interrupt latency and the wakeup of user space.
+ *
+ * @param ctx The IRQ context.
+ * @return 0 on success, error code if no edge was delivered.
+ */
+static int run_latency(struct irq_ctx *ctx)
+{
+    const struct irq_info *info = ctx->info;
+    static struct stats_hist wake, irq;
+    uint64_t t0_mono, t0_real, t1, ts;
+    uint64_t lost = 0;
+    clockid_t ts_clock = CLOCK_MONOTONIC;
+    char metric[32];
+    int i = 0, ret = 0;
+
+    stats_hist_init(&wake);
+    stats_hist_init(&irq);
+
+    for (i = 0; i < info->edges; i++) {
+        t0_real = clock_ns(CLOCK_REALTIME);
+        t0_mono = clock_ns(CLOCK_MONOTONIC);
+        ret = toggle_output(ctx);
+        if (ret) {
+            return ret;
+        }
+
+        ret = wait_event(ctx, EDGE_TIMEOUT_MS, &ts);
+        t1 = clock_ns(CLOCK_MONOTONIC);
+        if (ret == -ETIMEDOUT) {
+            lost++;
+            continue;
+        } else if (ret) {
+            return ret;
+        }
+        stats_hist_record(&wake, t1 - t0_mono);
+
+        if (ts == 0) {
+            continue;
+        }
+        /* the event clock changed from realtime to monotonic in 5.7 */
+        if (irq.count == 0) {
+            ts_clock = abs_diff(ts, t0_mono) < abs_diff(ts, t0_real) ?
+                       CLOCK_MONOTONIC : CLOCK_REALTIME;
+        }
+        t0_mono = ts_clock == CLOCK_MONOTONIC ? t0_mono : t0_real;
+        stats_hist_record(&irq, ts > t0_mono ? ts - t0_mono : 0);
+    }
+
+    printf("\n%s: mode=%s edges=%d lost=%llu wake_p50_us=%.1f "
+           "wake_p99_us=%.1f wake_max_us=%.1f\n", APP_NAME,
+           mode_name[ctx->mode], info->edges, (unsigned long long)lost,
+           stats_hist_percentile(&wake, 50.0) / 1000.0,
+           stats_hist_percentile(&wake, 99.0) / 1000.0,
+           stats_hist_percentile(&wake, 100.0) / 1000.0);
+    snprintf(metric, sizeof(metric), "%s_wake", mode_name[ctx->mode]);
+    stats_hist_report(info->case_id, metric, &wake);
+
+    if (irq.count) {
+        printf("%s: mode=%s irq_p50_us=%.1f irq_p99_us=%.1f "
+               "irq_max_us=%.1f clock=%s\n", APP_NAME, mode_name[ctx->mode],
+               stats_hist_percentile(&irq, 50.0) / 1000.0,
+               stats_hist_percentile(&irq, 99.0) / 1000.0,
+               stats_hist_percentile(&irq, 100.0) / 1000.0,
+               ts_clock == CLOCK_MONOTONIC ? "monotonic" : "realtime");
+        snprintf(metric, sizeof(metric), "%s_irq", mode_name[ctx->mode]);
+        stats_hist_report(info->case_id, metric, &irq);
+    }
+
+    return wake.count ? 0 : -ETIMEDOUT;
+}
+
+/**
+ * @brief Generate one burst of edges and count the delivered events.
+ *
+ * Events are drained between edges while waiting for the next one, so a
+ * shortfall means the kernel dropped or coalesced them.
+ *
+ * @param ctx The IRQ context.
+ * @param period_us Edge spacing in microseconds.
+ * @param rate Returns the achieved edge rate in Hz.
+ * @return number of delivered events, error code on failure.
+ */
+static int run_burst(struct irq_ctx *ctx, int period_us, double *rate)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    uint64_t start, next, ts;
+    int i = 0, events = 0, ret = 0;
+
+    start = clock_ns(CLOCK_MONOTONIC);
+    next = start;
+
+    for (i = 0; i < BURST_EDGES; i++) {
+        ret = toggle_output(ctx);
+        if (ret) {
+            return ret;
+        }
+        next += (uint64_t)period_us * 1000;
+
+        do {
+            ret = wait_event(ctx, 0, &ts);
+            if (!ret) {
+                events++;
+            } else if (ret != -ETIMEDOUT) {
+                return ret;
+            }
+        } while (clock_ns(CLOCK_MONOTONIC) < next);
+    }
+
+    *rate = BURST_EDGES * 1e9 / (clock_ns(CLOCK_MONOTONIC) - start);
+
+    while (!(ret = wait_event(ctx, DRAIN_TIMEOUT_MS, &ts))) {
+        events++;
+    }
+
+    return ret == -ETIMEDOUT ? events : ret;
+}
+
+/**
+ * @brief Sweep the edge rate up until events are lost.
+ *
+ * @param ctx The IRQ context.
+ * @return 0 on success, error code on failure.
+ */
+static int run_rate(struct irq_ctx *ctx)
+{
+    double rate = 0.0, max_rate = 0.0;
+    char metric[32];
+    int i = 0, events = 0;
+    int nsteps = sizeof(burst_period_us) / sizeof(burst_period_us[0]);
+
+    for (i = 0; i < nsteps; i++) {
+        events = run_burst(ctx, burst_period_us[i], &rate);
+        if (events < 0) {
+            return events;
+        }
+
+        printf("%s: mode=%s period_us=%d rate_hz=%.0f edges=%d "
+               "events=%d\n", APP_NAME, mode_name[ctx->mode],
+               burst_period_us[i], rate, BURST_EDGES, events);
+        if (events < BURST_EDGES) {
+            break;
+        }
+        max_rate = rate;
+    }
+
+    printf("%s: mode=%s max_rate_hz=%.0f\n", APP_NAME, mode_name[ctx->mode],
+           max_rate);
+    snprintf(metric, sizeof(metric), "%s_max_rate", mode_name[ctx->mode]);
+    print_test_case_perf(ctx->info->case_id, metric, max_rate, "Hz");
+
     return 0;
 }
+
+/**
+ * @brief Parse the -m option.
+ *
+ * @param arg The mode name.
+ * @return bit mask of modes to run, 0 on bad name.
+ */
+static int parse_modes(const char *arg)
+{
+    int i = 0;
+
+    if (!strcmp(arg, "all")) {
+        return (1 << MODE_MAX) - 1;
+    }
+
+    for (i = 0; i < MODE_MAX; i++) {
+        if (!strcmp(arg, mode_name[i])) {
+            return 1 << i;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct irq_info info;
+    struct irq_ctx ctx;
+    const struct gb_discovery *disc = NULL;
+    int options = 0, i = 0, ret = 0, all_modes = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.in = 1;
+    info.edges = DEFAULT_EDGES;
+    info.modes = parse_modes("all");
+
+    while ((options = getopt(argc, argv, "c:l:m:n:p:")) != -1) {
+        switch (options) {
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'l':
+                info.in = atoi(optarg);
+                break;
+            case 'm':
+                info.modes = parse_modes(optarg);
+                break;
+            case 'n':
+                info.edges = atoi(optarg);
+                break;
+            case 'p':
+                info.out = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    all_modes = info.modes == parse_modes("all");
+    if (!info.modes || info.edges < 1 || info.edges > MAX_EDGES ||
+        info.out < 0 || info.in < 0 || info.out == info.in) {
+        usage();
+        return -EINVAL;
+    }
+
+    disc = gb_discover(0);
+    if (disc->ngpio_chips < 1) {
+        ret = -ENODEV;
+        goto out;
+    }
+    info.base = disc->gpio_chips[0].base;
+    info.ngpio = disc->gpio_chips[0].ngpio;
+    info.chipnum = disc->gpio_chips[0].chipnum;
+
+    if (info.out >= info.ngpio || info.in >= info.ngpio) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    ctx.info = &info;
+    for (i = 0; i < MODE_MAX && !ret; i++) {
+        if (!(info.modes & (1 << i))) {
+            continue;
+        }
+
+        /* without a usable chardev "all" still reports the sysfs mode */
+        if (i == MODE_CDEV && all_modes && info.chipnum < 0) {
+            print_test_case_log(APP_NAME, info.case_id,
+                                "no GPIO chardev, cdev mode skipped");
+            continue;
+        }
+
+        ctx.mode = i;
+        ret = mode_setup(&ctx);
+        if (ret == -ENOSYS && i == MODE_CDEV && all_modes) {
+            print_test_case_log(APP_NAME, info.case_id,
+                                "GPIO chardev not supported, cdev mode "
+                                "skipped");
+            mode_teardown(&ctx);
+            ret = 0;
+            continue;
+        }
+        if (!ret) {
+            ret = run_latency(&ctx);
+        }
+        if (!ret) {
+            ret = run_rate(&ctx);
+        }
+        mode_teardown(&ctx);
+    }
+
+out:
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
+}
@@ -1,16 +1,351 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "gpio_pio"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+/* Default bus width sweep, in data bits */
+#define DEFAULT_WIDTHS "1,2,4"
+/* Default run time of each width, in seconds */
+#define DEFAULT_DURATION 5
+/* Max data bits, strobe and data lines share one line handle */
+#define MAX_WIDTH 32
+/* Max input reads while waiting for the strobe of a word */
+#define STROBE_SPINS 1000
+
+struct pio_info {
+    int case_id;
+    int chipnum;
+    int ngpio;
+    /* strobe offset, the data lines follow it */
+    int out_offset;
+    int in_offset;
+    int duration;
+    int split;
+    int allow_errors;
+    struct sweep widths;
+};
+
+struct pio_result {
+    uint64_t words;
+    uint64_t bit_errors;
+    uint64_t timeouts;
+    uint64_t elapsed_ns;
+    struct stats_hist hist;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-w widths] [-o offset] [-i offset] "
+            "[-t seconds] [-s] [-a]\n        [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -w: comma separated bus widths in data bits, up "
+            "to %d\n        (default %s).\n", MAX_WIDTH, DEFAULT_WIDTHS);
+    fprintf(stdout, "    -o: first output line offset within the first "
+            "Greybus GPIO\n        controller, the strobe, data bit n "
+            "follows at offset + 1 + n\n        (default 0).\n");
+    fprintf(stdout, "    -i: first input line offset, wired to the strobe "
+            "and data outputs\n        in the same order (default the "
+            "line after the widest bus).\n");
+    fprintf(stdout, "    -t: run time of each width in seconds "
+            "(default %d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -s: set the data before the strobe with two "
+            "requests, the default sets\n        both at once.\n");
+    fprintf(stdout, "    -a: report bit errors without failing the test.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Each word toggles the strobe; the reader waits for "
+            "the strobe and checks\nthe data, so a word is one full "
+            "write to read back round trip.\n");
+    fprintf(stdout, "Example: %s -w 8 -o 0 -i 9 -t 10\n", APP_NAME);
+}
+
+/* next word of the bus, xorshift so every data line keeps toggling */
+static uint32_t next_word(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+/**
+ * @brief Request the strobe and data lines of one side of the bus.
+ *
+ * @param info The app info.
+ * @param offset Strobe offset.
+ * @param width Data bits.
+ * @param output Non-zero for the driver side.
+ * @return line handle on success, error code on failure.
+ */
+static int request_bus(const struct pio_info *info, int offset, int width,
+                       int output)
+{
+    int offsets[MAX_WIDTH + 1];
+    int i;
+
+    for (i = 0; i <= width; i++) {
+        offsets[i] = offset + i;
+    }
+
+    return gpio_cdev_request(info->chipnum, offsets, width + 1, output, NULL,
+                             APP_NAME);
+}
+
+/**
+ * @brief Transfer words for the run time of one bus width.
+ *
+ * @param info The app info.
+ * @param width Data bits.
+ * @param result The measured result.
+ * @return 0 on success, error code on failure.
+ */
+static int run_width(const struct pio_info *info, int width,
+                     struct pio_result *result)
+{
+    uint8_t out[MAX_WIDTH + 1], in[MAX_WIDTH + 1];
+    uint64_t start, end, t0, t1 = 0;
+    uint32_t state = 0x2545f491, word, got;
+    int out_fd = -1, in_fd = -1, strobe = 0, spins = 0, i, ret = 0;
+
+    memset(result, 0, sizeof(*result));
+    stats_hist_init(&result->hist);
+    memset(out, 0, sizeof(out));
+
+    out_fd = request_bus(info, info->out_offset, width, 1);
+    if (out_fd < 0) {
+        return out_fd;
+    }
+    in_fd = request_bus(info, info->in_offset, width, 0);
+    if (in_fd < 0) {
+        gpio_cdev_release(out_fd);
+        return in_fd;
+    }
+
+    start = stats_now_ns();
+    end = start + (uint64_t)info->duration * 1000000000ULL;
+
+    for (t1 = start; t1 < end && !ret; ) {
+        word = next_word(&state) & (width == 32 ? ~0U : (1U << width) - 1);
+        for (i = 0; i < width; i++) {
+            out[i + 1] = (word >> i) & 1;
+        }
+        strobe = !strobe;
+
+        t0 = stats_now_ns();
+        if (info->split) {
+            /* data with the old strobe, then the strobe */
+            out[0] = !strobe;
+            ret = gpio_cdev_set_values(out_fd, out, width + 1);
+        }
+        out[0] = strobe;
+        if (!ret) {
+            ret = gpio_cdev_set_values(out_fd, out, width + 1);
+        }
+
+        for (spins = 0; !ret && spins < STROBE_SPINS; spins++) {
+            ret = gpio_cdev_get_values(in_fd, in, width + 1);
+            if (!ret && in[0] == strobe) {
+                break;
+            }
+        }
+        t1 = stats_now_ns();
+        if (ret) {
+            break;
+        }
+        if (spins == STROBE_SPINS) {
+            result->timeouts++;
+            continue;
+        }
+
+        got = 0;
+        for (i = 0; i < width; i++) {
+            got |= (uint32_t)!!in[i + 1] << i;
+        }
+        result->bit_errors += __builtin_popcount(got ^ word);
+        result->words++;
+        stats_hist_record(&result->hist, t1 - t0);
+    }
+
+    result->elapsed_ns = t1 - start;
+    gpio_cdev_release(in_fd);
+    gpio_cdev_release(out_fd);
+
+    if (!ret && !result->words) {
+        ret = -ETIMEDOUT;
+    }
+    return ret;
+}
+
+/**
+ * @brief Print the result of one bus width.
+ *
+ * Bit errors are counted on the words whose strobe was seen, a strobe
+ * timeout is a lost word.
+ *
+ * @param info The app info.
+ * @param width Data bits.
+ * @param result The measured result.
+ */
+static void print_result(const struct pio_info *info, int width,
+                         const struct pio_result *result)
+{
+    double secs = result->elapsed_ns / 1e9;
+    double rate = secs > 0 ? result->words / secs : 0.0;
+    double bits = (double)result->words * width;
+    double ber = bits > 0 ? result->bit_errors / bits : 0.0;
+    char prefix[64];
+
+    printf("\n%s: width=%d strobe=%s words=%llu timeouts=%llu "
+           "bit_errors=%llu ber=%.3g words_per_s=%.1f bits_per_s=%.1f "
+           "p50_us=%.1f p99_us=%.1f\n",
+           APP_NAME, width, info->split ? "after" : "with",
+           (unsigned long long)result->words,
+           (unsigned long long)result->timeouts,
+           (unsigned long long)result->bit_errors, ber, rate, rate * width,
+           stats_hist_percentile(&result->hist, 50.0) / 1000.0,
+           stats_hist_percentile(&result->hist, 99.0) / 1000.0);
+
+    snprintf(prefix, sizeof(prefix), "w%d_words_per_s", width);
+    print_test_case_perf(info->case_id, prefix, rate, "Hz");
+    snprintf(prefix, sizeof(prefix), "w%d_bits_per_s", width);
+    print_test_case_perf(info->case_id, prefix, rate * width, "b/s");
+    snprintf(prefix, sizeof(prefix), "w%d_ber", width);
+    print_test_case_perf(info->case_id, prefix, ber, "ratio");
+    snprintf(prefix, sizeof(prefix), "w%d_timeouts", width);
+    print_test_case_perf(info->case_id, prefix, result->timeouts, "words");
+    snprintf(prefix, sizeof(prefix), "w%d_word", width);
+    stats_hist_report(info->case_id, prefix, &result->hist);
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    struct pio_info info;
+    static struct pio_result result;
+    const struct gb_discovery *disc = NULL;
+    int options = 0, i = 0, widest = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.in_offset = -1;
+    info.duration = DEFAULT_DURATION;
+    sweep_parse(&info.widths, DEFAULT_WIDTHS, 1, MAX_WIDTH);
+
+    while ((options = getopt(argc, argv, "ac:i:o:st:w:")) != -1) {
+        switch (options) {
+            case 'a':
+                info.allow_errors = 1;
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'i':
+                info.in_offset = atoi(optarg);
+                break;
+            case 'o':
+                info.out_offset = atoi(optarg);
+                break;
+            case 's':
+                info.split = 1;
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            case 'w':
+                ret = sweep_parse(&info.widths, optarg, 1, MAX_WIDTH);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    for (i = 0; i < info.widths.count; i++) {
+        if (info.widths.value[i] > widest) {
+            widest = info.widths.value[i];
+        }
+    }
+    if (info.in_offset < 0) {
+        info.in_offset = info.out_offset + widest + 1;
+    }
+
+    /* the two sides of the widest bus must not overlap */
+    if (info.duration < 1 || info.out_offset < 0 ||
+        (info.in_offset <= info.out_offset + widest &&
+         info.out_offset <= info.in_offset + widest)) {
+        usage();
+        return -EINVAL;
+    }
+
+    disc = gb_discover(0);
+    if (disc->ngpio_chips < 1 || disc->gpio_chips[0].chipnum < 0) {
+        ret = -ENODEV;
+        goto out;
+    }
+    info.chipnum = disc->gpio_chips[0].chipnum;
+    info.ngpio = disc->gpio_chips[0].ngpio;
+
+    if (info.out_offset + widest >= info.ngpio ||
+        info.in_offset + widest >= info.ngpio) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    for (i = 0; i < info.widths.count && !ret; i++) {
+        ret = run_width(&info, info.widths.value[i], &result);
+        print_result(&info, info.widths.value[i], &result);
+        if (!ret && !info.allow_errors &&
+            (result.bit_errors || result.timeouts)) {
+            ret = -EIO;
+        }
+    }
+
+out:
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
 }
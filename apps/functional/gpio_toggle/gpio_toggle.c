@@ -1,16 +1,435 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "gpio_toggle"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+/* Default run time of each access mode, in seconds */
+#define DEFAULT_DURATION 5
+/* Max number of input reads while waiting for the loopback level */
+#define LOOPBACK_SPINS 1000
+
+enum toggle_mode {
+    MODE_SYSFS_OPEN,
+    MODE_SYSFS,
+    MODE_CDEV,
+    MODE_MAX,
+};
+
+static const char *mode_name[MODE_MAX] = {
+    "sysfs-open",
+    "sysfs",
+    "cdev",
+};
+
+struct toggle_info {
+    int case_id;
+    int base;
+    int ngpio;
+    int chipnum;
+    int offset;
+    int loopback;
+    int duration;
+    int modes;
+};
+
+struct toggle_result {
+    uint64_t ops;
+    uint64_t errors;
+    uint64_t elapsed_ns;
+    struct stats_hist hist;
+};
+
+/* per mode state of the pins under test */
+struct toggle_ctx {
+    const struct toggle_info *info;
+    int out_fd;
+    int in_fd;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-p offset] [-l offset] [-m mode] "
+            "[-t seconds] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -p: output line offset within the first Greybus "
+            "GPIO\n        controller (default 0).\n");
+    fprintf(stdout, "    -l: input line offset wired back to the output, "
+            "measures the\n        set to read back round trip "
+            "(optional).\n");
+    fprintf(stdout, "    -m: sysfs-open, sysfs, cdev or all (default all).\n");
+    fprintf(stdout, "    -t: run time of each mode in seconds "
+            "(default %d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Example: %s -p 8 -l 9 -m cdev -t 10\n", APP_NAME);
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Export a pin and set its direction through sysfs.
+ *
+ * @param gpio GPIO number.
+ * @param direction "in" or "out".
+ * @return 0 on success, error code on failure.
+ */
+static int sysfs_setup(int gpio, char *direction)
+{
+    int ret = 0;
+
+    ret = gpio_export(gpio);
+    if (ret) {
+        return ret;
+    }
+
+    return gpio_set_attr(gpio, GPIO_ATTR_DIRECTION, direction,
+                         strlen(direction));
+}
+
+static int mode_setup(struct toggle_ctx *ctx, enum toggle_mode mode)
+{
+    const struct toggle_info *info = ctx->info;
+    int ret = 0;
+
+    ctx->out_fd = -1;
+    ctx->in_fd = -1;
+
+    if (mode == MODE_CDEV) {
+        ctx->out_fd = gpio_cdev_request(info->chipnum, &info->offset, 1, 1,
+                                        NULL, APP_NAME);
+        if (ctx->out_fd < 0) {
+            return ctx->out_fd;
+        }
+        if (info->loopback >= 0) {
+            ctx->in_fd = gpio_cdev_request(info->chipnum, &info->loopback, 1,
+                                           0, NULL, APP_NAME);
+            if (ctx->in_fd < 0) {
+                return ctx->in_fd;
+            }
+        }
+        return 0;
+    }
+
+    ret = sysfs_setup(info->base + info->offset, "out");
+    if (!ret && info->loopback >= 0) {
+        ret = sysfs_setup(info->base + info->loopback, "in");
+    }
+
+    return ret;
+}
+
+static void mode_teardown(struct toggle_ctx *ctx, enum toggle_mode mode)
+{
+    const struct toggle_info *info = ctx->info;
+
+    if (mode == MODE_CDEV) {
+        gpio_cdev_release(ctx->out_fd);
+        gpio_cdev_release(ctx->in_fd);
+        return;
+    }
+
+    gpio_unexport(info->base + info->offset);
+    if (info->loopback >= 0) {
+        gpio_unexport(info->base + info->loopback);
+    }
+}
+
+/**
+ * @brief Drive the output pin to a level.
+ *
+ * @param ctx The toggle context.
+ * @param mode The access mode.
+ * @param level 0 or 1.
+ * @return 0 on success, error code on failure.
+ */
+static int set_level(struct toggle_ctx *ctx, enum toggle_mode mode, int level)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    const struct toggle_info *info = ctx->info;
+    uint8_t val = level;
+    char value[2] = { level ? '1' : '0', '\0' };
+    char gpiostr[PATH_MAX];
+
+    switch (mode) {
+        case MODE_SYSFS_OPEN:
+            snprintf(gpiostr, sizeof(gpiostr), "%s%d", "/sys/class/gpio/gpio",
+                     info->base + info->offset);
+            return debugfs_set_attr(gpiostr, "value", value, 1);
+        case MODE_SYSFS:
+            return gpio_set_attr(info->base + info->offset, GPIO_ATTR_VALUE,
+                                 value, 1);
+        case MODE_CDEV:
+            return gpio_cdev_set_values(ctx->out_fd, &val, 1);
+        default:
+            return -EINVAL;
+    }
+}
+
+/**
+ * @brief Read the loopback input pin level.
+ *
+ * @param ctx The toggle context.
+ * @param mode The access mode.
+ * @return 0 or 1 on success, error code on failure.
+ */
+static int get_level(struct toggle_ctx *ctx, enum toggle_mode mode)
+{
+    const struct toggle_info *info = ctx->info;
+    uint8_t val = 0;
+    char value[8];
+    char gpiostr[PATH_MAX];
+    int ret = 0;
+
+    switch (mode) {
+        case MODE_SYSFS_OPEN:
+            snprintf(gpiostr, sizeof(gpiostr), "%s%d", "/sys/class/gpio/gpio",
+                     info->base + info->loopback);
+            ret = debugfs_get_attr(gpiostr, "value", value, sizeof(value));
+            break;
+        case MODE_SYSFS:
+            ret = gpio_get_attr(info->base + info->loopback, GPIO_ATTR_VALUE,
+                                value, sizeof(value));
+            break;
+        case MODE_CDEV:
+            ret = gpio_cdev_get_values(ctx->in_fd, &val, 1);
+            return ret ? ret : val;
+        default:
+            return -EINVAL;
+    }
+
+    return ret ? ret : value[0] == '1';
+}
+
+/**
+ * @brief Toggle the output back to back for the configured run time.
+ *
+ * Without loopback each sample is the time of one set-value call, with
+ * loopback it lasts until the input pin reads back the new level.
+ *
+ * @param ctx The toggle context.
+ * @param mode The access mode.
+ * @param result The measured result.
+ * @return 0 on success, negative errno if no toggle succeeded.
+ */
+static int run_mode(struct toggle_ctx *ctx, enum toggle_mode mode,
+                    struct toggle_result *result)
+{
+    const struct toggle_info *info = ctx->info;
+    uint64_t start, end, t0, t1;
+    int level = 0, spins = 0, ret = 0;
+
+    result->ops = 0;
+    result->errors = 0;
+    stats_hist_init(&result->hist);
+
+    start = stats_now_ns();
+    end = start + (uint64_t)info->duration * 1000000000ULL;
+
+    do {
+        level = !level;
+        t0 = stats_now_ns();
+        ret = set_level(ctx, mode, level);
+        if (!ret && info->loopback >= 0) {
+            for (spins = 0; spins < LOOPBACK_SPINS; spins++) {
+                ret = get_level(ctx, mode);
+                if (ret < 0 || ret == level) {
+                    break;
+                }
+            }
+            ret = ret < 0 ? ret : (ret == level ? 0 : -ETIMEDOUT);
+        }
+        t1 = stats_now_ns();
+
+        if (ret) {
+            result->errors++;
+            continue;
+        }
+        result->ops++;
+        stats_hist_record(&result->hist, t1 - t0);
+    } while (t1 < end);
+
+    result->elapsed_ns = t1 - start;
+
+    return result->ops ? 0 : (ret ? ret : -EIO);
+}
+
+/**
+ * @brief Print the result and latency histogram of one access mode.
+ *
+ * @param case_id Testrail test case ID of the [P] lines.
+ * @param mode The access mode.
+ * @param loopback Non-zero when latency is the loopback round trip.
+ * @param result The measured result.
+ */
+static void print_result(int case_id, enum toggle_mode mode, int loopback,
+                         struct toggle_result *result)
+{
+    double secs = result->elapsed_ns / 1e9;
+    double rate = secs > 0 ? result->ops / secs : 0.0;
+    char prefix[64];
+
+    printf("\n%s: mode=%s latency=%s toggles=%llu errors=%llu "
+           "toggles_per_s=%.1f min_us=%.1f avg_us=%.1f max_us=%.1f\n",
+           APP_NAME, mode_name[mode], loopback ? "roundtrip" : "set",
+           (unsigned long long)result->ops,
+           (unsigned long long)result->errors, rate,
+           stats_hist_percentile(&result->hist, 0.0) / 1000.0,
+           stats_hist_mean(&result->hist) / 1000.0,
+           stats_hist_percentile(&result->hist, 100.0) / 1000.0);
+
+    snprintf(prefix, sizeof(prefix), "%s: mode=%s", APP_NAME,
+             mode_name[mode]);
+    stats_hist_dump(prefix, &result->hist);
+
+    snprintf(prefix, sizeof(prefix), "%s_toggles_per_s", mode_name[mode]);
+    print_test_case_perf(case_id, prefix, rate, "Hz");
+    snprintf(prefix, sizeof(prefix), "%s_latency", mode_name[mode]);
+    stats_hist_report(case_id, prefix, &result->hist);
+}
+
+/**
+ * @brief Parse the -m option.
+ *
+ * @param arg The mode name.
+ * @return bit mask of modes to run, 0 on bad name.
+ */
+static int parse_modes(const char *arg)
+{
+    int i = 0;
+
+    if (!strcmp(arg, "all")) {
+        return (1 << MODE_MAX) - 1;
+    }
+
+    for (i = 0; i < MODE_MAX; i++) {
+        if (!strcmp(arg, mode_name[i])) {
+            return 1 << i;
+        }
+    }
+
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    struct toggle_info info;
+    struct toggle_ctx ctx;
+    static struct toggle_result result;
+    const struct gb_discovery *disc = NULL;
+    int options = 0, i = 0, ret = 0, all_modes = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.loopback = -1;
+    info.duration = DEFAULT_DURATION;
+    info.modes = parse_modes("all");
+
+    while ((options = getopt(argc, argv, "c:l:m:p:t:")) != -1) {
+        switch (options) {
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'l':
+                info.loopback = atoi(optarg);
+                break;
+            case 'm':
+                info.modes = parse_modes(optarg);
+                break;
+            case 'p':
+                info.offset = atoi(optarg);
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    all_modes = info.modes == parse_modes("all");
+    if (!info.modes || info.duration < 1 || info.offset < 0 ||
+        info.offset == info.loopback) {
+        usage();
+        return -EINVAL;
+    }
+
+    disc = gb_discover(0);
+    if (disc->ngpio_chips < 1) {
+        ret = -ENODEV;
+        goto out;
+    }
+    info.base = disc->gpio_chips[0].base;
+    info.ngpio = disc->gpio_chips[0].ngpio;
+    info.chipnum = disc->gpio_chips[0].chipnum;
+
+    if (info.offset >= info.ngpio || info.loopback >= info.ngpio) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    ctx.info = &info;
+    for (i = 0; i < MODE_MAX && !ret; i++) {
+        if (!(info.modes & (1 << i))) {
+            continue;
+        }
+
+        /* without a usable chardev "all" still reports the sysfs modes */
+        if (i == MODE_CDEV && all_modes && info.chipnum < 0) {
+            print_test_case_log(APP_NAME, info.case_id,
+                                "no GPIO chardev, cdev mode skipped");
+            continue;
+        }
+
+        ret = mode_setup(&ctx, i);
+        if (ret == -ENOSYS && i == MODE_CDEV && all_modes) {
+            print_test_case_log(APP_NAME, info.case_id,
+                                "GPIO chardev not supported, cdev mode "
+                                "skipped");
+            ret = 0;
+        } else if (!ret) {
+            ret = run_mode(&ctx, i, &result);
+            print_result(info.case_id, i, info.loopback >= 0, &result);
+        }
+        mode_teardown(&ctx, i);
+    }
+
+out:
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
+}
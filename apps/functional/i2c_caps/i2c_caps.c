@@ -1,16 +1,163 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "i2c_caps"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
 #include "libfwtest.h"
 
+struct i2c_func_name {
+    unsigned long func;
+    const char *name;
+};
+
+static const struct i2c_func_name i2c_funcs[] = {
+    { I2C_FUNC_I2C, "i2c" },
+    { I2C_FUNC_10BIT_ADDR, "10bit_addr" },
+    { I2C_FUNC_PROTOCOL_MANGLING, "protocol_mangling" },
+    { I2C_FUNC_SMBUS_PEC, "smbus_pec" },
+    { I2C_FUNC_NOSTART, "nostart" },
+    { I2C_FUNC_SMBUS_QUICK, "smbus_quick" },
+    { I2C_FUNC_SMBUS_READ_BYTE, "smbus_read_byte" },
+    { I2C_FUNC_SMBUS_WRITE_BYTE, "smbus_write_byte" },
+    { I2C_FUNC_SMBUS_READ_BYTE_DATA, "smbus_read_byte_data" },
+    { I2C_FUNC_SMBUS_WRITE_BYTE_DATA, "smbus_write_byte_data" },
+    { I2C_FUNC_SMBUS_READ_WORD_DATA, "smbus_read_word_data" },
+    { I2C_FUNC_SMBUS_WRITE_WORD_DATA, "smbus_write_word_data" },
+    { I2C_FUNC_SMBUS_PROC_CALL, "smbus_proc_call" },
+    { I2C_FUNC_SMBUS_READ_BLOCK_DATA, "smbus_read_block_data" },
+    { I2C_FUNC_SMBUS_WRITE_BLOCK_DATA, "smbus_write_block_data" },
+    { I2C_FUNC_SMBUS_READ_I2C_BLOCK, "smbus_read_i2c_block" },
+    { I2C_FUNC_SMBUS_WRITE_I2C_BLOCK, "smbus_write_i2c_block" },
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-b bus_id] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -b: bus number, defaults to every Greybus I2C "
+            "adapter.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Lists the I2C_FUNCS of the adapters. The Greybus I2C "
+            "protocol needs\nplain I2C transfers, the check fails "
+            "without them.\n");
+}
+
+/**
+ * @brief Print the functionality of one adapter.
+ *
+ * @param case_id Testrail test case ID.
+ * @param busid The bus number.
+ * @param name sysfs name of the adapter, for the metric names.
+ * @return 0 on success, error code on failure.
+ */
+static int print_caps(int case_id, int busid, const char *name)
+{
+    unsigned long funcs = 0;
+    char metric[64];
+    unsigned int i, count = 0;
+    int file, ret = 0;
+
+    file = open_i2c_dev(busid);
+    if (file < 0) {
+        return -errno;
+    }
+    if (ioctl(file, I2C_FUNCS, &funcs) < 0) {
+        ret = -errno;
+    }
+    close(file);
+    if (ret) {
+        return ret;
+    }
+
+    printf("%s: %s funcs 0x%08lx", APP_NAME, name, funcs);
+    for (i = 0; i < sizeof(i2c_funcs) / sizeof(i2c_funcs[0]); i++) {
+        if (funcs & i2c_funcs[i].func) {
+            printf(" %s", i2c_funcs[i].name);
+            count++;
+        }
+    }
+    printf("\n");
+
+    snprintf(metric, sizeof(metric), "%s_funcs", name);
+    print_test_case_perf(case_id, metric, count, "funcs");
+    snprintf(metric, sizeof(metric), "%s_i2c", name);
+    print_test_case_check(case_id, metric, !(funcs & I2C_FUNC_I2C));
+
+    return funcs & I2C_FUNC_I2C ? 0 : -EOPNOTSUPP;
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    static struct gb_enum_dev devs[GB_ENUM_MAX_DEVS];
+    char name[GB_ENUM_NAME_LEN];
+    int options = 0, case_id = 0, busid = -1, ndevs = 0, i = 0, ret = 0;
+    int err = 0;
+
+    while ((options = getopt(argc, argv, "b:c:")) != -1) {
+        switch (options) {
+            case 'b':
+                busid = atoi(optarg);
+                break;
+            case 'c':
+                case_id = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (busid >= 0) {
+        snprintf(name, sizeof(name), "i2c-%d", busid);
+        ret = print_caps(case_id, busid, name);
+    } else {
+        ndevs = gb_enum(GB_ENUM_MASK(GB_ENUM_I2C), devs, GB_ENUM_MAX_DEVS);
+        ret = ndevs < 0 ? ndevs : (ndevs ? 0 : -ENODEV);
+        for (i = 0; i < ndevs; i++) {
+            err = print_caps(case_id, devs[i].num[0], devs[i].name);
+            if (err && !ret) {
+                ret = err;
+            }
+        }
+    }
+
+    print_test_case_result(APP_NAME, case_id, ret, strerror(-ret));
+
+    return ret;
 }
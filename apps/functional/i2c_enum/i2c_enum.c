@@ -1,16 +1,90 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "i2c_enum"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <getopt.h>
+
 #include "libfwtest.h"
 
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-n count] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -n: least number of I2C adapters expected "
+            "(default 1).\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Lists the Greybus I2C adapters with their bundle, "
+            "device node\nand sysfs attributes.\n");
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    static struct gb_enum_dev devs[GB_ENUM_MAX_DEVS];
+    uint64_t t0 = 0, elapsed = 0;
+    int options = 0, case_id = 0, expected = 1, ndevs = 0, i = 0, ret = 0;
+
+    while ((options = getopt(argc, argv, "c:n:")) != -1) {
+        switch (options) {
+            case 'c':
+                case_id = atoi(optarg);
+                break;
+            case 'n':
+                expected = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    t0 = stats_now_ns();
+    ndevs = gb_enum(GB_ENUM_MASK(GB_ENUM_I2C), devs, GB_ENUM_MAX_DEVS);
+    elapsed = stats_now_ns() - t0;
+
+    for (i = 0; i < ndevs; i++) {
+        gb_enum_print(APP_NAME, &devs[i]);
+    }
+    if (ndevs >= 0) {
+        print_test_case_perf(case_id, "adapters", ndevs, "adapters");
+        print_test_case_perf(case_id, "enum_time", elapsed / 1000.0, "us");
+    }
+
+    ret = ndevs < 0 ? ndevs : (ndevs < expected ? -ENODEV : 0);
+    if (ret) {
+        print_test_case_result(APP_NAME, case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(case_id, ret);
+    }
+
+    return ret;
 }
@@ -1,16 +1,269 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "i2c_readperf"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+
 #include "libfwtest.h"
 
+/* Default transfer size sweep, in bytes */
+#define DEFAULT_SIZES "1,2,4,8,16,32,64,128"
+/* Default run time of each transfer size, in seconds */
+#define DEFAULT_DURATION 5
+/* Max number of transfer sizes in one sweep */
+#define MAX_SIZES 16
+/* Max bytes per I2C read transaction */
+#define MAX_XFER_SIZE 4096
+
+struct readperf_info {
+    int case_id;
+    int busid;
+    int devaddress;
+    int addr;
+    int duration;
+    int nsizes;
+    int sizes[MAX_SIZES];
+};
+
+struct readperf_result {
+    uint64_t ops;
+    uint64_t errors;
+    uint64_t elapsed_ns;
+    struct stats_hist hist;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-b bus_id] [-a device_address] [-i index] "
+            "[-s sizes] [-t seconds] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -b: bus number in decimal integer, defaults to the "
+            "first\n        Greybus I2C adapter.\n");
+    fprintf(stdout, "    -a: device address in decimal integer.\n");
+    fprintf(stdout, "    -i: register index set once before reading "
+            "(optional).\n");
+    fprintf(stdout, "    -s: comma separated transfer sizes in bytes "
+            "(default %s).\n", DEFAULT_SIZES);
+    fprintf(stdout, "    -t: run time of each transfer size in seconds "
+            "(default %d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Example: %s -b 1 -a 41 -s 1,16,64 -t 10\n", APP_NAME);
+}
+
+/**
+ * @brief Parse comma separated transfer size list.
+ *
+ * @param info The readperf info to fill.
+ * @param list The size list from command line.
+ * @return 0 on success, -EINVAL on bad list.
+ */
+static int parse_sizes(struct readperf_info *info, const char *list)
+{
+    char buf[128];
+    char *tok, *save = NULL;
+    int size;
+
+    snprintf(buf, sizeof(buf), "%s", list);
+    info->nsizes = 0;
+
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        size = atoi(tok);
+        if (size < 1 || size > MAX_XFER_SIZE || info->nsizes >= MAX_SIZES) {
+            return -EINVAL;
+        }
+        info->sizes[info->nsizes++] = size;
+    }
+
+    return info->nsizes ? 0 : -EINVAL;
+}
+
+/**
+ * @brief Run back to back reads of one transfer size.
+ *
+ * @param file The I2C device file descriptor.
+ * @param size Bytes per read transaction.
+ * @param duration Run time in seconds.
+ * @param result The measured result.
+ * @return 0 on success, negative errno if no read succeeded.
+ */
+static int run_size(int file, int size, int duration,
+                    struct readperf_result *result)
+{
+    uint8_t buf[MAX_XFER_SIZE];
+    uint64_t start, end, t0, t1;
+
+    result->ops = 0;
+    result->errors = 0;
+    stats_hist_init(&result->hist);
+
+    start = stats_now_ns();
+    end = start + (uint64_t)duration * 1000000000ULL;
+
+    do {
+        t0 = stats_now_ns();
+        if (read(file, buf, size) != size) {
+            result->errors++;
+            t1 = stats_now_ns();
+            continue;
+        }
+        t1 = stats_now_ns();
+
+        result->ops++;
+        stats_hist_record(&result->hist, t1 - t0);
+    } while (t1 < end);
+
+    result->elapsed_ns = t1 - start;
+
+    return result->ops ? 0 : -EIO;
+}
+
+/**
+ * @brief Print the result of one transfer size.
+ *
+ * @param case_id Testrail test case ID of the [P] lines.
+ * @param size Bytes per read transaction.
+ * @param result The measured result.
+ */
+static void print_result(int case_id, int size, struct readperf_result *result)
+{
+    double secs = result->elapsed_ns / 1e9;
+    double ops_s = secs > 0 ? result->ops / secs : 0.0;
+    char metric[32];
+
+    printf("\n%s: size=%d ops=%llu errors=%llu ops_per_s=%.1f "
+           "bytes_per_s=%.1f p50_us=%.1f p99_us=%.1f p999_us=%.1f\n",
+           APP_NAME, size, (unsigned long long)result->ops,
+           (unsigned long long)result->errors, ops_s, ops_s * size,
+           stats_hist_percentile(&result->hist, 50.0) / 1000.0,
+           stats_hist_percentile(&result->hist, 99.0) / 1000.0,
+           stats_hist_percentile(&result->hist, 99.9) / 1000.0);
+
+    snprintf(metric, sizeof(metric), "size%d_bytes_per_s", size);
+    print_test_case_perf(case_id, metric, ops_s * size, "B/s");
+    snprintf(metric, sizeof(metric), "size%d_latency", size);
+    stats_hist_report(case_id, metric, &result->hist);
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    struct readperf_info info;
+    static struct readperf_result result;
+    int options = 0, file = -1, i = 0, ret = 0;
+    uint8_t index;
+
+    memset(&info, 0, sizeof(info));
+    info.busid = -EINVAL;
+    info.devaddress = -EINVAL;
+    info.addr = -EINVAL;
+    info.duration = DEFAULT_DURATION;
+    parse_sizes(&info, DEFAULT_SIZES);
+
+    while ((options = getopt(argc, argv, "a:b:c:i:s:t:")) != -1) {
+        switch (options) {
+            case 'a':
+                info.devaddress = atoi(optarg);
+                break;
+            case 'b':
+                info.busid = atoi(optarg);
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'i':
+                info.addr = atoi(optarg);
+                break;
+            case 's':
+                if (parse_sizes(&info, optarg)) {
+                    usage();
+                    return -EINVAL;
+                }
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (info.busid == -EINVAL) {
+        gb_find_i2c_adapter(0, &info.busid);
+    }
+
+    if (info.busid == -EINVAL || info.devaddress == -EINVAL ||
+        info.duration < 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    file = open_i2c_dev(info.busid);
+    if (file < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    ret = force_set_slave_addr(file, info.devaddress);
+    if (ret) {
+        goto out;
+    }
+
+    /* point the slave at the first register, reads then auto-increment */
+    if (info.addr != -EINVAL) {
+        index = (uint8_t)info.addr;
+        if (write(file, &index, 1) != 1) {
+            ret = -errno;
+            goto out;
+        }
+    }
+
+    for (i = 0; i < info.nsizes && !ret; i++) {
+        ret = run_size(file, info.sizes[i], info.duration, &result);
+        print_result(info.case_id, info.sizes[i], &result);
+    }
+
+out:
+    if (file >= 0) {
+        close(file);
+    }
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
 }
@@ -1,16 +1,362 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "i2c_timeout"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+
 #include "libfwtest.h"
 
+/* Default adapter timeout sweep, in ms */
+#define DEFAULT_TIMEOUTS "10,50,100,500,1000"
+/* Default adapter retry sweep */
+#define DEFAULT_RETRIES "0,1,3"
+/* Default transactions per sweep point */
+#define DEFAULT_XFERS 20
+/* Default bytes read per transaction */
+#define DEFAULT_SIZE 1
+/* Adapter settings restored at the end, the greybus I2C defaults */
+#define DEFAULT_RESTORE_TIMEOUT_MS 1000
+#define DEFAULT_RESTORE_RETRIES 3
+#define MAX_XFER_SIZE 256
+/* response bit of the greybus message type */
+#define GB_TYPE_RESPONSE 0x80
+
+/* greybus operation counting through the message send tracepoint */
+struct op_trace {
+    int enabled;
+    struct trace_page_layout layout;
+    int send_id;
+    int pid_off;
+    int type_off;
+    int pid;
+    long ops;
+};
+
+struct timeout_info {
+    int case_id;
+    int busid;
+    int devaddress;
+    int addr;
+    int size;
+    int xfers;
+    int restore_timeout;
+    int restore_retries;
+    struct sweep timeouts;
+    struct sweep retries;
+    struct op_trace trace;
+};
+
+struct timeout_run {
+    long failed;
+    struct stats_hist ok;
+    struct stats_hist fail;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-b bus_id] -a device_address [-i index] "
+            "[-s size]\n        [-T timeouts] [-R retries] [-n xfers] "
+            "[-D timeout_ms,retries]\n        [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -b: bus number, defaults to the first Greybus I2C "
+            "adapter.\n");
+    fprintf(stdout, "    -a: address of the slow or stretching slave, an "
+            "absent address\n        measures NAK failures.\n");
+    fprintf(stdout, "    -i: register index of the reads (default 0).\n");
+    fprintf(stdout, "    -s: bytes per read (default %d).\n", DEFAULT_SIZE);
+    fprintf(stdout, "    -T: comma separated adapter timeouts in ms, 10 ms "
+            "steps\n        (default %s).\n", DEFAULT_TIMEOUTS);
+    fprintf(stdout, "    -R: comma separated adapter retries (default "
+            "%s).\n", DEFAULT_RETRIES);
+    fprintf(stdout, "    -n: transactions per point (default %d).\n",
+            DEFAULT_XFERS);
+    fprintf(stdout, "    -D: adapter settings restored at the end "
+            "(default %d,%d).\n", DEFAULT_RESTORE_TIMEOUT_MS,
+            DEFAULT_RESTORE_RETRIES);
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "The adapter timeout and retries are shared by every "
+            "user of the bus.\nGreybus operations per transaction need the "
+            "greybus tracepoints.\n");
+    fprintf(stdout, "Example: %s -b 1 -a 72 -T 20,200 -R 0,5 -n 50\n",
+            APP_NAME);
+}
+
+/**
+ * @brief Count the greybus requests this process sends.
+ *
+ * trace_drain() callback.
+ */
+static void count_op(void *arg, int cpu, uint64_t ts, const uint8_t *data,
+                     int len)
+{
+    struct op_trace *trace = arg;
+    uint16_t id = 0;
+    int32_t pid = 0;
+
+    /* only the count matters, not where or when */
+    (void)cpu;
+    (void)ts;
+
+    if (len < trace->pid_off + 4 || len <= trace->type_off) {
+        return;
+    }
+    memcpy(&id, data, sizeof(id));
+    memcpy(&pid, data + trace->pid_off, sizeof(pid));
+    if (id == trace->send_id && pid == trace->pid &&
+        !(data[trace->type_off] & GB_TYPE_RESPONSE)) {
+        trace->ops++;
+    }
+}
+
+/**
+ * @brief Enable the greybus message send tracepoint, if there is one.
+ *
+ * @param trace The operation trace.
+ */
+static void trace_setup(struct op_trace *trace)
+{
+    int size = 0;
+
+    memset(trace, 0, sizeof(*trace));
+    trace->pid = getpid();
+    trace->send_id = trace_event_id("greybus", "gb_message_send");
+    if (trace->send_id < 0 || trace_page_layout(&trace->layout) ||
+        trace_event_field("greybus", "gb_message_send", "common_pid",
+                          &trace->pid_off, &size) ||
+        trace_event_field("greybus", "gb_message_send", "type",
+                          &trace->type_off, &size)) {
+        return;
+    }
+
+    tracefs_write("tracing_on", "0");
+    tracefs_write("trace", "");
+    if (!tracefs_write("events/greybus/gb_message_send/enable", "1")) {
+        trace->enabled = 1;
+    }
+}
+
+/* start counting, or stop and return the count since the start */
+static long trace_ops(struct op_trace *trace, int start)
+{
+    if (!trace->enabled) {
+        return -1;
+    }
+
+    tracefs_write("tracing_on", "0");
+    trace->ops = 0;
+    trace_drain(&trace->layout, count_op, trace);
+    if (start) {
+        trace->ops = 0;
+        tracefs_write("tracing_on", "1");
+    }
+
+    return trace->ops;
+}
+
+static void trace_teardown(struct op_trace *trace)
+{
+    if (trace->enabled) {
+        tracefs_write("tracing_on", "0");
+        tracefs_write("events/greybus/gb_message_send/enable", "0");
+    }
+}
+
+/**
+ * @brief Run the transactions of one timeout and retry setting.
+ *
+ * @param info The timeout info.
+ * @param file The I2C device file descriptor.
+ * @param run Returns the measurements.
+ */
+static void run_point(struct timeout_info *info, int file,
+                     struct timeout_run *run)
+{
+    uint8_t buf[MAX_XFER_SIZE];
+    uint64_t t0 = 0;
+    int i, ret = 0;
+
+    for (i = 0; i < info->xfers; i++) {
+        t0 = stats_now_ns();
+        ret = i2c_rdwr_read_regs(file, info->devaddress, info->addr, buf,
+                                 info->size);
+        if (ret) {
+            stats_hist_record(&run->fail, stats_now_ns() - t0);
+            run->failed++;
+        } else {
+            stats_hist_record(&run->ok, stats_now_ns() - t0);
+        }
+    }
+}
+
+static void print_point(struct timeout_info *info, int timeout, int retries,
+                        struct timeout_run *run, long ops)
+{
+    char name[48];
+
+    snprintf(name, sizeof(name), "t%d_r%d_failed", timeout, retries);
+    print_test_case_perf(info->case_id, name, 100.0 * run->failed /
+                         info->xfers, "%");
+    if (run->fail.count) {
+        snprintf(name, sizeof(name), "t%d_r%d_fail", timeout, retries);
+        stats_hist_report(info->case_id, name, &run->fail);
+    }
+    if (run->ok.count) {
+        snprintf(name, sizeof(name), "t%d_r%d_ok", timeout, retries);
+        stats_hist_report(info->case_id, name, &run->ok);
+    }
+    if (ops >= 0) {
+        snprintf(name, sizeof(name), "t%d_r%d_gb_ops_per_xfer", timeout,
+                 retries);
+        print_test_case_perf(info->case_id, name,
+                             (double)ops / info->xfers, "ops");
+    }
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    struct timeout_info info;
+    static struct timeout_run run;
+    uint64_t worst = 0;
+    long ops = 0;
+    int options = 0, file = -1, i = 0, j = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.busid = -EINVAL;
+    info.devaddress = -EINVAL;
+    info.size = DEFAULT_SIZE;
+    info.xfers = DEFAULT_XFERS;
+    info.restore_timeout = DEFAULT_RESTORE_TIMEOUT_MS;
+    info.restore_retries = DEFAULT_RESTORE_RETRIES;
+    sweep_parse(&info.timeouts, DEFAULT_TIMEOUTS, 10, INT32_MAX);
+    sweep_parse(&info.retries, DEFAULT_RETRIES, 0, INT32_MAX);
+
+    while ((options = getopt(argc, argv, "a:b:c:D:i:n:R:s:T:")) != -1) {
+        switch (options) {
+            case 'a':
+                info.devaddress = atoi(optarg);
+                break;
+            case 'b':
+                info.busid = atoi(optarg);
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'D':
+                if (sscanf(optarg, "%d,%d", &info.restore_timeout,
+                           &info.restore_retries) != 2) {
+                    ret = -EINVAL;
+                }
+                break;
+            case 'i':
+                info.addr = atoi(optarg);
+                break;
+            case 'n':
+                info.xfers = atoi(optarg);
+                break;
+            case 'R':
+                ret = sweep_parse(&info.retries, optarg, 0, INT32_MAX);
+                break;
+            case 's':
+                info.size = atoi(optarg);
+                break;
+            case 'T':
+                ret = sweep_parse(&info.timeouts, optarg, 10, INT32_MAX);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (info.busid == -EINVAL) {
+        gb_find_i2c_adapter(0, &info.busid);
+    }
+
+    if (info.busid == -EINVAL || info.devaddress == -EINVAL ||
+        info.xfers < 1 || info.size < 1 || info.size > MAX_XFER_SIZE ||
+        info.addr < 0 || info.addr > 0xff) {
+        usage();
+        return -EINVAL;
+    }
+
+    file = open_i2c_dev(info.busid);
+    if (file < 0) {
+        ret = -errno;
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+        return ret;
+    }
+
+    trace_setup(&info.trace);
+
+    for (i = 0; i < info.timeouts.count && !ret; i++) {
+        for (j = 0; j < info.retries.count && !ret; j++) {
+            ret = i2c_set_timeout(file, info.timeouts.value[i]);
+            if (!ret) {
+                ret = i2c_set_retries(file, info.retries.value[j]);
+            }
+            if (ret) {
+                break;
+            }
+
+            memset(&run, 0, sizeof(run));
+            stats_hist_init(&run.ok);
+            stats_hist_init(&run.fail);
+            trace_ops(&info.trace, 1);
+            run_point(&info, file, &run);
+            ops = trace_ops(&info.trace, 0);
+            print_point(&info, info.timeouts.value[i], info.retries.value[j],
+                        &run, ops);
+            if (run.fail.count && run.fail.max > worst) {
+                worst = run.fail.max;
+            }
+        }
+    }
+
+    trace_teardown(&info.trace);
+    i2c_set_timeout(file, info.restore_timeout);
+    i2c_set_retries(file, info.restore_retries);
+    close(file);
+
+    if (worst) {
+        print_test_case_perf(info.case_id, "worst_failure", worst / 1000.0,
+                             "us");
+    }
+    print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+
+    return ret;
 }
@@ -1,16 +1,371 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "i2c_transfer"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
 #include "libfwtest.h"
 
+/* Default worker thread count sweep */
+#define DEFAULT_THREADS "1,2,4,8"
+/* Default run time of each sweep point, in seconds */
+#define DEFAULT_DURATION 5
+/* Default bytes read per transaction */
+#define DEFAULT_SIZE 2
+#define MAX_THREADS 32
+#define MAX_XFER_SIZE 256
+
+struct transfer_info {
+    int case_id;
+    int busid;
+    struct sweep addresses;
+    int addr;
+    int size;
+    int duration;
+    struct sweep threads;
+    /* count the CPU cost of every transaction */
+    int perf;
+};
+
+struct worker {
+    pthread_t thread;
+    const struct transfer_info *info;
+    int file;
+    int devaddress;
+    uint64_t ops;
+    uint64_t errors;
+    struct stats_hist hist;
+    struct stats_perf perf;
+    struct stats_perf_count count;
+};
+
+/* start and stop of all workers of a sweep point */
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int started;
+static int stopped;
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-b bus_id] -a addresses [-i index] "
+            "[-s size] [-n threads]\n        [-t seconds] [-P] "
+            "[-c case_id]\n",
+            APP_NAME);
+    fprintf(stdout, "    -b: bus number, defaults to the first Greybus I2C "
+            "adapter.\n");
+    fprintf(stdout, "    -a: comma separated slave addresses, thread i "
+            "uses address i modulo\n        the count.\n");
+    fprintf(stdout, "    -i: register index of the reads (default 0).\n");
+    fprintf(stdout, "    -s: bytes per read (default %d).\n", DEFAULT_SIZE);
+    fprintf(stdout, "    -n: comma separated worker thread counts (default "
+            "%s).\n", DEFAULT_THREADS);
+    fprintf(stdout, "    -t: run time of each thread count in seconds "
+            "(default %d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -P: count CPU cycles, instructions, context "
+            "switches and cache\n        misses per transaction.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "A speedup near 1 means the greybus I2C connection "
+            "serializes the clients.\n");
+    fprintf(stdout, "Example: %s -b 1 -a 72,73 -n 1,2,4\n", APP_NAME);
+}
+
+/**
+ * @brief Worker: back to back register reads on its own fd and slave.
+ */
+static void *worker_thread(void *arg)
+{
+    struct worker *w = arg;
+    const struct transfer_info *info = w->info;
+    uint8_t buf[MAX_XFER_SIZE];
+    struct stats_perf_snap snap;
+    uint64_t t0 = 0;
+
+    /* the counters count the thread that opens them */
+    if (info->perf) {
+        stats_perf_open(&w->perf);
+    }
+
+    pthread_mutex_lock(&start_lock);
+    while (!started) {
+        pthread_cond_wait(&start_cond, &start_lock);
+    }
+    pthread_mutex_unlock(&start_lock);
+
+    while (!__atomic_load_n(&stopped, __ATOMIC_RELAXED)) {
+        if (info->perf) {
+            stats_perf_begin(&w->perf, &snap);
+        }
+        t0 = stats_now_ns();
+        if (i2c_rdwr_read_regs(w->file, w->devaddress, info->addr, buf,
+                               info->size)) {
+            w->errors++;
+            continue;
+        }
+        stats_hist_record(&w->hist, stats_now_ns() - t0);
+        if (info->perf) {
+            stats_perf_end(&w->perf, &snap, &w->count);
+        }
+        w->ops++;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Run one thread count.
+ *
+ * @param info The transfer info.
+ * @param workers The workers.
+ * @param nthreads Number of workers.
+ * @param elapsed_ns Returns the run time.
+ * @return 0 on success, error code on failure.
+ */
+static int run_point(const struct transfer_info *info, struct worker *workers,
+                     int nthreads, uint64_t *elapsed_ns)
+{
+    uint64_t start = 0;
+    int i, n = 0, ret = 0;
+
+    started = 0;
+    stopped = 0;
+    for (n = 0; n < nthreads; n++) {
+        memset(&workers[n], 0, sizeof(workers[n]));
+        workers[n].info = info;
+        workers[n].devaddress = info->addresses.value[n %
+                                                      info->addresses.count];
+        stats_hist_init(&workers[n].hist);
+        workers[n].file = open_i2c_dev(info->busid);
+        if (workers[n].file < 0) {
+            ret = -errno;
+            break;
+        }
+        ret = -pthread_create(&workers[n].thread, NULL, worker_thread,
+                              &workers[n]);
+        if (ret) {
+            close(workers[n].file);
+            break;
+        }
+    }
+
+    start = stats_now_ns();
+    pthread_mutex_lock(&start_lock);
+    started = 1;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&start_lock);
+
+    if (!ret) {
+        sleep(info->duration);
+    }
+    __atomic_store_n(&stopped, 1, __ATOMIC_RELAXED);
+
+    for (i = 0; i < n; i++) {
+        pthread_join(workers[i].thread, NULL);
+        close(workers[i].file);
+    }
+    for (i = 0; i < n && ret && info->perf; i++) {
+        stats_perf_close(&workers[i].perf);
+    }
+    *elapsed_ns = stats_now_ns() - start;
+
+    return ret;
+}
+
+/**
+ * @brief Print one thread count.
+ *
+ * Fairness is Jain's index of the per thread rates, 1 when every thread
+ * got the same share of the bus. The CPU cost per transaction is of the
+ * workers that got the same counters as the first one that got any.
+ *
+ * @param info The transfer info.
+ * @param workers The workers.
+ * @param nthreads Number of workers.
+ * @param elapsed_ns The run time.
+ * @param base Aggregate rate of the first thread count, 0 for this is it.
+ * @return the aggregate rate in transactions/s.
+ */
+static double print_point(const struct transfer_info *info,
+                          struct worker *workers, int nthreads,
+                          uint64_t elapsed_ns, double base)
+{
+    static struct stats_hist hist;
+    struct stats_perf_count count;
+    const struct stats_perf *perf = NULL;
+    double secs = elapsed_ns / 1e9, rate = 0, sum = 0, sum2 = 0;
+    double min = 0, max = 0;
+    uint64_t errors = 0;
+    char name[48];
+    int i;
+
+    stats_hist_init(&hist);
+    stats_perf_count_init(&count);
+    for (i = 0; i < nthreads; i++) {
+        if (!perf && workers[i].perf.nslots) {
+            perf = &workers[i].perf;
+        }
+        if (perf && !memcmp(perf->slot, workers[i].perf.slot,
+                            sizeof(perf->slot))) {
+            stats_perf_count_merge(&count, &workers[i].count);
+        }
+        rate = workers[i].ops / secs;
+        sum += rate;
+        sum2 += rate * rate;
+        if (!i || rate < min) {
+            min = rate;
+        }
+        if (!i || rate > max) {
+            max = rate;
+        }
+        errors += workers[i].errors;
+        stats_hist_merge(&hist, &workers[i].hist);
+    }
+
+    snprintf(name, sizeof(name), "n%d_xfers_per_s", nthreads);
+    print_test_case_perf(info->case_id, name, sum, "xfers/s");
+    snprintf(name, sizeof(name), "n%d_bytes_per_s", nthreads);
+    print_test_case_perf(info->case_id, name, sum * info->size, "B/s");
+    if (base > 0) {
+        snprintf(name, sizeof(name), "n%d_speedup", nthreads);
+        print_test_case_perf(info->case_id, name, sum / base, "x");
+    }
+    snprintf(name, sizeof(name), "n%d_fairness", nthreads);
+    print_test_case_perf(info->case_id, name,
+                         sum2 > 0 ? sum * sum / (nthreads * sum2) : 0,
+                         "ratio");
+    snprintf(name, sizeof(name), "n%d_min_max_ratio", nthreads);
+    print_test_case_perf(info->case_id, name, max > 0 ? min / max : 0,
+                         "ratio");
+    if (errors) {
+        snprintf(name, sizeof(name), "n%d_errors", nthreads);
+        print_test_case_perf(info->case_id, name, errors, "xfers");
+    }
+    snprintf(name, sizeof(name), "n%d_latency", nthreads);
+    stats_hist_report(info->case_id, name, &hist);
+    if (perf) {
+        snprintf(name, sizeof(name), "n%d_xfer", nthreads);
+        stats_perf_report(info->case_id, name, perf, &count);
+    }
+
+    return sum;
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    struct transfer_info info;
+    static struct worker workers[MAX_THREADS];
+    uint64_t elapsed = 0, total = 0;
+    double base = 0, rate = 0;
+    int options = 0, i = 0, j = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.busid = -EINVAL;
+    info.size = DEFAULT_SIZE;
+    info.duration = DEFAULT_DURATION;
+    sweep_parse(&info.threads, DEFAULT_THREADS, 1, MAX_THREADS);
+
+    while ((options = getopt(argc, argv, "a:b:c:i:n:s:t:P")) != -1) {
+        switch (options) {
+            case 'a':
+                ret = sweep_parse(&info.addresses, optarg, 0, 0x7f);
+                break;
+            case 'b':
+                info.busid = atoi(optarg);
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'i':
+                info.addr = atoi(optarg);
+                break;
+            case 'n':
+                ret = sweep_parse(&info.threads, optarg, 1, MAX_THREADS);
+                break;
+            case 's':
+                info.size = atoi(optarg);
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            case 'P':
+                info.perf = 1;
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (info.busid == -EINVAL) {
+        gb_find_i2c_adapter(0, &info.busid);
+    }
+
+    if (info.busid == -EINVAL || !info.addresses.count ||
+        info.duration < 1 || info.size < 1 || info.size > MAX_XFER_SIZE ||
+        info.addr < 0 || info.addr > 0xff) {
+        usage();
+        return -EINVAL;
+    }
+
+    for (i = 0; i < info.threads.count && !ret; i++) {
+        ret = run_point(&info, workers, info.threads.value[i], &elapsed);
+        if (ret) {
+            break;
+        }
+
+        rate = print_point(&info, workers, info.threads.value[i], elapsed,
+                           base);
+        if (!i) {
+            base = rate;
+        }
+        for (j = 0; j < info.threads.value[i] && info.perf; j++) {
+            stats_perf_close(&workers[j].perf);
+        }
+        for (j = 0, total = 0; j < info.threads.value[i]; j++) {
+            total += workers[j].ops;
+        }
+        if (!total) {
+            ret = -EIO;
+        }
+    }
+
+    print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+
+    return ret;
 }
@@ -1,16 +1,475 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "mod_release"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+#define GB_DEVICES "/sys/bus/greybus/devices"
+/* Default number of release/re-insert cycles */
+#define DEFAULT_CYCLES 10
+/* Default give up time of one stage, in seconds */
+#define DEFAULT_TIMEOUT 30
+/* Default quiet time that ends a re-enumeration, in ms */
+#define DEFAULT_SETTLE_MS 1000
+/* Max device nodes followed per cycle */
+#define MAX_NODES 16
+#define DEV_LEN (PATH_MAX / 2)
+
+/* re-enumeration stages, in order */
+enum stage {
+    STAGE_MODULE,
+    STAGE_INTERFACE,
+    STAGE_BUNDLE,
+    STAGE_BIND,
+    STAGE_DEVNODE,
+    STAGE_MAX,
+};
+
+static const char * const stage_name[STAGE_MAX] = {
+    "module", "interface", "bundle", "bind", "devnode",
+};
+
+struct release_info {
+    int case_id;
+    char module[64];
+    char *reinsert;
+    int cycles;
+    int timeout;
+    int settle_ms;
+    int sock;
+    int inotify;
+};
+
+/* stage times of one cycle, ns from the re-insert, 0 if not seen */
+struct cycle {
+    uint64_t stage[STAGE_MAX];
+    int nnodes;
+    char nodes[MAX_NODES][64];
+};
+
+struct release_run {
+    struct stats_hist release;
+    struct stats_hist total;
+    struct stats_hist stage[STAGE_MAX];
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-m module] [-r command] [-n cycles] "
+            "[-t seconds] [-s settle_ms]\n        [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -m: greybus module, e.g. 1-2 (default the "
+            "first).\n");
+    fprintf(stdout, "    -r: shell command that re-inserts the module, "
+            "without it the\n        module must be re-inserted by "
+            "hand.\n");
+    fprintf(stdout, "    -n: release/re-insert cycles (default %d).\n",
+            DEFAULT_CYCLES);
+    fprintf(stdout, "    -t: give up on a stage after this many seconds "
+            "(default %d).\n", DEFAULT_TIMEOUT);
+    fprintf(stdout, "    -s: quiet time in ms that ends a re-enumeration "
+            "(default %d).\n", DEFAULT_SETTLE_MS);
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Stage times are from the re-insert command, or from "
+            "the module uevent\nwithout one; each stage is reported as "
+            "the time since the previous.\n");
+    fprintf(stdout, "Example: %s -m 1-2 -n 20 -r \"jigctl slot2 on\"\n",
+            APP_NAME);
+}
+
+/**
+ * @brief Find the first ejectable greybus module.
+ *
+ * @param module Returns the module name.
+ * @param len The module buffer size.
+ * @return 0 on success, -ENODEV if there is none.
+ */
+static int find_module(char *module, int len)
+{
+    char path[PATH_MAX];
+    struct dirent *entry;
+    DIR *dir = NULL;
+    int ret = -ENODEV;
+
+    dir = opendir(GB_DEVICES);
+    if (dir == NULL) {
+        return -ENODEV;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        snprintf(path, sizeof(path), "%s/%s/eject", GB_DEVICES,
+                 entry->d_name);
+        /* a truncated name would not be the module, skip it */
+        if (entry->d_name[0] != '.' && strlen(entry->d_name) < (size_t)len &&
+            !access(path, W_OK)) {
+            memcpy(module, entry->d_name, strlen(entry->d_name) + 1);
+            ret = 0;
+            break;
+        }
+    }
+    closedir(dir);
+
+    return ret;
+}
+
+/**
+ * @brief Wait for the next uevent or device node creation.
+ *
+ * @param info The release info.
+ * @param ev Returns the uevent, only its ts is set on inotify.
+ * @param timeout_ms Give up time.
+ * @return 0 on a uevent, 1 on inotify, -ETIMEDOUT or -errno.
+ */
+static int wait_event(struct release_info *info, struct uevent *ev,
+                      int timeout_ms)
+{
+    char buf[4096];
+    struct pollfd fds[2];
+    int ret = 0;
+
+    fds[0].fd = info->sock;
+    fds[0].events = POLLIN;
+    fds[1].fd = info->inotify;
+    fds[1].events = POLLIN;
+
+    while (1) {
+        ret = poll(fds, 2, timeout_ms);
+        if (ret < 0) {
+            return -errno;
+        }
+        if (!ret) {
+            return -ETIMEDOUT;
+        }
+        if (fds[1].revents & POLLIN) {
+            while (read(info->inotify, buf, sizeof(buf)) > 0) {
+            }
+            ev->ts = stats_now_ns();
+            return 1;
+        }
+
+        /* times out at once on messages that are not kernel uevents */
+        ret = uevent_recv(info->sock, ev, 0);
+        if (ret != -ETIMEDOUT) {
+            return ret;
+        }
+    }
+}
+
+/* true if devpath is the module or one of its children */
+static int in_module(const struct release_info *info, const char *devpath)
+{
+    const char *p = strstr(devpath, info->module);
+    size_t len = strlen(info->module);
+
+    return p != NULL && p > devpath && p[-1] == '/' &&
+           (p[len] == '\0' || p[len] == '/' || p[len] == '.');
+}
+
+/**
+ * @brief Follow a device node until it appears in /dev.
+ *
+ * @param info The release info.
+ * @param cyc The cycle.
+ * @param devname DEVNAME of the uevent.
+ * @param t0 Start of the cycle.
+ */
+static void add_node(struct release_info *info, struct cycle *cyc,
+                     const char *devname, uint64_t t0)
+{
+    char path[PATH_MAX];
+    int i = cyc->nnodes;
+
+    if (i == MAX_NODES) {
+        return;
+    }
+
+    snprintf(cyc->nodes[i], sizeof(cyc->nodes[i]), "/dev/%s", devname);
+    snprintf(path, sizeof(path), "%s", cyc->nodes[i]);
+    inotify_add_watch(info->inotify, dirname(path), IN_CREATE);
+    if (!access(cyc->nodes[i], F_OK)) {
+        cyc->stage[STAGE_DEVNODE] = stats_now_ns() - t0;
+        return;
+    }
+    cyc->nnodes++;
+}
+
+/* drop the nodes that now exist, returns the number still missing */
+static int check_nodes(struct cycle *cyc, uint64_t t0)
+{
+    int i = 0;
+
+    while (i < cyc->nnodes) {
+        if (access(cyc->nodes[i], F_OK)) {
+            i++;
+            continue;
+        }
+        cyc->stage[STAGE_DEVNODE] = stats_now_ns() - t0;
+        cyc->nnodes--;
+        memmove(cyc->nodes[i], cyc->nodes[cyc->nnodes],
+                sizeof(cyc->nodes[i]));
+    }
+
+    return cyc->nnodes;
+}
+
+/**
+ * @brief Eject the module and wait for it to go.
+ *
+ * @param info The release info.
+ * @param ns Returns the eject to module removal time.
+ * @return 0 on success, error code on failure.
+ */
+static int release_module(struct release_info *info, uint64_t *ns)
+{
+    char dev[PATH_MAX], value[4];
+    static struct uevent ev;
+    uint64_t t0 = 0;
+    int ret = 0;
+
+    snprintf(dev, sizeof(dev), "%s/%s", GB_DEVICES, info->module);
+    snprintf(value, sizeof(value), "1");
+    t0 = stats_now_ns();
+    ret = debugfs_set_attr(dev, "eject", value, strlen(value));
+    if (ret) {
+        return ret;
+    }
+
+    while ((ret = wait_event(info, &ev, info->timeout * 1000)) >= 0) {
+        if (ret == 0 && !strcmp(ev.action, "remove") &&
+            !strcmp(ev.devtype, "greybus_module") &&
+            in_module(info, ev.devpath)) {
+            *ns = ev.ts - t0;
+            return 0;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Re-insert the module and time the re-enumeration stages.
+ *
+ * Ends once a bundle is up, all device nodes exist and no uevent of the
+ * module came for the settle time.
+ *
+ * @param info The release info.
+ * @param cyc Returns the stage times.
+ * @return 0 on success, error code on failure.
+ */
+static int reinsert_module(struct release_info *info, struct cycle *cyc)
+{
+    static struct uevent ev;
+    uint64_t t0 = 0, deadline = 0, t = 0, *stage = NULL;
+    int timeout_ms = 0, ret = 0;
+
+    memset(cyc, 0, sizeof(*cyc));
+    t0 = stats_now_ns();
+    if (info->reinsert != NULL && system(info->reinsert)) {
+        return -ECHILD;
+    }
+    if (info->reinsert == NULL) {
+        print_test_case_log(APP_NAME, info->case_id,
+                            "Re-insert the module");
+        t0 = 0;
+    }
+
+    deadline = stats_now_ns() + info->timeout * 1000000000ULL;
+    while (1) {
+        timeout_ms = cyc->stage[STAGE_BUNDLE] && !cyc->nnodes ?
+                     info->settle_ms : info->timeout * 1000;
+        if (stats_now_ns() > deadline) {
+            return -ETIMEDOUT;
+        }
+
+        ret = wait_event(info, &ev, timeout_ms);
+        if (ret == -ETIMEDOUT && cyc->stage[STAGE_BUNDLE] && !cyc->nnodes) {
+            return 0;
+        }
+        if (ret < 0) {
+            return ret;
+        }
+        if (ret == 1) {
+            check_nodes(cyc, t0);
+            continue;
+        }
+        if (!in_module(info, ev.devpath)) {
+            continue;
+        }
+        if (!t0) {
+            /* by hand, the first uevent of the module starts the clock */
+            t0 = ev.ts - 1;
+        }
+        t = ev.ts - t0;
+
+        stage = NULL;
+        if (!strcmp(ev.action, "add") && !strcmp(ev.subsystem, "greybus")) {
+            if (!strcmp(ev.devtype, "greybus_module")) {
+                stage = &cyc->stage[STAGE_MODULE];
+            } else if (!strcmp(ev.devtype, "greybus_interface")) {
+                stage = &cyc->stage[STAGE_INTERFACE];
+            } else if (!strcmp(ev.devtype, "greybus_bundle")) {
+                stage = &cyc->stage[STAGE_BUNDLE];
+            }
+        } else if (!strcmp(ev.action, "bind") ||
+                   !strcmp(ev.action, "add")) {
+            /* bind uevents, or the class devices of a bound driver */
+            stage = &cyc->stage[STAGE_BIND];
+        }
+        if (stage != NULL && t > *stage) {
+            *stage = t;
+        }
+        if (!strcmp(ev.action, "add") && ev.devname[0]) {
+            add_node(info, cyc, ev.devname, t0);
+        }
+    }
+}
+
+static void record_cycle(struct release_run *run, const struct cycle *cyc)
+{
+    uint64_t prev = 0, total = 0;
+    int i;
+
+    for (i = 0; i < STAGE_MAX; i++) {
+        if (!cyc->stage[i]) {
+            continue;
+        }
+        stats_hist_record(&run->stage[i],
+                          cyc->stage[i] > prev ? cyc->stage[i] - prev : 0);
+        prev = cyc->stage[i];
+        if (prev > total) {
+            total = prev;
+        }
+    }
+    stats_hist_record(&run->total, total);
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    struct release_info info;
+    static struct release_run run;
+    struct cycle cyc;
+    char name[32];
+    uint64_t ns = 0;
+    int options = 0, i = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.cycles = DEFAULT_CYCLES;
+    info.timeout = DEFAULT_TIMEOUT;
+    info.settle_ms = DEFAULT_SETTLE_MS;
+
+    while ((options = getopt(argc, argv, "c:m:n:r:s:t:")) != -1) {
+        switch (options) {
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'm':
+                snprintf(info.module, sizeof(info.module), "%s", optarg);
+                break;
+            case 'n':
+                info.cycles = atoi(optarg);
+                break;
+            case 'r':
+                info.reinsert = optarg;
+                break;
+            case 's':
+                info.settle_ms = atoi(optarg);
+                break;
+            case 't':
+                info.timeout = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (!info.module[0]) {
+        find_module(info.module, sizeof(info.module));
+    }
+    if (!info.module[0] || info.cycles < 1 || info.timeout < 1 ||
+        info.settle_ms < 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    stats_hist_init(&run.release);
+    stats_hist_init(&run.total);
+    for (i = 0; i < STAGE_MAX; i++) {
+        stats_hist_init(&run.stage[i]);
+    }
+
+    info.sock = uevent_open();
+    info.inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (info.sock < 0) {
+        ret = info.sock;
+    } else if (info.inotify < 0) {
+        ret = -errno;
+    }
+
+    for (i = 0; i < info.cycles && !ret; i++) {
+        ret = release_module(&info, &ns);
+        if (!ret) {
+            stats_hist_record(&run.release, ns);
+            ret = reinsert_module(&info, &cyc);
+        }
+        if (!ret) {
+            record_cycle(&run, &cyc);
+        }
+    }
+
+    uevent_close(info.sock);
+    if (info.inotify >= 0) {
+        close(info.inotify);
+    }
+
+    stats_hist_report(info.case_id, "release", &run.release);
+    for (i = 0; i < STAGE_MAX; i++) {
+        if (run.stage[i].count) {
+            snprintf(name, sizeof(name), "enum_%s", stage_name[i]);
+            stats_hist_report(info.case_id, name, &run.stage[i]);
+        }
+    }
+    stats_hist_report(info.case_id, "enum_total", &run.total);
+
+    print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+
+    return ret;
 }
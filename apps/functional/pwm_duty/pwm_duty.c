@@ -1,16 +1,410 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "pwm_duty"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+
 #include "libfwtest.h"
 
+/* Default PWM period, in ns */
+#define DEFAULT_PERIOD_NS 1000000
+/* Default number of updates of the rate test */
+#define DEFAULT_UPDATES 2000
+/* Default number of edges of the latency test */
+#define DEFAULT_EDGES 100
+/* Default update spacing sweep of the coalescing test, in us */
+#define DEFAULT_SPACINGS "10000,5000,2000,1000,500,200,100,0"
+/* Updates per step of the coalescing test */
+#define BURST_UPDATES 100
+/* Wait for one output edge before it counts as lost, in ms */
+#define EDGE_TIMEOUT_MS 1000
+/* Wait for late edges after a burst, in ms */
+#define DRAIN_TIMEOUT_MS 100
+
+struct pwm_info {
+    int case_id;
+    int chip;
+    int channel;
+    unsigned int period;
+    int updates;
+    int edges;
+    int in;
+    int event_fd;
+    struct sweep spacings;
+    clockid_t ts_clock;
+    int clock_known;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d index] [-n channel] [-P period_ns] "
+            "[-u updates]\n        [-l offset] [-e edges] [-s spacings] "
+            "[-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -d: greybus PWM controller index (default 0).\n");
+    fprintf(stdout, "    -n: PWM channel (default 0).\n");
+    fprintf(stdout, "    -P: PWM period in ns (default %d).\n",
+            DEFAULT_PERIOD_NS);
+    fprintf(stdout, "    -u: updates of the rate test (default %d).\n",
+            DEFAULT_UPDATES);
+    fprintf(stdout, "    -l: input line offset of the first greybus GPIO "
+            "controller wired\n        to the PWM output, enables the "
+            "latency and coalescing tests.\n");
+    fprintf(stdout, "    -e: edges of the latency test (default %d).\n",
+            DEFAULT_EDGES);
+    fprintf(stdout, "    -s: comma separated update spacings in us of the "
+            "coalescing test\n        (default %s).\n", DEFAULT_SPACINGS);
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Example: %s -n 0 -P 100000 -l 3\n", APP_NAME);
+}
+
+static uint64_t clock_ns(clockid_t clk)
+{
+    struct timespec ts;
+
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t abs_diff(uint64_t a, uint64_t b)
+{
+    return a > b ? a - b : b - a;
+}
+
+static int set_value(struct pwm_info *info, enum pwm_attr attr,
+                     unsigned int value)
+{
+    char buf[16];
+
+    snprintf(buf, sizeof(buf), "%u", value);
+    return pwm_set_attr(info->chip, info->channel, attr, buf, strlen(buf));
+}
+
+/**
+ * @brief Time back to back updates of one attribute.
+ *
+ * Duty updates alternate between a quarter and three quarters of the
+ * period. Period updates alternate between the period and twice it, with
+ * the duty at a quarter so both are valid.
+ *
+ * @param info The PWM info.
+ * @param attr PWM_ATTR_DUTY_CYCLE or PWM_ATTR_PERIOD.
+ * @param name Metric name.
+ * @return 0 on success, error code on failure.
+ */
+static int run_rate(struct pwm_info *info, enum pwm_attr attr,
+                    const char *name)
+{
+    static struct stats_hist hist;
+    unsigned int value[2];
+    uint64_t start = 0, t0 = 0;
+    char metric[32];
+    int i, ret = 0;
+
+    if (attr == PWM_ATTR_PERIOD) {
+        value[0] = info->period;
+        value[1] = info->period * 2;
+    } else {
+        value[0] = info->period / 4;
+        value[1] = info->period / 4 * 3;
+    }
+    ret = set_value(info, PWM_ATTR_DUTY_CYCLE, info->period / 4);
+
+    stats_hist_init(&hist);
+    start = stats_now_ns();
+    for (i = 0; i < info->updates && !ret; i++) {
+        t0 = stats_now_ns();
+        ret = set_value(info, attr, value[i & 1]);
+        stats_hist_record(&hist, stats_now_ns() - t0);
+    }
+    if (ret) {
+        return ret;
+    }
+
+    snprintf(metric, sizeof(metric), "%s_updates_per_s", name);
+    print_test_case_perf(info->case_id, metric,
+                         info->updates * 1e9 / (stats_now_ns() - start),
+                         "updates/s");
+    snprintf(metric, sizeof(metric), "%s_update", name);
+    stats_hist_report(info->case_id, metric, &hist);
+
+    return set_value(info, PWM_ATTR_PERIOD, info->period);
+}
+
+/* drop the pending events of the loopback input */
+static void drain_events(struct pwm_info *info, int timeout_ms)
+{
+    while (!gpio_cdev_read_event(info->event_fd, timeout_ms, NULL, NULL)) {
+    }
+}
+
+/**
+ * @brief Time an update to the matching edge on the loopback input.
+ *
+ * The output is flipped between constant low and constant high, duty 0
+ * and duty of a full period, so each update makes exactly one edge.
+ *
+ * @param info The PWM info.
+ * @return 0 on success, error code on failure.
+ */
+static int run_latency(struct pwm_info *info)
+{
+    static struct stats_hist hist;
+    uint64_t t_mono = 0, t_real = 0, ts = 0, t = 0;
+    int i, level = 0, lost = 0, ret = 0;
+
+    stats_hist_init(&hist);
+    ret = set_value(info, PWM_ATTR_DUTY_CYCLE, 0);
+    drain_events(info, DRAIN_TIMEOUT_MS);
+
+    for (i = 0; i < info->edges && !ret; i++) {
+        level = !level;
+        t_real = clock_ns(CLOCK_REALTIME);
+        t_mono = clock_ns(CLOCK_MONOTONIC);
+        ret = set_value(info, PWM_ATTR_DUTY_CYCLE,
+                        level ? info->period : 0);
+        if (ret) {
+            break;
+        }
+
+        ret = gpio_cdev_read_event(info->event_fd, EDGE_TIMEOUT_MS, &ts,
+                                   NULL);
+        if (ret == -ETIMEDOUT) {
+            lost++;
+            ret = 0;
+            continue;
+        }
+        if (ret) {
+            break;
+        }
+
+        /* the event clock changed from realtime to monotonic in 5.7 */
+        if (!info->clock_known) {
+            info->ts_clock = abs_diff(ts, t_mono) < abs_diff(ts, t_real) ?
+                             CLOCK_MONOTONIC : CLOCK_REALTIME;
+            info->clock_known = 1;
+        }
+        t = info->ts_clock == CLOCK_MONOTONIC ? t_mono : t_real;
+        stats_hist_record(&hist, ts > t ? ts - t : 0);
+    }
+    if (ret) {
+        return ret;
+    }
+
+    stats_hist_report(info->case_id, "update_to_output", &hist);
+    if (lost) {
+        print_test_case_perf(info->case_id, "lost_edges", lost, "edges");
+    }
+
+    return hist.count ? 0 : -ETIMEDOUT;
+}
+
+/**
+ * @brief Find where the firmware starts dropping updates.
+ *
+ * Bursts of level flipping updates at closer and closer spacing, a
+ * burst that makes fewer edges than updates had some coalesced.
+ *
+ * @param info The PWM info.
+ * @return 0 on success, error code on failure.
+ */
+static int run_coalesce(struct pwm_info *info)
+{
+    uint64_t next = 0;
+    char metric[32];
+    int i, j, events = 0, level = 0, ret = 0;
+    int coalesce_us = -1;
+
+    for (i = 0; i < info->spacings.count && !ret; i++) {
+        level = 0;
+        ret = set_value(info, PWM_ATTR_DUTY_CYCLE, 0);
+        drain_events(info, DRAIN_TIMEOUT_MS);
+
+        events = 0;
+        next = stats_now_ns();
+        for (j = 0; j < BURST_UPDATES && !ret; j++) {
+            level = !level;
+            ret = set_value(info, PWM_ATTR_DUTY_CYCLE,
+                            level ? info->period : 0);
+            next += (uint64_t)info->spacings.value[i] * 1000;
+            do {
+                if (!gpio_cdev_read_event(info->event_fd, 0, NULL, NULL)) {
+                    events++;
+                }
+            } while (stats_now_ns() < next);
+        }
+        while (!ret && !gpio_cdev_read_event(info->event_fd,
+                                             DRAIN_TIMEOUT_MS, NULL, NULL)) {
+            events++;
+        }
+        if (ret) {
+            break;
+        }
+
+        snprintf(metric, sizeof(metric), "s%d_delivered",
+                 info->spacings.value[i]);
+        print_test_case_perf(info->case_id, metric,
+                             100.0 * events / BURST_UPDATES, "%");
+        if (events < BURST_UPDATES && coalesce_us < 0) {
+            coalesce_us = info->spacings.value[i];
+        }
+    }
+
+    if (!ret && coalesce_us >= 0) {
+        print_test_case_perf(info->case_id, "coalesce_spacing", coalesce_us,
+                             "us");
+    }
+
+    return ret;
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    struct pwm_info info;
+    const struct gb_discovery *disc = NULL;
+    char pwmstr[64];
+    int options = 0, index = 0, npwm = 0, exported = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.period = DEFAULT_PERIOD_NS;
+    info.updates = DEFAULT_UPDATES;
+    info.edges = DEFAULT_EDGES;
+    info.in = -1;
+    info.event_fd = -1;
+    sweep_parse(&info.spacings, DEFAULT_SPACINGS, 0, INT32_MAX);
+
+    while ((options = getopt(argc, argv, "c:d:e:l:n:P:s:u:")) != -1) {
+        switch (options) {
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                index = atoi(optarg);
+                break;
+            case 'e':
+                info.edges = atoi(optarg);
+                break;
+            case 'l':
+                info.in = atoi(optarg);
+                break;
+            case 'n':
+                info.channel = atoi(optarg);
+                break;
+            case 'P':
+                info.period = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                ret = sweep_parse(&info.spacings, optarg, 0, INT32_MAX);
+                break;
+            case 'u':
+                info.updates = atoi(optarg);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (info.period < 4 || info.period > 0x7fffffff || info.updates < 1 ||
+        info.edges < 1 || info.channel < 0) {
+        usage();
+        return -EINVAL;
+    }
+
+    ret = gb_find_pwm_chip(index, &info.chip, &npwm);
+    if (!ret && info.channel >= npwm) {
+        ret = -EINVAL;
+    }
+    if (!ret && info.in >= 0) {
+        disc = gb_discover(0);
+        if (disc->ngpio_chips < 1 || info.in >= disc->gpio_chips[0].ngpio) {
+            ret = -ENODEV;
+        } else {
+            info.event_fd = gpio_cdev_request_event(
+                                disc->gpio_chips[0].chipnum, info.in,
+                                GPIO_EDGE_BOTH, APP_NAME);
+            ret = info.event_fd < 0 ? info.event_fd : 0;
+        }
+    }
+
+    /* duty 0 first, any duty must fit the period */
+    if (!ret) {
+        snprintf(pwmstr, sizeof(pwmstr), "/sys/class/pwm/pwmchip%d/pwm%d",
+                 info.chip, info.channel);
+        /* only a channel exported here is unexported again */
+        if (access(pwmstr, F_OK)) {
+            ret = pwm_export(info.chip, info.channel);
+            exported = !ret;
+        }
+    }
+    if (!ret) {
+        ret = set_value(&info, PWM_ATTR_DUTY_CYCLE, 0);
+    }
+    if (!ret) {
+        ret = set_value(&info, PWM_ATTR_PERIOD, info.period);
+    }
+    if (!ret) {
+        ret = set_value(&info, PWM_ATTR_ENABLE, 1);
+    }
+
+    if (!ret) {
+        ret = run_rate(&info, PWM_ATTR_DUTY_CYCLE, "duty");
+    }
+    if (!ret) {
+        ret = run_rate(&info, PWM_ATTR_PERIOD, "period");
+    }
+    if (!ret && info.event_fd >= 0) {
+        ret = run_latency(&info);
+    }
+    if (!ret && info.event_fd >= 0) {
+        ret = run_coalesce(&info);
+    }
+
+    if (exported) {
+        set_value(&info, PWM_ATTR_ENABLE, 0);
+        pwm_unexport(info.chip, info.channel);
+    }
+    if (info.event_fd >= 0) {
+        gpio_cdev_release(info.event_fd);
+    }
+
+    print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+
+    return ret;
 }
@@ -1,16 +1,564 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "sd_block"
 
-#include "stdio.h"
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+/* Default test area size, in MiB */
+#define DEFAULT_SIZE_MB 64
+/* Default I/O size of one pipeline buffer, in bytes */
+#define DEFAULT_CHUNK (1024 * 1024)
+/* Max I/O size of one pipeline buffer, in bytes */
+#define MAX_CHUNK (16 * 1024 * 1024)
+/* O_DIRECT buffer and offset alignment */
+#define DIRECT_ALIGN 4096
+/* Logical block size the LBAs are counted in */
+#define LBA_SIZE 512
+/* Pipeline depth, one buffer in I/O while the other is filled or verified */
+#define NR_SLOTS 2
+/* Max mismatched LBAs kept for the log */
+#define MAX_BAD_LBAS 16
+/* Default pattern seed */
+#define DEFAULT_SEED 0x5344424c4f434b21ULL
+
+struct block_info {
+    int case_id;
+    char device[PATH_MAX];
+    uint64_t start;
+    uint64_t size;
+    int chunk;
+    int do_write;
+    int do_read;
+    int force;
+    uint64_t seed;
+    uint64_t dev_size;
+};
+
+enum slot_state {
+    SLOT_EMPTY,
+    SLOT_FULL,
+};
+
+struct pipe_slot {
+    uint8_t *buf;
+    uint64_t off;
+    size_t len;
+    enum slot_state state;
+};
+
+struct pipeline;
+typedef int (*stage_fn)(struct pipeline *pipe, struct pipe_slot *slot);
+
+/*
+ * Two stage pipeline over NR_SLOTS buffers. The producer takes empty
+ * slots in order and hands them over full, the consumer takes them back
+ * in the same order. Each stage has its own thread so I/O and CPU work
+ * overlap.
+ */
+struct pipeline {
+    const struct block_info *info;
+    int fd;
+    struct pipe_slot slot[NR_SLOTS];
+    uint64_t nchunks;
+    stage_fn producer;
+    stage_fn consumer;
+    uint64_t producer_ns;
+    uint64_t consumer_ns;
+    uint64_t start_ns;
+    uint64_t elapsed_ns;
+    int ret;
+    uint64_t bad_count;
+    uint64_t bad_lba[MAX_BAD_LBAS];
+    uint64_t bad_found[MAX_BAD_LBAS];
+    uint16_t bad_byte[MAX_BAD_LBAS];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d device] [-o offset_mb] [-s size_mb] "
+            "[-b chunk] [-m mode] [-f] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -d: block device, defaults to the first card in a "
+            "Greybus\n        SD host.\n");
+    fprintf(stdout, "    -o: start of the test area in MiB (default 0).\n");
+    fprintf(stdout, "    -s: size of the test area in MiB (default %d).\n",
+            DEFAULT_SIZE_MB);
+    fprintf(stdout, "    -b: I/O size in bytes, a multiple of %d "
+            "(default %d).\n", DIRECT_ALIGN, DEFAULT_CHUNK);
+    fprintf(stdout, "    -m: write, read or all (default all). read checks "
+            "an area\n        written before with the same -o.\n");
+    fprintf(stdout, "    -f: write even if the device is mounted.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "WARNING: the write destroys the data in the test "
+            "area.\n");
+    fprintf(stdout, "Example: %s -d /dev/block/mmcblk1 -o 128 -s 256\n",
+            APP_NAME);
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Check if the device or one of its partitions is mounted.
+ *
+ * @param device The block device path.
+ * @return 1 if mounted, 0 if not.
+ */
+static int device_mounted(const char *device)
+{
+    char line[512], dev[PATH_MAX];
+    const char *name = strrchr(device, '/');
+    const char *mname;
+    FILE *fp;
+    int mounted = 0;
+
+    name = name ? name + 1 : device;
+
+    fp = fopen("/proc/mounts", "r");
+    if (!fp) {
+        return 0;
+    }
+
+    while (!mounted && fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%s", dev) != 1) {
+            continue;
+        }
+        mname = strrchr(dev, '/');
+        mname = mname ? mname + 1 : dev;
+        /* mmcblk1 or one of its partitions mmcblk1p1..., not mmcblk10 */
+        mounted = !strncmp(mname, name, strlen(name)) &&
+                  (!mname[strlen(name)] ||
+                   (mname[strlen(name)] == 'p' &&
+                    isdigit((unsigned char)mname[strlen(name) + 1])));
+    }
+
+    fclose(fp);
+    return mounted;
+}
+
+/**
+ * @brief Fill one buffer with the LBA tagged pattern.
+ *
+ * The pattern word at device byte offset off is seed ^ (off / 8), so the
+ * first word of every LBA carries its own LBA number.
+ */
+static int fill_slot(struct pipeline *pipe, struct pipe_slot *slot)
+{
+    pattern_fill(slot->buf, slot->len, slot->off, pipe->info->seed);
+    return 0;
+}
+
+/**
+ * @brief Write one buffer to the device.
+ */
+static int write_slot(struct pipeline *pipe, struct pipe_slot *slot)
+{
+    ssize_t n = pwrite(pipe->fd, slot->buf, slot->len, slot->off);
+
+    if (n != (ssize_t)slot->len) {
+        return n < 0 ? -errno : -ENOSPC;
+    }
+    return 0;
+}
+
+/**
+ * @brief Read one buffer from the device.
+ */
+static int read_slot(struct pipeline *pipe, struct pipe_slot *slot)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    ssize_t n = pread(pipe->fd, slot->buf, slot->len, slot->off);
+
+    if (n != (ssize_t)slot->len) {
+        return n < 0 ? -errno : -EIO;
+    }
+    return 0;
+}
+
+/**
+ * @brief Verify one buffer, recording every mismatched LBA.
+ *
+ * Only the consumer thread touches the mismatch record until the
+ * pipeline is joined.
+ */
+static int verify_slot(struct pipeline *pipe, struct pipe_slot *slot)
+{
+    uint64_t seed = pipe->info->seed, abs, lba, word;
+    size_t pos = 0;
+    int64_t bad;
+
+    while (pos < slot->len) {
+        bad = pattern_check(slot->buf + pos, slot->len - pos,
+                            slot->off + pos, seed);
+        if (bad < 0) {
+            break;
+        }
+
+        abs = slot->off + pos + bad;
+        lba = abs / LBA_SIZE;
+        if (pipe->bad_count < MAX_BAD_LBAS) {
+            /* the first word tells where misdirected data was meant to go */
+            memcpy(&word, slot->buf + (lba * LBA_SIZE - slot->off),
+                   sizeof(word));
+            word ^= seed;
+            pipe->bad_lba[pipe->bad_count] = lba;
+            pipe->bad_byte[pipe->bad_count] = abs % LBA_SIZE;
+            pipe->bad_found[pipe->bad_count] = word % (LBA_SIZE / 8) ?
+                                               UINT64_MAX :
+                                               word / (LBA_SIZE / 8);
+        }
+        pipe->bad_count++;
+        pos = (lba + 1) * LBA_SIZE - slot->off;
+    }
+
     return 0;
 }
+
+/**
+ * @brief Wait for a slot to reach a state, or for the pipeline to fail.
+ *
+ * @param pipe The pipeline, locked by the caller.
+ * @param slot The slot to wait on.
+ * @param state The state to wait for.
+ * @return 0 when the slot is ready, the pipeline error otherwise.
+ */
+static int wait_slot(struct pipeline *pipe, struct pipe_slot *slot,
+                     enum slot_state state)
+{
+    while (slot->state != state && !pipe->ret) {
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
+    }
+    return pipe->ret;
+}
+
+/**
+ * @brief Run one stage of the pipeline over all chunks.
+ *
+ * @param pipe The pipeline.
+ * @param fn The stage work.
+ * @param wait The slot state the stage takes slots in.
+ * @param busy_ns Returns the time spent in fn.
+ * @return 0 on success, error code on failure.
+ */
+static int run_stage(struct pipeline *pipe, stage_fn fn,
+                     enum slot_state wait, uint64_t *busy_ns)
+{
+    const struct block_info *info = pipe->info;
+    struct pipe_slot *slot;
+    uint64_t i, t0, len;
+    int ret = 0;
+
+    for (i = 0; i < pipe->nchunks && !ret; i++) {
+        slot = &pipe->slot[i % NR_SLOTS];
+
+        pthread_mutex_lock(&pipe->lock);
+        ret = wait_slot(pipe, slot, wait);
+        pthread_mutex_unlock(&pipe->lock);
+        if (ret) {
+            break;
+        }
+
+        /* the producer lays out the chunk, the consumer inherits it */
+        if (wait == SLOT_EMPTY) {
+            slot->off = info->start + i * info->chunk;
+            len = info->start + info->size - slot->off;
+            slot->len = len < (uint64_t)info->chunk ? len :
+                        (uint64_t)info->chunk;
+        }
+
+        t0 = stats_now_ns();
+        ret = fn(pipe, slot);
+        *busy_ns += stats_now_ns() - t0;
+
+        pthread_mutex_lock(&pipe->lock);
+        if (ret) {
+            pipe->ret = ret;
+        } else {
+            slot->state = wait == SLOT_EMPTY ? SLOT_FULL : SLOT_EMPTY;
+        }
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+
+    return ret;
+}
+
+static void *consumer_thread(void *arg)
+{
+    struct pipeline *pipe = arg;
+
+    run_stage(pipe, pipe->consumer, SLOT_FULL, &pipe->consumer_ns);
+    return NULL;
+}
+
+/**
+ * @brief Run a producer and a consumer stage over the test area.
+ *
+ * The caller runs the producer and a second thread the consumer.
+ *
+ * @param pipe The pipeline with info, fd, buffers and stages set.
+ * @return 0 on success, error code on failure.
+ */
+static int run_pipeline(struct pipeline *pipe)
+{
+    const struct block_info *info = pipe->info;
+    pthread_t thread;
+    int i = 0, ret = 0;
+
+    pipe->nchunks = (info->size + info->chunk - 1) / info->chunk;
+    pipe->producer_ns = 0;
+    pipe->consumer_ns = 0;
+    pipe->ret = 0;
+    for (i = 0; i < NR_SLOTS; i++) {
+        pipe->slot[i].state = SLOT_EMPTY;
+    }
+
+    pipe->start_ns = stats_now_ns();
+
+    ret = pthread_create(&thread, NULL, consumer_thread, pipe);
+    if (ret) {
+        return -ret;
+    }
+
+    run_stage(pipe, pipe->producer, SLOT_EMPTY, &pipe->producer_ns);
+    pthread_join(thread, NULL);
+
+    pipe->elapsed_ns = stats_now_ns() - pipe->start_ns;
+
+    return pipe->ret;
+}
+
+/**
+ * @brief Print the bandwidth and stage use of one pass.
+ *
+ * @param pipe The finished pipeline.
+ * @param name Pass name.
+ * @param io_ns Time spent in the I/O stage.
+ * @param cpu_ns Time spent in the fill or verify stage.
+ */
+static void print_pass(const struct pipeline *pipe, const char *name,
+                       uint64_t io_ns, uint64_t cpu_ns)
+{
+    double secs = pipe->elapsed_ns / 1e9;
+    double mbps = secs > 0 ? pipe->info->size / secs / 1e6 : 0.0;
+    char metric[32];
+
+    printf("%s: %s MB_per_s=%.2f time_s=%.3f io_busy=%.1f%% "
+           "cpu_busy=%.1f%%\n", APP_NAME, name, mbps, secs,
+           secs > 0 ? io_ns / 1e7 / secs : 0.0,
+           secs > 0 ? cpu_ns / 1e7 / secs : 0.0);
+
+    snprintf(metric, sizeof(metric), "%s_bandwidth", name);
+    print_test_case_perf(pipe->info->case_id, metric, mbps, "MB/s");
+}
+
+/**
+ * @brief Log the mismatched LBAs of the read pass.
+ *
+ * @param pipe The finished pipeline.
+ */
+static void print_mismatches(const struct pipeline *pipe)
+{
+    char logbuf[96];
+    uint64_t i;
+
+    print_test_case_perf(pipe->info->case_id, "mismatched_lbas",
+                         pipe->bad_count, "LBAs");
+
+    for (i = 0; i < pipe->bad_count && i < MAX_BAD_LBAS; i++) {
+        if (pipe->bad_found[i] == pipe->bad_lba[i] ||
+            pipe->bad_found[i] == UINT64_MAX) {
+            snprintf(logbuf, sizeof(logbuf), "LBA %llu: bad data at byte %u",
+                     (unsigned long long)pipe->bad_lba[i],
+                     pipe->bad_byte[i]);
+        } else {
+            snprintf(logbuf, sizeof(logbuf), "LBA %llu: holds LBA %llu",
+                     (unsigned long long)pipe->bad_lba[i],
+                     (unsigned long long)pipe->bad_found[i]);
+        }
+        print_test_case_log(APP_NAME, pipe->info->case_id, logbuf);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct block_info info;
+    static struct pipeline pipe;
+    int options = 0, fd = -1, i = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.size = (uint64_t)DEFAULT_SIZE_MB << 20;
+    info.chunk = DEFAULT_CHUNK;
+    info.do_write = 1;
+    info.do_read = 1;
+    info.seed = DEFAULT_SEED;
+
+    while ((options = getopt(argc, argv, "b:c:d:fm:o:s:")) != -1) {
+        switch (options) {
+            case 'b':
+                info.chunk = atoi(optarg);
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                snprintf(info.device, sizeof(info.device), "%s", optarg);
+                break;
+            case 'f':
+                info.force = 1;
+                break;
+            case 'm':
+                if (strcmp(optarg, "write") && strcmp(optarg, "read") &&
+                    strcmp(optarg, "all")) {
+                    usage();
+                    return -EINVAL;
+                }
+                info.do_write = strcmp(optarg, "read") != 0;
+                info.do_read = strcmp(optarg, "write") != 0;
+                break;
+            case 'o':
+                info.start = (uint64_t)atoll(optarg) << 20;
+                break;
+            case 's':
+                info.size = (uint64_t)atoll(optarg) << 20;
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (!info.size || info.chunk < DIRECT_ALIGN || info.chunk > MAX_CHUNK ||
+        info.chunk % DIRECT_ALIGN) {
+        usage();
+        return -EINVAL;
+    }
+
+    if (!info.device[0] &&
+        gb_find_sd_blockdev(0, info.device, sizeof(info.device))) {
+        usage();
+        return -EINVAL;
+    }
+
+    if (info.do_write && !info.force && device_mounted(info.device)) {
+        ret = -EBUSY;
+        print_test_case_log(APP_NAME, info.case_id,
+                            "device is mounted, use -f to write anyway");
+        goto out;
+    }
+
+    fd = open(info.device, (info.do_write ? O_RDWR : O_RDONLY) | O_DIRECT);
+    if (fd < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    if (ioctl(fd, BLKGETSIZE64, &info.dev_size) < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    if (info.start + info.size > info.dev_size) {
+        ret = -ERANGE;
+        print_test_case_log(APP_NAME, info.case_id,
+                            "test area is past the end of the device");
+        goto out;
+    }
+
+    printf("%s: device=%s dev_size=%llu start=%llu size=%llu chunk=%d\n",
+           APP_NAME, info.device, (unsigned long long)info.dev_size,
+           (unsigned long long)info.start, (unsigned long long)info.size,
+           info.chunk);
+
+    pipe.info = &info;
+    pipe.fd = fd;
+    pthread_mutex_init(&pipe.lock, NULL);
+    pthread_cond_init(&pipe.cond, NULL);
+    for (i = 0; i < NR_SLOTS; i++) {
+        if (posix_memalign((void **)&pipe.slot[i].buf, DIRECT_ALIGN,
+                           info.chunk)) {
+            ret = -ENOMEM;
+            goto out;
+        }
+    }
+
+    if (info.do_write) {
+        pipe.producer = fill_slot;
+        pipe.consumer = write_slot;
+        ret = run_pipeline(&pipe);
+        /* the card may still cache the data, flush it before timing ends */
+        if (!ret && fsync(fd)) {
+            ret = -errno;
+        }
+        if (!ret) {
+            pipe.elapsed_ns = stats_now_ns() - pipe.start_ns;
+            print_pass(&pipe, "write", pipe.consumer_ns, pipe.producer_ns);
+        }
+    }
+
+    if (!ret && info.do_read) {
+        pipe.producer = read_slot;
+        pipe.consumer = verify_slot;
+        pipe.bad_count = 0;
+        ret = run_pipeline(&pipe);
+        if (!ret) {
+            print_pass(&pipe, "read", pipe.producer_ns, pipe.consumer_ns);
+            print_mismatches(&pipe);
+            ret = pipe.bad_count ? -EIO : 0;
+        }
+    }
+
+out:
+    for (i = 0; i < NR_SLOTS; i++) {
+        free(pipe.slot[i].buf);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
+}
@@ -1,16 +1,130 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "sd_caps"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <getopt.h>
+
 #include "libfwtest.h"
 
+/* /sys/block size is in 512 byte sectors whatever the block size */
+#define SECTOR_SIZE 512
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-w] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -w: fail if a card is read only.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Lists the capacity, block size and max request size of "
+            "the cards in the\nGreybus SD hosts.\n");
+}
+
+/**
+ * @brief Print the capabilities of one card.
+ *
+ * @param case_id Testrail test case ID.
+ * @param dev The card.
+ * @param writable Fail if the card is read only.
+ * @return 0 on success, error code on failure.
+ */
+static int print_caps(int case_id, const struct gb_enum_dev *dev,
+                      int writable)
+{
+    const char *type = gb_enum_attr(dev, "device/type");
+    const char *card = gb_enum_attr(dev, "device/name");
+    double size_mb = 0;
+    char metric[64];
+    int ro = 0;
+
+    if (!gb_enum_attr(dev, "size")[0]) {
+        return -ENODEV;
+    }
+    size_mb = strtoull(gb_enum_attr(dev, "size"), NULL, 0) * SECTOR_SIZE /
+              1e6;
+    ro = atoi(gb_enum_attr(dev, "ro"));
+
+    printf("%s: %s bundle %s type %s name %s%s\n", APP_NAME, dev->name,
+           dev->bundle[0] ? dev->bundle : "-", type[0] ? type : "-",
+           card[0] ? card : "-", ro ? " read_only" : "");
+
+    snprintf(metric, sizeof(metric), "%s_capacity", dev->name);
+    print_test_case_perf(case_id, metric, size_mb, "MB");
+    snprintf(metric, sizeof(metric), "%s_block_size", dev->name);
+    print_test_case_perf(case_id, metric,
+                         atoi(gb_enum_attr(dev, "queue/logical_block_size")),
+                         "B");
+    snprintf(metric, sizeof(metric), "%s_max_request", dev->name);
+    print_test_case_perf(case_id, metric,
+                         atoi(gb_enum_attr(dev, "queue/max_hw_sectors_kb")),
+                         "kB");
+    if (writable) {
+        snprintf(metric, sizeof(metric), "%s_writable", dev->name);
+        print_test_case_check(case_id, metric, ro);
+    }
+
+    return writable && ro ? -EROFS : 0;
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    static struct gb_enum_dev devs[GB_ENUM_MAX_DEVS];
+    int options = 0, case_id = 0, writable = 0, ndevs = 0, i = 0;
+    int ret = 0, err = 0;
+
+    while ((options = getopt(argc, argv, "c:w")) != -1) {
+        switch (options) {
+            case 'c':
+                case_id = atoi(optarg);
+                break;
+            case 'w':
+                writable = 1;
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    ndevs = gb_enum(GB_ENUM_MASK(GB_ENUM_SD), devs, GB_ENUM_MAX_DEVS);
+    ret = ndevs < 0 ? ndevs : (ndevs ? 0 : -ENODEV);
+    for (i = 0; i < ndevs; i++) {
+        err = print_caps(case_id, &devs[i], writable);
+        if (err && !ret) {
+            ret = err;
+        }
+    }
+
+    print_test_case_result(APP_NAME, case_id, ret, strerror(-ret));
+
+    return ret;
 }
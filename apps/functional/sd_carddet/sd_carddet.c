@@ -1,16 +1,413 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "sd_carddet"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+#define GPIO_CLASS "/sys/class/gpio"
+/* Default number of insert/remove cycles */
+#define DEFAULT_CYCLES 10
+/* Default give up time of one insertion or removal, in seconds */
+#define DEFAULT_TIMEOUT 10
+/* Default time the card stays in once ready, in ms */
+#define DEFAULT_HOLD_MS 500
+/* Default time between bounces of the emulated card detect, in us */
+#define DEFAULT_BOUNCE_US 1000
+#define SECTOR_SIZE 512
+
+enum stage {
+    /* card detect to the mmc card uevent: interrupt, debounce, rescan */
+    STAGE_CARD,
+    /* the card to its block disk uevent */
+    STAGE_DISK,
+    /* the disk uevent to a readable device node */
+    STAGE_READY,
+    STAGE_MAX,
+};
+
+static const char * const stage_name[STAGE_MAX] = {
+    "card", "disk", "ready",
+};
+
+struct carddet_info {
+    int case_id;
+    int gpio;
+    int insert_level;
+    int cycles;
+    int timeout;
+    int hold_ms;
+    int bounces;
+    int bounce_us;
+    int sock;
+};
+
+struct carddet_run {
+    struct stats_hist stage[STAGE_MAX];
+    struct stats_hist total;
+    struct stats_hist removal;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-g gpio] [-l level] [-b bounces] "
+            "[-B us] [-n cycles]\n        [-h hold_ms] [-t seconds] "
+            "[-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -g: GPIO that drives the card detect line, "
+            "without it cards are\n        inserted and removed by "
+            "hand.\n");
+    fprintf(stdout, "    -l: GPIO level of an inserted card (default 0, "
+            "active low).\n");
+    fprintf(stdout, "    -b: contact bounces before each emulated edge "
+            "(default 0).\n");
+    fprintf(stdout, "    -B: time between bounces in us (default %d).\n",
+            DEFAULT_BOUNCE_US);
+    fprintf(stdout, "    -n: insert/remove cycles (default %d).\n",
+            DEFAULT_CYCLES);
+    fprintf(stdout, "    -h: time the card stays in once ready, in ms "
+            "(default %d).\n", DEFAULT_HOLD_MS);
+    fprintf(stdout, "    -t: give up on an insertion or removal after "
+            "this many seconds\n        (default %d).\n", DEFAULT_TIMEOUT);
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Times are from the last emulated edge, or from the "
+            "card uevent by hand.\n");
+    fprintf(stdout, "Example: %s -g 42 -b 5 -B 2000 -n 50\n", APP_NAME);
+}
+
+static int set_level(struct carddet_info *info, int level)
+{
+    char value[4];
+
+    snprintf(value, sizeof(value), "%d", level);
+    return gpio_set_attr(info->gpio, GPIO_ATTR_VALUE, value, strlen(value));
+}
+
+/**
+ * @brief Drive the emulated card detect line, with contact bounce.
+ *
+ * @param info The card detect info.
+ * @param inserted 1 to insert the card, 0 to remove it.
+ * @param t0 Returns the time of the final edge.
+ * @return 0 on success, error code on failure.
+ */
+static int set_card(struct carddet_info *info, int inserted, uint64_t *t0)
+{
+    int level = inserted ? info->insert_level : !info->insert_level;
+    int i, ret = 0;
+
+    if (info->gpio < 0) {
+        print_test_case_log(APP_NAME, info->case_id, inserted ?
+                            "Insert the card" : "Remove the card");
+        *t0 = 0;
+        return 0;
+    }
+
+    for (i = 0; i < info->bounces && !ret; i++) {
+        ret = set_level(info, level);
+        usleep(info->bounce_us);
+        if (!ret) {
+            ret = set_level(info, !level);
+        }
+        usleep(info->bounce_us);
+    }
+    if (!ret) {
+        *t0 = stats_now_ns();
+        ret = set_level(info, level);
+    }
+
+    return ret;
+}
+
+/* a greybus SD card or its block device */
+static int is_greybus_mmc(const struct uevent *ev, const char *subsystem)
+{
+    return !strcmp(ev->subsystem, subsystem) &&
+           strstr(ev->devpath, "/greybus") != NULL;
+}
+
+/* the node is ready once its first sector reads */
+static int read_first_sector(const char *node)
+{
+    static char buf[SECTOR_SIZE];
+    int fd = -1, ret = 0;
+
+    fd = open(node, O_RDONLY);
+    if (fd < 0) {
+        return -errno;
+    }
+    if (pread(fd, buf, sizeof(buf), 0) != sizeof(buf)) {
+        ret = -EIO;
+    }
+    close(fd);
+
+    return ret;
+}
+
+/**
+ * @brief Insert the card and time it to a readable block device.
+ *
+ * @param info The card detect info.
+ * @param stage Returns the stage times, each from the previous stage.
+ * @param disk Returns the block device name.
+ * @param len The disk buffer size.
+ * @return 0 on success, error code on failure.
+ */
+static int insert_card(struct carddet_info *info, uint64_t *stage, char *disk,
+                       int len)
+{
+    static struct uevent ev;
+    char node[PATH_MAX];
+    uint64_t t0 = 0, card = 0, t = 0;
+    int ret = 0;
+
+    ret = set_card(info, 1, &t0);
+
+    while (!ret) {
+        ret = uevent_recv(info->sock, &ev, info->timeout * 1000);
+        if (ret) {
+            break;
+        }
+        if (!strcmp(ev.action, "add") && is_greybus_mmc(&ev, "mmc")) {
+            if (!t0) {
+                t0 = ev.ts;
+            }
+            card = ev.ts;
+            stage[STAGE_CARD] = card - t0;
+        } else if (card && !strcmp(ev.action, "add") &&
+                   is_greybus_mmc(&ev, "block") &&
+                   !strcmp(ev.devtype, "disk")) {
+            stage[STAGE_DISK] = ev.ts - card;
+            snprintf(disk, len, "%s", ev.devname);
+            break;
+        }
+    }
+    if (ret) {
+        return ret;
+    }
+
+    t = ev.ts;
+    snprintf(node, sizeof(node), "/dev/block/%s", disk);
+    if (access(node, F_OK) && !access("/dev/block", F_OK)) {
+        ret = uevent_wait_devnode(node, info->timeout * 1000);
+    } else if (access(node, F_OK)) {
+        snprintf(node, sizeof(node), "/dev/%s", disk);
+        ret = uevent_wait_devnode(node, info->timeout * 1000);
+    }
+    if (!ret) {
+        ret = read_first_sector(node);
+    }
+    if (!ret) {
+        stage[STAGE_READY] = stats_now_ns() - t;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Remove the card and time it to the removal of its block device.
+ *
+ * @param info The card detect info.
+ * @param disk The block device name.
+ * @param ns Returns the time.
+ * @return 0 on success, error code on failure.
+ */
+static int remove_card(struct carddet_info *info, const char *disk,
+                       uint64_t *ns)
+{
+    static struct uevent ev;
+    struct uevent_filter filter;
+    char devname[80];
+    uint64_t t0 = 0;
+    int ret = 0;
+
+    /*
+     * DEVNAME is the last DEVPATH component, matching it whole keeps
+     * mmcblk1 from matching mmcblk10
+     */
+    snprintf(devname, sizeof(devname), "DEVNAME=%s", disk);
+    memset(&filter, 0, sizeof(filter));
+    filter.action = "remove";
+    filter.subsystem = "block";
+    filter.devtype = "disk";
+    filter.env = devname;
+
+    ret = set_card(info, 0, &t0);
+    if (!ret) {
+        ret = uevent_wait(info->sock, &filter, info->timeout * 1000, &ev);
+    }
+    if (!ret) {
+        *ns = t0 ? ev.ts - t0 : 0;
+    }
+
+    return ret;
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    struct carddet_info info;
+    static struct carddet_run run;
+    uint64_t stage[STAGE_MAX], total = 0, ns = 0;
+    char disk[64], gpiostr[PATH_MAX], name[32];
+    int options = 0, i = 0, j = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.gpio = -1;
+    info.sock = -1;
+    info.cycles = DEFAULT_CYCLES;
+    info.timeout = DEFAULT_TIMEOUT;
+    info.hold_ms = DEFAULT_HOLD_MS;
+    info.bounce_us = DEFAULT_BOUNCE_US;
+
+    while ((options = getopt(argc, argv, "b:B:c:g:h:l:n:t:")) != -1) {
+        switch (options) {
+            case 'b':
+                info.bounces = atoi(optarg);
+                break;
+            case 'B':
+                info.bounce_us = atoi(optarg);
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'g':
+                info.gpio = atoi(optarg);
+                break;
+            case 'h':
+                info.hold_ms = atoi(optarg);
+                break;
+            case 'l':
+                info.insert_level = !!atoi(optarg);
+                break;
+            case 'n':
+                info.cycles = atoi(optarg);
+                break;
+            case 't':
+                info.timeout = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (info.cycles < 1 || info.timeout < 1 || info.hold_ms < 0 ||
+        info.bounces < 0 || info.bounce_us < 0) {
+        usage();
+        return -EINVAL;
+    }
+
+    for (i = 0; i < STAGE_MAX; i++) {
+        stats_hist_init(&run.stage[i]);
+    }
+    stats_hist_init(&run.total);
+    stats_hist_init(&run.removal);
+
+    /* the emulated card starts out removed */
+    if (info.gpio >= 0) {
+        snprintf(gpiostr, sizeof(gpiostr), "%s/gpio%d", GPIO_CLASS,
+                 info.gpio);
+        if (access(gpiostr, F_OK)) {
+            ret = gpio_export(info.gpio);
+        }
+        if (!ret) {
+            snprintf(gpiostr, sizeof(gpiostr), info.insert_level ? "low" :
+                     "high");
+            ret = gpio_set_attr(info.gpio, GPIO_ATTR_DIRECTION, gpiostr,
+                                strlen(gpiostr));
+        }
+    }
+
+    if (!ret) {
+        info.sock = uevent_open();
+        if (info.sock < 0) {
+            ret = info.sock;
+        }
+    }
+
+    /* a card that was in goes with the line set to removed above */
+    if (!ret && info.gpio >= 0 &&
+        !gb_find_sd_blockdev(0, disk, sizeof(disk))) {
+        snprintf(gpiostr, sizeof(gpiostr), "/sys/class/block/%s",
+                 basename(disk));
+        ret = uevent_wait_sysfs(gpiostr, 0, info.timeout * 1000);
+    }
+
+    for (i = 0; i < info.cycles && !ret; i++) {
+        memset(stage, 0, sizeof(stage));
+        ret = insert_card(&info, stage, disk, sizeof(disk));
+        if (ret) {
+            break;
+        }
+
+        total = 0;
+        for (j = 0; j < STAGE_MAX; j++) {
+            if (j != STAGE_CARD || info.gpio >= 0) {
+                stats_hist_record(&run.stage[j], stage[j]);
+            }
+            total += stage[j];
+        }
+        stats_hist_record(&run.total, total);
+
+        usleep(info.hold_ms * 1000);
+        ret = remove_card(&info, disk, &ns);
+        if (!ret && ns) {
+            stats_hist_record(&run.removal, ns);
+        }
+    }
+
+    uevent_close(info.sock);
+    if (info.gpio >= 0) {
+        gpio_attr_release(info.gpio);
+    }
+
+    for (i = 0; i < STAGE_MAX; i++) {
+        if (run.stage[i].count) {
+            snprintf(name, sizeof(name), "insert_%s", stage_name[i]);
+            stats_hist_report(info.case_id, name, &run.stage[i]);
+        }
+    }
+    stats_hist_report(info.case_id, "insert_total", &run.total);
+    if (run.removal.count) {
+        stats_hist_report(info.case_id, "removal", &run.removal);
+    }
+
+    print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+
+    return ret;
 }
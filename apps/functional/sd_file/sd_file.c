@@ -1,16 +1,434 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "sd_file"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+/* Default test file size, in MiB */
+#define DEFAULT_SIZE_MB 256
+/* Default write and read() chunk size, in bytes */
+#define DEFAULT_CHUNK (1024 * 1024)
+/* Max write and read() chunk size, in bytes */
+#define MAX_CHUNK (64 * 1024 * 1024)
+/* mmap verify window, the pages of one window are faulted in at once */
+#define VERIFY_WINDOW (8 * 1024 * 1024)
+/* Default pattern seed */
+#define DEFAULT_SEED 0x5344464954455354ULL
+
+enum verify_method {
+    VERIFY_MMAP,
+    VERIFY_READ,
+};
+
+struct file_info {
+    int case_id;
+    char path[PATH_MAX];
+    uint64_t size;
+    int chunk;
+    int do_write;
+    int do_verify;
+    int keep;
+    enum verify_method method;
+    uint64_t seed;
+};
+
+/* time split of one pass, I/O is the kernel and card, verify the CPU */
+struct pass_time {
+    uint64_t io_ns;
+    uint64_t verify_ns;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s -f file [-s size_mb] [-b chunk] "
+            "[-m mode] [-v method] [-k] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -f: test file on the SD card file system.\n");
+    fprintf(stdout, "    -s: file size in MiB (default %d).\n",
+            DEFAULT_SIZE_MB);
+    fprintf(stdout, "    -b: write and read() chunk size in bytes "
+            "(default %d).\n", DEFAULT_CHUNK);
+    fprintf(stdout, "    -m: write, verify or all (default all).\n");
+    fprintf(stdout, "    -v: verify through mmap or read (default mmap).\n");
+    fprintf(stdout, "    -k: keep the file after the test.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Example: %s -f /storage/sdcard1/sd_file.bin -s 2048\n",
+            APP_NAME);
+}
+
+/**
+ * @brief Print the bandwidth of a pass part as summary and [P] lines.
+ *
+ * @param info The file info.
+ * @param name Metric name.
+ * @param ns Time spent, in nanoseconds.
+ */
+static void print_bandwidth(const struct file_info *info, const char *name,
+                            uint64_t ns)
+{
+    double mbps = ns ? info->size / (ns / 1e9) / 1e6 : 0.0;
+
+    printf("%s: %s_MB_per_s=%.2f time_s=%.3f\n", APP_NAME, name, mbps,
+           ns / 1e9);
+    print_test_case_perf(info->case_id, name, mbps, "MB/s");
+}
+
+/**
+ * @brief Write the pattern file.
+ *
+ * The time includes the final fsync(), so the data is on the card.
+ *
+ * @param info The file info.
+ * @param time The measured time.
+ * @return 0 on success, error code on failure.
+ */
+static int write_file(const struct file_info *info, struct pass_time *time)
+{
+    uint64_t off = 0, t0, t1;
+    uint8_t *buf = NULL;
+    ssize_t n;
+    size_t len;
+    int fd = -1, ret = 0;
+
+    if (posix_memalign((void **)&buf, 4096, info->chunk)) {
+        return -ENOMEM;
+    }
+
+    fd = open(info->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    for (off = 0; off < info->size; off += len) {
+        len = info->size - off < (uint64_t)info->chunk ?
+              info->size - off : (uint64_t)info->chunk;
+
+        t0 = stats_now_ns();
+        pattern_fill(buf, len, off, info->seed);
+        t1 = stats_now_ns();
+        time->verify_ns += t1 - t0;
+
+        n = write(fd, buf, len);
+        time->io_ns += stats_now_ns() - t1;
+        if (n != (ssize_t)len) {
+            ret = n < 0 ? -errno : -ENOSPC;
+            goto out;
+        }
+    }
+
+    t0 = stats_now_ns();
+    if (fsync(fd)) {
+        ret = -errno;
+    }
+    time->io_ns += stats_now_ns() - t0;
+
+out:
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(buf);
+    return ret;
+}
+
+/**
+ * @brief Report a pattern mismatch.
+ *
+ * @param info The file info.
+ * @param off File offset of the mismatching word.
+ * @return -EIO
+ */
+static int report_mismatch(const struct file_info *info, uint64_t off)
+{
+    char logbuf[96];
+
+    snprintf(logbuf, sizeof(logbuf), "pattern mismatch at offset %llu",
+             (unsigned long long)off);
+    print_test_case_log(APP_NAME, info->case_id, logbuf);
+
+    return -EIO;
+}
+
+/**
+ * @brief Verify the file through a shared read-only mapping.
+ *
+ * The pages of each window are faulted in first, touching one byte per
+ * page, which is counted as I/O. The pattern and CRC kernel then runs on
+ * resident pages and is counted as verify time. The data is never copied.
+ *
+ * @param info The file info.
+ * @param crc Returns the file CRC-32.
+ * @param time The measured time.
+ * @return 0 on success, error code on failure.
+ */
+static int verify_mmap(const struct file_info *info, uint32_t *crc,
+                       struct pass_time *time)
+{
+    volatile const uint8_t *touch;
+    uint64_t off = 0, t0, t1;
+    long page = sysconf(_SC_PAGESIZE);
+    uint8_t *map = NULL;
+    int64_t bad;
+    size_t len, i;
+    int fd = -1, ret = 0;
+
+    fd = open(info->path, O_RDONLY);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    map = mmap(NULL, info->size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        ret = -errno;
+        close(fd);
+        return ret;
+    }
+    madvise(map, info->size, MADV_SEQUENTIAL);
+
+    for (off = 0; off < info->size && !ret; off += len) {
+        len = info->size - off < VERIFY_WINDOW ?
+              info->size - off : VERIFY_WINDOW;
+
+        t0 = stats_now_ns();
+        touch = map + off;
+        for (i = 0; i < len; i += page) {
+            (void)touch[i];
+        }
+        t1 = stats_now_ns();
+        time->io_ns += t1 - t0;
+
+        bad = pattern_check(map + off, len, off, info->seed);
+        *crc = crc32_update(*crc, map + off, len);
+        time->verify_ns += stats_now_ns() - t1;
+        if (bad >= 0) {
+            ret = report_mismatch(info, off + bad);
+        }
+
+        /* the window is done, let it go before the next one comes in */
+        madvise(map + off, len, MADV_DONTNEED);
+    }
+
+    munmap(map, info->size);
+    close(fd);
+    return ret;
+}
+
+/**
+ * @brief Verify the file with read() into a buffer, for comparison.
+ *
+ * @param info The file info.
+ * @param crc Returns the file CRC-32.
+ * @param time The measured time.
+ * @return 0 on success, error code on failure.
+ */
+static int verify_read(const struct file_info *info, uint32_t *crc,
+                       struct pass_time *time)
+{
+    uint64_t off = 0, t0, t1;
+    uint8_t *buf = NULL;
+    int64_t bad;
+    ssize_t n;
+    size_t len;
+    int fd = -1, ret = 0;
+
+    if (posix_memalign((void **)&buf, 4096, info->chunk)) {
+        return -ENOMEM;
+    }
+
+    fd = open(info->path, O_RDONLY);
+    if (fd < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    for (off = 0; off < info->size && !ret; off += len) {
+        len = info->size - off < (uint64_t)info->chunk ?
+              info->size - off : (uint64_t)info->chunk;
+
+        t0 = stats_now_ns();
+        n = read(fd, buf, len);
+        t1 = stats_now_ns();
+        time->io_ns += t1 - t0;
+        if (n != (ssize_t)len) {
+            ret = n < 0 ? -errno : -EIO;
+            break;
+        }
+
+        bad = pattern_check(buf, len, off, info->seed);
+        *crc = crc32_update(*crc, buf, len);
+        time->verify_ns += stats_now_ns() - t1;
+        if (bad >= 0) {
+            ret = report_mismatch(info, off + bad);
+        }
+    }
+
+out:
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(buf);
+    return ret;
+}
+
+/**
+ * @brief Drop the file from the page cache, so the verify reads the card.
+ *
+ * @param info The file info.
+ * @return None
+ */
+static void drop_cache(const struct file_info *info)
+{
+    int fd = open(info->path, O_RDONLY);
+
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    struct file_info info;
+    struct pass_time wtime, vtime;
+    struct stat st;
+    uint32_t crc = 0;
+    char logbuf[64];
+    int options = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.size = (uint64_t)DEFAULT_SIZE_MB << 20;
+    info.chunk = DEFAULT_CHUNK;
+    info.do_write = 1;
+    info.do_verify = 1;
+    info.method = VERIFY_MMAP;
+    info.seed = DEFAULT_SEED;
+
+    while ((options = getopt(argc, argv, "b:c:f:km:s:v:")) != -1) {
+        switch (options) {
+            case 'b':
+                info.chunk = atoi(optarg);
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'f':
+                snprintf(info.path, sizeof(info.path), "%s", optarg);
+                break;
+            case 'k':
+                info.keep = 1;
+                break;
+            case 'm':
+                if (strcmp(optarg, "write") && strcmp(optarg, "verify") &&
+                    strcmp(optarg, "all")) {
+                    usage();
+                    return -EINVAL;
+                }
+                info.do_write = strcmp(optarg, "verify") != 0;
+                info.do_verify = strcmp(optarg, "write") != 0;
+                break;
+            case 's':
+                info.size = (uint64_t)atoll(optarg) << 20;
+                break;
+            case 'v':
+                if (!strcmp(optarg, "mmap")) {
+                    info.method = VERIFY_MMAP;
+                } else if (!strcmp(optarg, "read")) {
+                    info.method = VERIFY_READ;
+                } else {
+                    usage();
+                    return -EINVAL;
+                }
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (!info.path[0] || !info.size || info.chunk < 8 ||
+        info.chunk > MAX_CHUNK || info.chunk % 8) {
+        usage();
+        return -EINVAL;
+    }
+
+    memset(&wtime, 0, sizeof(wtime));
+    memset(&vtime, 0, sizeof(vtime));
+
+    if (info.do_write) {
+        ret = write_file(&info, &wtime);
+        if (!ret) {
+            print_bandwidth(&info, "write_io", wtime.io_ns);
+            print_bandwidth(&info, "write_fill", wtime.verify_ns);
+        }
+    } else if (stat(info.path, &st)) {
+        ret = -errno;
+    } else {
+        /* verify an existing file with its own size */
+        info.size = st.st_size & ~7ULL;
+    }
+
+    if (!ret && info.do_verify) {
+        drop_cache(&info);
+        if (info.method == VERIFY_MMAP) {
+            ret = verify_mmap(&info, &crc, &vtime);
+        } else {
+            ret = verify_read(&info, &crc, &vtime);
+        }
+
+        print_bandwidth(&info, "verify_io", vtime.io_ns);
+        print_bandwidth(&info, "verify_cpu", vtime.verify_ns);
+        print_bandwidth(&info, "verify_total", vtime.io_ns + vtime.verify_ns);
+        snprintf(logbuf, sizeof(logbuf), "method=%s crc32=%08x",
+                 info.method == VERIFY_MMAP ? "mmap" : "read", crc);
+        print_test_case_log(APP_NAME, info.case_id, logbuf);
+    }
+
+    if (info.do_write && !info.keep) {
+        unlink(info.path);
+    }
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
 }
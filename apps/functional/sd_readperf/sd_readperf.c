@@ -1,16 +1,529 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "sd_readperf"
 
-#include "stdio.h"
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#include <linux/aio_abi.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+/* Default block size sweep, in bytes */
+#define DEFAULT_SIZES "4096,65536,1048576"
+/* Default run time of each pattern and block size, in seconds */
+#define DEFAULT_DURATION 10
+/* Max number of block sizes in one sweep */
+#define MAX_SIZES 8
+/* Max block size, in bytes */
+#define MAX_BLOCK_SIZE (16 * 1024 * 1024)
+/* Max number of reads in flight */
+#define MAX_QUEUE_DEPTH 64
+/* O_DIRECT buffer and offset alignment */
+#define DIRECT_ALIGN 4096
+
+enum read_pattern {
+    PATTERN_SEQ,
+    PATTERN_RAND,
+    PATTERN_MAX,
+};
+
+static const char *pattern_name[PATTERN_MAX] = {
+    "seq",
+    "rand",
+};
+
+struct readperf_info {
+    int case_id;
+    char device[PATH_MAX];
+    int duration;
+    int qdepth;
+    int patterns;
+    int nsizes;
+    int sizes[MAX_SIZES];
+    uint64_t dev_size;
+};
+
+struct readperf_result {
+    uint64_t ops;
+    uint64_t errors;
+    uint64_t elapsed_ns;
+    struct stats_hist hist;
+};
+
+/* offset generator of one pattern run */
+struct offset_gen {
+    enum read_pattern pattern;
+    uint64_t next;
+    uint64_t nblocks;
+    uint64_t seed;
+    int size;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d device] [-p pattern] [-s sizes] "
+            "[-q depth] [-t seconds] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -d: block device, defaults to the first card in a "
+            "Greybus\n        SD host.\n");
+    fprintf(stdout, "    -p: seq, rand or all (default all).\n");
+    fprintf(stdout, "    -s: comma separated block sizes in bytes, multiples "
+            "of %d\n        (default %s).\n", DIRECT_ALIGN, DEFAULT_SIZES);
+    fprintf(stdout, "    -q: reads in flight, up to %d (default 1). Depths "
+            "above 1\n        use Linux native AIO.\n", MAX_QUEUE_DEPTH);
+    fprintf(stdout, "    -t: run time of each pattern and size in seconds "
+            "(default %d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Example: %s -d /dev/block/mmcblk1 -p rand -s 4096 -q 8\n",
+            APP_NAME);
 }
 
-int main(int argc, char **argv)
+/*
+ * Native AIO through raw system calls, the NDK has no libaio and the
+ * target kernels predate io_uring.
+ */
+static int io_setup(unsigned nr, aio_context_t *ctx)
+{
+    return syscall(__NR_io_setup, nr, ctx);
+}
+
+static int io_destroy(aio_context_t ctx)
+{
+    return syscall(__NR_io_destroy, ctx);
+}
+
+static int io_submit(aio_context_t ctx, long nr, struct iocb **iocbpp)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    return syscall(__NR_io_submit, ctx, nr, iocbpp);
+}
+
+static int io_getevents(aio_context_t ctx, long min_nr, long max_nr,
+                        struct io_event *events, struct timespec *timeout)
+{
+    return syscall(__NR_io_getevents, ctx, min_nr, max_nr, events, timeout);
+}
+
+/**
+ * @brief Parse comma separated block size list.
+ *
+ * @param info The readperf info to fill.
+ * @param list The size list from command line.
+ * @return 0 on success, -EINVAL on bad list.
+ */
+static int parse_sizes(struct readperf_info *info, const char *list)
+{
+    char buf[128];
+    char *tok, *save = NULL;
+    int size;
+
+    snprintf(buf, sizeof(buf), "%s", list);
+    info->nsizes = 0;
+
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        size = atoi(tok);
+        if (size < DIRECT_ALIGN || size > MAX_BLOCK_SIZE ||
+            size % DIRECT_ALIGN || info->nsizes >= MAX_SIZES) {
+            return -EINVAL;
+        }
+        info->sizes[info->nsizes++] = size;
+    }
+
+    return info->nsizes ? 0 : -EINVAL;
+}
+
+/**
+ * @brief Parse the -p option.
+ *
+ * @param arg The pattern name.
+ * @return bit mask of patterns to run, 0 on bad name.
+ */
+static int parse_patterns(const char *arg)
+{
+    int i = 0;
+
+    if (!strcmp(arg, "all")) {
+        return (1 << PATTERN_MAX) - 1;
+    }
+
+    for (i = 0; i < PATTERN_MAX; i++) {
+        if (!strcmp(arg, pattern_name[i])) {
+            return 1 << i;
+        }
+    }
+
     return 0;
 }
+
+/**
+ * @brief Get the offset of the next read.
+ *
+ * Sequential reads wrap at the end of the device, random reads pick a
+ * block aligned offset with a xorshift generator.
+ *
+ * @param gen The offset generator.
+ * @return byte offset.
+ */
+static uint64_t next_offset(struct offset_gen *gen)
+{
+    uint64_t block;
+
+    if (gen->pattern == PATTERN_SEQ) {
+        block = gen->next++;
+        if (gen->next >= gen->nblocks) {
+            gen->next = 0;
+        }
+    } else {
+        gen->seed ^= gen->seed << 13;
+        gen->seed ^= gen->seed >> 7;
+        gen->seed ^= gen->seed << 17;
+        block = gen->seed % gen->nblocks;
+    }
+
+    return block * gen->size;
+}
+
+/**
+ * @brief Read with one request at a time.
+ *
+ * @param fd The block device.
+ * @param gen The offset generator.
+ * @param buf Aligned read buffer.
+ * @param end End time in nanoseconds.
+ * @param result The measured result.
+ * @return 0 on success, error code on failure.
+ */
+static int run_sync(int fd, struct offset_gen *gen, uint8_t *buf, uint64_t end,
+                    struct readperf_result *result)
+{
+    uint64_t t0, t1;
+
+    do {
+        t0 = stats_now_ns();
+        if (pread(fd, buf, gen->size, next_offset(gen)) != gen->size) {
+            result->errors++;
+            t1 = stats_now_ns();
+            continue;
+        }
+        t1 = stats_now_ns();
+
+        result->ops++;
+        stats_hist_record(&result->hist, t1 - t0);
+    } while (t1 < end);
+
+    return 0;
+}
+
+/**
+ * @brief Read with qdepth requests in flight.
+ *
+ * Every completion is replaced by a new read right away until the run
+ * time is over, then the remaining reads are reaped.
+ *
+ * @param fd The block device.
+ * @param gen The offset generator.
+ * @param buf Aligned read buffer, qdepth blocks.
+ * @param qdepth Number of reads in flight.
+ * @param end End time in nanoseconds.
+ * @param result The measured result.
+ * @return 0 on success, error code on failure.
+ */
+static int run_aio(int fd, struct offset_gen *gen, uint8_t *buf, int qdepth,
+                   uint64_t end, struct readperf_result *result)
+{
+    struct iocb iocbs[MAX_QUEUE_DEPTH];
+    struct iocb *iocbp[MAX_QUEUE_DEPTH];
+    struct io_event events[MAX_QUEUE_DEPTH];
+    uint64_t submitted[MAX_QUEUE_DEPTH];
+    aio_context_t ctx = 0;
+    uint64_t now;
+    int inflight = 0, i = 0, n = 0, slot = 0, ret = 0;
+
+    if (io_setup(qdepth, &ctx) < 0) {
+        return -errno;
+    }
+
+    memset(iocbs, 0, sizeof(iocbs));
+    for (i = 0; i < qdepth; i++) {
+        iocbs[i].aio_data = i;
+        iocbs[i].aio_lio_opcode = IOCB_CMD_PREAD;
+        iocbs[i].aio_fildes = fd;
+        iocbs[i].aio_buf = (uintptr_t)(buf + (size_t)i * gen->size);
+        iocbs[i].aio_nbytes = gen->size;
+        iocbs[i].aio_offset = next_offset(gen);
+        iocbp[i] = &iocbs[i];
+        submitted[i] = stats_now_ns();
+    }
+
+    if (io_submit(ctx, qdepth, iocbp) != qdepth) {
+        ret = -errno;
+        io_destroy(ctx);
+        return ret ? ret : -EIO;
+    }
+    inflight = qdepth;
+
+    while (inflight) {
+        n = io_getevents(ctx, 1, qdepth, events, NULL);
+        if (n < 0) {
+            ret = -errno;
+            break;
+        }
+        now = stats_now_ns();
+
+        for (i = 0; i < n; i++) {
+            slot = events[i].data;
+            inflight--;
+            if (events[i].res != (int64_t)gen->size) {
+                result->errors++;
+            } else {
+                result->ops++;
+                stats_hist_record(&result->hist, now - submitted[slot]);
+            }
+
+            if (now >= end) {
+                continue;
+            }
+
+            iocbs[slot].aio_offset = next_offset(gen);
+            submitted[slot] = stats_now_ns();
+            if (io_submit(ctx, 1, &iocbp[slot]) != 1) {
+                ret = -errno;
+                continue;
+            }
+            inflight++;
+        }
+    }
+
+    io_destroy(ctx);
+    return ret;
+}
+
+/**
+ * @brief Run one pattern and block size.
+ *
+ * @param fd The block device.
+ * @param info The readperf info.
+ * @param pattern The read pattern.
+ * @param size Block size.
+ * @param buf Aligned read buffer, qdepth blocks.
+ * @param result The measured result.
+ * @return 0 on success, error code if no read succeeded.
+ */
+static int run_one(int fd, const struct readperf_info *info,
+                   enum read_pattern pattern, int size, uint8_t *buf,
+                   struct readperf_result *result)
+{
+    struct offset_gen gen;
+    uint64_t start, end;
+    int ret = 0;
+
+    memset(&gen, 0, sizeof(gen));
+    gen.pattern = pattern;
+    gen.size = size;
+    gen.nblocks = info->dev_size / size;
+    gen.seed = 0x9e3779b97f4a7c15ULL;
+
+    result->ops = 0;
+    result->errors = 0;
+    stats_hist_init(&result->hist);
+
+    if (gen.nblocks == 0) {
+        return -EINVAL;
+    }
+
+    start = stats_now_ns();
+    end = start + (uint64_t)info->duration * 1000000000ULL;
+
+    if (info->qdepth > 1) {
+        ret = run_aio(fd, &gen, buf, info->qdepth, end, result);
+    } else {
+        ret = run_sync(fd, &gen, buf, end, result);
+    }
+    result->elapsed_ns = stats_now_ns() - start;
+
+    if (!ret && !result->ops) {
+        ret = -EIO;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Print the result of one pattern and block size.
+ *
+ * @param info The readperf info.
+ * @param pattern The read pattern.
+ * @param size Block size.
+ * @param result The measured result.
+ */
+static void print_result(const struct readperf_info *info,
+                         enum read_pattern pattern, int size,
+                         struct readperf_result *result)
+{
+    double secs = result->elapsed_ns / 1e9;
+    double iops = secs > 0 ? result->ops / secs : 0.0;
+    double mbps = iops * size / 1e6;
+    char metric[64];
+
+    printf("\n%s: pattern=%s size=%d qdepth=%d ops=%llu errors=%llu "
+           "MB_per_s=%.2f iops=%.1f p50_us=%.1f p99_us=%.1f "
+           "p999_us=%.1f\n", APP_NAME, pattern_name[pattern], size,
+           info->qdepth, (unsigned long long)result->ops,
+           (unsigned long long)result->errors, mbps, iops,
+           stats_hist_percentile(&result->hist, 50.0) / 1000.0,
+           stats_hist_percentile(&result->hist, 99.0) / 1000.0,
+           stats_hist_percentile(&result->hist, 99.9) / 1000.0);
+
+    snprintf(metric, sizeof(metric), "%s_%dk_qd%d_MBps",
+             pattern_name[pattern], size / 1024, info->qdepth);
+    print_test_case_perf(info->case_id, metric, mbps, "MB/s");
+    snprintf(metric, sizeof(metric), "%s_%dk_qd%d_iops",
+             pattern_name[pattern], size / 1024, info->qdepth);
+    print_test_case_perf(info->case_id, metric, iops, "IOPS");
+    snprintf(metric, sizeof(metric), "%s_%dk_qd%d_latency",
+             pattern_name[pattern], size / 1024, info->qdepth);
+    stats_hist_report(info->case_id, metric, &result->hist);
+}
+
+int main(int argc, char **argv)
+{
+    struct readperf_info info;
+    static struct readperf_result result;
+    uint8_t *buf = NULL;
+    int options = 0, fd = -1, i = 0, p = 0, maxsize = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.duration = DEFAULT_DURATION;
+    info.qdepth = 1;
+    info.patterns = parse_patterns("all");
+    parse_sizes(&info, DEFAULT_SIZES);
+
+    while ((options = getopt(argc, argv, "c:d:p:q:s:t:")) != -1) {
+        switch (options) {
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                snprintf(info.device, sizeof(info.device), "%s", optarg);
+                break;
+            case 'p':
+                info.patterns = parse_patterns(optarg);
+                break;
+            case 'q':
+                info.qdepth = atoi(optarg);
+                break;
+            case 's':
+                if (parse_sizes(&info, optarg)) {
+                    usage();
+                    return -EINVAL;
+                }
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (!info.patterns || info.duration < 1 || info.qdepth < 1 ||
+        info.qdepth > MAX_QUEUE_DEPTH) {
+        usage();
+        return -EINVAL;
+    }
+
+    if (!info.device[0] &&
+        gb_find_sd_blockdev(0, info.device, sizeof(info.device))) {
+        ret = -ENODEV;
+        goto out;
+    }
+
+    fd = open(info.device, O_RDONLY | O_DIRECT);
+    if (fd < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    if (ioctl(fd, BLKGETSIZE64, &info.dev_size) < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    for (i = 0; i < info.nsizes; i++) {
+        if (info.sizes[i] > maxsize) {
+            maxsize = info.sizes[i];
+        }
+    }
+
+    ret = posix_memalign((void **)&buf, DIRECT_ALIGN,
+                         (size_t)maxsize * info.qdepth);
+    if (ret) {
+        buf = NULL;
+        ret = -ret;
+        goto out;
+    }
+
+    printf("%s: device=%s size_bytes=%llu\n", APP_NAME, info.device,
+           (unsigned long long)info.dev_size);
+
+    for (p = 0; p < PATTERN_MAX && !ret; p++) {
+        if (!(info.patterns & (1 << p))) {
+            continue;
+        }
+        for (i = 0; i < info.nsizes && !ret; i++) {
+            ret = run_one(fd, &info, p, info.sizes[i], buf, &result);
+            print_result(&info, p, info.sizes[i], &result);
+        }
+    }
+
+out:
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(buf);
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
+}
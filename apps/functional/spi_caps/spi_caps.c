@@ -1,16 +1,155 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "spi_caps"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+
+#include <linux/spi/spidev.h>
+
 #include "libfwtest.h"
 
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-b bus -s chip_select] [-c case_id]\n",
+            APP_NAME);
+    fprintf(stdout, "    -b: SPI bus number, defaults to every Greybus "
+            "spidev device.\n");
+    fprintf(stdout, "    -s: chip select of the device on the bus (default "
+            "0).\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Lists the default mode, word size and max clock rate "
+            "of the devices.\n");
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Print the default transfer parameters of one spidev device.
+ *
+ * @param case_id Testrail test case ID.
+ * @param bus SPI bus number.
+ * @param cs Chip select of the device on the bus.
+ * @param modalias modalias of the SPI device, NULL if unknown.
+ * @return 0 on success, error code on failure.
+ */
+static int print_caps(int case_id, int bus, int cs, const char *modalias)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    uint32_t mode = 0, speed = 0;
+    uint8_t mode8 = 0, bits = 0, lsb = 0;
+    char metric[64];
+    int file, ret = 0;
+
+    file = open_spi_dev(bus, cs);
+    if (file < 0) {
+        return -errno;
+    }
+
+    /* SPI_IOC_RD_MODE32 is newer than some of the kernels we run on */
+    if (ioctl(file, SPI_IOC_RD_MODE32, &mode) < 0) {
+        if (ioctl(file, SPI_IOC_RD_MODE, &mode8) < 0) {
+            ret = -errno;
+        }
+        mode = mode8;
+    }
+    if (!ret && (ioctl(file, SPI_IOC_RD_LSB_FIRST, &lsb) < 0 ||
+                 ioctl(file, SPI_IOC_RD_BITS_PER_WORD, &bits) < 0 ||
+                 ioctl(file, SPI_IOC_RD_MAX_SPEED_HZ, &speed) < 0)) {
+        ret = -errno;
+    }
+    close(file);
+    if (ret) {
+        return ret;
+    }
+
+    /* 0 bits per word means the default of 8 */
+    bits = bits ? bits : 8;
+    printf("%s: spidev%d.%d modalias %s mode %u%s%s%s%s bits %u "
+           "max_speed %u\n", APP_NAME, bus, cs,
+           modalias && modalias[0] ? modalias : "-",
+           (unsigned int)(mode & SPI_MODE_3),
+           mode & SPI_CS_HIGH ? " cs_high" : "",
+           lsb ? " lsb_first" : "", mode & SPI_3WIRE ? " 3wire" : "",
+           mode & SPI_LOOP ? " loop" : "", bits, speed);
+
+    snprintf(metric, sizeof(metric), "spidev%d.%d_mode", bus, cs);
+    print_test_case_perf(case_id, metric, mode & SPI_MODE_3, "mode");
+    snprintf(metric, sizeof(metric), "spidev%d.%d_bits_per_word", bus, cs);
+    print_test_case_perf(case_id, metric, bits, "bits");
+    snprintf(metric, sizeof(metric), "spidev%d.%d_max_speed", bus, cs);
+    print_test_case_perf(case_id, metric, speed, "Hz");
+
     return 0;
 }
+
+int main(int argc, char **argv)
+{
+    static struct gb_enum_dev devs[GB_ENUM_MAX_DEVS];
+    int options = 0, case_id = 0, bus = -1, cs = 0, ndevs = 0, i = 0;
+    int ret = 0, err = 0;
+
+    while ((options = getopt(argc, argv, "b:c:s:")) != -1) {
+        switch (options) {
+            case 'b':
+                bus = atoi(optarg);
+                break;
+            case 'c':
+                case_id = atoi(optarg);
+                break;
+            case 's':
+                cs = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (bus >= 0) {
+        ret = print_caps(case_id, bus, cs, NULL);
+    } else {
+        ndevs = gb_enum(GB_ENUM_MASK(GB_ENUM_SPI), devs, GB_ENUM_MAX_DEVS);
+        ret = ndevs < 0 ? ndevs : (ndevs ? 0 : -ENODEV);
+        for (i = 0; i < ndevs; i++) {
+            err = print_caps(case_id, devs[i].num[0], devs[i].num[1],
+                             gb_enum_attr(&devs[i], "device/modalias"));
+            if (err && !ret) {
+                ret = err;
+            }
+        }
+    }
+
+    print_test_case_result(APP_NAME, case_id, ret, strerror(-ret));
+
+    return ret;
+}
@@ -1,16 +1,337 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "spi_readperf"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <linux/spi/spidev.h>
+
 #include "libfwtest.h"
 
+/* Default clock rate sweep, in Hz */
+#define DEFAULT_SPEEDS "1000000,4000000,12000000"
+/* Default transfer size sweep, in bytes */
+#define DEFAULT_SIZES "16,64,256,1024,4096"
+/* Default batch depth sweep, transfers per SPI message */
+#define DEFAULT_DEPTHS "1,4,16"
+/* Default run time of each sweep point, in seconds */
+#define DEFAULT_DURATION 2
+/* Max bytes per transfer */
+#define MAX_XFER_SIZE 65536
+/* Max transfers per SPI message */
+#define MAX_DEPTH 64
+
+struct readperf_info {
+    int case_id;
+    int bus;
+    int cs;
+    int mode;
+    int duration;
+    struct sweep speeds;
+    struct sweep sizes;
+    struct sweep depths;
+};
+
+struct readperf_result {
+    uint64_t msgs;
+    uint64_t errors;
+    uint64_t elapsed_ns;
+    struct stats_hist hist;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d bus.cs] [-m mode] [-f speeds] "
+            "[-s sizes] [-n depths] [-t seconds] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -d: spidev device, defaults to the first one on a "
+            "Greybus\n        SPI master.\n");
+    fprintf(stdout, "    -m: SPI mode 0-3 (default 0).\n");
+    fprintf(stdout, "    -f: comma separated clock rates in Hz "
+            "(default %s).\n", DEFAULT_SPEEDS);
+    fprintf(stdout, "    -s: comma separated transfer sizes in bytes "
+            "(default %s).\n", DEFAULT_SIZES);
+    fprintf(stdout, "    -n: comma separated transfers per message, up to "
+            "%d\n        (default %s).\n", MAX_DEPTH, DEFAULT_DEPTHS);
+    fprintf(stdout, "    -t: run time of each point in seconds "
+            "(default %d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Points with more than the spidev bufsiz bytes per "
+            "message (size x depth)\nare skipped.\n");
+    fprintf(stdout, "Example: %s -d 1.0 -f 8000000 -s 256,1024 -n 1,4\n",
+            APP_NAME);
+}
+
+/**
+ * @brief Run back to back SPI messages of one sweep point.
+ *
+ * Every message carries depth full duplex transfers of size bytes. The
+ * transfers share one chip select assertion, so the message costs one
+ * syscall and one greybus operation however deep it is.
+ *
+ * @param file The spidev file descriptor.
+ * @param speed Clock rate in Hz.
+ * @param size Bytes per transfer.
+ * @param depth Transfers per message.
+ * @param duration Run time in seconds.
+ * @param tx Transmit buffer of depth * size bytes.
+ * @param rx Receive buffer of depth * size bytes.
+ * @param result The measured result.
+ * @return 0 on success, negative errno if no message succeeded.
+ */
+static int run_point(int file, int speed, int size, int depth, int duration,
+                     uint8_t *tx, uint8_t *rx, struct readperf_result *result)
+{
+    struct spi_ioc_transfer xfers[MAX_DEPTH];
+    uint64_t start, end, t0, t1;
+    int i = 0, ret = 0;
+
+    memset(xfers, 0, sizeof(xfers));
+    for (i = 0; i < depth; i++) {
+        xfers[i].tx_buf = (unsigned long)(tx + i * size);
+        xfers[i].rx_buf = (unsigned long)(rx + i * size);
+        xfers[i].len = size;
+        xfers[i].speed_hz = speed;
+        xfers[i].bits_per_word = 8;
+    }
+
+    result->msgs = 0;
+    result->errors = 0;
+    stats_hist_init(&result->hist);
+
+    start = stats_now_ns();
+    end = start + (uint64_t)duration * 1000000000ULL;
+
+    do {
+        t0 = stats_now_ns();
+        ret = spi_transfer_message(file, xfers, depth);
+        t1 = stats_now_ns();
+        if (ret) {
+            result->errors++;
+            continue;
+        }
+
+        result->msgs++;
+        stats_hist_record(&result->hist, t1 - t0);
+    } while (t1 < end);
+
+    result->elapsed_ns = t1 - start;
+
+    return result->msgs ? 0 : ret;
+}
+
+/**
+ * @brief Print the result of one sweep point.
+ *
+ * Link use compares the payload bit rate with the clock rate, it drops
+ * where greybus framing and per-message overhead dominate.
+ *
+ * @param case_id Testrail test case ID of the [P] lines.
+ * @param speed Clock rate in Hz.
+ * @param size Bytes per transfer.
+ * @param depth Transfers per message.
+ * @param result The measured result.
+ */
+static void print_result(int case_id, int speed, int size, int depth,
+                         struct readperf_result *result)
+{
+    double secs = result->elapsed_ns / 1e9;
+    double bytes_s = secs > 0 ? result->msgs * depth * (double)size / secs :
+                     0.0;
+    double use = bytes_s * 8 * 100.0 / speed;
+    char metric[48];
+
+    printf("\n%s: speed=%d size=%d depth=%d msgs=%llu errors=%llu "
+           "bytes_per_s=%.1f link_use=%.1f%% p50_us=%.1f p99_us=%.1f\n",
+           APP_NAME, speed, size, depth, (unsigned long long)result->msgs,
+           (unsigned long long)result->errors, bytes_s, use,
+           stats_hist_percentile(&result->hist, 50.0) / 1000.0,
+           stats_hist_percentile(&result->hist, 99.0) / 1000.0);
+
+    snprintf(metric, sizeof(metric), "hz%d_size%d_x%d_bytes_per_s", speed,
+             size, depth);
+    print_test_case_perf(case_id, metric, bytes_s, "B/s");
+    snprintf(metric, sizeof(metric), "hz%d_size%d_x%d_link_use", speed, size,
+             depth);
+    print_test_case_perf(case_id, metric, use, "%");
+    snprintf(metric, sizeof(metric), "hz%d_size%d_x%d_msg_latency", speed,
+             size, depth);
+    stats_hist_report(case_id, metric, &result->hist);
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    struct readperf_info info;
+    static struct readperf_result result;
+    uint8_t *tx = NULL, *rx = NULL;
+    int options = 0, file = -1, ret = 0;
+    int i = 0, j = 0, k = 0, maxsize = 0, maxdepth = 0;
+    int size = 0, depth = 0, bufsiz = 0, skipped = 0, point_ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.bus = -EINVAL;
+    info.duration = DEFAULT_DURATION;
+    sweep_parse(&info.speeds, DEFAULT_SPEEDS, 1, INT32_MAX);
+    sweep_parse(&info.sizes, DEFAULT_SIZES, 1, MAX_XFER_SIZE);
+    sweep_parse(&info.depths, DEFAULT_DEPTHS, 1, MAX_DEPTH);
+
+    while ((options = getopt(argc, argv, "c:d:f:m:n:s:t:")) != -1) {
+        switch (options) {
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                if (sscanf(optarg, "%d.%d", &info.bus, &info.cs) != 2) {
+                    usage();
+                    return -EINVAL;
+                }
+                break;
+            case 'f':
+                ret = sweep_parse(&info.speeds, optarg, 1, INT32_MAX);
+                break;
+            case 'm':
+                info.mode = atoi(optarg);
+                break;
+            case 'n':
+                ret = sweep_parse(&info.depths, optarg, 1, MAX_DEPTH);
+                break;
+            case 's':
+                ret = sweep_parse(&info.sizes, optarg, 1, MAX_XFER_SIZE);
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (info.bus == -EINVAL) {
+        gb_find_spi_dev(0, &info.bus, &info.cs);
+    }
+
+    if (info.bus == -EINVAL || info.mode < 0 || info.mode > 3 ||
+        info.duration < 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    for (i = 0; i < info.sizes.count; i++) {
+        if (info.sizes.value[i] > maxsize) {
+            maxsize = info.sizes.value[i];
+        }
+    }
+    for (i = 0; i < info.depths.count; i++) {
+        if (info.depths.value[i] > maxdepth) {
+            maxdepth = info.depths.value[i];
+        }
+    }
+
+    tx = malloc((size_t)maxsize * maxdepth);
+    rx = malloc((size_t)maxsize * maxdepth);
+    if (!tx || !rx) {
+        ret = -ENOMEM;
+        goto out;
+    }
+    for (i = 0; i < maxsize * maxdepth; i++) {
+        tx[i] = (uint8_t)i;
+    }
+
+    file = open_spi_dev(info.bus, info.cs);
+    if (file < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    ret = spi_setup(file, info.mode, 8, info.speeds.value[0]);
+    if (ret) {
+        goto out;
+    }
+
+    /* spidev fails messages over bufsiz, unknown means no limit */
+    bufsiz = spi_get_bufsiz();
+
+    /* a failed point is reported and the sweep goes on */
+    for (i = 0; i < info.speeds.count; i++) {
+        for (j = 0; j < info.sizes.count; j++) {
+            for (k = 0; k < info.depths.count; k++) {
+                size = info.sizes.value[j];
+                depth = info.depths.value[k];
+                if (bufsiz > 0 && (long)size * depth > bufsiz) {
+                    printf("\n%s: speed=%d size=%d depth=%d skipped, "
+                           "message over spidev bufsiz %d\n", APP_NAME,
+                           info.speeds.value[i], size, depth, bufsiz);
+                    skipped++;
+                    continue;
+                }
+
+                point_ret = run_point(file, info.speeds.value[i], size,
+                                      depth, info.duration, tx, rx,
+                                      &result);
+                if (point_ret) {
+                    printf("\n%s: speed=%d size=%d depth=%d failed: %s\n",
+                           APP_NAME, info.speeds.value[i], size, depth,
+                           strerror(-point_ret));
+                    ret = ret ? ret : point_ret;
+                    continue;
+                }
+                print_result(info.case_id, info.speeds.value[i], size,
+                             depth, &result);
+            }
+        }
+    }
+
+    if (skipped == info.speeds.count * info.sizes.count * info.depths.count) {
+        ret = -EMSGSIZE;
+    }
+
+out:
+    if (file >= 0) {
+        close(file);
+    }
+    free(tx);
+    free(rx);
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
 }
@@ -1,16 +1,407 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "spk_play"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+
 #include "libfwtest.h"
 
+/* Default period size sweep, in frames */
+#define DEFAULT_PERIOD_SIZES "64,128,256,512,1024"
+/* Default period count sweep */
+#define DEFAULT_PERIOD_COUNTS "2,3,4"
+/* Default play time of each sweep point, in seconds */
+#define DEFAULT_DURATION 120
+#define DEFAULT_RATE 48000
+#define DEFAULT_CHANNELS 2
+#define DEFAULT_TONE_HZ 1000
+#define MAX_PERIOD_FRAMES 16384
+#define MAX_CHANNELS 8
+/* Tone amplitude, -6 dBFS */
+#define TONE_AMPLITUDE 16384.0
+#define PI 3.14159265358979323846
+
+struct spk_info {
+    int case_id;
+    int card;
+    int device;
+    int rate;
+    int channels;
+    int tone_hz;
+    int duration;
+    int sweep_all;
+    struct sweep sizes;
+    struct sweep counts;
+};
+
+/* one buffer configuration */
+struct spk_point {
+    int period_frames;
+    int periods;
+};
+
+struct spk_run {
+    int period_frames;
+    int periods;
+    uint64_t frames;
+    uint64_t xruns;
+    struct stats_hist delay;
+};
+
+/* one second of the tone waveform, sampled at the rate */
+static int16_t *tone;
+static int tone_phase;
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-D card,device] [-r rate] [-C channels] "
+            "[-f tone_hz]\n        [-p period_sizes] [-n period_counts] "
+            "[-t seconds] [-A] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -D: ALSA playback PCM, defaults to device 0 of "
+            "the first\n        Greybus sound card.\n");
+    fprintf(stdout, "    -r: sample rate in Hz (default %d).\n",
+            DEFAULT_RATE);
+    fprintf(stdout, "    -C: channels (default %d), S16_LE interleaved.\n",
+            DEFAULT_CHANNELS);
+    fprintf(stdout, "    -f: tone frequency in Hz (default %d).\n",
+            DEFAULT_TONE_HZ);
+    fprintf(stdout, "    -p: comma separated period sizes in frames "
+            "(default %s).\n", DEFAULT_PERIOD_SIZES);
+    fprintf(stdout, "    -n: comma separated period counts (default %s).\n",
+            DEFAULT_PERIOD_COUNTS);
+    fprintf(stdout, "    -t: play time of each configuration in seconds "
+            "(default %d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -A: play every configuration for the whole time. "
+            "By default\n        configurations play from the smallest "
+            "buffer up, each one\n        ends at its first XRUN and the "
+            "sweep ends at the first\n        one without.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Example: %s -D 1,0 -p 96,192,384 -n 2,4 -t 300\n",
+            APP_NAME);
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Build the one second tone table.
+ *
+ * The sine comes from the oscillator recurrence
+ * s[k] = 2 cos(w) s[k - 1] - s[k - 2], seeded by short series for sin(w)
+ * and cos(w), so the apps do not need libm. An integer frequency has a
+ * whole number of cycles in one second, so the table loops seamlessly.
+ *
+ * @param rate Sample rate in Hz.
+ * @return 0 on success, -ENOMEM on failure.
+ */
+static int tone_init(int rate)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    double w = 2.0 * PI / rate;
+    double c = 1.0 - w * w / 2.0 + w * w * w * w / 24.0;
+    double s0 = 0.0, s1 = w - w * w * w / 6.0, s2 = 0.0;
+    int k = 0;
+
+    tone = malloc(rate * sizeof(tone[0]));
+    if (tone == NULL) {
+        return -ENOMEM;
+    }
+
+    for (k = 0; k < rate; k++) {
+        tone[k] = (int16_t)(s0 * TONE_AMPLITUDE);
+        s2 = 2.0 * c * s1 - s0;
+        s0 = s1;
+        s1 = s2;
+    }
+    tone_phase = 0;
+
     return 0;
 }
+
+/**
+ * @brief Generate the next period of the tone into the write buffer.
+ *
+ * @param info The speaker info.
+ * @param buf The period buffer.
+ * @param frames Frames in the period.
+ */
+static void tone_fill(const struct spk_info *info, int16_t *buf, int frames)
+{
+    int i = 0, ch = 0;
+
+    for (i = 0; i < frames; i++) {
+        for (ch = 0; ch < info->channels; ch++) {
+            *buf++ = tone[tone_phase];
+        }
+        tone_phase += info->tone_hz;
+        if (tone_phase >= info->rate) {
+            tone_phase -= info->rate;
+        }
+    }
+}
+
+/**
+ * @brief Play one buffer configuration.
+ *
+ * Playback starts once the buffer is full. After every period written,
+ * the PCM delay is sampled, which is the output latency a new sample
+ * sees. An underrun is counted, the PCM is prepared again and refilled.
+ *
+ * @param info The speaker info.
+ * @param point The configuration.
+ * @param run Returns the measurements.
+ * @param buf The period buffer.
+ * @return 0 on success, -errno on failure, underruns are not failures.
+ */
+static int play_point(const struct spk_info *info,
+                      const struct spk_point *point, struct spk_run *run,
+                      int16_t *buf)
+{
+    uint64_t end = 0;
+    long delay = 0;
+    int fd = -1, ret = 0;
+
+    run->period_frames = point->period_frames;
+    run->periods = point->periods;
+
+    fd = open_pcm_dev(info->card, info->device);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    ret = pcm_set_params(fd, info->rate, info->channels, &run->period_frames,
+                         &run->periods);
+    if (!ret && run->period_frames > MAX_PERIOD_FRAMES) {
+        ret = -EINVAL;
+    }
+
+    end = stats_now_ns() + (uint64_t)info->duration * 1000000000ULL;
+    while (!ret && stats_now_ns() < end) {
+        tone_fill(info, buf, run->period_frames);
+        ret = pcm_write_frames(fd, buf, run->period_frames);
+        if (ret == -EPIPE) {
+            run->xruns++;
+            if (!info->sweep_all) {
+                ret = 0;
+                break;
+            }
+            ret = pcm_prepare(fd);
+            continue;
+        }
+        if (ret) {
+            break;
+        }
+        run->frames += run->period_frames;
+
+        if (!pcm_delay(fd, &delay) && delay > 0) {
+            stats_hist_record(&run->delay,
+                              (uint64_t)delay * 1000000000ULL / info->rate);
+        }
+    }
+
+    close(fd);
+
+    return ret;
+}
+
+/**
+ * @brief Print the result of one configuration.
+ *
+ * @param info The speaker info.
+ * @param run The measurements.
+ */
+static void print_result(const struct spk_info *info,
+                         const struct spk_run *run)
+{
+    double buffer_ms = run->period_frames * run->periods * 1000.0 /
+                       info->rate;
+    char metric[48];
+
+    printf("\n%s: period=%d periods=%d buffer_ms=%.2f frames=%llu "
+           "xruns=%llu p50_delay_us=%.1f max_delay_us=%.1f\n", APP_NAME,
+           run->period_frames, run->periods, buffer_ms,
+           (unsigned long long)run->frames, (unsigned long long)run->xruns,
+           stats_hist_percentile(&run->delay, 50.0) / 1000.0,
+           run->delay.count ? run->delay.max / 1000.0 : 0.0);
+
+    snprintf(metric, sizeof(metric), "p%dx%d_xruns", run->period_frames,
+             run->periods);
+    print_test_case_perf(info->case_id, metric, run->xruns, "xruns");
+    snprintf(metric, sizeof(metric), "p%dx%d_buffer", run->period_frames,
+             run->periods);
+    print_test_case_perf(info->case_id, metric, buffer_ms, "ms");
+    if (run->delay.count) {
+        snprintf(metric, sizeof(metric), "p%dx%d_delay", run->period_frames,
+                 run->periods);
+        stats_hist_report(info->case_id, metric, &run->delay);
+    }
+}
+
+/**
+ * @brief Order the sweep from the smallest buffer up.
+ *
+ * Equal buffers try fewer, larger periods first, they wake the CPU less.
+ *
+ * @param a The first configuration.
+ * @param b The second configuration.
+ * @return <0, 0 or >0 as for qsort().
+ */
+static int point_cmp(const void *a, const void *b)
+{
+    const struct spk_point *pa = a, *pb = b;
+    int fa = pa->period_frames * pa->periods;
+    int fb = pb->period_frames * pb->periods;
+
+    return fa != fb ? fa - fb : pa->periods - pb->periods;
+}
+
+int main(int argc, char **argv)
+{
+    struct spk_info info;
+    static struct spk_point points[SWEEP_MAX * SWEEP_MAX];
+    static int16_t buf[MAX_PERIOD_FRAMES * MAX_CHANNELS];
+    static struct spk_run run;
+    struct spk_run best;
+    int options = 0, npoints = 0, i = 0, j = 0, found = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    memset(&best, 0, sizeof(best));
+    info.card = -1;
+    info.rate = DEFAULT_RATE;
+    info.channels = DEFAULT_CHANNELS;
+    info.tone_hz = DEFAULT_TONE_HZ;
+    info.duration = DEFAULT_DURATION;
+    sweep_parse(&info.sizes, DEFAULT_PERIOD_SIZES, 1, MAX_PERIOD_FRAMES);
+    sweep_parse(&info.counts, DEFAULT_PERIOD_COUNTS, 1, 64);
+
+    while ((options = getopt(argc, argv, "AC:D:c:f:n:p:r:t:")) != -1) {
+        switch (options) {
+            case 'A':
+                info.sweep_all = 1;
+                break;
+            case 'C':
+                info.channels = atoi(optarg);
+                break;
+            case 'D':
+                if (sscanf(optarg, "%d,%d", &info.card, &info.device) != 2) {
+                    ret = -EINVAL;
+                }
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'f':
+                info.tone_hz = atoi(optarg);
+                break;
+            case 'n':
+                ret = sweep_parse(&info.counts, optarg, 1, 64);
+                break;
+            case 'p':
+                ret = sweep_parse(&info.sizes, optarg, 1, MAX_PERIOD_FRAMES);
+                break;
+            case 'r':
+                info.rate = atoi(optarg);
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (info.card < 0) {
+        gb_find_sound_card(0, &info.card);
+    }
+
+    if (info.card < 0 || info.rate < 8000 || info.channels < 1 ||
+        info.channels > MAX_CHANNELS || info.tone_hz < 1 ||
+        info.tone_hz >= info.rate / 2 || info.duration < 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    for (i = 0; i < info.sizes.count; i++) {
+        for (j = 0; j < info.counts.count; j++) {
+            points[npoints].period_frames = info.sizes.value[i];
+            points[npoints].periods = info.counts.value[j];
+            npoints++;
+        }
+    }
+    qsort(points, npoints, sizeof(points[0]), point_cmp);
+
+    ret = tone_init(info.rate);
+
+    for (i = 0; i < npoints && !ret; i++) {
+        memset(&run, 0, sizeof(run));
+        stats_hist_init(&run.delay);
+
+        ret = play_point(&info, &points[i], &run, buf);
+        print_result(&info, &run);
+        if (!ret && !run.xruns && (!found ||
+            run.period_frames * run.periods <
+            best.period_frames * best.periods)) {
+            best = run;
+            found = 1;
+        }
+        if (found && !info.sweep_all) {
+            break;
+        }
+    }
+
+    if (!ret && found) {
+        printf("\n%s: smallest buffer without XRUN in %d s: period=%d "
+               "periods=%d\n", APP_NAME, info.duration, best.period_frames,
+               best.periods);
+        print_test_case_perf(info.case_id, "min_buffer_frames",
+                             best.period_frames * best.periods, "frames");
+        print_test_case_perf(info.case_id, "min_buffer",
+                             best.period_frames * best.periods * 1000.0 /
+                             info.rate, "ms");
+    } else if (!ret) {
+        ret = -EPIPE;
+    }
+
+    free(tone);
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
+}
@@ -1,16 +1,461 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "uart_burst"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+/* Default baud rate sweep */
+#define DEFAULT_BAUDS "115200,921600"
+/* Default burst size sweep, in bytes */
+#define DEFAULT_BURSTS "32,256,4096"
+/* Default run time of each sweep point, in seconds */
+#define DEFAULT_DURATION 5
+/* Max burst size, in bytes */
+#define MAX_BURST 65536
+/* Receiver gives up this long after the sender finished, in ms */
+#define DRAIN_MS 500
+/* Bursts whose send time is kept for the latency lookup */
+#define SEND_RING 1024
+
+struct burst_info {
+    int case_id;
+    char tty[PATH_MAX];
+    int duration;
+    int gap_ms;
+    int flow;
+    int allow_loss;
+    struct sweep bauds;
+    struct sweep bursts;
+};
+
+struct send_slot {
+    uint64_t burst;
+    uint64_t ns;
+};
+
+/* one sweep point, shared by the sender and the receiver thread */
+struct burst_run {
+    int fd;
+    int frames_per_burst;
+    int done;
+    uint64_t done_ns;
+    struct send_slot sent[SEND_RING];
+    /* sender side */
+    uint64_t tx_frames;
+    uint64_t tx_ns;
+    /* receiver side */
+    uint8_t frame[UART_FRAME_SIZE];
+    int pos;
+    uint64_t frame_ns;
+    uint64_t expected;
+    uint64_t rx_frames;
+    uint64_t dropped;
+    uint64_t reordered;
+    uint64_t corrupt;
+    uint64_t garbage;
+    uint64_t first_rx_ns;
+    uint64_t last_rx_ns;
+    int rx_ret;
+    struct stats_hist hist;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d tty] [-b bauds] [-s bursts] [-g gap_ms] "
+            "[-t seconds] [-r] [-a] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -d: tty with TX looped back to RX, defaults to the "
+            "first\n        Greybus UART.\n");
+    fprintf(stdout, "    -b: comma separated baud rates (default %s).\n",
+            DEFAULT_BAUDS);
+    fprintf(stdout, "    -s: comma separated burst sizes in bytes, rounded "
+            "up to\n        %d byte frames (default %s).\n", UART_FRAME_SIZE,
+            DEFAULT_BURSTS);
+    fprintf(stdout, "    -g: idle time between bursts in ms (default 0, "
+            "stream).\n        The first byte latency includes queueing "
+            "when streaming.\n");
+    fprintf(stdout, "    -t: run time of each point in seconds "
+            "(default %d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -r: enable RTS/CTS hardware flow control.\n");
+    fprintf(stdout, "    -a: report lost bytes without failing the test.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Example: %s -d /dev/ttyGB0 -b 3000000 -s 4096 -r\n",
+            APP_NAME);
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Account one complete received frame.
+ *
+ * @param run The sweep point.
+ */
+static void frame_receive(struct burst_run *run)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    const uint8_t *frame = run->frame;
+    struct send_slot *slot;
+    uint64_t burst;
+    uint32_t seq;
+
+    if (uart_frame_check(frame, &seq)) {
+        run->corrupt++;
+        return;
+    }
+
+    if (seq < run->expected) {
+        run->reordered++;
+    } else {
+        run->dropped += seq - run->expected;
+        run->expected = seq + 1;
+    }
+
+    if (!run->rx_frames) {
+        run->first_rx_ns = run->frame_ns;
+    }
+    run->rx_frames++;
+
+    if (frame[1] & UART_FRAME_FIRST) {
+        burst = seq / run->frames_per_burst;
+        slot = &run->sent[burst % SEND_RING];
+        if (__atomic_load_n(&slot->burst, __ATOMIC_ACQUIRE) == burst) {
+            stats_hist_record(&run->hist, run->frame_ns - slot->ns);
+        }
+    }
+}
+
+/**
+ * @brief Receiver thread, parse frames until the sender is done and the
+ * line has been idle for DRAIN_MS.
+ */
+static void *rx_thread(void *arg)
+{
+    struct burst_run *run = arg;
+    struct pollfd pfd;
+    uint8_t buf[4096];
+    uint64_t now;
+    ssize_t n, i;
+
+    pfd.fd = run->fd;
+    pfd.events = POLLIN;
+
+    while (1) {
+        if (poll(&pfd, 1, 100) < 0) {
+            run->rx_ret = -errno;
+            break;
+        }
+
+        n = 0;
+        if (pfd.revents & POLLIN) {
+            n = read(run->fd, buf, sizeof(buf));
+            if (n < 0) {
+                run->rx_ret = -errno;
+                break;
+            }
+        }
+        now = stats_now_ns();
+
+        if (n == 0) {
+            if (__atomic_load_n(&run->done, __ATOMIC_ACQUIRE) &&
+                now - run->last_rx_ns > DRAIN_MS * 1000000ULL &&
+                now - run->done_ns > DRAIN_MS * 1000000ULL) {
+                break;
+            }
+            continue;
+        }
+
+        for (i = 0; i < n; i++) {
+            if (!run->pos && buf[i] != UART_FRAME_MAGIC) {
+                run->garbage++;
+                continue;
+            }
+            if (!run->pos) {
+                run->frame_ns = now;
+            }
+            run->frame[run->pos++] = buf[i];
+            if (run->pos == UART_FRAME_SIZE) {
+                run->pos = 0;
+                frame_receive(run);
+            }
+        }
+        run->last_rx_ns = now;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Write a whole buffer to the tty.
+ *
+ * @param fd The tty file descriptor.
+ * @param buf The data.
+ * @param len The data length.
+ * @return 0 on success, -errno on failure.
+ */
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len) {
+        n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        buf += n;
+        len -= n;
+    }
+
     return 0;
 }
+
+/**
+ * @brief Stream bursts for one sweep point while the receiver thread
+ * checks them.
+ *
+ * @param info The burst info.
+ * @param run The sweep point, fd and frames_per_burst set.
+ * @param buf Burst buffer of MAX_BURST bytes.
+ * @return 0 on success, error code on failure.
+ */
+static int run_point(const struct burst_info *info, struct burst_run *run,
+                     uint8_t *buf)
+{
+    uint64_t start, end, now, burst = 0;
+    uint32_t seq = 0;
+    pthread_t thread;
+    int i, ret = 0;
+
+    run->done = 0;
+    run->expected = 0;
+    stats_hist_init(&run->hist);
+    for (i = 0; i < SEND_RING; i++) {
+        run->sent[i].burst = UINT64_MAX;
+    }
+
+    ret = pthread_create(&thread, NULL, rx_thread, run);
+    if (ret) {
+        return -ret;
+    }
+
+    start = stats_now_ns();
+    end = start + (uint64_t)info->duration * 1000000000ULL;
+
+    for (now = start; now < end && !ret; now = stats_now_ns()) {
+        for (i = 0; i < run->frames_per_burst; i++) {
+            uart_frame_build(buf + i * UART_FRAME_SIZE, seq + i,
+                             i ? 0 : UART_FRAME_FIRST);
+        }
+
+        run->sent[burst % SEND_RING].ns = stats_now_ns();
+        __atomic_store_n(&run->sent[burst % SEND_RING].burst, burst,
+                         __ATOMIC_RELEASE);
+        ret = write_all(run->fd, buf,
+                        run->frames_per_burst * UART_FRAME_SIZE);
+
+        seq += run->frames_per_burst;
+        burst++;
+        if (info->gap_ms) {
+            usleep(info->gap_ms * 1000);
+        }
+    }
+
+    if (!ret && tcdrain(run->fd) < 0) {
+        ret = -errno;
+    }
+    run->tx_frames = seq;
+    run->tx_ns = stats_now_ns() - start;
+    run->done_ns = stats_now_ns();
+    __atomic_store_n(&run->done, 1, __ATOMIC_RELEASE);
+
+    pthread_join(thread, NULL);
+
+    /* frames after the last one received never arrived */
+    if (run->tx_frames > run->expected) {
+        run->dropped += run->tx_frames - run->expected;
+    }
+
+    return ret ? ret : run->rx_ret;
+}
+
+/**
+ * @brief Print the result of one sweep point.
+ *
+ * Line use compares the received payload rate with the 10 bits per byte
+ * an 8N1 line can carry at the baud rate.
+ *
+ * @param info The burst info.
+ * @param baud Baud rate.
+ * @param burst Burst size in bytes.
+ * @param run The finished sweep point.
+ */
+static void print_result(const struct burst_info *info, int baud, int burst,
+                         const struct burst_run *run)
+{
+    double secs = (run->last_rx_ns - run->first_rx_ns) / 1e9;
+    double bytes_s = secs > 0 ? run->rx_frames * UART_FRAME_SIZE / secs :
+                     0.0;
+    double use = bytes_s * 10 * 100.0 / baud;
+    char metric[48];
+
+    printf("\n%s: baud=%d burst=%d tx_frames=%llu rx_frames=%llu "
+           "dropped=%llu reordered=%llu corrupt=%llu garbage_bytes=%llu "
+           "bytes_per_s=%.1f line_use=%.1f%% p50_us=%.1f p99_us=%.1f\n",
+           APP_NAME, baud, burst, (unsigned long long)run->tx_frames,
+           (unsigned long long)run->rx_frames,
+           (unsigned long long)run->dropped,
+           (unsigned long long)run->reordered,
+           (unsigned long long)run->corrupt,
+           (unsigned long long)run->garbage, bytes_s, use,
+           stats_hist_percentile(&run->hist, 50.0) / 1000.0,
+           stats_hist_percentile(&run->hist, 99.0) / 1000.0);
+
+    snprintf(metric, sizeof(metric), "baud%d_burst%d_bytes_per_s", baud,
+             burst);
+    print_test_case_perf(info->case_id, metric, bytes_s, "B/s");
+    snprintf(metric, sizeof(metric), "baud%d_burst%d_lost_bytes", baud,
+             burst);
+    print_test_case_perf(info->case_id, metric,
+                         (run->dropped + run->corrupt) * UART_FRAME_SIZE,
+                         "B");
+    snprintf(metric, sizeof(metric), "baud%d_burst%d_reordered", baud,
+             burst);
+    print_test_case_perf(info->case_id, metric, run->reordered, "frames");
+    snprintf(metric, sizeof(metric), "baud%d_burst%d_first_byte", baud,
+             burst);
+    stats_hist_report(info->case_id, metric, &run->hist);
+}
+
+int main(int argc, char **argv)
+{
+    struct burst_info info;
+    static struct burst_run run;
+    static uint8_t buf[MAX_BURST];
+    int options = 0, fd = -1, i = 0, j = 0, burst = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.duration = DEFAULT_DURATION;
+    sweep_parse(&info.bauds, DEFAULT_BAUDS, 1, INT32_MAX);
+    sweep_parse(&info.bursts, DEFAULT_BURSTS, 1, MAX_BURST);
+
+    while ((options = getopt(argc, argv, "ab:c:d:g:rs:t:")) != -1) {
+        switch (options) {
+            case 'a':
+                info.allow_loss = 1;
+                break;
+            case 'b':
+                ret = sweep_parse(&info.bauds, optarg, 1, INT32_MAX);
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                snprintf(info.tty, sizeof(info.tty), "%s", optarg);
+                break;
+            case 'g':
+                info.gap_ms = atoi(optarg);
+                break;
+            case 'r':
+                info.flow = 1;
+                break;
+            case 's':
+                ret = sweep_parse(&info.bursts, optarg, 1, MAX_BURST);
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (!info.tty[0]) {
+        gb_find_uart_tty(0, info.tty, sizeof(info.tty));
+    }
+
+    if (!info.tty[0] || info.duration < 1 || info.gap_ms < 0) {
+        usage();
+        return -EINVAL;
+    }
+
+    fd = open_uart_tty(info.tty);
+    if (fd < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    for (i = 0; i < info.bauds.count && !ret; i++) {
+        for (j = 0; j < info.bursts.count && !ret; j++) {
+            ret = uart_set_raw(fd, info.bauds.value[i], info.flow);
+            if (ret) {
+                break;
+            }
+
+            memset(&run, 0, sizeof(run));
+            run.fd = fd;
+            run.frames_per_burst = (info.bursts.value[j] +
+                                    UART_FRAME_SIZE - 1) / UART_FRAME_SIZE;
+            burst = run.frames_per_burst * UART_FRAME_SIZE;
+
+            ret = run_point(&info, &run, buf);
+            print_result(&info, info.bauds.value[i], burst, &run);
+            if (!ret && !info.allow_loss &&
+                (run.dropped || run.corrupt || run.reordered)) {
+                ret = -EIO;
+            }
+        }
+    }
+
+out:
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
+}
@@ -1,16 +1,536 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "uart_flow"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/limits.h>
+#include <linux/serial.h>
+
 #include "libfwtest.h"
 
+/* Default baud rate sweep */
+#define DEFAULT_BAUDS "115200,921600,3000000"
+/* Default run time of each baud rate, in seconds */
+#define DEFAULT_DURATION 10
+/* Default time the receiver stops reading, in ms */
+#define DEFAULT_PAUSE_MS 200
+/* Default time the receiver reads between pauses, in ms */
+#define DEFAULT_READ_MS 100
+/* Frames written per write() */
+#define CHUNK_FRAMES 128
+/* Queue sampling interval during a pause, in ms */
+#define SAMPLE_MS 1
+/* A pause throttled the sender if it made no progress this long, in ms */
+#define STALL_MS 20
+/* Sender gives up when it made no progress this long while read, in ms */
+#define STUCK_MS 2000
+/* Receiver gives up this long after the sender finished, in ms */
+#define DRAIN_MS 500
+
+struct flow_info {
+    int case_id;
+    char tty[PATH_MAX];
+    int duration;
+    int pause_ms;
+    int read_ms;
+    int allow_loss;
+    struct sweep bauds;
+};
+
+/* one baud rate, shared by the sender and the receiver thread */
+struct flow_run {
+    const struct flow_info *info;
+    int fd;
+    int done;
+    /* sender side, read by the receiver */
+    uint64_t tx_bytes;
+    uint64_t tx_progress_ns;
+    /* receiver side */
+    uint8_t frame[UART_FRAME_SIZE];
+    int pos;
+    uint64_t expected;
+    uint64_t rx_bytes;
+    uint64_t rx_frames;
+    uint64_t dropped;
+    uint64_t corrupt;
+    uint64_t garbage;
+    uint64_t first_rx_ns;
+    uint64_t last_rx_ns;
+    int pauses;
+    int throttled;
+    int rx_hwm;
+    int tx_hwm;
+    uint64_t inflight_hwm;
+    int rx_ret;
+    /* from the start of a pause until the sender made no more progress */
+    struct stats_hist stop;
+    /* from the end of a throttled pause until the sender made progress */
+    struct stats_hist resume;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d tty] [-b bauds] [-p pause_ms] "
+            "[-i read_ms] [-t seconds]\n        [-a] [-c case_id]\n",
+            APP_NAME);
+    fprintf(stdout, "    -d: tty with TX looped back to RX and RTS to CTS, "
+            "defaults to\n        the first Greybus UART.\n");
+    fprintf(stdout, "    -b: comma separated baud rates (default %s).\n",
+            DEFAULT_BAUDS);
+    fprintf(stdout, "    -p: time the receiver stops reading in ms "
+            "(default %d).\n", DEFAULT_PAUSE_MS);
+    fprintf(stdout, "    -i: time the receiver reads between pauses in ms "
+            "(default %d).\n", DEFAULT_READ_MS);
+    fprintf(stdout, "    -t: run time of each baud rate in seconds "
+            "(default %d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -a: report lost bytes without failing the test.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "The sender streams at full rate with RTS/CTS flow "
+            "control while the\nreceiver pauses. A pause should stop the "
+            "sender without losing data;\none too short to fill the "
+            "receive buffers is not counted as throttled.\n");
+    fprintf(stdout, "Example: %s -d /dev/ttyGB0 -b 3000000 -p 500\n",
+            APP_NAME);
+}
+
+/**
+ * @brief Account one complete received frame.
+ *
+ * @param run The run.
+ */
+static void frame_receive(struct flow_run *run)
+{
+    const uint8_t *frame = run->frame;
+    uint32_t seq;
+
+    if (uart_frame_check(frame, &seq)) {
+        run->corrupt++;
+        return;
+    }
+
+    /* flow control keeps order, an old frame is a lost resync */
+    if (seq >= run->expected) {
+        run->dropped += seq - run->expected;
+        run->expected = seq + 1;
+    }
+    run->rx_frames++;
+}
+
+/**
+ * @brief Sample the queues during a pause.
+ *
+ * @param run The run.
+ */
+static void sample_queues(struct flow_run *run)
+{
+    uint64_t inflight;
+    int queued = 0;
+
+    if (!ioctl(run->fd, FIONREAD, &queued) && queued > run->rx_hwm) {
+        run->rx_hwm = queued;
+    }
+    if (!ioctl(run->fd, TIOCOUTQ, &queued) && queued > run->tx_hwm) {
+        run->tx_hwm = queued;
+    }
+
+    inflight = __atomic_load_n(&run->tx_bytes, __ATOMIC_ACQUIRE) -
+               run->rx_bytes;
+    if (inflight > run->inflight_hwm) {
+        run->inflight_hwm = inflight;
+    }
+}
+
+/**
+ * @brief Stop reading for the pause time, then record whether and when
+ * the sender stopped.
+ *
+ * @param info The app info.
+ * @param run The run.
+ * @return 1 when the pause throttled the sender, else 0.
+ */
+static int pause_rx(const struct flow_info *info, struct flow_run *run)
+{
+    uint64_t start = stats_now_ns(), now = start, last = 0;
+    uint64_t end = start + info->pause_ms * 1000000ULL;
+
+    for (; now < end; now = stats_now_ns()) {
+        sample_queues(run);
+        usleep(SAMPLE_MS * 1000);
+    }
+
+    run->pauses++;
+    last = __atomic_load_n(&run->tx_progress_ns, __ATOMIC_ACQUIRE);
+    if (now - last < STALL_MS * 1000000ULL) {
+        return 0;
+    }
+
+    run->throttled++;
+    stats_hist_record(&run->stop, last > start ? last - start : 0);
+    return 1;
+}
+
+/**
+ * @brief Receiver thread, alternate reading and pausing until the sender
+ * is done, then read until the line has been idle for DRAIN_MS.
+ */
+static void *rx_thread(void *arg)
+{
+    struct flow_run *run = arg;
+    const struct flow_info *info = run->info;
+    struct pollfd pfd;
+    uint8_t buf[4096];
+    uint64_t now, phase_end, resume_ns = 0, resume_tx = 0;
+    ssize_t n, i;
+    int done;
+
+    pfd.fd = run->fd;
+    pfd.events = POLLIN;
+    phase_end = stats_now_ns() + info->read_ms * 1000000ULL;
+
+    while (1) {
+        if (poll(&pfd, 1, 10) < 0) {
+            run->rx_ret = -errno;
+            break;
+        }
+
+        n = 0;
+        if (pfd.revents & POLLIN) {
+            n = read(run->fd, buf, sizeof(buf));
+            if (n < 0 && errno != EAGAIN) {
+                run->rx_ret = -errno;
+                break;
+            }
+        }
+        now = stats_now_ns();
+        done = __atomic_load_n(&run->done, __ATOMIC_ACQUIRE);
+
+        if (resume_ns &&
+            __atomic_load_n(&run->tx_bytes, __ATOMIC_ACQUIRE) > resume_tx) {
+            stats_hist_record(&run->resume, now - resume_ns);
+            resume_ns = 0;
+        }
+
+        for (i = 0; i < n; i++) {
+            if (!run->pos && buf[i] != UART_FRAME_MAGIC) {
+                run->garbage++;
+                continue;
+            }
+            run->frame[run->pos++] = buf[i];
+            if (run->pos == UART_FRAME_SIZE) {
+                run->pos = 0;
+                frame_receive(run);
+            }
+        }
+        if (n > 0) {
+            if (!run->first_rx_ns) {
+                run->first_rx_ns = now;
+            }
+            run->last_rx_ns = now;
+            run->rx_bytes += n;
+        }
+
+        if (done) {
+            if (n <= 0 && now - run->last_rx_ns > DRAIN_MS * 1000000ULL) {
+                break;
+            }
+        } else if (now >= phase_end) {
+            if (pause_rx(info, run)) {
+                resume_ns = stats_now_ns();
+                resume_tx = __atomic_load_n(&run->tx_bytes,
+                                            __ATOMIC_ACQUIRE);
+            }
+            phase_end = stats_now_ns() + info->read_ms * 1000000ULL;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Stream frames at full rate for one baud rate while the receiver
+ * thread throttles and checks them.
+ *
+ * @param info The app info.
+ * @param run The run, info and fd set.
+ * @return 0 on success, -ETIMEDOUT when the sender was stopped for good,
+ * error code on other failures.
+ */
+static int run_baud(const struct flow_info *info, struct flow_run *run)
+{
+    static uint8_t buf[CHUNK_FRAMES * UART_FRAME_SIZE];
+    struct pollfd pfd = { run->fd, POLLOUT, 0 };
+    uint64_t start, end, now, tx = 0;
+    uint32_t seq = 0;
+    size_t pos = sizeof(buf);
+    pthread_t thread;
+    ssize_t n;
+    int i, queued = 0, ret = 0;
+
+    stats_hist_init(&run->stop);
+    stats_hist_init(&run->resume);
+
+    start = stats_now_ns();
+    run->tx_progress_ns = start;
+    ret = pthread_create(&thread, NULL, rx_thread, run);
+    if (ret) {
+        return -ret;
+    }
+
+    end = start + (uint64_t)info->duration * 1000000000ULL;
+
+    for (now = start; now < end && !ret; now = stats_now_ns()) {
+        if (pos == sizeof(buf)) {
+            for (i = 0; i < CHUNK_FRAMES; i++) {
+                uart_frame_build(buf + i * UART_FRAME_SIZE, seq++, 0);
+            }
+            pos = 0;
+        }
+
+        n = write(run->fd, buf + pos, sizeof(buf) - pos);
+        if (n > 0) {
+            pos += n;
+            tx += n;
+            __atomic_store_n(&run->tx_bytes, tx, __ATOMIC_RELEASE);
+            __atomic_store_n(&run->tx_progress_ns, stats_now_ns(),
+                             __ATOMIC_RELEASE);
+            continue;
+        } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            ret = -errno;
+            break;
+        }
+
+        if (poll(&pfd, 1, 100) < 0) {
+            ret = -errno;
+        } else if (now - __atomic_load_n(&run->tx_progress_ns,
+                                         __ATOMIC_ACQUIRE) >
+                   (info->pause_ms + STUCK_MS) * 1000000ULL) {
+            ret = -ETIMEDOUT;
+        }
+    }
+
+    /* tcdrain() would block for good if CTS never comes back */
+    while (!ret && !ioctl(run->fd, TIOCOUTQ, &queued) && queued > 0) {
+        if (stats_now_ns() - __atomic_load_n(&run->tx_progress_ns,
+                                             __ATOMIC_ACQUIRE) >
+            (info->pause_ms + STUCK_MS) * 1000000ULL) {
+            ret = -ETIMEDOUT;
+            break;
+        }
+        usleep(10000);
+    }
+    __atomic_store_n(&run->done, 1, __ATOMIC_RELEASE);
+
+    pthread_join(thread, NULL);
+
+    /* frames after the last one received never arrived */
+    if (tx / UART_FRAME_SIZE > run->expected) {
+        run->dropped += tx / UART_FRAME_SIZE - run->expected;
+    }
+
+    return ret ? ret : run->rx_ret;
+}
+
+/**
+ * @brief Read the driver overrun counters.
+ *
+ * @param fd The tty file descriptor.
+ * @return hardware and buffer overruns so far, 0 if not supported.
+ */
+static uint64_t get_overruns(int fd)
+{
+    struct serial_icounter_struct icount;
+
+    memset(&icount, 0, sizeof(icount));
+    if (ioctl(fd, TIOCGICOUNT, &icount) < 0) {
+        return 0;
+    }
+
+    return (uint64_t)icount.overrun + icount.buf_overrun;
+}
+
+/**
+ * @brief Print the result of one baud rate.
+ *
+ * Net throughput includes the pauses, line use compares it with the 10
+ * bits per byte an 8N1 line can carry at the baud rate.
+ *
+ * @param info The app info.
+ * @param baud Baud rate.
+ * @param run The finished run.
+ * @param overruns Driver overruns during the run.
+ */
+static void print_result(const struct flow_info *info, int baud,
+                         const struct flow_run *run, uint64_t overruns)
+{
+    double secs = (run->last_rx_ns - run->first_rx_ns) / 1e9;
+    double bytes_s = secs > 0 ? run->rx_frames * UART_FRAME_SIZE / secs :
+                     0.0;
+    double use = bytes_s * 10 * 100.0 / baud;
+    uint64_t lost = (run->dropped + run->corrupt) * UART_FRAME_SIZE;
+    char metric[48];
+
+    printf("\n%s: baud=%d tx_bytes=%llu rx_bytes=%llu lost_bytes=%llu "
+           "garbage_bytes=%llu overruns=%llu pauses=%d throttled=%d "
+           "rx_hwm=%d tx_hwm=%d inflight_hwm=%llu bytes_per_s=%.1f "
+           "line_use=%.1f%% resume_p50_us=%.1f resume_max_us=%.1f\n",
+           APP_NAME, baud, (unsigned long long)run->tx_bytes,
+           (unsigned long long)run->rx_bytes, (unsigned long long)lost,
+           (unsigned long long)run->garbage, (unsigned long long)overruns,
+           run->pauses, run->throttled, run->rx_hwm, run->tx_hwm,
+           (unsigned long long)run->inflight_hwm, bytes_s, use,
+           stats_hist_percentile(&run->resume, 50.0) / 1000.0,
+           run->resume.max / 1000.0);
+
+    snprintf(metric, sizeof(metric), "baud%d_bytes_per_s", baud);
+    print_test_case_perf(info->case_id, metric, bytes_s, "B/s");
+    snprintf(metric, sizeof(metric), "baud%d_line_use", baud);
+    print_test_case_perf(info->case_id, metric, use, "%");
+    snprintf(metric, sizeof(metric), "baud%d_lost_bytes", baud);
+    print_test_case_perf(info->case_id, metric, lost, "B");
+    snprintf(metric, sizeof(metric), "baud%d_overruns", baud);
+    print_test_case_perf(info->case_id, metric, overruns, "overruns");
+    snprintf(metric, sizeof(metric), "baud%d_throttled", baud);
+    print_test_case_perf(info->case_id, metric, run->throttled, "pauses");
+    snprintf(metric, sizeof(metric), "baud%d_rx_hwm", baud);
+    print_test_case_perf(info->case_id, metric, run->rx_hwm, "B");
+    snprintf(metric, sizeof(metric), "baud%d_tx_hwm", baud);
+    print_test_case_perf(info->case_id, metric, run->tx_hwm, "B");
+    snprintf(metric, sizeof(metric), "baud%d_inflight_hwm", baud);
+    print_test_case_perf(info->case_id, metric, run->inflight_hwm, "B");
+    snprintf(metric, sizeof(metric), "baud%d_stop", baud);
+    stats_hist_report(info->case_id, metric, &run->stop);
+    snprintf(metric, sizeof(metric), "baud%d_resume", baud);
+    stats_hist_report(info->case_id, metric, &run->resume);
 }
 
 int main(int argc, char **argv)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
-    return 0;
+    struct flow_info info;
+    static struct flow_run run;
+    uint64_t overruns = 0;
+    int options = 0, fd = -1, i = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.duration = DEFAULT_DURATION;
+    info.pause_ms = DEFAULT_PAUSE_MS;
+    info.read_ms = DEFAULT_READ_MS;
+    sweep_parse(&info.bauds, DEFAULT_BAUDS, 1, INT32_MAX);
+
+    while ((options = getopt(argc, argv, "ab:c:d:i:p:t:")) != -1) {
+        switch (options) {
+            case 'a':
+                info.allow_loss = 1;
+                break;
+            case 'b':
+                ret = sweep_parse(&info.bauds, optarg, 1, INT32_MAX);
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                snprintf(info.tty, sizeof(info.tty), "%s", optarg);
+                break;
+            case 'i':
+                info.read_ms = atoi(optarg);
+                break;
+            case 'p':
+                info.pause_ms = atoi(optarg);
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (!info.tty[0]) {
+        gb_find_uart_tty(0, info.tty, sizeof(info.tty));
+    }
+
+    if (!info.tty[0] || info.duration < 1 || info.pause_ms <= STALL_MS ||
+        info.read_ms < 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    fd = open_uart_tty(info.tty);
+    if (fd < 0 || fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    for (i = 0; i < info.bauds.count && !ret; i++) {
+        ret = uart_set_raw(fd, info.bauds.value[i], 1);
+        if (ret) {
+            break;
+        }
+
+        memset(&run, 0, sizeof(run));
+        run.info = &info;
+        run.fd = fd;
+        overruns = get_overruns(fd);
+
+        ret = run_baud(&info, &run);
+        overruns = get_overruns(fd) - overruns;
+        print_result(&info, info.bauds.value[i], &run, overruns);
+        if (!ret && !info.allow_loss &&
+            (run.dropped || run.corrupt || overruns)) {
+            ret = -EIO;
+        }
+    }
+
+out:
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
 }
@@ -1,16 +1,628 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
 #define APP_NAME "uart_linecfg"
 
-#include "stdio.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <linux/limits.h>
+
 #include "libfwtest.h"
 
+/* Default sweeps */
+#define DEFAULT_BAUDS "115200,921600"
+#define DEFAULT_BITS "7,8"
+#define DEFAULT_PARITIES "n,e,o"
+#define DEFAULT_STOPS "1,2"
+/* Default streaming time of each line setting, in seconds */
+#define DEFAULT_DURATION 2
+/* Max number of line settings of a run */
+#define MAX_POINTS 256
+/* Probe retry interval and recovery timeout after a switch, in ms */
+#define PROBE_MS 10
+#define RECOVER_MS 2000
+/* Bytes sent with the old settings right before a switch */
+#define TAIL_LEN 64
+#define PROBE_LEN 16
+/* Receiver gives up this long after the sender finished, in ms */
+#define DRAIN_MS 200
+/* Stream write size, in bytes */
+#define CHUNK 256
+
+struct linecfg_info {
+    int case_id;
+    char tty[PATH_MAX];
+    int duration;
+    int flow;
+    int allow_errors;
+    struct sweep bauds;
+    struct sweep bits;
+    struct sweep parities;
+    struct sweep stops;
+};
+
+/* one line setting and what it measured */
+struct line_point {
+    int baud;
+    int bits;
+    char parity;
+    int stop;
+    int ret;
+    /* tcsetattr() of the switch to this setting, in ns */
+    uint64_t setattr_ns;
+    /* from the switch until a probe came back intact, in ns */
+    uint64_t recover_ns;
+    /* bytes sent with the previous setting that did not come back */
+    int tail_lost;
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint64_t errors;
+    double bytes_s;
+    double line_use;
+};
+
 void usage()
 {
-    fprintf(stdout,"Usage: %s\n", APP_NAME);
+    fprintf(stdout, "\nUsage: %s [-d tty] [-b bauds] [-w bits] [-p parities] "
+            "[-s stops]\n        [-t seconds] [-r] [-a] [-c case_id]\n",
+            APP_NAME);
+    fprintf(stdout, "    -d: tty with TX looped back to RX, defaults to the "
+            "first\n        Greybus UART.\n");
+    fprintf(stdout, "    -b: comma separated baud rates (default %s).\n",
+            DEFAULT_BAUDS);
+    fprintf(stdout, "    -w: comma separated word sizes, 5 to 8 "
+            "(default %s).\n", DEFAULT_BITS);
+    fprintf(stdout, "    -p: comma separated parities, n, e, o, m or s "
+            "(default %s).\n", DEFAULT_PARITIES);
+    fprintf(stdout, "    -s: comma separated stop bits, 1 or 2 "
+            "(default %s).\n", DEFAULT_STOPS);
+    fprintf(stdout, "    -t: streaming time of each setting in seconds "
+            "(default %d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -r: enable RTS/CTS hardware flow control.\n");
+    fprintf(stdout, "    -a: report data errors without failing the "
+            "test.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Switches through every combination of the settings "
+            "with tcsetattr() and\nreports the switch latency, until data "
+            "flows again, and the throughput\nof each. The matrix at the "
+            "end shows the line use per setting and baud rate.\n");
+    fprintf(stdout, "Example: %s -d /dev/ttyGB0 -b 115200,3000000 -w 8 "
+            "-p n,e\n", APP_NAME);
 }
 
-int main(int argc, char **argv)
+/**
+ * @brief Parse a comma separated parity list.
+ *
+ * @param sweep The sweep to fill with parity characters.
+ * @param list The list from command line.
+ * @return 0 on success, -EINVAL on bad list.
+ */
+static int parse_parities(struct sweep *sweep, const char *list)
+{
+    char buf[128];
+    char *tok, *save = NULL;
+
+    snprintf(buf, sizeof(buf), "%s", list);
+    sweep->count = 0;
+
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        if (strlen(tok) != 1 || !strchr("neoms", tok[0]) ||
+            sweep->count >= SWEEP_MAX) {
+            return -EINVAL;
+        }
+        sweep->value[sweep->count++] = tok[0];
+    }
+
+    return sweep->count ? 0 : -EINVAL;
+}
+
+/**
+ * @brief Test pattern byte, fits the word size.
+ *
+ * @param seq Byte sequence number.
+ * @param bits Word size.
+ * @return the byte.
+ */
+static uint8_t pattern(uint64_t seq, int bits)
+{
+    return (uint8_t)(seq * 37 + (seq >> 8)) & ((1 << bits) - 1);
+}
+
+/**
+ * @brief Bits on the line per character of a setting.
+ *
+ * @param pt The line setting.
+ * @return start, data, parity and stop bits.
+ */
+static int char_bits(const struct line_point *pt)
 {
-    fprintf(stdout,"%s\n", APP_NAME);
-    dumpargs(argc, argv);
+    return 1 + pt->bits + (pt->parity != 'n') + pt->stop;
+}
+
+/**
+ * @brief Write a whole buffer to the non-blocking tty.
+ *
+ * @param fd The tty file descriptor.
+ * @param buf The data.
+ * @param len The data length.
+ * @return 0 on success, -errno on failure.
+ */
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+    struct pollfd pfd = { fd, POLLOUT, 0 };
+    ssize_t n;
+
+    while (len) {
+        n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EAGAIN) {
+                poll(&pfd, 1, 100);
+                continue;
+            } else if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        buf += n;
+        len -= n;
+    }
+
     return 0;
 }
+
+/**
+ * @brief Count the tail bytes that came back.
+ *
+ * @param rx Bytes received after the switch.
+ * @param len Length of rx.
+ * @param tail The tail sent before the switch.
+ * @return number of tail bytes received in order, from the first one
+ * found.
+ */
+static int tail_received(const uint8_t *rx, int len, const uint8_t *tail)
+{
+    int i = 0, j = 0, best = 0, n = 0;
+
+    for (i = 0; i < TAIL_LEN; i++) {
+        for (j = 0; j < len; j++) {
+            for (n = 0; i + n < TAIL_LEN && j + n < len &&
+                 rx[j + n] == tail[i + n]; n++) {
+            }
+            if (n > best) {
+                best = n;
+            }
+        }
+        if (best >= TAIL_LEN - i) {
+            break;
+        }
+    }
+
+    /* a few bytes match by chance, words can be as small as 5 bits */
+    return best >= 4 ? best : 0;
+}
+
+/**
+ * @brief Switch to a line setting and wait until data flows again.
+ *
+ * A tail is written with the previous setting right before the switch,
+ * the bytes of it that come back show whether switching flushes data in
+ * flight. Probes are then written every PROBE_MS, or every two probe
+ * times on the wire at low baud rates, until one comes back intact.
+ *
+ * @param info The app info.
+ * @param fd The tty file descriptor.
+ * @param prev The previous setting, NULL for the first one.
+ * @param pt The setting to switch to.
+ * @return 0 on success, -ETIMEDOUT if no probe came back, error code on
+ * other failures.
+ */
+static int switch_line(const struct linecfg_info *info, int fd,
+                       const struct line_point *prev, struct line_point *pt)
+{
+    static uint8_t rx[TAIL_LEN + RECOVER_MS / PROBE_MS * PROBE_LEN * 4];
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    uint8_t tail[TAIL_LEN], probe[PROBE_LEN];
+    uint64_t start = 0, probe_ns = 0, now = 0, seq = 0, interval = 0;
+    int len = 0, i = 0, ret = 0;
+    ssize_t n = 0;
+
+    if (prev != NULL) {
+        for (i = 0; i < TAIL_LEN; i++) {
+            tail[i] = pattern(i, prev->bits);
+        }
+        ret = write_all(fd, tail, sizeof(tail));
+        if (ret) {
+            return ret;
+        }
+    }
+
+    start = stats_now_ns();
+    ret = uart_set_line(fd, pt->baud, pt->bits, pt->parity, pt->stop,
+                        info->flow);
+    pt->setattr_ns = stats_now_ns() - start;
+    if (ret) {
+        return ret;
+    }
+
+    /* only the latest probe matches, the previous one must drain first */
+    interval = 2 * 1000000000ULL * PROBE_LEN * char_bits(pt) / pt->baud;
+    if (interval < PROBE_MS * 1000000ULL) {
+        interval = PROBE_MS * 1000000ULL;
+    }
+
+    for (now = start; now - start < RECOVER_MS * 1000000ULL;
+         now = stats_now_ns()) {
+        if (now - probe_ns >= interval) {
+            /* a new probe each time, an old one may still come back */
+            for (i = 0; i < PROBE_LEN; i++) {
+                probe[i] = pattern(seq * PROBE_LEN + i + 1000, pt->bits);
+            }
+            seq++;
+            ret = write_all(fd, probe, sizeof(probe));
+            if (ret) {
+                return ret;
+            }
+            probe_ns = stats_now_ns();
+        }
+
+        if (poll(&pfd, 1, PROBE_MS) < 0) {
+            return -errno;
+        }
+        if (!(pfd.revents & POLLIN)) {
+            continue;
+        }
+
+        n = read(fd, rx + len, sizeof(rx) - len);
+        if (n < 0 && errno != EAGAIN) {
+            return -errno;
+        }
+        len += n > 0 ? n : 0;
+
+        if (len >= PROBE_LEN &&
+            !memcmp(rx + len - PROBE_LEN, probe, PROBE_LEN)) {
+            pt->recover_ns = stats_now_ns() - start;
+            pt->tail_lost = prev != NULL ?
+                            TAIL_LEN - tail_received(rx, len, tail) : 0;
+            return 0;
+        }
+        if (len == (int)sizeof(rx)) {
+            /* keep the end, a probe may be split over two reads */
+            memmove(rx, rx + len - PROBE_LEN, PROBE_LEN);
+            len = PROBE_LEN;
+        }
+    }
+
+    return -ETIMEDOUT;
+}
+
+/**
+ * @brief Stream the test pattern for the run time of a setting.
+ *
+ * A mismatching byte is an error, the check then continues from the
+ * byte received, so one lost byte is a single error.
+ *
+ * @param info The app info.
+ * @param fd The tty file descriptor.
+ * @param pt The current setting.
+ * @return 0 on success, error code on failure.
+ */
+static int stream(const struct linecfg_info *info, int fd,
+                  struct line_point *pt)
+{
+    struct pollfd pfd = { fd, POLLIN | POLLOUT, 0 };
+    uint8_t tx[CHUNK], rx[4096];
+    uint64_t start = 0, end = 0, now = 0, last_rx = 0, first_rx = 0;
+    uint64_t txseq = 0, rxseq = 0;
+    uint8_t expect = 0;
+    ssize_t n = 0, i = 0, k = 0;
+    int mask = (1 << pt->bits) - 1;
+
+    start = stats_now_ns();
+    end = start + (uint64_t)info->duration * 1000000000ULL;
+
+    for (now = start; ; now = stats_now_ns()) {
+        if (now >= end) {
+            pfd.events = POLLIN;
+            if (now - (last_rx > end ? last_rx : end) >
+                DRAIN_MS * 1000000ULL) {
+                break;
+            }
+        }
+
+        if (poll(&pfd, 1, 50) < 0) {
+            return -errno;
+        }
+
+        if ((pfd.events & POLLOUT) && (pfd.revents & POLLOUT)) {
+            for (k = 0; k < CHUNK; k++) {
+                tx[k] = pattern(txseq + k, pt->bits);
+            }
+            n = write(fd, tx, sizeof(tx));
+            if (n < 0 && errno != EAGAIN) {
+                return -errno;
+            }
+            txseq += n > 0 ? n : 0;
+        }
+
+        if (!(pfd.revents & POLLIN)) {
+            continue;
+        }
+        n = read(fd, rx, sizeof(rx));
+        if (n < 0 && errno != EAGAIN) {
+            return -errno;
+        }
+        now = stats_now_ns();
+        for (i = 0; i < n; i++) {
+            expect = pattern(rxseq, pt->bits);
+            if ((rx[i] & mask) != expect) {
+                pt->errors++;
+                /* resync on the next sequence number giving this byte */
+                for (k = 1; k < 256 && pattern(rxseq + k, pt->bits) !=
+                     (rx[i] & mask); k++) {
+                }
+                rxseq += k < 256 ? k : 0;
+            }
+            rxseq++;
+            pt->rx_bytes++;
+        }
+        if (n > 0) {
+            if (!first_rx) {
+                first_rx = now;
+            }
+            last_rx = now;
+        }
+    }
+
+    pt->tx_bytes = txseq;
+    pt->bytes_s = last_rx > first_rx ?
+                  (pt->rx_bytes - pt->errors) / ((last_rx - first_rx) / 1e9) :
+                  0.0;
+    pt->line_use = pt->bytes_s * char_bits(pt) * 100.0 / pt->baud;
+
+    return 0;
+}
+
+/**
+ * @brief Print the results of one line setting.
+ *
+ * @param info The app info.
+ * @param pt The measured setting.
+ */
+static void print_point(const struct linecfg_info *info,
+                        const struct line_point *pt)
+{
+    char metric[64], prefix[32];
+
+    snprintf(prefix, sizeof(prefix), "b%d_%d%c%d", pt->baud, pt->bits,
+             pt->parity, pt->stop);
+
+    printf("\n%s: %s baud=%d format=%d%c%d setattr_us=%.1f "
+           "recover_us=%.1f tail_lost=%d tx_bytes=%llu rx_bytes=%llu "
+           "errors=%llu bytes_per_s=%.1f line_use=%.1f%%%s%s\n",
+           APP_NAME, prefix, pt->baud, pt->bits, pt->parity, pt->stop,
+           pt->setattr_ns / 1000.0, pt->recover_ns / 1000.0, pt->tail_lost,
+           (unsigned long long)pt->tx_bytes,
+           (unsigned long long)pt->rx_bytes,
+           (unsigned long long)pt->errors, pt->bytes_s, pt->line_use,
+           pt->ret ? " error=" : "", pt->ret ? strerror(-pt->ret) : "");
+
+    print_test_case_check(info->case_id, prefix, pt->ret);
+    if (pt->ret) {
+        return;
+    }
+
+    snprintf(metric, sizeof(metric), "%s_setattr", prefix);
+    print_test_case_perf(info->case_id, metric, pt->setattr_ns / 1000.0,
+                         "us");
+    snprintf(metric, sizeof(metric), "%s_recover", prefix);
+    print_test_case_perf(info->case_id, metric, pt->recover_ns / 1000.0,
+                         "us");
+    snprintf(metric, sizeof(metric), "%s_tail_lost", prefix);
+    print_test_case_perf(info->case_id, metric, pt->tail_lost, "B");
+    snprintf(metric, sizeof(metric), "%s_bytes_per_s", prefix);
+    print_test_case_perf(info->case_id, metric, pt->bytes_s, "B/s");
+    snprintf(metric, sizeof(metric), "%s_line_use", prefix);
+    print_test_case_perf(info->case_id, metric, pt->line_use, "%");
+    snprintf(metric, sizeof(metric), "%s_errors", prefix);
+    print_test_case_perf(info->case_id, metric, pt->errors, "B");
+}
+
+/**
+ * @brief Print the line use of every setting, one row per word size,
+ * parity and stop bits, one column per baud rate.
+ *
+ * @param info The app info.
+ * @param pts The measured settings, in sweep order.
+ * @param count Number of settings.
+ */
+static void print_matrix(const struct linecfg_info *info,
+                         const struct line_point *pts, int count)
+{
+    int rows = count / info->bauds.count, r = 0, b = 0;
+    const struct line_point *pt = NULL;
+
+    printf("\n%s: line use in %% of the baud rate, - failed\nformat ",
+           APP_NAME);
+    for (b = 0; b < info->bauds.count; b++) {
+        printf(" %8d", info->bauds.value[b]);
+    }
+    printf("\n");
+
+    for (r = 0; r < rows; r++) {
+        printf("%d%c%d   ", pts[r].bits, pts[r].parity, pts[r].stop);
+        for (b = 0; b < info->bauds.count; b++) {
+            pt = &pts[b * rows + r];
+            if (pt->ret) {
+                printf(" %8s", "-");
+            } else {
+                printf(" %8.1f", pt->line_use);
+            }
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct linecfg_info info;
+    static struct line_point pts[MAX_POINTS];
+    const struct line_point *prev = NULL;
+    int options = 0, fd = -1, count = 0, ret = 0, err = 0;
+    int b = 0, w = 0, p = 0, s = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.duration = DEFAULT_DURATION;
+    sweep_parse(&info.bauds, DEFAULT_BAUDS, 1, INT32_MAX);
+    sweep_parse(&info.bits, DEFAULT_BITS, 5, 8);
+    parse_parities(&info.parities, DEFAULT_PARITIES);
+    sweep_parse(&info.stops, DEFAULT_STOPS, 1, 2);
+
+    while ((options = getopt(argc, argv, "ab:c:d:p:rs:t:w:")) != -1) {
+        switch (options) {
+            case 'a':
+                info.allow_errors = 1;
+                break;
+            case 'b':
+                ret = sweep_parse(&info.bauds, optarg, 1, INT32_MAX);
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                snprintf(info.tty, sizeof(info.tty), "%s", optarg);
+                break;
+            case 'p':
+                ret = parse_parities(&info.parities, optarg);
+                break;
+            case 'r':
+                info.flow = 1;
+                break;
+            case 's':
+                ret = sweep_parse(&info.stops, optarg, 1, 2);
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            case 'w':
+                ret = sweep_parse(&info.bits, optarg, 5, 8);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (!info.tty[0]) {
+        gb_find_uart_tty(0, info.tty, sizeof(info.tty));
+    }
+
+    if (!info.tty[0] || info.duration < 1 ||
+        info.bauds.count * info.bits.count * info.parities.count *
+        info.stops.count > MAX_POINTS) {
+        usage();
+        return -EINVAL;
+    }
+
+    fd = open_uart_tty(info.tty);
+    if (fd < 0 || fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+        ret = -errno;
+        goto out;
+    }
+
+    /* start from a clean 8N1 line at the first baud rate */
+    ret = uart_set_raw(fd, info.bauds.value[0], info.flow);
+    if (ret) {
+        goto out;
+    }
+
+    for (b = 0; b < info.bauds.count; b++) {
+        for (w = 0; w < info.bits.count; w++) {
+            for (p = 0; p < info.parities.count; p++) {
+                for (s = 0; s < info.stops.count; s++) {
+                    struct line_point *pt = &pts[count++];
+
+                    pt->baud = info.bauds.value[b];
+                    pt->bits = info.bits.value[w];
+                    pt->parity = (char)info.parities.value[p];
+                    pt->stop = info.stops.value[s];
+
+                    pt->ret = switch_line(&info, fd, prev, pt);
+                    if (!pt->ret) {
+                        pt->ret = stream(&info, fd, pt);
+                    }
+                    if (!pt->ret && pt->errors && !info.allow_errors) {
+                        pt->ret = -EIO;
+                    }
+                    print_point(&info, pt);
+
+                    /* a failed switch leaves the line state unknown */
+                    if (pt->ret == -ETIMEDOUT || pt->ret == -EOPNOTSUPP) {
+                        err = uart_set_raw(fd, pt->baud, info.flow);
+                        prev = NULL;
+                    } else {
+                        prev = pt;
+                    }
+                    if (pt->ret && !ret) {
+                        ret = pt->ret;
+                    }
+                    if (err) {
+                        ret = err;
+                        goto out;
+                    }
+                }
+            }
+        }
+    }
+
+    print_matrix(&info, pts, count);
+
+out:
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
+}
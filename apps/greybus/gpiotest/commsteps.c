@@ -39,208 +39,231 @@
 #include <stdlib.h>
 #include <time.h>
 #include <sys/time.h>
-#include <linux/limits.h>
+#include <stdarg.h>
 #include <ctype.h>
 
 #include <libfwtest.h>
 #include "commsteps.h"
 
+static const char *gpio_step_name[GPIO_STEP_MAX] = {
+    "activate",
+    "deactivate",
+    "set_direction",
+    "get_direction",
+    "set_value",
+    "get_value",
+    "set_edge",
+    "get_edge",
+};
+
+/* Longest [D] message of a step */
+#define GPIO_LOG_LEN 64
+
+/* per step latency and CPU cost of the running test case, when enabled */
+static int step_timing;
+static struct stats_hist step_hist[GPIO_STEP_MAX];
+static struct stats_perf step_perf;
+static struct stats_perf_snap step_snap;
+static struct stats_perf_count step_count[GPIO_STEP_MAX];
+
 /**
- * @brief Read GPIO debugfs to get Greybus GPIO max count
+ * @brief Enable timing of every GPIO operation
  *
- * @param case_id The GPIO test case number
- * @param gpio_pin Greybus GPIO base pin
- * @param gpio_max_count Greybus GPIO max count
- * @return 0 on success, error code on failure
+ * Each sysfs access of a single pin and each gpio chardev call of a batch
+ * pin set is one sample of its step type. The CPU counters of the
+ * process are read around each of them too when the kernel has them.
+ *
+ * @param enable Non-zero to time steps
+ * @return None
  */
-int get_greybus_gpio_count(int gpio_pin, char *gpio_max_count, int len)
+void gpio_step_timing(int enable)
 {
-    int ret = 0;
-    char gpiostr[PATH_MAX];
+    int i = 0;
 
-    snprintf(gpiostr, sizeof(gpiostr), "%s%d", "/sys/class/gpio/gpiochip",
-             gpio_pin);
-    ret = debugfs_get_attr(gpiostr, "ngpio", gpio_max_count, len);
-    return ret;
+    if (step_timing && step_perf.nslots) {
+        stats_perf_close(&step_perf);
+    }
+    step_timing = enable;
+    for (i = 0; i < GPIO_STEP_MAX; i++) {
+        stats_hist_init(&step_hist[i]);
+        stats_perf_count_init(&step_count[i]);
+    }
+    if (step_timing && stats_perf_open(&step_perf) < 0) {
+        print_test_case_log(LOG_TAG, 0, "no CPU counters, latency only");
+    }
 }
 
 /**
- * @brief Check the Greybus GPIO controller exists
+ * @brief Start timing a step
  *
- * @param gpio_pin GPIO test pin
- * @param gpio_max_count Greybus GPIO max count
- * @return 0 on success, error code on failure
+ * @return start time, 0 when timing is off
  */
-int check_greybus_gpio(int *gpio_pin, int *gpio_max_count)
+static uint64_t step_begin(void)
 {
-    int ret = 0, i = 0;
-    DIR *fdir;
-    struct dirent *ptr;
-    char buf[PATH_MAX] ,gpiostr[PATH_MAX];
-
-    /* Scan debugfs, find Greybus GPIO sysfs */
-    fdir = opendir("/sys/class/gpio");
-    if(fdir == NULL) {
-        return -ENOENT;
-    }
-
-    while ((ptr = readdir(fdir)) != NULL) {
-        if (ptr->d_type == DT_LNK) {
-            snprintf(gpiostr, sizeof(gpiostr), "%s%s", "/sys/class/gpio/",
-                     ptr->d_name);
-            if(debugfs_get_attr(gpiostr, "label", buf, sizeof(buf)) >= 0) {
-                if(strcmp(buf, "greybus_gpio") == 0) {
-                    /* re-assign gpiostr string */
-                    snprintf(gpiostr, sizeof(gpiostr), "%s%s",
-                             "/sys/class/gpio/", ptr->d_name);
-                    ret = debugfs_get_attr(gpiostr, "base", buf, sizeof(buf));
-                    *gpio_pin = atoi(buf);
-                }
-            }
-        }
+    if (!step_timing) {
+        return 0;
     }
 
-    ret = get_greybus_gpio_count(*gpio_pin, buf, sizeof(buf));
-    *gpio_max_count = atoi(buf);
+    stats_perf_begin(&step_perf, &step_snap);
+    return stats_now_ns();
+}
 
-    return ret;
+/**
+ * @brief Finish timing a step, failed steps are not sampled
+ *
+ * @param step The step type
+ * @param start Time returned by step_begin()
+ * @param ret The step result
+ * @return None
+ */
+static void step_end(enum gpio_step step, uint64_t start, int ret)
+{
+    uint64_t end;
+
+    if (step_timing && !ret) {
+        end = stats_now_ns();
+        stats_perf_end(&step_perf, &step_snap, &step_count[step]);
+        stats_hist_record(&step_hist[step], end - start);
+    }
 }
 
 /**
- * @brief Activate GPIO single pin
+ * @brief Print the step latency histograms and CPU cost per operation of
+ * a test case and reset them
  *
  * @param case_id The GPIO test case number
- * @param gpio_pin GPIO test pin
- * @return 0 on success, error code on failure
+ * @return None
  */
-int activate_gpio_pin(int case_id, int gpio_pin)
+void gpio_step_report(int case_id)
 {
-    int ret = 0;
-    char gpiostr[PATH_MAX];
+    char metric[32];
+    int i = 0;
 
-    snprintf(gpiostr, sizeof(gpiostr), "%d\n", gpio_pin);
-    ret = debugfs_set_attr("/sys/class/gpio", "export" , gpiostr,
-                           sizeof(gpiostr));
-    snprintf(gpiostr, sizeof(gpiostr), "%s%d", "Activate GPIO Pin: gpio",
-             gpio_pin);
-    if(!ret) {
-        print_test_case_log(LOG_TAG, case_id, gpiostr);
+    if (!step_timing) {
+        return;
     }
 
-    return ret;
+    for (i = 0; i < GPIO_STEP_MAX; i++) {
+        if (step_hist[i].count) {
+            snprintf(metric, sizeof(metric), "%s_latency", gpio_step_name[i]);
+            stats_hist_report(case_id, metric, &step_hist[i]);
+        }
+        stats_perf_report(case_id, gpio_step_name[i], &step_perf,
+                          &step_count[i]);
+        stats_hist_init(&step_hist[i]);
+        stats_perf_count_init(&step_count[i]);
+    }
 }
 
 /**
- * @brief Activate GPIO multiple pin
+ * @brief Print the [D] message of a step
+ *
+ * The message is only formatted when [D] lines print, so repeated steps,
+ * which run at LOG_LEVEL_RESULT after the first iteration, do no string
+ * formatting.
  *
  * @param case_id The GPIO test case number
- * @param gpio_pin1 SDB APB bridge test GPIO pin1
- * @param gpio_pin2 SDB APB bridge test GPIO pin2
- * @param gpio_pin3 SDB APB bridge test GPIO pin3
- * @return 0 on success, error code on failure
+ * @param fmt printf() format of the message
+ * @return None
  */
-int activate_gpio_multiple_pin(int case_id, int gpio_pin1, int gpio_pin2,
-                               int gpio_pin3)
+static void __attribute__((format(printf, 2, 3)))
+step_log(int case_id, const char *fmt, ...)
 {
-    int ret = 0, i = 0;
-    char gpiostr[PATH_MAX];
+    char gpiostr[GPIO_LOG_LEN];
+    va_list ap;
 
-    /* export Greybus GPIO */
-    snprintf(gpiostr, sizeof(gpiostr), "%d\n", gpio_pin1);
-    ret = debugfs_set_attr("/sys/class/gpio", "export" , gpiostr,
-                           sizeof(gpiostr));
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "Activate GPIO Pin: gpio",
-             gpio_pin1);
-    if(!ret) {
-        print_test_case_log(LOG_TAG, case_id, gpiostr);
+    if (log_get_level() < LOG_LEVEL_DEBUG) {
+        return;
     }
 
-    snprintf(gpiostr, sizeof(gpiostr), "%d\n", gpio_pin2);
-    ret = debugfs_set_attr("/sys/class/gpio", "export" , gpiostr,
-                           sizeof(gpiostr));
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "Activate GPIO Pin: gpio",
-             gpio_pin2);
-    if(!ret) {
-        print_test_case_log(LOG_TAG, case_id, gpiostr);
-    }
+    va_start(ap, fmt);
+    vsnprintf(gpiostr, sizeof(gpiostr), fmt, ap);
+    va_end(ap);
+    print_test_case_log(LOG_TAG, case_id, gpiostr);
+}
 
-    snprintf(gpiostr, sizeof(gpiostr), "%d\n", gpio_pin3);
-    ret = debugfs_set_attr("/sys/class/gpio", "export" , gpiostr,
-                           sizeof(gpiostr));
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "Activate GPIO Pin: gpio",
-             gpio_pin3);
-    if(!ret) {
-        print_test_case_log(LOG_TAG, case_id, gpiostr);
-    }
+/**
+ * @brief Read GPIO debugfs to get Greybus GPIO max count
+ *
+ * @param case_id The GPIO test case number
+ * @param gpio_pin Greybus GPIO base pin
+ * @param gpio_max_count Greybus GPIO max count
+ * @return 0 on success, error code on failure
+ */
+int get_greybus_gpio_count(int gpio_pin, char *gpio_max_count, int len)
+{
+    int ret = 0;
+    char gpiostr[sizeof("/sys/class/gpio/gpiochip") + 12];
 
+    snprintf(gpiostr, sizeof(gpiostr), "%s%d", "/sys/class/gpio/gpiochip",
+             gpio_pin);
+    ret = debugfs_get_attr(gpiostr, "ngpio", gpio_max_count, len);
     return ret;
 }
 
 /**
- * @brief Deactivate GPIO single pin
+ * @brief Check the Greybus GPIO controller exists
+ *
+ * Uses the libfwtest discovery cache, so sysfs is only scanned when the
+ * Greybus devices changed since the last test app run.
  *
- * @param case_id The GPIO test case number
  * @param gpio_pin GPIO test pin
+ * @param gpio_max_count Greybus GPIO max count
+ * @param chipnum N of the controller's /dev/gpiochipN
  * @return 0 on success, error code on failure
  */
-int deactivate_gpio_pin(int case_id, int gpio_pin)
+int check_greybus_gpio(int *gpio_pin, int *gpio_max_count, int *chipnum)
 {
+    const struct gb_discovery *disc = gb_discover(0);
     int ret = 0;
-    char gpiostr[PATH_MAX];
 
-    snprintf(gpiostr, sizeof(gpiostr), "%d\n", gpio_pin);
-    ret = debugfs_set_attr("/sys/class/gpio", "unexport" , gpiostr,
-                           sizeof(gpiostr));
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "Deactivate GPIO Pin: gpio",
-             gpio_pin);
-    if(!ret) {
-        print_test_case_log(LOG_TAG, case_id, gpiostr);
+    ret = gb_find_gpio_chip(0, gpio_pin, gpio_max_count);
+    if (!ret) {
+        *chipnum = disc->gpio_chips[0].chipnum;
     }
 
     return ret;
 }
 
 /**
- * @brief Deactivate GPIO multiple pins
+ * @brief Activate GPIO single pin
  *
  * @param case_id The GPIO test case number
- * @param gpio_pin1 SDB APB bridge test GPIO pin1
- * @param gpio_pin2 SDB APB bridge test GPIO pin2
- * @param gpio_pin3 SDB APB bridge test GPIO pin3
+ * @param gpio_pin GPIO test pin
  * @return 0 on success, error code on failure
  */
-int deactivate_gpio_multiple_pin(int case_id, int gpio_pin1, int gpio_pin2,
-                                 int gpio_pin3)
+int activate_gpio_pin(int case_id, int gpio_pin)
 {
-    int ret = 0, i = 0;
-    char gpiostr[PATH_MAX];
+    int ret = 0;
+    uint64_t t0 = 0;
 
-    /* unexport Greybus GPIO */
-    snprintf(gpiostr, sizeof(gpiostr), "%d\n", gpio_pin1);
-    ret = debugfs_set_attr("/sys/class/gpio", "unexport" , gpiostr,
-                           sizeof(gpiostr));
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "Deactivate GPIO Pin: gpio",
-             gpio_pin1);
-    if(!ret) {
-        print_test_case_log(LOG_TAG, case_id, gpiostr);
+    t0 = step_begin();
+    ret = gpio_export(gpio_pin);
+    step_end(GPIO_STEP_ACTIVATE, t0, ret);
+    if (!ret) {
+        step_log(case_id, "Activate GPIO Pin: gpio%d", gpio_pin);
     }
 
-    snprintf(gpiostr, sizeof(gpiostr), "%d\n", gpio_pin2);
-    ret = debugfs_set_attr("/sys/class/gpio", "unexport" , gpiostr,
-                           sizeof(gpiostr));
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "Deactivate GPIO Pin: gpio",
-             gpio_pin2);
-    if(!ret) {
-        print_test_case_log(LOG_TAG, case_id, gpiostr);
-    }
+    return ret;
+}
+
+/**
+ * @brief Deactivate GPIO single pin
+ *
+ * @param case_id The GPIO test case number
+ * @param gpio_pin GPIO test pin
+ * @return 0 on success, error code on failure
+ */
+int deactivate_gpio_pin(int case_id, int gpio_pin)
+{
+    int ret = 0;
+    uint64_t t0 = 0;
 
-    snprintf(gpiostr, sizeof(gpiostr), "%d\n", gpio_pin3);
-    ret = debugfs_set_attr("/sys/class/gpio", "unexport" , gpiostr,
-                           sizeof(gpiostr));
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "Deactivate GPIO Pin: gpio",
-             gpio_pin3);
-    if(!ret) {
-        print_test_case_log(LOG_TAG, case_id, gpiostr);
+    t0 = step_begin();
+    ret = gpio_unexport(gpio_pin);
+    step_end(GPIO_STEP_DEACTIVATE, t0, ret);
+    if (!ret) {
+        step_log(case_id, "Deactivate GPIO Pin: gpio%d", gpio_pin);
     }
 
     return ret;
@@ -258,14 +281,13 @@ int deactivate_gpio_multiple_pin(int case_id, int gpio_pin1, int gpio_pin2,
 int set_gpio_direction(int case_id, int gpio_pin, char *gpio_direction, int len)
 {
     int ret = 0;
-    char gpiostr[PATH_MAX];
+    uint64_t t0 = 0;
 
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "/sys/class/gpio/gpio", gpio_pin)
-             ;
-    ret = debugfs_set_attr(gpiostr, "direction", gpio_direction, len);
-    snprintf(gpiostr, sizeof(gpiostr), "Set GPIO%d direction = %s",  gpio_pin,
+    t0 = step_begin();
+    ret = gpio_set_attr(gpio_pin, GPIO_ATTR_DIRECTION, gpio_direction, len);
+    step_end(GPIO_STEP_SET_DIRECTION, t0, ret);
+    step_log(case_id, "Set GPIO%d direction = %s", gpio_pin,
              gpio_direction);
-    print_test_case_log(LOG_TAG, case_id, gpiostr);
     return ret;
 }
 
@@ -281,14 +303,12 @@ int set_gpio_direction(int case_id, int gpio_pin, char *gpio_direction, int len)
 int get_gpio_direction(int case_id, int gpio_pin, char *gpio_direction, int len)
 {
     int ret = 0;
-    char gpiostr[PATH_MAX];
+    uint64_t t0 = 0;
 
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "/sys/class/gpio/gpio",
-             gpio_pin);
-    ret = debugfs_get_attr(gpiostr, "direction", gpio_direction, len);
-    snprintf(gpiostr, sizeof(gpiostr), "GPIO%d direction = %s", gpio_pin,
-             gpio_direction);
-    print_test_case_log(LOG_TAG, case_id, gpiostr);
+    t0 = step_begin();
+    ret = gpio_get_attr(gpio_pin, GPIO_ATTR_DIRECTION, gpio_direction, len);
+    step_end(GPIO_STEP_GET_DIRECTION, t0, ret);
+    step_log(case_id, "GPIO%d direction = %s", gpio_pin, gpio_direction);
     return ret;
 }
 
@@ -304,14 +324,14 @@ int get_gpio_direction(int case_id, int gpio_pin, char *gpio_direction, int len)
 int set_gpio_value(int case_id, int gpio_pin, char *gpio_value, int len)
 {
     int ret = 0;
-    char gpiostr[PATH_MAX];
+    uint64_t t0 = 0;
 
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "/sys/class/gpio/gpio",
-             gpio_pin);
-    ret = debugfs_set_attr(gpiostr, "value", gpio_value, len);
-    snprintf(gpiostr, sizeof(gpiostr), "Set GPIO%d value = %d", gpio_pin,
-             atoi(gpio_value));
-    print_test_case_log(LOG_TAG, case_id, gpiostr);
+    trace_call_begin("set_gpio_value");
+    t0 = step_begin();
+    ret = gpio_set_attr(gpio_pin, GPIO_ATTR_VALUE, gpio_value, len);
+    step_end(GPIO_STEP_SET_VALUE, t0, ret);
+    trace_call_end("set_gpio_value");
+    step_log(case_id, "Set GPIO%d value = %d", gpio_pin, atoi(gpio_value));
 
     return ret;
 }
@@ -328,14 +348,12 @@ int set_gpio_value(int case_id, int gpio_pin, char *gpio_value, int len)
 int get_gpio_value(int case_id, int gpio_pin, char *gpio_value, int len)
 {
     int ret = 0;
-    char gpiostr[PATH_MAX];
+    uint64_t t0 = 0;
 
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "/sys/class/gpio/gpio",
-             gpio_pin);
-    ret = debugfs_get_attr(gpiostr, "value", gpio_value, len);
-    snprintf(gpiostr, sizeof(gpiostr), "GPIO%d value = %d", gpio_pin,
-             atoi(gpio_value));
-    print_test_case_log(LOG_TAG, case_id, gpiostr);
+    t0 = step_begin();
+    ret = gpio_get_attr(gpio_pin, GPIO_ATTR_VALUE, gpio_value, len);
+    step_end(GPIO_STEP_GET_VALUE, t0, ret);
+    step_log(case_id, "GPIO%d value = %d", gpio_pin, atoi(gpio_value));
 
     return ret;
 }
@@ -352,14 +370,12 @@ int get_gpio_value(int case_id, int gpio_pin, char *gpio_value, int len)
 int set_gpio_edge(int case_id, int gpio_pin, char *gpio_edge, int len)
 {
     int ret = 0;
-    char gpiostr[PATH_MAX];
+    uint64_t t0 = 0;
 
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "/sys/class/gpio/gpio",
-             gpio_pin);
-    ret = debugfs_set_attr(gpiostr, "edge", gpio_edge, len);
-    snprintf(gpiostr, sizeof(gpiostr), "Set GPIO%d edge = %s", gpio_pin,
-             gpio_edge);
-    print_test_case_log(LOG_TAG, case_id, gpiostr);
+    t0 = step_begin();
+    ret = gpio_set_attr(gpio_pin, GPIO_ATTR_EDGE, gpio_edge, len);
+    step_end(GPIO_STEP_SET_EDGE, t0, ret);
+    step_log(case_id, "Set GPIO%d edge = %s", gpio_pin, gpio_edge);
 
     return ret;
 }
@@ -376,17 +392,748 @@ int set_gpio_edge(int case_id, int gpio_pin, char *gpio_edge, int len)
 int get_gpio_edge(int case_id, int gpio_pin, char *gpio_edge, int len)
 {
     int ret = 0;
-    char gpiostr[PATH_MAX];
+    uint64_t t0 = 0;
 
-    snprintf(gpiostr, sizeof(gpiostr), "%s%i", "/sys/class/gpio/gpio", gpio_pin)
-             ;
-    ret = debugfs_get_attr(gpiostr, "edge", gpio_edge, len);
-    snprintf(gpiostr, sizeof(gpiostr), "GPIO%d edge = %s", gpio_pin, gpio_edge);
-    print_test_case_log(LOG_TAG, case_id, gpiostr);
+    t0 = step_begin();
+    ret = gpio_get_attr(gpio_pin, GPIO_ATTR_EDGE, gpio_edge, len);
+    step_end(GPIO_STEP_GET_EDGE, t0, ret);
+    step_log(case_id, "GPIO%d edge = %s", gpio_pin, gpio_edge);
+
+    return ret;
+}
+
+/* Signature shared by the single pin get and set steps */
+typedef int (*gpio_step_fn)(int case_id, int gpio_pin, char *buf, int len);
+
+/**
+ * @brief Run a single pin set step on every pin of a pin set
+ *
+ * @param case_id The GPIO test case number
+ * @param pins The GPIO pins
+ * @param step The single pin set step
+ * @param value The value to write
+ * @return 0 on success, error code of the first failing pin
+ */
+static int set_pins_step(int case_id, struct gpio_pins *pins, gpio_step_fn step,
+                         const char *value)
+{
+    int ret = 0, i = 0, err = 0, len = 0;
+    char buf[16];
+
+    /* set steps only read the buffer, fill it once for all pins */
+    len = snprintf(buf, sizeof(buf), "%s", value);
+    for (i = 0; i < pins->count; i++) {
+        err = step(case_id, pins->pin[i], buf, len);
+        if (err && !ret) {
+            ret = err;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Run a single pin get step on every pin of a pin set
+ *
+ * @param case_id The GPIO test case number
+ * @param pins The GPIO pins
+ * @param step The single pin get step
+ * @param expect Expected value, NULL to only read
+ * @return 0 on success, -EINVAL on unexpected value, error code of the
+ * first failing pin
+ */
+static int get_pins_step(int case_id, struct gpio_pins *pins, gpio_step_fn step,
+                         const char *expect)
+{
+    int ret = 0, i = 0, err = 0;
+    char buf[16];
+
+    for (i = 0; i < pins->count; i++) {
+        err = step(case_id, pins->pin[i], buf, sizeof(buf));
+        if (!err && expect != NULL && strcmp(buf, expect)) {
+            err = -EINVAL;
+        }
+        if (err && !ret) {
+            ret = err;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Request all pins of a pin set with one gpio chardev line request
+ *
+ * @param pins The GPIO pins
+ * @param output Non-zero to request outputs, driven low
+ * @return 0 on success, error code on failure
+ */
+static int request_pins_batch(struct gpio_pins *pins, int output)
+{
+    int offsets[GPIO_MAX_PINS];
+    int i = 0;
+
+    for (i = 0; i < pins->count; i++) {
+        offsets[i] = pins->pin[i] - pins->base;
+    }
+
+    pins->handle = gpio_cdev_request(pins->chipnum, offsets, pins->count,
+                                     output, NULL, "gpiotest");
+    if (pins->handle < 0) {
+        return pins->handle;
+    }
+    pins->output = output;
+
+    return 0;
+}
+
+/**
+ * @brief Log one message per pin of a pin set
+ *
+ * @param case_id The GPIO test case number
+ * @param pins The GPIO pins
+ * @param fmt Message format, gets the GPIO number and value
+ * @param values Per pin values, NULL when fmt only takes the GPIO number
+ * @return None
+ */
+static void log_pins(int case_id, struct gpio_pins *pins, const char *fmt,
+                     const char * const *values)
+{
+    int i = 0;
+
+    if (log_get_level() < LOG_LEVEL_DEBUG) {
+        return;
+    }
+
+    for (i = 0; i < pins->count; i++) {
+        step_log(case_id, fmt, pins->pin[i], values ? values[i] : "");
+    }
+}
+
+/**
+ * @brief Activate all pins of a pin set
+ *
+ * Batch pin sets are requested with one gpio chardev line request, all
+ * lines as inputs, and stay unexported. Other pin sets, or when the
+ * chardev request fails for any reason, are exported to sysfs pin by pin.
+ *
+ * @param case_id The GPIO test case number
+ * @param pins The GPIO pins
+ * @return 0 on success, error code on failure
+ */
+int activate_gpio_pins(int case_id, struct gpio_pins *pins)
+{
+    char logbuf[96];
+    int ret = 0, i = 0, err = 0;
+    uint64_t t0 = 0;
+
+    pins->handle = -1;
+
+    if (pins->batch) {
+        ret = -ENODEV;
+        if (pins->chipnum >= 0) {
+            t0 = step_begin();
+            ret = request_pins_batch(pins, 0);
+            step_end(GPIO_STEP_ACTIVATE, t0, ret);
+        }
+        if (!ret) {
+            log_pins(case_id, pins, "Activate GPIO Pin: gpio%d%s", NULL);
+            return 0;
+        }
+
+        snprintf(logbuf, sizeof(logbuf), "No gpio chardev request (%s), "
+                 "using sysfs", strerror(-ret));
+        print_test_case_log(LOG_TAG, case_id, logbuf);
+        pins->handle = -1;
+        ret = 0;
+    }
+
+    for (i = 0; i < pins->count; i++) {
+        err = activate_gpio_pin(case_id, pins->pin[i]);
+        if (err && !ret) {
+            ret = err;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Deactivate all pins of a pin set
+ *
+ * @param case_id The GPIO test case number
+ * @param pins The GPIO pins
+ * @return 0 on success, error code on failure
+ */
+int deactivate_gpio_pins(int case_id, struct gpio_pins *pins)
+{
+    int ret = 0, i = 0, err = 0;
+    uint64_t t0 = 0;
+
+    if (pins->handle >= 0) {
+        t0 = step_begin();
+        gpio_cdev_release(pins->handle);
+        step_end(GPIO_STEP_DEACTIVATE, t0, 0);
+        pins->handle = -1;
+        log_pins(case_id, pins, "Deactivate GPIO Pin: gpio%d%s", NULL);
+        return 0;
+    }
+
+    for (i = 0; i < pins->count; i++) {
+        err = deactivate_gpio_pin(case_id, pins->pin[i]);
+        if (err && !ret) {
+            ret = err;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Set the direction of all pins of a pin set
+ *
+ * A batch line request is replaced by one of the new direction, so all
+ * lines change with a single ioctl.
+ *
+ * @param case_id The GPIO test case number
+ * @param pins The GPIO pins
+ * @param gpio_direction GPIO direction (in or out)
+ * @return 0 on success, error code on failure
+ */
+int set_gpio_pins_direction(int case_id, struct gpio_pins *pins,
+                            const char *gpio_direction)
+{
+    const char *values[GPIO_MAX_PINS];
+    uint64_t t0 = 0;
+    int ret = 0, i = 0;
+
+    if (pins->handle < 0) {
+        return set_pins_step(case_id, pins, set_gpio_direction,
+                             gpio_direction);
+    }
+
+    for (i = 0; i < pins->count; i++) {
+        values[i] = gpio_direction;
+    }
+    log_pins(case_id, pins, "Set GPIO%d direction = %s", values);
+
+    t0 = step_begin();
+    gpio_cdev_release(pins->handle);
+    ret = request_pins_batch(pins, !strcmp(gpio_direction, "out"));
+    step_end(GPIO_STEP_SET_DIRECTION, t0, ret);
+
+    return ret;
+}
+
+/**
+ * @brief Get and optionally verify the direction of all pins of a pin set
+ *
+ * @param case_id The GPIO test case number
+ * @param pins The GPIO pins
+ * @param expect Expected direction (in or out), NULL to only read
+ * @return 0 on success, -EINVAL on unexpected direction, error code on
+ * failure
+ */
+int get_gpio_pins_direction(int case_id, struct gpio_pins *pins,
+                            const char *expect)
+{
+    const char *values[GPIO_MAX_PINS];
+    int offsets[GPIO_MAX_PINS];
+    uint8_t output[GPIO_MAX_PINS];
+    uint64_t t0 = 0;
+    int ret = 0, i = 0;
+
+    if (pins->handle < 0) {
+        return get_pins_step(case_id, pins, get_gpio_direction, expect);
+    }
+
+    for (i = 0; i < pins->count; i++) {
+        offsets[i] = pins->pin[i] - pins->base;
+    }
+    t0 = step_begin();
+    ret = gpio_cdev_get_directions(pins->chipnum, offsets, pins->count,
+                                   output);
+    step_end(GPIO_STEP_GET_DIRECTION, t0, ret);
+    if (ret) {
+        return ret;
+    }
+
+    for (i = 0; i < pins->count; i++) {
+        values[i] = output[i] ? "out" : "in";
+        if (expect != NULL && strcmp(values[i], expect)) {
+            ret = -EINVAL;
+        }
+    }
+    log_pins(case_id, pins, "GPIO%d direction = %s", values);
+
+    return ret;
+}
+
+/**
+ * @brief Set the value of all pins of a pin set
+ *
+ * @param case_id The GPIO test case number
+ * @param pins The GPIO pins
+ * @param gpio_value GPIO value (0 or 1)
+ * @return 0 on success, error code on failure
+ */
+int set_gpio_pins_value(int case_id, struct gpio_pins *pins,
+                        const char *gpio_value)
+{
+    const char *values[GPIO_MAX_PINS];
+    uint8_t data[GPIO_MAX_PINS];
+    uint64_t t0 = 0;
+    int ret = 0, i = 0;
+
+    if (pins->handle < 0) {
+        return set_pins_step(case_id, pins, set_gpio_value, gpio_value);
+    }
+
+    for (i = 0; i < pins->count; i++) {
+        data[i] = atoi(gpio_value) ? 1 : 0;
+        values[i] = gpio_value;
+    }
+    log_pins(case_id, pins, "Set GPIO%d value = %s", values);
+
+    t0 = step_begin();
+    ret = gpio_cdev_set_values(pins->handle, data, pins->count);
+    step_end(GPIO_STEP_SET_VALUE, t0, ret);
+
+    return ret;
+}
+
+/**
+ * @brief Get and optionally verify the value of all pins of a pin set
+ *
+ * @param case_id The GPIO test case number
+ * @param pins The GPIO pins
+ * @param expect Expected value (0 or 1), NULL to only read
+ * @return 0 on success, -EINVAL on unexpected value, error code on failure
+ */
+int get_gpio_pins_value(int case_id, struct gpio_pins *pins,
+                        const char *expect)
+{
+    const char *values[GPIO_MAX_PINS];
+    uint8_t data[GPIO_MAX_PINS];
+    uint64_t t0 = 0;
+    int ret = 0, i = 0;
+
+    if (pins->handle < 0) {
+        return get_pins_step(case_id, pins, get_gpio_value, expect);
+    }
+
+    t0 = step_begin();
+    ret = gpio_cdev_get_values(pins->handle, data, pins->count);
+    step_end(GPIO_STEP_GET_VALUE, t0, ret);
+    if (ret) {
+        return ret;
+    }
+
+    for (i = 0; i < pins->count; i++) {
+        values[i] = data[i] ? "1" : "0";
+        if (expect != NULL && strcmp(values[i], expect)) {
+            ret = -EINVAL;
+        }
+    }
+    log_pins(case_id, pins, "GPIO%d value = %s", values);
+
+    return ret;
+}
+
+/**
+ * @brief Set the edge of all pins of a pin set
+ *
+ * Edges are a sysfs attribute, batch line requests do not have one.
+ *
+ * @param case_id The GPIO test case number
+ * @param pins The GPIO pins
+ * @param gpio_edge GPIO edge (none, rising, falling, both)
+ * @return 0 on success, error code on failure
+ */
+int set_gpio_pins_edge(int case_id, struct gpio_pins *pins,
+                       const char *gpio_edge)
+{
+    if (pins->handle >= 0) {
+        return -EOPNOTSUPP;
+    }
+
+    return set_pins_step(case_id, pins, set_gpio_edge, gpio_edge);
+}
+
+/**
+ * @brief Get and optionally verify the edge of all pins of a pin set
+ *
+ * @param case_id The GPIO test case number
+ * @param pins The GPIO pins
+ * @param expect Expected edge (none, rising, falling, both), NULL to only
+ * read
+ * @return 0 on success, -EINVAL on unexpected edge, error code on failure
+ */
+int get_gpio_pins_edge(int case_id, struct gpio_pins *pins, const char *expect)
+{
+    if (pins->handle >= 0) {
+        return -EOPNOTSUPP;
+    }
+
+    return get_pins_step(case_id, pins, get_gpio_edge, expect);
+}
+
+/**
+ * @brief Initialize the step engine
+ *
+ * @param eng The step engine
+ * @param base Greybus GPIO base pin
+ * @param max_count Greybus GPIO line count
+ * @return None
+ */
+void gpio_engine_init(struct gpio_engine *eng, int base, int max_count)
+{
+    memset(eng, 0, sizeof(*eng));
+    eng->base = base;
+    eng->max_count = max_count;
+    eng->iterations = 1;
+    eng->pins.handle = -1;
+}
+
+/**
+ * @brief Deactivate the pins left active by the previous case
+ *
+ * @param eng The step engine
+ * @param case_id The GPIO test case number
+ * @return 0 on success, error code on failure
+ */
+int gpio_engine_release(struct gpio_engine *eng, int case_id)
+{
+    int ret = 0;
+
+    if (!eng->active) {
+        return 0;
+    }
+
+    ret = deactivate_gpio_pins(case_id, &eng->pins);
+    eng->active = 0;
+    eng->edge_set = 0;
 
     return ret;
 }
 
+/**
+ * @brief Bring the pins used by the run back to their state before it
+ *
+ * Ends a run. A batch line request is released, then only the pin
+ * attributes that differ from the snapshot taken when the run first used
+ * each pin are written: pins the run exported are unexported, pins that
+ * were exported before the run get their direction, level and edge back.
+ *
+ * @param eng The step engine
+ * @param case_id The GPIO test case number
+ * @return 0 on success, error code on failure
+ */
+int gpio_engine_restore(struct gpio_engine *eng, int case_id)
+{
+    int ret = 0, err = 0, changes = 0;
+
+    if (eng->active && eng->pins.handle >= 0) {
+        ret = deactivate_gpio_pins(case_id, &eng->pins);
+    }
+    eng->active = 0;
+    eng->edge_set = 0;
+
+    err = gpio_snapshot_restore(&eng->snapshot, &changes);
+    step_log(case_id, "Restore pre-test state of %d GPIO pins: %d changes",
+             eng->snapshot.count, changes);
+    gpio_snapshot_init(&eng->snapshot);
+
+    return ret ? ret : err;
+}
+
+/**
+ * @brief Check if two pin sets are the same lines, requested the same way
+ *
+ * @param a The first pin set
+ * @param b The second pin set
+ * @return Non-zero if they are the same
+ */
+static int same_pins(const struct gpio_pins *a, const struct gpio_pins *b)
+{
+    return a->count == b->count && a->batch == b->batch &&
+           a->chipnum == b->chipnum &&
+           !memcmp(a->pin, b->pin, a->count * sizeof(a->pin[0]));
+}
+
+/**
+ * @brief Check if a pin set has a pin
+ *
+ * @param pins The pin set
+ * @param pin GPIO number
+ * @return Non-zero if the pin is in the set
+ */
+static int has_pin(const struct gpio_pins *pins, int pin)
+{
+    int i = 0;
+
+    for (i = 0; i < pins->count; i++) {
+        if (pins->pin[i] == pin) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Hand the active sysfs pins of the previous case to a new pin set
+ *
+ * Only the pins the new set drops are unexported and the pins it adds
+ * exported, pins of both sets stay exported and get their edge cleared.
+ *
+ * @param eng The step engine
+ * @param case_id The GPIO test case number
+ * @param pins The pins of the case
+ * @return 0 on success, error code of the first failing pin
+ */
+static int handover_pins(struct gpio_engine *eng, int case_id,
+                         const struct gpio_pins *pins)
+{
+    int ret = 0, err = 0, i = 0;
+    char buf[8];
+
+    for (i = 0; i < eng->pins.count; i++) {
+        err = 0;
+        if (!has_pin(pins, eng->pins.pin[i])) {
+            err = deactivate_gpio_pin(case_id, eng->pins.pin[i]);
+        } else if (eng->edge_set) {
+            snprintf(buf, sizeof(buf), "%s", "none");
+            err = set_gpio_edge(case_id, eng->pins.pin[i], buf, strlen(buf));
+        }
+        if (err && !ret) {
+            ret = err;
+        }
+    }
+
+    for (i = 0; i < pins->count; i++) {
+        if (!has_pin(&eng->pins, pins->pin[i])) {
+            err = activate_gpio_pin(case_id, pins->pin[i]);
+            if (err && !ret) {
+                ret = err;
+            }
+        }
+    }
+
+    eng->pins = *pins;
+    eng->pins.handle = -1;
+    eng->edge_set = 0;
+
+    return ret;
+}
+
+/**
+ * @brief Take the pins of a case over from the previous case
+ *
+ * The state of every pin is recorded the first time the run uses it, for
+ * gpio_engine_restore(). Pins the previous case left active are kept when
+ * the case runs on the same pins, which saves the greybus deactivate and
+ * activate operations of a full unexport and export. Sysfs pins are handed
+ * over pin by pin when the pin sets differ, batch line requests are all or
+ * nothing. An edge left set is cleared, gpiolib does not change the
+ * direction of a line used as an interrupt.
+ *
+ * @param eng The step engine
+ * @param case_id The GPIO test case number
+ * @param pins The pins of the case
+ * @param fresh Non-zero to always start with inactive pins
+ * @return 0 on success, error code on failure
+ */
+static int acquire_pins(struct gpio_engine *eng, int case_id,
+                        const struct gpio_pins *pins, int fresh)
+{
+    int ret = 0, i = 0;
+
+    for (i = 0; i < pins->count; i++) {
+        ret = gpio_snapshot_add(&eng->snapshot, pins->pin[i]);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    if (eng->active && !fresh && !same_pins(&eng->pins, pins) &&
+        !pins->batch && eng->pins.handle < 0) {
+        return handover_pins(eng, case_id, pins);
+    }
+
+    if (eng->active && (fresh || !same_pins(&eng->pins, pins))) {
+        ret = gpio_engine_release(eng, case_id);
+    }
+
+    if (!eng->active) {
+        eng->pins = *pins;
+        eng->pins.handle = -1;
+    } else if (eng->edge_set) {
+        ret = set_gpio_pins_edge(case_id, &eng->pins, "none");
+        eng->edge_set = 0;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Run one step of a test case
+ *
+ * @param eng The step engine
+ * @param case_id The GPIO test case number
+ * @param step The step
+ * @return 0 on success, error code on failure
+ */
+static int run_step(struct gpio_engine *eng, int case_id,
+                    const struct gpio_case_step *step)
+{
+    struct gpio_pins *pins = &eng->pins;
+    /* Get debugfs ngpio buffer string */
+    char countbuf[4];
+    int ret = 0;
+
+    switch (step->op) {
+        case GPIO_OP_COUNT:
+            /* Read debugfs "ngpio to set GPIO_MAX_COUNT" */
+            ret = get_greybus_gpio_count(eng->base, countbuf,
+                                         sizeof(countbuf));
+            eng->max_count = atoi(countbuf);
+            step_log(case_id, "GPIO count: %d", eng->max_count);
+            return ret;
+        case GPIO_OP_ACTIVATE:
+            if (eng->active) {
+                log_pins(case_id, pins, "Reuse active GPIO Pin: gpio%d%s",
+                         NULL);
+                return 0;
+            }
+            /* a partly activated set is still released after the case */
+            eng->active = 1;
+            return activate_gpio_pins(case_id, pins);
+        case GPIO_OP_DEACTIVATE:
+            eng->active = 0;
+            eng->edge_set = 0;
+            return deactivate_gpio_pins(case_id, pins);
+        case GPIO_OP_SET_DIRECTION:
+            return set_gpio_pins_direction(case_id, pins, step->arg);
+        case GPIO_OP_GET_DIRECTION:
+            return get_gpio_pins_direction(case_id, pins, step->arg);
+        case GPIO_OP_SET_VALUE:
+            return set_gpio_pins_value(case_id, pins, step->arg);
+        case GPIO_OP_GET_VALUE:
+            return get_gpio_pins_value(case_id, pins, step->arg);
+        case GPIO_OP_SET_EDGE:
+            ret = set_gpio_pins_edge(case_id, pins, step->arg);
+            eng->edge_set = strcmp(step->arg, "none") != 0;
+            return ret;
+        case GPIO_OP_GET_EDGE:
+            return get_gpio_pins_edge(case_id, pins, step->arg);
+        default:
+            return -EINVAL;
+    }
+}
+
+/**
+ * @brief Run one step of a test case repeatedly
+ *
+ * The step runs eng->iterations times, or for eng->duration seconds.
+ * Failures are counted and do not end the loop. Only the first iteration
+ * logs its steps, so long runs do not flood the log. With -n or -d the
+ * operation rate and error rate print as [P] lines.
+ *
+ * @param eng The step engine
+ * @param case_id The GPIO test case number
+ * @param step The step
+ * @return 0 if every iteration passed, else the error code of the first
+ * failure
+ */
+static int repeat_step(struct gpio_engine *eng, int case_id,
+                       const struct gpio_case_step *step)
+{
+    uint64_t start = 0, end = 0, iterations = 0, errors = 0;
+    int ret = 0, err = 0, level = log_get_level();
+    double secs = 0.0;
+
+    start = stats_now_ns();
+    end = start + (uint64_t)eng->duration * 1000000000ULL;
+
+    do {
+        err = run_step(eng, case_id, step);
+        if (err) {
+            errors++;
+            if (!ret) {
+                ret = err;
+            }
+        }
+        if (!iterations++) {
+            log_set_level(LOG_LEVEL_RESULT);
+        }
+    } while (eng->duration ? stats_now_ns() < end :
+             iterations < (uint64_t)eng->iterations);
+
+    log_set_level(level);
+    secs = (stats_now_ns() - start) / 1e9;
+
+    if (errors) {
+        step_log(case_id, "%llu of %llu iterations failed",
+                 (unsigned long long)errors, (unsigned long long)iterations);
+    }
+
+    if (eng->repeat_set) {
+        print_test_case_perf(case_id, "iterations", iterations, "ops");
+        print_test_case_perf(case_id, "ops_per_s",
+                             secs > 0 ? iterations / secs : 0.0, "ops/s");
+        print_test_case_perf(case_id, "error_rate",
+                             errors * 100.0 / iterations, "%");
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Run a table driven test case
+ *
+ * The steps run in order up to the first failure, then the case result
+ * prints. Pins stay active after a passing case, so the next case can
+ * reuse them; gpio_engine_restore() brings them back to their pre-test
+ * state at the end of the run. A failing case deactivates its pins right
+ * away, its pin state is unknown.
+ *
+ * @param eng The step engine
+ * @param gcase The test case
+ * @param pins The pins of the case, NULL for cases that run on no pins
+ * @return 0 on success, error code on failure
+ */
+int gpio_run_case(struct gpio_engine *eng, const struct gpio_case *gcase,
+                  const struct gpio_pins *pins)
+{
+    const struct gpio_case_step *step = gcase->steps;
+    const struct gpio_case_step *last = gcase->steps + GPIO_CASE_MAX_STEPS;
+    int ret = 0, post_ret = 0;
+
+    if (pins != NULL) {
+        ret = acquire_pins(eng, gcase->case_id, pins,
+                           gcase->flags & GPIO_CASE_FRESH);
+    }
+
+    for (; !ret && step < last && step->op != GPIO_OP_END; step++) {
+        if (step->repeat) {
+            ret = repeat_step(eng, gcase->case_id, step);
+        } else {
+            ret = run_step(eng, gcase->case_id, step);
+        }
+    }
+
+    check_step_result(gcase->case_id, ret);
+    print_test_result(gcase->case_id, ret);
+
+    /* Post-condition: Recover pre-test status */
+    if (ret) {
+        post_ret = gpio_engine_release(eng, gcase->case_id);
+    }
+
+    return ret ? ret : post_ret;
+}
+
 /**
  * @brief check step ret value and confirm step status
  *
@@ -37,15 +37,103 @@ extern "C" {
 #define LOG_TAG "ARA"
 /* If getopt is -1 will exit */
 #define ERROR (-1)
+/* Max number of GPIO pins one test case runs on */
+#define GPIO_MAX_PINS 64
 
+/* The GPIO pins a test case runs on */
+struct gpio_pins {
+    int count;
+    /* Linux GPIO numbers */
+    int pin[GPIO_MAX_PINS];
+    /* Greybus GPIO base pin and its /dev/gpiochipN */
+    int base;
+    int chipnum;
+    /* Use one gpio chardev line request for all pins when possible */
+    int batch;
+    /* Batch line handle, -1 when the pins are exported to sysfs */
+    int handle;
+    int output;
+};
+
+/* GPIO operation types timed by gpio_step_timing() */
+enum gpio_step {
+    GPIO_STEP_ACTIVATE,
+    GPIO_STEP_DEACTIVATE,
+    GPIO_STEP_SET_DIRECTION,
+    GPIO_STEP_GET_DIRECTION,
+    GPIO_STEP_SET_VALUE,
+    GPIO_STEP_GET_VALUE,
+    GPIO_STEP_SET_EDGE,
+    GPIO_STEP_GET_EDGE,
+    GPIO_STEP_MAX,
+};
+
+/* Operations of a table driven test case step */
+enum gpio_op {
+    /* ends the step list of a case */
+    GPIO_OP_END,
+    /* read the Greybus GPIO line count */
+    GPIO_OP_COUNT,
+    GPIO_OP_ACTIVATE,
+    GPIO_OP_DEACTIVATE,
+    GPIO_OP_SET_DIRECTION,
+    GPIO_OP_GET_DIRECTION,
+    GPIO_OP_SET_VALUE,
+    GPIO_OP_GET_VALUE,
+    GPIO_OP_SET_EDGE,
+    GPIO_OP_GET_EDGE,
+};
+
+/* Max number of steps of one test case */
+#define GPIO_CASE_MAX_STEPS 12
+
+/* Activate the pins afresh, never reuse the pins of the previous case */
+#define GPIO_CASE_FRESH 0x1
+
+struct gpio_case_step {
+    enum gpio_op op;
+    /* value to set, or value to verify, NULL to only read */
+    const char *arg;
+    /* run the step repeatedly, as set with -n or -d */
+    int repeat;
+};
+
+/* A Testrail test case as a list of steps interpreted by gpio_run_case() */
+struct gpio_case {
+    int case_id;
+    /* number types the case supports, NULL when it runs on no pins */
+    const char *types;
+    /* number type used when -t is not given */
+    const char *default_type;
+    int flags;
+    struct gpio_case_step steps[GPIO_CASE_MAX_STEPS];
+};
+
+/* Step engine state, kept across the test cases of one run */
+struct gpio_engine {
+    /* Greybus GPIO base pin and line count */
+    int base;
+    int max_count;
+    /* iterations or run time of repeated steps */
+    int iterations;
+    int duration;
+    /* -n or -d given, report the rate of repeated steps */
+    int repeat_set;
+    /* pins left active by the previous case */
+    struct gpio_pins pins;
+    int active;
+    /* the active pins have an edge other than none */
+    int edge_set;
+    /* state of every pin before the run first used it */
+    struct gpio_snapshot snapshot;
+};
+
+void gpio_step_timing(int enable);
+void gpio_step_report(int case_id);
 int get_greybus_gpio_count(int gpio_pin, char *gpio_max_count, int len);
-int check_greybus_gpio(int *gpio_pin, int *gpio_max_count);
+int check_greybus_gpio(int *gpio_pin, int *gpio_max_count, int *chipnum);
 int activate_gpio_pin(int case_id, int gpio_pin);
-int activate_gpio_multiple_pin(int case_id, int gpio_pin1, int gpio_pin2,
-                               int gpio_pin3);
 int deactivate_gpio_pin(int case_id, int gpio_pin);
-int deactivate_gpio_multiple_pin(int case_id, int gpio_pin1, int gpio_pin2,
-                                 int gpio_pin3);
 int set_gpio_direction(int case_id, int gpio_pin, char *gpio_direction,
                        int len);
 int get_gpio_direction(int case_id, int gpio_pin, char *gpio_direction,
@@ -54,6 +142,24 @@ int set_gpio_value(int case_id, int gpio_pin, char *gpio_value, int len);
 int get_gpio_value(int case_id, int gpio_pin, char *gpio_value, int len);
 int set_gpio_edge(int case_id, int gpio_pin, char *gpio_edge, int len);
 int get_gpio_edge(int case_id, int gpio_pin, char *gpio_edge, int len);
+int activate_gpio_pins(int case_id, struct gpio_pins *pins);
+int deactivate_gpio_pins(int case_id, struct gpio_pins *pins);
+int set_gpio_pins_direction(int case_id, struct gpio_pins *pins,
+                            const char *gpio_direction);
+int get_gpio_pins_direction(int case_id, struct gpio_pins *pins,
+                            const char *expect);
+int set_gpio_pins_value(int case_id, struct gpio_pins *pins,
+                        const char *gpio_value);
+int get_gpio_pins_value(int case_id, struct gpio_pins *pins,
+                        const char *expect);
+int set_gpio_pins_edge(int case_id, struct gpio_pins *pins,
+                       const char *gpio_edge);
+int get_gpio_pins_edge(int case_id, struct gpio_pins *pins, const char *expect);
+void gpio_engine_init(struct gpio_engine *eng, int base, int max_count);
+int gpio_run_case(struct gpio_engine *eng, const struct gpio_case *gcase,
+                  const struct gpio_pins *pins);
+int gpio_engine_release(struct gpio_engine *eng, int case_id);
+int gpio_engine_restore(struct gpio_engine *eng, int case_id);
 void check_step_result(int case_id, int ret);
 void print_test_result(int case_id, int ret);
 
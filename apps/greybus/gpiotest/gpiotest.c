@@ -27,6 +27,7 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <string.h>
@@ -39,18 +40,36 @@
 #include <time.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <ctype.h>
 
 #include <libfwtest.h>
 #include "commsteps.h"
 
+/* Testrail test cases implemented by this application */
+#define GPIO_CASE_FIRST 1028
+#define GPIO_CASE_LAST  1050
+/* Max number of test cases run by one invocation */
+#define GPIO_MAX_CASES 64
+/* Iterations of the repeated request cases, as in Testrail */
+#define GPIO_DEFAULT_REPEAT 10
+
 struct gpio_app_info {
     uint16_t    case_id;
-    uint16_t    base_pin;
-    uint16_t    max_count;
-    uint16_t    gpio_pin1;
-    uint16_t    gpio_pin2;
-    uint16_t    gpio_pin3;
+    int         chipnum;
+    /* pin offsets given with -p or -1/-2/-3 */
+    int         pin_count;
+    uint16_t    pin_list[GPIO_MAX_PINS];
+    /* request multiple pins with one gpio chardev line request */
+    int         batch;
+    /* time every GPIO operation, print per step latency and CPU profiles */
+    int         profile;
+    /* controller, repeat options and pins kept across test cases */
+    struct gpio_engine engine;
     char        num_type[2];
+    /* num_type given on command line, else use the per case default */
+    int         num_type_set;
+    int         case_count;
+    uint16_t    case_list[GPIO_MAX_CASES];
 };
 
 /**
@@ -60,16 +79,39 @@ struct gpio_app_info {
  */
 static void print_usage()
 {
-    printf("\nUsage: gpiotest [-c case-id] [-t number-type] [-1 gpio-pin1]"
-           "[-2 gpio-pin2] [-3 gpio-pin3]\n");
-    printf("    -c: Testrail test case ID.\n");
-    printf("    -t: 's' for Single pin test or 'm' for Multiple pins test.\n");
-    printf("    -1: GPIO pin1 number for single pin or multiple pins test\n");
-    printf("    -2: GPIO pin2 number for multiple pins test\n");
-    printf("    -3: GPIO pin3 number for multiple pins test\n");
+    printf("\nUsage: gpiotest [-c case-id] [-t number-type] [-p pin-list] "
+           "[-b] [-P]\n        [-n iterations] [-d seconds]\n");
+    printf("    -c: Testrail test case ID. Several cases run in one go with\n");
+    printf("        a comma separated list, ranges or 'all' (%d-%d),\n",
+           GPIO_CASE_FIRST, GPIO_CASE_LAST);
+    printf("        e.g. -c 1028,1031-1035\n");
+    printf("    -t: 's' for Single pin test, 'm' for Multiple pins test or\n");
+    printf("        'a' for All the controller's pins (cases that support\n");
+    printf("        it). If omitted, each case uses its default number\n");
+    printf("        type.\n");
+    printf("    -p: comma separated GPIO pin list, the first pin is used by\n");
+    printf("        single pin tests (default 0).\n");
+    printf("    -1, -2, -3: set the first, second or third pin of the list.\n");
+    printf("    -b: request multiple pins with one gpio chardev line\n");
+    printf("        request instead of one sysfs export per pin. Always on\n");
+    printf("        for 'a', which falls back to sysfs without a chardev.\n");
+    printf("    -P: time every GPIO operation and print the latency and\n");
+    printf("        CPU cost profile of each step type (activate,\n");
+    printf("        direction, value, edge, deactivate) as [P] lines\n");
+    printf("        after each case result.\n");
+    printf("    -n: iterations of the repeated request cases 1032, 1035 and\n");
+    printf("        1037 (default %d).\n", GPIO_DEFAULT_REPEAT);
+    printf("    -d: run the repeated request cases for this many seconds\n");
+    printf("        instead. -n and -d print the operation rate and error\n");
+    printf("        rate as [P] lines.\n");
     printf("Example : case C1031 use SDB board, GPIO had 3 pins can\n");
     printf("     test(GPIO0 GPIO8 GPIO9)\n");
-    printf("     ./gpiotest -c 1031 -t m -1 0 -2 8 -3 9\n");
+    printf("     ./gpiotest -c 1031 -t m -p 0,8,9\n");
+    printf("Example : run the whole suite on the same pins\n");
+    printf("     ./gpiotest -c all -p 0,8,9\n");
+    printf("Debug lines are buffered until each case result, set\n");
+    printf("FWTEST_LOG_BUFFER=0 to print them as they come, or\n");
+    printf("FWTEST_LOG_LEVEL=0 to only print results.\n");
  }
 
 /**
@@ -83,2159 +125,492 @@ static void print_usage()
  */
 static void default_params(struct gpio_app_info *info)
 {
+    /* unset -1/-2/-3 pins default to offset 0 */
+    memset(info, 0, sizeof(*info));
     info->case_id = 0;
-    info->base_pin = 0;
-    info->max_count = 0;
+    gpio_engine_init(&info->engine, 0, 0);
+    info->engine.iterations = GPIO_DEFAULT_REPEAT;
     snprintf(info->num_type, sizeof("") + 1, "%s", "");
-    info->gpio_pin1 = 0;
-    info->gpio_pin2 = 0;
-    info->gpio_pin3 = 0;
+    info->chipnum = -1;
+    info->pin_count = 0;
+    info->batch = 0;
+    info->profile = 0;
+    info->num_type_set = 0;
+    info->case_count = 0;
 }
 
 /**
- * @brief Command parser
+ * @brief Parse the test case list
  *
- * Parse the command input from console
+ * Accepts a single case ID, a comma separated list of case IDs and
+ * ranges ("1028,1031-1035"), or "all".
  *
  * @param info The GPIO info from user
- * @param argc Indicate how many input parameters
- * @param argv Commands input from console
+ * @param list The case list from command line
  * @return 0 on success, negative errno on error
  */
-static int command_parse(struct gpio_app_info *info, int argc, char **argv)
+static int parse_case_list(struct gpio_app_info *info, const char *list)
 {
-    int option;
+    char buf[256];
+    char *tok, *dash, *save = NULL;
+    int first, last, id;
 
-    while ((option = getopt(argc, argv, "c:C:t:T:1:2:3:")) != ERROR) {
-        switch(option) {
-            case 'c':
-                info->case_id = (uint16_t)atoi(optarg);
-                break;
-            case 'C':
-                info->case_id = (uint16_t)atoi(optarg);
-                break;
-            case 't':
-                snprintf(info->num_type, strlen(optarg) + 1, "%s", optarg);
-                break;
-            case 'T':
-                snprintf(info->num_type, strlen(optarg) + 1, "%s", optarg);
-                break;
-            case '1':
-                info->gpio_pin1 = (uint16_t)atoi(optarg);
-                break;
-            case '2':
-                info->gpio_pin2 = (uint16_t)atoi(optarg);
-                break;
-            case '3':
-                info->gpio_pin3 = (uint16_t)atoi(optarg);
-                break;
-            default:
-                print_usage();
-                return -EINVAL;
+    info->case_count = 0;
+
+    if (!strcasecmp(list, "all")) {
+        first = GPIO_CASE_FIRST;
+        last = GPIO_CASE_LAST;
+        for (id = first; id <= last; id++) {
+            info->case_list[info->case_count++] = (uint16_t)id;
         }
+        return 0;
     }
 
-    return 0;
-}
-
-/**
- * @brief Testrail test case C1028
- *
- * C1028: GPIO line count response contains the number of GPIO lines used by
- * the GPIO Controller. This test case verifies that the GPIO Line Count
- * Response payload contains a one-byte value corresponding to the number of
- * lines managed by the GPIO Controller
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1028_get_count(struct gpio_app_info *info)
-{
-    int ret = 0;
-    char gpiostr[PATH_MAX];
-    /* Get debugfs ngpio buffer string */
-    char countbuf[4];
-
-    /* Read debugfs "ngpio to set GPIO_MAX_COUNT" */
-    ret = get_greybus_gpio_count(info->base_pin, countbuf,
-                                 sizeof(countbuf));
-    info->max_count = atoi(countbuf);
-
-    snprintf(gpiostr, sizeof(gpiostr), "GPIO count: %d", info->max_count);
-    print_test_case_log(LOG_TAG, info->case_id, gpiostr);
-
-    print_test_result(info->case_id, ret);
+    snprintf(buf, sizeof(buf), "%s", list);
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        first = atoi(tok);
+        dash = strchr(tok, '-');
+        last = dash ? atoi(dash + 1) : first;
+        if (last < first) {
+            return -EINVAL;
+        }
+        for (id = first; id <= last; id++) {
+            if (info->case_count >= GPIO_MAX_CASES) {
+                return -EINVAL;
+            }
+            info->case_list[info->case_count++] = (uint16_t)id;
+        }
+    }
 
-    return ret;
+    return info->case_count ? 0 : -EINVAL;
 }
 
 /**
- * @brief Testrail test case C1029
- *
- * C1029: Generate multiple GPIO activate Request. This test case verifies
- * that multiple GPIO Activate Request operations can be executed successfully
+ * @brief Parse the GPIO pin list
  *
  * @param info The GPIO info from user
- * @return 0 on success, error code on failure
+ * @param list Comma separated pin offsets from command line
+ * @return 0 on success, negative errno on error
  */
-static int ARA_1029_multiple_activate(struct gpio_app_info *info)
+static int parse_pin_list(struct gpio_app_info *info, const char *list)
 {
-    int ret = 0;
-
-    /* Activate multiple GPIO pins */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = activate_gpio_multiple_pin(info->case_id,
-                                        (info->base_pin + info->gpio_pin1),
-                                        (info->base_pin + info->gpio_pin2),
-                                        (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id,
-                               (info->base_pin + info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
+    char buf[256];
+    char *tok, *save = NULL;
 
-    print_test_result(info->case_id, ret);
+    info->pin_count = 0;
 
-    /* Post-condition: Recover pre-test status.*/
-    /* Deactivate GPIO multiple pins */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = deactivate_gpio_multiple_pin(info->case_id,
-                                          (info->base_pin + info->gpio_pin1),
-                                          (info->base_pin + info->gpio_pin2),
-                                          (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id,
-                                 (info->base_pin + info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
+    snprintf(buf, sizeof(buf), "%s", list);
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        if (info->pin_count >= GPIO_MAX_PINS) {
+            return -EINVAL;
+        }
+        info->pin_list[info->pin_count++] = (uint16_t)atoi(tok);
     }
 
-    return ret;
+    return info->pin_count ? 0 : -EINVAL;
 }
 
 /**
- * @brief Testrail test case C1030
+ * @brief Set one pin of the pin list
  *
- * C1030: Generate multiple GPIO Deactivate Request. This test case verifies
- * that multiple GPIO Deactivate Request operations can be executed successfully
+ * Keeps the -1/-2/-3 options of the three pin LAVA jobs working.
  *
  * @param info The GPIO info from user
- * @return 0 on success, error code on failure
+ * @param index Index in the pin list
+ * @param pin The pin offset
+ * @return None
  */
-static int ARA_1030_multiple_deactivate(struct gpio_app_info *info)
+static void set_pin_list(struct gpio_app_info *info, int index, int pin)
 {
-    int ret = 0;
-
-    /* Activate multiple GPIO pins */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = activate_gpio_multiple_pin(info->case_id,
-                                        (info->base_pin + info->gpio_pin1),
-                                        (info->base_pin + info->gpio_pin2),
-                                        (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id,
-                               (info->base_pin + info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Deactivate multiple GPIO pins */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = deactivate_gpio_multiple_pin(info->case_id,
-                                          (info->base_pin + info->gpio_pin1),
-                                          (info->base_pin + info->gpio_pin2),
-                                          (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id,
-                                 (info->base_pin + info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
+    info->pin_list[index] = (uint16_t)pin;
+    if (info->pin_count <= index) {
+        info->pin_count = index + 1;
     }
-
-    print_test_result(info->case_id, ret);
-
-    return ret;
 }
 
 /**
- * @brief Testrail test case C1031
+ * @brief Command parser
  *
- * C1031: Generate multiple GPIO Direction Request. This test case verifies
- * that multiple GPIO Direction Request operations can be executed successfully
+ * Parse the command input from console
  *
  * @param info The GPIO info from user
- * @return 0 on success, error code on failure
+ * @param argc Indicate how many input parameters
+ * @param argv Commands input from console
+ * @return 0 on success, negative errno on error
  */
-static int ARA_1031_multiple_direction(struct gpio_app_info *info)
+static int command_parse(struct gpio_app_info *info, int argc, char **argv)
 {
-    int ret = 0;
-    /* Get GPIO direction buffer */
-    char directbuf[4];
+    int option;
 
-    /* Activate multiple GPIO pins */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = activate_gpio_multiple_pin(info->case_id,
-                                        (info->base_pin + info->gpio_pin1),
-                                        (info->base_pin + info->gpio_pin2),
-                                        (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id,
-                               (info->base_pin + info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
+    while ((option = getopt(argc, argv, "bc:C:d:n:p:Pt:T:1:2:3:")) != ERROR) {
+        switch(option) {
+            case 'c':
+            case 'C':
+                if (parse_case_list(info, optarg)) {
+                    print_usage();
+                    return -EINVAL;
+                }
+                info->case_id = info->case_list[0];
+                break;
+            case 't':
+            case 'T':
+                snprintf(info->num_type, sizeof(info->num_type), "%s", optarg);
+                info->num_type_set = 1;
+                break;
+            case 'b':
+                info->batch = 1;
+                break;
+            case 'P':
+                info->profile = 1;
+                break;
+            case 'n':
+                info->engine.iterations = atoi(optarg);
+                info->engine.repeat_set = 1;
+                if (info->engine.iterations < 1) {
+                    print_usage();
+                    return -EINVAL;
+                }
+                break;
+            case 'd':
+                info->engine.duration = atoi(optarg);
+                info->engine.repeat_set = 1;
+                if (info->engine.duration < 1) {
+                    print_usage();
+                    return -EINVAL;
+                }
+                break;
+            case 'p':
+                if (parse_pin_list(info, optarg)) {
+                    print_usage();
+                    return -EINVAL;
+                }
+                break;
+            case '1':
+            case '2':
+            case '3':
+                set_pin_list(info, option - '1', atoi(optarg));
+                break;
+            default:
+                print_usage();
+                return -EINVAL;
+        }
     }
 
-    check_step_result(info->case_id, ret);
-
-    /* Get multiple GPIO direction */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = get_gpio_direction(info->case_id,
-                                (info->base_pin + info->gpio_pin1),
-                                 directbuf, sizeof(directbuf));
-        ret = get_gpio_direction(info->case_id,
-                                (info->base_pin + info->gpio_pin2),
-                                 directbuf, sizeof(directbuf));
-        ret = get_gpio_direction(info->case_id,
-                                (info->base_pin + info->gpio_pin3),
-                                 directbuf, sizeof(directbuf));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_direction(info->case_id,
-                                (info->base_pin + info->gpio_pin1),
-                                     directbuf, sizeof(directbuf));
-    } else {
-        ret = -EINVAL;
+    /* No -c given, let the case dispatcher report the bad case ID */
+    if (!info->case_count) {
+        info->case_list[info->case_count++] = info->case_id;
     }
 
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status.*/
-    /* Deactivate multiple GPIO pins */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = deactivate_gpio_multiple_pin(info->case_id,
-                                          (info->base_pin + info->gpio_pin1),
-                                          (info->base_pin + info->gpio_pin2),
-                                          (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id,
-                                 (info->base_pin + info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
+    if (!info->pin_count) {
+        info->pin_list[info->pin_count++] = 0;
     }
 
-    return ret;
+    return 0;
 }
 
 /**
- * @brief Testrail test case C1032
+ * @brief Select the pins the running test case operates on
  *
- * C1032: GPIO Direction Request multiple times for the same GPIO line. This
- * test case verifies that multiple GPIO Direction Request operations for the
- * same GPIO line do not generate an error message
+ * 's' uses the first pin of the pin list, 'm' the whole pin list and 'a'
+ * every line of the controller. 'a' always batches all lines into one
+ * gpio chardev line request, 'm' only with -b.
  *
  * @param info The GPIO info from user
- * @return 0 on success, error code on failure
+ * @param types The number types the test case supports
+ * @param pins Returns the pins of the test case
+ * @return 0 on success, -EINVAL if the number type is not supported
  */
-static int ARA_1032_multiple_times_direction(struct gpio_app_info *info)
+static int select_pins(struct gpio_app_info *info, const char *types,
+                       struct gpio_pins *pins)
 {
-    int ret = 0, i = 0;
-    /* Get GPIO direction buffer */
-    char directbuf[4];
-    /* Testrail test case test 10 times */
-    int test_times = 10;
-
-    /* Activate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Read GPIO direction 10 times */
-    for(i = 0; i < test_times; i++) {
-        if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-            ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                     info->gpio_pin1), directbuf,
-                                     sizeof(directbuf));
-        } else {
-            ret = -EINVAL;
-        }
+    int base = info->engine.base;
+    int i = 0;
+
+    memset(pins, 0, sizeof(*pins));
+    pins->handle = -1;
+    pins->base = base;
+    pins->chipnum = info->chipnum;
+    pins->batch = info->batch;
+
+    if (strlen(info->num_type) != 1 ||
+        !strchr(types, tolower((unsigned char)info->num_type[0]))) {
+        return -EINVAL;
+    }
+
+    switch (tolower((unsigned char)info->num_type[0])) {
+        case 's':
+            pins->pin[pins->count++] = base + info->pin_list[0];
+            break;
+        case 'm':
+            for (i = 0; i < info->pin_count; i++) {
+                pins->pin[pins->count++] = base + info->pin_list[i];
+            }
+            break;
+        case 'a':
+            for (i = 0; i < info->engine.max_count && i < GPIO_MAX_PINS;
+                 i++) {
+                pins->pin[pins->count++] = base + i;
+            }
+            pins->batch = 1;
+            break;
     }
 
-    print_test_result(info->case_id, ret);
+    return 0;
+}
 
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
+#define STEP(op, arg)   { GPIO_OP_##op, arg, 0 }
+#define REPEAT(op, arg) { GPIO_OP_##op, arg, 1 }
+/* Common start of the value and edge cases */
+#define OUTPUT_HIGH \
+    STEP(ACTIVATE, NULL), STEP(SET_DIRECTION, "out"), STEP(SET_VALUE, "1")
 
-    return ret;
-}
+/*
+ * Testrail test cases. Every case that runs on pins starts with an
+ * activate step, which reuses the pins a previous case left active.
+ */
+static const struct gpio_case gpio_cases[] = {
+    /*
+     * C1028: GPIO line count response contains the number of GPIO lines
+     * used by the GPIO Controller.
+     */
+    { 1028, NULL, "s", 0, {
+        STEP(COUNT, NULL) } },
+    /* C1029: Generate multiple GPIO activate Request. */
+    { 1029, "sma", "m", GPIO_CASE_FRESH, {
+        STEP(ACTIVATE, NULL) } },
+    /* C1030: Generate multiple GPIO Deactivate Request. */
+    { 1030, "sma", "m", GPIO_CASE_FRESH, {
+        STEP(ACTIVATE, NULL), STEP(DEACTIVATE, NULL) } },
+    /* C1031: Generate multiple GPIO Direction Request. */
+    { 1031, "sma", "m", 0, {
+        STEP(ACTIVATE, NULL), STEP(GET_DIRECTION, NULL) } },
+    /*
+     * C1032: GPIO Direction Request multiple times for the same GPIO line
+     * does not generate an error. 10 times, or as set with -n or -d.
+     */
+    { 1032, "s", "s", 0, {
+        STEP(ACTIVATE, NULL), REPEAT(GET_DIRECTION, NULL) } },
+    /*
+     * C1033: GPIO Direction Request for all the GPIO lines, including
+     * lines that have not been activated.
+     */
+    { 1033, "sma", "m", 0, {
+        STEP(ACTIVATE, NULL), STEP(GET_DIRECTION, NULL) } },
+    /* C1034: Generate multiple GPIO Direction Input Request. */
+    { 1034, "sma", "m", 0, {
+        STEP(ACTIVATE, NULL), STEP(SET_DIRECTION, "in"),
+        STEP(GET_DIRECTION, "in") } },
+    /*
+     * C1035: GPIO direction input request multiple times for the same GPIO
+     * line does not generate an error.
+     */
+    { 1035, "s", "s", 0, {
+        STEP(ACTIVATE, NULL), REPEAT(SET_DIRECTION, "in"),
+        STEP(GET_DIRECTION, "in") } },
+    /* C1036: Generate multiple GPIO direction output request. */
+    { 1036, "sma", "m", 0, {
+        STEP(ACTIVATE, NULL), STEP(SET_DIRECTION, "out"),
+        STEP(GET_DIRECTION, "out") } },
+    /*
+     * C1037: GPIO direction output request multiple times for the same
+     * line does not generate an error.
+     */
+    { 1037, "s", "s", 0, {
+        STEP(ACTIVATE, NULL), REPEAT(SET_DIRECTION, "out"),
+        STEP(GET_DIRECTION, "out") } },
+    /* C1038: GPIO get response payload returns GPIO line current value. */
+    { 1038, "sma", "m", 0, {
+        STEP(ACTIVATE, NULL), STEP(SET_DIRECTION, "in"),
+        STEP(GET_VALUE, NULL) } },
+    /* C1039: Set GPIO line to high. */
+    { 1039, "s", "s", 0, {
+        OUTPUT_HIGH, STEP(GET_DIRECTION, "out"), STEP(GET_VALUE, "1") } },
+    /* C1040: Set GPIO line to low. */
+    { 1040, "s", "s", 0, {
+        STEP(ACTIVATE, NULL), STEP(SET_DIRECTION, "out"),
+        STEP(SET_VALUE, "0"), STEP(GET_DIRECTION, "out"),
+        STEP(GET_VALUE, "0") } },
+    /* C1041: GPIO IRQ type can be set to EDGE_RISING. */
+    { 1041, "s", "s", 0, {
+        OUTPUT_HIGH, STEP(SET_EDGE, "rising"), STEP(GET_EDGE, "rising") } },
+    /* C1042: GPIO IRQ type can be set to EDGE_FALLING. */
+    { 1042, "s", "s", 0, {
+        OUTPUT_HIGH, STEP(SET_EDGE, "falling"),
+        STEP(GET_EDGE, "falling") } },
+    /* C1043: GPIO IRQ type can be set to EDGE_BOTH. */
+    { 1043, "s", "s", 0, {
+        OUTPUT_HIGH, STEP(SET_EDGE, "both"), STEP(GET_EDGE, "both") } },
+    /* C1044: GPIO line direction changes from input to output. */
+    { 1044, "s", "s", 0, {
+        STEP(ACTIVATE, NULL), STEP(SET_DIRECTION, "in"),
+        STEP(GET_VALUE, NULL), STEP(DEACTIVATE, NULL),
+        OUTPUT_HIGH, STEP(GET_VALUE, "1") } },
+    /* C1045: GPIO line direction changes from output to input. */
+    { 1045, "s", "s", 0, {
+        OUTPUT_HIGH, STEP(DEACTIVATE, NULL), STEP(ACTIVATE, NULL),
+        STEP(SET_DIRECTION, "in"), STEP(GET_VALUE, NULL) } },
+    /* C1046: GPIO IRQ type changes from EDGE_FALLING to EDGE_RISING. */
+    { 1046, "s", "s", 0, {
+        OUTPUT_HIGH, STEP(SET_EDGE, "falling"), STEP(GET_EDGE, "falling"),
+        STEP(SET_EDGE, "rising"), STEP(GET_EDGE, "rising") } },
+    /* C1047: GPIO IRQ type changes from EDGE_RISING to EDGE_FALLING. */
+    { 1047, "s", "s", 0, {
+        OUTPUT_HIGH, STEP(SET_EDGE, "rising"), STEP(GET_EDGE, "rising"),
+        STEP(SET_EDGE, "falling"), STEP(GET_EDGE, "falling") } },
+    /* C1048: GPIO IRQ type changes from EDGE_RISING to EDGE_BOTH. */
+    { 1048, "s", "s", 0, {
+        OUTPUT_HIGH, STEP(SET_EDGE, "rising"), STEP(GET_EDGE, "rising"),
+        STEP(SET_EDGE, "both"), STEP(GET_EDGE, "both") } },
+    /* C1049: GPIO IRQ type changes from NONE to EDGE_BOTH. */
+    { 1049, "s", "s", 0, {
+        OUTPUT_HIGH, STEP(SET_EDGE, "none"), STEP(GET_EDGE, "none"),
+        STEP(SET_EDGE, "both"), STEP(GET_EDGE, "both") } },
+    /* C1050: GPIO IRQ type changes from EDGE_BOTH to NONE. */
+    { 1050, "s", "s", 0, {
+        OUTPUT_HIGH, STEP(SET_EDGE, "both"), STEP(GET_EDGE, "both"),
+        STEP(SET_EDGE, "none"), STEP(GET_EDGE, "none") } },
+};
 
 /**
- * @brief Testrail test case C1033
+ * @brief Find a test case in the case table
  *
- * C1033: GPIO Direction Request for all the GPIO lines. This test case
- * verifies that GPIO Direction Request Operations can be initiated for all the
- * GPIO lines including lines that have not been activated
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
+ * @param case_id The GPIO test case number
+ * @return the test case, NULL if there is no such case
  */
-static int ARA_1033_all_direction(struct gpio_app_info *info)
+static const struct gpio_case *find_case(int case_id)
 {
-    int ret = 0, i = 0;
-    /* Get GPIO direction buffer */
-    char directbuf[4];
-
-    /* Activate all GPIO pins */
-    if (!(strncasecmp(info->num_type, "a", strlen("a") + 1))) {
-        for (i = 0; i < info->max_count; i++) {
-            ret = activate_gpio_pin(info->case_id, (info->base_pin + i));
-        }
-    } else if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = activate_gpio_multiple_pin(info->case_id,
-                                        (info->base_pin + info->gpio_pin1),
-                                        (info->base_pin + info->gpio_pin2),
-                                        (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id,
-                               (info->base_pin + info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO direction */
-    if (!(strncasecmp(info->num_type, "a", strlen("a") + 1))) {
-        for (i = 0; i < info->max_count; i++) {
-            ret = get_gpio_direction(info->case_id, (info->base_pin + i),
-                                     directbuf, sizeof(directbuf));
-        }
-    } else if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), directbuf,
-                                 sizeof(directbuf));
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin2), directbuf,
-                                 sizeof(directbuf));
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin3), directbuf,
-                                 sizeof(directbuf));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), directbuf,
-                                 sizeof(directbuf));
-    } else {
-        ret = -EINVAL;
-    }
+    size_t i = 0;
 
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status.*/
-    /* Deactivate all GPIO pins */
-    if (!(strncasecmp(info->num_type, "a", strlen("a") + 1))) {
-        for (i = 0; i < info->max_count; i++) {
-            ret = deactivate_gpio_pin(info->case_id, (info->base_pin + i));
+    for (i = 0; i < sizeof(gpio_cases) / sizeof(gpio_cases[0]); i++) {
+        if (gpio_cases[i].case_id == case_id) {
+            return &gpio_cases[i];
         }
-    } else if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = deactivate_gpio_multiple_pin(info->case_id,
-                                          (info->base_pin + info->gpio_pin1),
-                                          (info->base_pin + info->gpio_pin2),
-                                          (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
     }
 
-    return ret;
+    return NULL;
 }
 
 /**
- * @brief Testrail test case C1034
- *
- * C1034: Generate multiple GPIO Direction Input Request. This test case
- * verifies that multiple GPIO Direction Input Request operations can be
- * executed successfully
+ * @brief Run the test case of info->case_id
  *
  * @param info The GPIO info from user
+ * @param gcase The test case
  * @return 0 on success, error code on failure
  */
-static int ARA_1034_multiple_input(struct gpio_app_info *info)
+static int run_case(struct gpio_app_info *info, const struct gpio_case *gcase)
 {
+    struct gpio_pins pins;
     int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[4];
-    /* Set GPIO direction string */
-    char directbuf[] = "in";
-
-    /* Activate multiple GPIO pins */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = activate_gpio_multiple_pin(info->case_id,
-                                        (info->base_pin + info->gpio_pin1),
-                                        (info->base_pin + info->gpio_pin2),
-                                        (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id,
-                               (info->base_pin + info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
 
-    /* Set GPIO direction is input */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin2), buf, sizeof(buf));
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin3), buf, sizeof(buf));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
+    if (!info->num_type_set) {
+        snprintf(info->num_type, sizeof(info->num_type), "%s",
+                 gcase->default_type);
     }
 
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO direction, and verify GPIO direction is input */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, directbuf);
-        }
-
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin2), buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, directbuf);
-        }
-
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin3), buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, directbuf);
-        }
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, directbuf);
-        }
-    } else {
-        ret = -EINVAL;
+    if (gcase->types == NULL) {
+        return gpio_run_case(&info->engine, gcase, NULL);
     }
 
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate multiple GPIO pins */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = deactivate_gpio_multiple_pin(info->case_id,
-                                          (info->base_pin + info->gpio_pin1),
-                                          (info->base_pin + info->gpio_pin2),
-                                          (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id,
-                                 (info->base_pin + info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
+    ret = select_pins(info, gcase->types, &pins);
+    if (ret) {
+        check_step_result(info->case_id, ret);
+        print_test_result(info->case_id, ret);
+        return ret;
     }
 
-    return ret;
+    return gpio_run_case(&info->engine, gcase, &pins);
 }
 
 /**
- * @brief Testrail test case C1035
+ * @brief Run all test cases of the case list
  *
- * C1035: GPIO direction input request multiple times for the same GPIO line.
- * This test case verifies that multiple GPIO Direction Input Request operations
- * for the same GPIO line do not generate an error message
+ * The Greybus GPIO controller is discovered once by the caller, cases then
+ * run back to back and each one prints its own [A] result line. Pins stay
+ * active from one case to the next while the cases run on the same pins.
  *
  * @param info The GPIO info from user
- * @return 0 on success, error code on failure
+ * @return 0 if all cases passed, else the error code of the first failure
  */
-static int ARA_1035_multiple_times_input(struct gpio_app_info *info)
+static int run_case_list(struct gpio_app_info *info)
 {
-    int ret = 0, i = 0;
-    /* GPIO debugfs buffer */
-    char buf[4];
-    /* Set GPIO direction string */
-    char directbuf[] = "in";
-    /* Testrail test case test 10 times */
-    int test_times = 10;
-
-    /* Activate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is input and set 10 times. */
-    for (i = 0; i < test_times; i++) {
-        if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-            strcpy(buf, directbuf);
-            ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                     info->gpio_pin1), buf, sizeof(buf));
+    const struct gpio_case *gcase = NULL;
+    int ret = 0, case_ret = 0, i = 0;
+
+    for (i = 0; i < info->case_count; i++) {
+        info->case_id = info->case_list[i];
+        gcase = find_case(info->case_id);
+        if (gcase == NULL) {
+            print_test_case_log(LOG_TAG, 0,
+                                "Error: The command had error case_id.");
+            case_ret = -EINVAL;
+            print_test_result(info->case_id, case_ret);
         } else {
-            ret = -EINVAL;
+            case_ret = run_case(info, gcase);
         }
-    }
-
-    check_step_result(info->case_id, ret);
 
-    /* Get GPIO direction, and verify GPIO direction is input */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, directbuf);
+        gpio_step_report(info->case_id);
+        if (case_ret && !ret) {
+            ret = case_ret;
         }
-    } else {
-        ret = -EINVAL;
     }
 
-    print_test_result(info->case_id, ret);
-
     /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
+    /* Only write back the pin state that differs from before the run */
+    case_ret = gpio_engine_restore(&info->engine, info->case_id);
+    check_step_result(info->case_id, case_ret);
 
-    return ret;
+    return ret ? ret : case_ret;
 }
 
 /**
- * @brief Testrail test case C1036
- *
- * C1036: Generate multiple GPIO direction output request. This test case
- * verifies that multiple GPIO Direction Output Request operations can be
- * executed successfully.
+ * @brief The gpiotest main function
  *
- * @param info The GPIO info from user
+ * @param argc The gpiotest main arguments count
+ * @param argv The gpiotest main arguments data
  * @return 0 on success, error code on failure
  */
-static int ARA_1036_multiple_output(struct gpio_app_info *info)
+int main(int argc, char **argv)
 {
-    int ret = 0, i = 0;
-    /* GPIO debugfs buffer */
-    char buf[4];
-    /* Set GPIO direction string */
-    char directbuf[] = "out";
-
-    /* Activate multiple GPIO pins */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = activate_gpio_multiple_pin(info->case_id,
-                                        (info->base_pin + info->gpio_pin1),
-                                        (info->base_pin + info->gpio_pin2),
-                                        (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id,
-                               (info->base_pin + info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin2), buf, sizeof(buf));
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin3), buf, sizeof(buf));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO direction, and verify GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, directbuf);
-        }
-
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin2), buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, directbuf);
-        }
-
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin3), buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, directbuf);
-        }
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, directbuf);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
+    struct gpio_app_info info;
+    int ret = 0, base_pin = 0, max_count = 0, chipnum = -1, i = 0;
 
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate multiple GPIO pins */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = deactivate_gpio_multiple_pin(info->case_id,
-                                          (info->base_pin + info->gpio_pin1),
-                                          (info->base_pin + info->gpio_pin2),
-                                          (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id,
-                                 (info->base_pin + info->gpio_pin1));
-    } else {
+    if (argc < 3) {
+        print_usage();
         ret = -EINVAL;
     }
 
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1037
- *
- * C1037: GPIO direction output request multiple times for the same line. This
- * test case verifies that multiple GPIO Direction Output Request operations for
- * the same GPIO line do not generate an error message
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1037_multiple_times_output(struct gpio_app_info *info)
-{
-    int ret = 0, i = 0;
-    /* GPIO debugfs buffer */
-    char buf[4];
-    /* Set GPIO direction string */
-    char directbuf[] = "out";
-    /* Testrail test case test 10 times */
-    int test_times = 10;
+    default_params(&info);
 
-    /* Activate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
+    /* every step logs, keep it off the console until each case result */
+    if (getenv("FWTEST_LOG_BUFFER") == NULL) {
+        log_set_buffered(1);
     }
 
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output and set 10 times. */
-    for (i = 0; i < test_times; i++) {
-        if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-            strcpy(buf, directbuf);
-            ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                     info->gpio_pin1), buf, sizeof(buf));
-        } else {
+    if (!ret) {
+        if (command_parse(&info, argc, argv)) {
             ret = -EINVAL;
         }
     }
 
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO direction, and verify GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, directbuf);
+    /* 1. Check Greybus GPIO controller */
+    if (!ret) {
+        ret = check_greybus_gpio(&base_pin, &max_count, &chipnum);
+        info.engine.base = base_pin;
+        info.engine.max_count = max_count;
+        info.chipnum = chipnum;
+        check_step_result(info.case_id, ret);
+        /* every listed case still reports its [A] result */
+        for (i = 0; ret && i < info.case_count; i++) {
+            print_test_result(info.case_list[i], ret);
         }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1038
- *
- * C1038: GPIO get response payload returns GPIO line current value. This test
- * case verifies that the GPIO Get Response payload contains a 1-byte value
- * indicating the GPIO Line Value
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1038_get_value(struct gpio_app_info *info)
-{
-    int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[4];
-    /* Set GPIO direction string */
-    char directbuf[] = "in";
-
-    /* activate multiple GPIO pins */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = activate_gpio_multiple_pin(info->case_id,
-                                        (info->base_pin + info->gpio_pin1),
-                                        (info->base_pin + info->gpio_pin2),
-                                        (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id,
-                               (info->base_pin + info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is input */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin2), buf, sizeof(buf));
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin3), buf, sizeof(buf));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO value */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = get_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-        ret = get_gpio_value(info->case_id, (info->base_pin + info->gpio_pin2),
-                             buf, sizeof(buf));
-        ret = get_gpio_value(info->case_id, (info->base_pin + info->gpio_pin3),
-                             buf, sizeof(buf));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate multiple GPIO pins */
-    if (!(strncasecmp(info->num_type, "m", strlen("m") + 1))) {
-        ret = deactivate_gpio_multiple_pin(info->case_id,
-                                          (info->base_pin + info->gpio_pin1),
-                                          (info->base_pin + info->gpio_pin2),
-                                          (info->base_pin + info->gpio_pin3));
-    } else if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id,
-                                 (info->base_pin + info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
     }
 
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1039
- *
- * C1039: Set GPIO line to high. This test case verifies that a given GPIO
- * Line can be set to HIGH using the GPIO Set Request operation.
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1039_set_value_high(struct gpio_app_info *info)
-{
-    int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[4];
-    /* Set GPIO direction string */
-    char directbuf[] = "out";
-    /* Set GPIO value string */
-    char valuebuf[] = "1";
-
-    /* activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO value is 1(high) */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, valuebuf);
-        ret = set_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO direction, and verify GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, directbuf);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO value, and verify GPIO value is 1 */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, valuebuf);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1040
- *
- * C1040: Set GPIO line to low. This test case verifies that a given GPIO Line
- * can be set to LOW using the GPIO Set Request operation
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1040_set_value_low(struct gpio_app_info *info)
-{
-   int ret = 0;
-    char buf[4];                /* GPIO debugfs buffer */
-    char directbuf[] = "out";   /* Set GPIO direction string */
-    char valuebuf[] = "0";      /* Set GPIO value string */
-
-    /* activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO value is 0(low) */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, valuebuf);
-        ret = set_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO direction, and verify GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, directbuf);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-   /* Get GPIO value, and verify GPIO value is 0 */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, valuebuf);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1041
- *
- * C1041: GPIO IRQ type can be set to EDGE_RISING. This test case verifies
- * that the GPIO IRQ Type Response doesn't return an error when setting the GPIO
- * IRQ Type is set to IRQ_TYPE_EDGE_RISING
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1041_set_edge_rising(struct gpio_app_info *info)
-{
-    int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[8];
-    /* Set GPIO direction string */
-    char directbuf[] = "out";
-    /* Set GPIO value string */
-    char valuebuf[] = "1";
-    /* Set GPIO edge string */
-    char edgebuf[] = "rising";
-
-    /* Activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO value is 1(high) */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, valuebuf);
-        ret = set_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is rising */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is rising */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1042
- *
- * C1042: GPIO IRQ type can be set to EDGE_FALLING. This test case verifies
- * that the GPIO IRQ Type Response doesn't return an error when setting the GPIO
- * IRQ Type is set to IRQ_TYPE_EDGE_FALLING.
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1042_set_edge_falling(struct gpio_app_info *info)
-{
-    int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[8];
-    /* Set GPIO direction string */
-    char directbuf[] = "out";
-    /* Set GPIO value string */
-    char valuebuf[] = "1";
-    /* Set GPIO edge string */
-    char edgebuf[] = "falling";
-
-    /* Activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO value is 1(high) */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, valuebuf);
-        ret = set_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is falling */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is falling */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1043
- *
- * C1043: GPIO IRQ type can be set to EDGE_BOTH. This test case verifies that
- * the GPIO IRQ Type Response doesn't return an error when setting the GPIO IRQ
- * Type is set to IRQ_TYPE_EDGE_BOTH.
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1043_set_edge_both(struct gpio_app_info *info)
-{
-    int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[8];
-    /* Set GPIO direction string */
-    char directbuf[] = "out";
-    /* Set GPIO value string */
-    char valuebuf[] = "1";
-    /* Set GPIO edge string */
-    char edgebuf[] = "both";
-
-    /* activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO value is 1(high) */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, valuebuf);
-        ret = set_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is both */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is both */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1044
- *
- * C1044: Change input line to output line. This test case verifies that a
- * previously configure GPIO line as an Input Line can be reconfigured to an
- * Output Line
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1044_input_to_output(struct gpio_app_info *info)
-{
-    int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[4];
-    /* Set GPIO direction string */
-    char directbuf1[] = "in";
-    /* Set GPIO direction string */
-    char directbuf2[] = "out";
-    /* Set GPIO value string */
-    char valuebuf[] = "1";
-
-    /* activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is input */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf1);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO value */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf2);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO value is 1(high) */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, valuebuf);
-        ret = set_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO value, and verify GPIO value is 1 */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, valuebuf);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1045
- *
- * C1045: Change output line to input line. This test case verifies that a
- * previously configure GPIO line as an output line can be reconfigured to an
- * input line
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1045_output_to_input(struct gpio_app_info *info)
-{
-    int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[4];
-    /* Set GPIO direction string */
-    char directbuf1[] = "out";
-    /* Set GPIO direction string */
-    char directbuf2[] = "in";
-    /* Set GPIO value string */
-    char valuebuf[] = "1";
-
-    /* activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf1);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO value is 1(high) */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, valuebuf);
-        ret = set_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is input */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf2);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO value*/
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1046
- *
- * C1046: Change IRQ type from falling edge to rising edge. This test case
- * verifies that the IRQ type can be changed from IRQ_TYPE_EDGE_FALLIN to
- * IRQ_TYPE_EDGE_RISING
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1046_falling_to_rising(struct gpio_app_info *info)
-{
-    int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[8];
-    /* Set GPIO direction string */
-    char directbuf[] = "out";
-    /* Set GPIO value string */
-    char valuebuf[] = "1";
-    /* Set GPIO edge string */
-    char edgebuf1[] = "falling";
-    /* Set GPIO edge string */
-    char edgebuf2[] = "rising";
-
-    /* activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO value is 1(high) */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, valuebuf);
-        ret = set_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is falling */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf1);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is falling */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf1);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is rising */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf2);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is rising */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf2);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1047
- *
- * C1047: Change IRQ type from rising edge to falling edge. This test case
- * verifies that the IRQ type can be changed from IRQ_TYPE_EDGE_RISING to
- * IRQ_TYPE_EDGE_FALLING
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1047_rising_to_falling(struct gpio_app_info *info)
-{
-    int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[8];
-    /* Set GPIO direction string */
-    char directbuf[] = "out";
-    /* Set GPIO value string */
-    char valuebuf[] = "1";
-    /* Set GPIO edge string */
-    char edgebuf1[] = "rising";
-    /* Set GPIO edge string */
-    char edgebuf2[] = "falling";
-
-    /* activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO value is 1(high) */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, valuebuf);
-        ret = set_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is rising */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf1);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is rising */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf1);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is falling */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf2);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is falling */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf2);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1048
- *
- * C1048: Change IRQ type from rising edge to falling edge triggered. This
- * test case verifies that the IRQ type can be changed from IRQ_TYPE_EDGE_RISING
- * to IRQ_TYPE_EDGE_BOTH
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1048_rising_to_both(struct gpio_app_info *info)
-{
-    int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[8];
-    /* Set GPIO direction string */
-    char directbuf[] = "out";
-    /* Set GPIO value string */
-    char valuebuf[] = "1";
-    /* Set GPIO edge string */
-    char edgebuf1[] = "rising";
-    /* Set GPIO edge string */
-    char edgebuf2[] = "both";
-
-    /* activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO value is 1(high) */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, valuebuf);
-        ret = set_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is rising */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf1);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is rising */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf1);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is both */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf2);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is both */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf2);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1049
- *
- * C1049: Change IRQ type from none to rising and falling edge. This test case
- * verifies that the IRQ type can be changed from IRQ_TYPE_NONE to
- * IRQ_TYPE_EDGE_BOTH
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1049_none_to_both(struct gpio_app_info *info)
-{
-    int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[8];
-    /* Set GPIO direction string */
-    char directbuf[] = "out";
-    /* Set GPIO value string */
-    char valuebuf[] = "1";
-    /* Set GPIO edge string */
-    char edgebuf1[] = "none";
-    /* Set GPIO edge string */
-    char edgebuf2[] = "both";
-
-    /* activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO value is 1(high) */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, valuebuf);
-        ret = set_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is none */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf1);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is none */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf1);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is both */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf2);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is both */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf2);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Testrail test case C1050
- *
- * C1050: Change IRQ type from rising and falling edge to none. This test case
- * verifies that the IRQ type can be changed from IRQ_TYPE_EDGE_BOTH to
- * IRQ_TYPE_NONE.
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int ARA_1050_both_to_none(struct gpio_app_info *info)
-{
-    int ret = 0;
-    /* GPIO debugfs buffer */
-    char buf[8];
-    /* Set GPIO direction string */
-    char directbuf[] = "out";
-    /* Set GPIO value string */
-    char valuebuf[] = "1";
-    /* Set GPIO edge string */
-    char edgebuf1[] = "both";
-    /* Set GPIO edge string */
-    char edgebuf2[] = "none";
-
-    /* Activate GPIO pins */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = activate_gpio_pin(info->case_id, (info->base_pin +
-                                info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO direction is output */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, directbuf);
-        ret = set_gpio_direction(info->case_id, (info->base_pin +
-                                 info->gpio_pin1), buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO value is 1(high) */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, valuebuf);
-        ret = set_gpio_value(info->case_id, (info->base_pin + info->gpio_pin1),
-                             buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is both */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf1);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is both */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf1);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Set GPIO edge is none */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        strcpy(buf, edgebuf2);
-        ret = set_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-    } else {
-        ret = -EINVAL;
-    }
-
-    check_step_result(info->case_id, ret);
-
-    /* Get GPIO edge, and verify GPIO edge is none */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = get_gpio_edge(info->case_id, (info->base_pin + info->gpio_pin1),
-                            buf, sizeof(buf));
-        if (!ret) {
-            ret = strcmp(buf, edgebuf2);
-        }
-    } else {
-        ret = -EINVAL;
-    }
-
-    print_test_result(info->case_id, ret);
-
-    /* Post-condition: Recover pre-test status */
-    /* Deactivate GPIO pin */
-    if (!(strncasecmp(info->num_type, "s", strlen("s") + 1))) {
-        ret = deactivate_gpio_pin(info->case_id, (info->base_pin +
-                                  info->gpio_pin1));
-    } else {
-        ret = -EINVAL;
-    }
-
-    return ret;
-}
-
-/**
- * @brief Switch case number and check case number is correct.
- *
- * @param info The GPIO info from user
- * @return 0 on success, error code on failure
- */
-static int switch_case_number(struct gpio_app_info *info)
-{
-        switch (info->case_id) {
-            case 1028:
-                return ARA_1028_get_count(info);
-            case 1029:
-                return ARA_1029_multiple_activate(info);
-            case 1030:
-                return ARA_1030_multiple_deactivate(info);
-            case 1031:
-                return ARA_1031_multiple_direction(info);
-            case 1032:
-                return ARA_1032_multiple_times_direction(info);
-            case 1033:
-                return ARA_1033_all_direction(info);
-            case 1034:
-                return ARA_1034_multiple_input(info);
-            case 1035:
-                return ARA_1035_multiple_times_input(info);
-            case 1036:
-                return ARA_1036_multiple_output(info);
-            case 1037:
-                return ARA_1037_multiple_times_output(info);
-            case 1038:
-                return ARA_1038_get_value(info);
-            case 1039:
-                return ARA_1039_set_value_high(info);
-            case 1040:
-                return ARA_1040_set_value_low(info);
-            case 1041:
-                return ARA_1041_set_edge_rising(info);
-            case 1042:
-                return ARA_1042_set_edge_falling(info);
-            case 1043:
-                return ARA_1043_set_edge_both(info);
-            case 1044:
-                return ARA_1044_input_to_output(info);
-            case 1045:
-                return ARA_1045_output_to_input(info);
-            case 1046:
-                return ARA_1046_falling_to_rising(info);
-            case 1047:
-                return ARA_1047_rising_to_falling(info);
-            case 1048:
-                return ARA_1048_rising_to_both(info);
-            case 1049:
-                return ARA_1049_none_to_both(info);
-            case 1050:
-                return ARA_1050_both_to_none(info);
-            default:
-                print_test_case_log(LOG_TAG, 0,
-                                    "Error: The command had error case_id.");
-                return -EINVAL;
-        }
-}
-
-/**
- * @brief The gpiotest main function
- *
- * @param argc The gpiotest main arguments count
- * @param argv The gpiotest main arguments data
- * @return 0 on success, error code on failure
- */
-int main(int argc, char **argv)
-{
-    struct gpio_app_info info;
-    int ret = 0, base_pin = 0, max_count;
-
-    if (argc < 3) {
-        print_usage();
-        ret = -EINVAL;
-    }
-
-    default_params(&info);
-
-    if (!ret) {
-        if (command_parse(&info, argc, argv)) {
-            ret = -EINVAL;
-        }
-    }
-
-    /* 1. Check Greybus GPIO controller */
-    if (!ret) {
-        ret = check_greybus_gpio(&base_pin, &max_count);
-        info.base_pin = base_pin;
-        info.max_count = max_count;
-        check_step_result(info.case_id, ret);
-    }
-
-    /* 2. Switch test case */
+    /* 2. Run test cases */
     if (!ret) {
-        ret = switch_case_number(&info);
-        check_step_result(info.case_id, ret);
+        gpio_step_timing(info.profile);
+        ret = run_case_list(&info);
     }
 
     return ret;
@@ -30,54 +30,17 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
 
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 
 #include "i2c-task.h"
+#include <libfwtest.h>
 
-/**
- * @brief open I2C devices.
- *
- * @param i2cbus HW I2C bus.
- *
- * @return file The new file descriptor, or -1 if an error occurred.
- */
-int open_i2c_dev(int i2cbus)
-{
-    int file;
-    char devname[MAXLENGTH];
-    size_t size = sizeof(devname);
-
-    snprintf(devname, size, "/dev/i2c-%d", i2cbus);
-    file = open(devname, O_RDWR);
-
-    if (file < 0 && (errno == ENOENT || errno == ENOTDIR))
-    {
-        sprintf(devname, "/dev/i2c/%d", i2cbus);
-        file = open(devname, O_RDWR);
-    }
-
-    return file;
-}
-
-/**
- * @brief set I2C devuce as slave.
- *
- * @param file The file descriptor return from open().
- *
- * @param address The I2C device address.
- *
- * @return 0 for success, -error if fail.
- */
-int force_set_slave_addr(int file, int address)
-{
-    if (ioctl(file, I2C_SLAVE_FORCE, address) < 0) {
-        return -errno;
-    }
-
-    return 0;
-}
+/* Log tag for register dumps and latency reports */
+#define LOG_TAG "I2C"
 
 /**
  * @brief get I2C function support.
@@ -118,9 +81,110 @@ int ARA_1001_i2cgetfunsupport(struct gb_i2c_info *info)
     return ret;
 }
 
+/**
+ * @brief read I2C registers with a separate index write and data read.
+ *
+ * @param file The file descriptor return from open().
+ * @param index The first register index.
+ * @param buf The buffer receiving the register values.
+ * @param len Number of registers to read.
+ *
+ * @return 0 for success, -error if fail.
+ */
+static int i2c_split_read_regs(int file, uint8_t index, uint8_t *buf, int len)
+{
+    ssize_t n;
+
+    n = write(file, &index, 1);
+    if (n != 1) {
+        return n < 0 ? -errno : -EIO;
+    }
+
+    n = read(file, buf, len);
+    if (n != len) {
+        return n < 0 ? -errno : -EIO;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief read I2C registers with the selected mode.
+ *
+ * @param file The file descriptor return from open().
+ * @param info The I2C info from user.
+ * @param mode I2C_MODE_SPLIT or I2C_MODE_RDWR.
+ * @param buf The buffer receiving the register values.
+ *
+ * @return 0 for success, -error if fail.
+ */
+static int i2c_read_regs(int file, struct gb_i2c_info *info, int mode,
+                         uint8_t *buf)
+{
+    if (mode == I2C_MODE_RDWR) {
+        return i2c_rdwr_read_regs(file, info->devaddress,
+                                  (uint8_t)info->addr, buf, info->count);
+    }
+
+    return i2c_split_read_regs(file, (uint8_t)info->addr, buf, info->count);
+}
+
+/**
+ * @brief time the split and combined register reads.
+ *
+ * Runs info->repeat reads with each mode and logs the average latency of
+ * both and the latency saved by the combined I2C_RDWR transaction. The
+ * values read by both modes must match.
+ *
+ * @param file The file descriptor return from open().
+ * @param info The I2C info from user.
+ * @param buf The buffer receiving the register values.
+ *
+ * @return 0 for success, -error if fail.
+ */
+static int i2c_compare_modes(int file, struct gb_i2c_info *info, uint8_t *buf)
+{
+    uint8_t rdwr_buf[MAXLENGTH];
+    uint64_t start, split_ns, rdwr_ns;
+    double split_us, rdwr_us;
+    char logbuf[128];
+    int i, ret = 0;
+
+    start = stats_now_ns();
+    for (i = 0; i < info->repeat && !ret; i++) {
+        ret = i2c_read_regs(file, info, I2C_MODE_SPLIT, buf);
+    }
+    split_ns = stats_now_ns() - start;
+
+    start = stats_now_ns();
+    for (i = 0; i < info->repeat && !ret; i++) {
+        ret = i2c_read_regs(file, info, I2C_MODE_RDWR, rdwr_buf);
+    }
+    rdwr_ns = stats_now_ns() - start;
+
+    if (ret) {
+        return ret;
+    }
+
+    split_us = split_ns / 1000.0 / info->repeat;
+    rdwr_us = rdwr_ns / 1000.0 / info->repeat;
+    snprintf(logbuf, sizeof(logbuf), "count=%d split_avg_us=%.1f "
+             "rdwr_avg_us=%.1f saved_us=%.1f saved_pct=%.1f", info->count,
+             split_us, rdwr_us, split_us - rdwr_us,
+             split_us > 0 ? (split_us - rdwr_us) * 100.0 / split_us : 0.0);
+    print_test_case_log(LOG_TAG, 1002, logbuf);
+    print_test_case_perf(1002, "split_avg", split_us, "us");
+    print_test_case_perf(1002, "rdwr_avg", rdwr_us, "us");
+
+    return memcmp(buf, rdwr_buf, info->count) ? -EIO : 0;
+}
+
 /**
  * @brief read I2C data.
  *
+ * Reads info->count registers starting at info->addr with the mode in
+ * info->mode, and compares the first one with the expected value.
+ *
  * @param info The I2C info from user.
  *
  * @return return the result compare with data and read from HW.
@@ -128,15 +192,18 @@ int ARA_1001_i2cgetfunsupport(struct gb_i2c_info *info)
 int ARA_1002_i2creaddata(struct gb_i2c_info *info)
 {
     int file;
-    int ret ;
-    int size = 1;
-    uint8_t buf[2];
+    int ret;
+    int i, n = 0;
+    uint8_t buf[MAXLENGTH];
+    char logbuf[MAXLENGTH * 4 + 16];
 
     /* check input value. */
     if ((-EINVAL == info->busid) ||
         (-EINVAL == info->devaddress) ||
         (-EINVAL == info->addr) ||
-        (-EINVAL == info->buf))
+        (-EINVAL == info->buf) ||
+        (info->count < 1 || info->count > MAXLENGTH) ||
+        (info->repeat < 1))
     {
         return -ENOINPUT;
     }
@@ -146,18 +213,33 @@ int ARA_1002_i2creaddata(struct gb_i2c_info *info)
         return -1;
     }
 
-    if (force_set_slave_addr(file, info->devaddress) < 0) {
+    ret = force_set_slave_addr(file, info->devaddress);
+    if (ret < 0) {
         close(file);
         return ret;
     }
 
-    buf[0] = (uint8_t)info->addr;
-    write(file, buf,size);
+    trace_call_begin("i2c_read");
+    if (info->mode == I2C_MODE_COMPARE) {
+        ret = i2c_compare_modes(file, info, buf);
+    } else {
+        ret = i2c_read_regs(file, info, info->mode, buf);
+    }
+    trace_call_end("i2c_read");
+    close(file);
 
-    read(file, buf, size);
+    if (ret) {
+        return ret;
+    }
 
-    ret = (buf[0] == (uint8_t)info->buf) ? 0 : -1 ;
+    if (info->count > 1) {
+        n = snprintf(logbuf, sizeof(logbuf), "reg[%d..%d] =", info->addr,
+                     info->addr + info->count - 1);
+        for (i = 0; i < info->count; i++) {
+            n += snprintf(logbuf + n, sizeof(logbuf) - n, " %d", buf[i]);
+        }
+        print_test_case_log(LOG_TAG, 1002, logbuf);
+    }
 
-    close(file);
-    return ret;
+    return (buf[0] == (uint8_t)info->buf) ? 0 : -1;
 }
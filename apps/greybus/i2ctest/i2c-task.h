@@ -37,6 +37,14 @@
 
 #define MAXLENGTH 32
 
+/* Register read modes of case 1002 */
+#define I2C_MODE_SPLIT   0 /* write() register index, then read() */
+#define I2C_MODE_RDWR    1 /* one I2C_RDWR ioctl with two messages */
+#define I2C_MODE_COMPARE 2 /* time both modes and report the savings */
+
+/* Default number of reads per mode in compare mode */
+#define I2C_COMPARE_REPEAT 100
+
 struct gb_i2c_info {
     /** I2C supported function */
     char functionality[MAXLENGTH] ;
@@ -47,6 +55,12 @@ struct gb_i2c_info {
     /** I2C info */
     int addr;
     int buf;
+    /** register read mode, I2C_MODE_* */
+    int mode;
+    /** number of registers read per transaction */
+    int count;
+    /** number of reads per mode in compare mode */
+    int repeat;
 };
 
 int ARA_1001_i2cgetfunsupport(struct gb_i2c_info *info);
@@ -46,19 +46,27 @@
 void print_usage(void)
 {
     printf("\nUsage: i2ctest [-c case_id] [-b bus_id] [-a device_address] "
-           "[-i index] [-d data]\n");
+           "[-i index] [-d data] [-m mode] [-n count] [-r repeat]\n");
     printf("    -c: Testrail test id, support 1001 and 1002.\n");
-    printf("    -b: bus number in decimal integer.\n");
+    printf("    -b: bus number in decimal integer, defaults to the first\n");
+    printf("        Greybus I2C adapter.\n");
     printf("    -a: device address in decimal integer.\n");
     printf("    -i: access the byte address in decimal integer.\n");
     printf("    -d: data need to input in test case.\n");
     printf("        For case 1001, it is support functions.\n");
     printf("        For case 1002, it is the decimal integer that read "
            "from the byte address.\n");
+    printf("    -m: case 1002 read mode: 'split' (write index, then read),\n");
+    printf("        'rdwr' (one combined I2C_RDWR transaction) or\n");
+    printf("        'compare' (time both and report the latency saved).\n");
+    printf("    -n: case 1002 number of registers read per transaction "
+           "(1-%d).\n", MAXLENGTH);
+    printf("    -r: case 1002 reads per mode in compare mode (default %d)."
+           "\n", I2C_COMPARE_REPEAT);
 
     printf("For case 1001, i2ctest -c 1001 [-b bus_id][-d data] \n");
     printf("For case 1002, i2ctest -c 1002 [-b bus_id] [-a device_address] "
-           "[-i index] [-d data] \n\n");
+           "[-i index] [-d data] [-m mode] [-n count] [-r repeat]\n\n");
 }
 
 /**
@@ -77,10 +85,13 @@ int main(int argc, char *argv[])
     i2c_info.devaddress = -EINVAL;
     i2c_info.addr = -EINVAL;
     i2c_info.buf = -EINVAL;
+    i2c_info.mode = I2C_MODE_SPLIT;
+    i2c_info.count = 1;
+    i2c_info.repeat = I2C_COMPARE_REPEAT;
     memset(i2c_info.functionality, 0x00, sizeof(i2c_info.functionality));
 
     /* parse options. */
-    while ((options = getopt (argc, argv, "a:b:c:d:i:")) != OPERROR) {
+    while ((options = getopt (argc, argv, "a:b:c:d:i:m:n:r:")) != OPERROR) {
         switch (options)
         {
             case 'a':
@@ -98,6 +109,24 @@ int main(int argc, char *argv[])
              case 'i':
                 i2c_info.addr = atoi(optarg);
                 break;
+             case 'm':
+                if (!strcmp(optarg, "split")) {
+                    i2c_info.mode = I2C_MODE_SPLIT;
+                } else if (!strcmp(optarg, "rdwr")) {
+                    i2c_info.mode = I2C_MODE_RDWR;
+                } else if (!strcmp(optarg, "compare")) {
+                    i2c_info.mode = I2C_MODE_COMPARE;
+                } else {
+                    print_usage();
+                    return 0;
+                }
+                break;
+             case 'n':
+                i2c_info.count = atoi(optarg);
+                break;
+             case 'r':
+                i2c_info.repeat = atoi(optarg);
+                break;
              case '?':
              default:
                 print_usage();
@@ -105,6 +134,11 @@ int main(int argc, char *argv[])
         }
     }
 
+    /* default to the first Greybus I2C adapter */
+    if (-EINVAL == i2c_info.busid) {
+        gb_find_i2c_adapter(0, &i2c_info.busid);
+    }
+
     switch (caseid)
     {
         case 1001:
@@ -0,0 +1,369 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "./include/libfwtest.h"
+
+/*
+ * fwtestd command protocol, on an AF_UNIX SOCK_SEQPACKET socket. The
+ * client sends one message: a struct agent_msg_hdr, then the working
+ * directory, the arguments and the FWTEST_* environment of the client as
+ * NUL terminated strings, with its stdin, stdout and stderr attached as
+ * SCM_RIGHTS. The test output goes straight to those fds. When the test
+ * ends the daemon replies with its int32_t return value.
+ */
+
+#define AGENT_MAGIC 0x44545746 /* "FWTD" little endian */
+/* Prefix of the environment variables handed to the daemon */
+#define AGENT_ENV_PREFIX "FWTEST_"
+
+struct agent_msg_hdr {
+    uint32_t magic;
+    uint16_t argc;
+    uint16_t nenv;
+    uint32_t len;
+};
+
+/**
+ * @brief Get the fwtestd socket path.
+ *
+ * @return FWTESTD_SOCKET if set, else the default path.
+ */
+const char *agent_socket(void)
+{
+    const char *path = getenv("FWTESTD_SOCKET");
+
+    return (path != NULL && *path) ? path : AGENT_SOCKET;
+}
+
+static int agent_addr(const char *path, struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        return -ENAMETOOLONG;
+    }
+    snprintf(addr->sun_path, sizeof(addr->sun_path), "%s", path);
+
+    return 0;
+}
+
+/**
+ * @brief Create the fwtestd listening socket.
+ *
+ * A stale socket file of an earlier daemon is removed.
+ *
+ * @param path The socket path.
+ * @return socket fd on success, error code on failure.
+ */
+int agent_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    int sock, ret;
+
+    ret = agent_addr(path, &addr);
+    if (ret) {
+        return ret;
+    }
+
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return -errno;
+    }
+
+    unlink(path);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(sock, AGENT_MAX_JOBS)) {
+        ret = -errno;
+        close(sock);
+        return ret;
+    }
+
+    return sock;
+}
+
+/**
+ * @brief Connect to fwtestd.
+ *
+ * @param path The socket path.
+ * @return socket fd on success, error code on failure.
+ */
+int agent_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    int sock, ret;
+
+    ret = agent_addr(path, &addr);
+    if (ret) {
+        return ret;
+    }
+
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return -errno;
+    }
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        ret = -errno;
+        close(sock);
+        return ret;
+    }
+
+    return sock;
+}
+
+static int agent_append(char *buf, size_t *len, const char *s)
+{
+    size_t n = strlen(s) + 1;
+
+    if (*len + n > AGENT_MSG_LEN) {
+        return -E2BIG;
+    }
+    memcpy(buf + *len, s, n);
+    *len += n;
+
+    return 0;
+}
+
+/**
+ * @brief Send a test command to fwtestd.
+ *
+ * @param sock The socket from agent_connect().
+ * @param argc Number of arguments, argv[0] names the test app.
+ * @param argv The arguments.
+ * @param envp The environment, only the FWTEST_* variables are sent.
+ * @return 0 on success, error code on failure.
+ */
+int agent_send_cmd(int sock, int argc, char **argv, char **envp)
+{
+    static char buf[AGENT_MSG_LEN];
+    char cwd[AGENT_CWD_LEN], cbuf[CMSG_SPACE(3 * sizeof(int))];
+    int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    struct agent_msg_hdr hdr;
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    struct iovec iov[2];
+    size_t len = 0;
+    int i, ret = 0;
+
+    if (argc < 1 || argc > AGENT_MAX_ARGS) {
+        return -E2BIG;
+    }
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        snprintf(cwd, sizeof(cwd), "/");
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = AGENT_MAGIC;
+    hdr.argc = argc;
+    ret = agent_append(buf, &len, cwd);
+    for (i = 0; i < argc && !ret; i++) {
+        ret = agent_append(buf, &len, argv[i]);
+    }
+    for (i = 0; envp != NULL && envp[i] != NULL && !ret; i++) {
+        if (strncmp(envp[i], AGENT_ENV_PREFIX, strlen(AGENT_ENV_PREFIX)) ||
+            hdr.nenv >= AGENT_MAX_ENV) {
+            continue;
+        }
+        ret = agent_append(buf, &len, envp[i]);
+        hdr.nenv++;
+    }
+    if (ret) {
+        return ret;
+    }
+    hdr.len = len;
+
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = buf;
+    iov[1].iov_len = len;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(cbuf, 0, sizeof(cbuf));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (sendmsg(sock, &msg, MSG_NOSIGNAL) < 0) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+static void close_fds(int *fds, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+            fds[i] = -1;
+        }
+    }
+}
+
+/**
+ * @brief Receive a test command in fwtestd.
+ *
+ * @param sock The accepted client socket.
+ * @param cmd Returns the command, the strings point into cmd->buf. On
+ * success the caller closes the fds, on failure they are already closed.
+ * @return 0 on success, error code on failure.
+ */
+int agent_recv_cmd(int sock, struct agent_cmd *cmd)
+{
+    char cbuf[CMSG_SPACE(3 * sizeof(int))];
+    struct agent_msg_hdr hdr;
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    struct iovec iov[2];
+    char *p, *end;
+    ssize_t n;
+    int i;
+
+    memset(cmd, 0, offsetof(struct agent_cmd, buf));
+    cmd->fds[0] = cmd->fds[1] = cmd->fds[2] = -1;
+
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = cmd->buf;
+    iov[1].iov_len = sizeof(cmd->buf) - 1;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 0) {
+        return -errno;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET ||
+            cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        if (cmsg->cmsg_len == CMSG_LEN(sizeof(cmd->fds)) &&
+            cmd->fds[0] < 0) {
+            memcpy(cmd->fds, CMSG_DATA(cmsg), sizeof(cmd->fds));
+        } else {
+            /* not the stdio triple we expect, don't keep them open */
+            close_fds((int *)CMSG_DATA(cmsg),
+                      (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        }
+    }
+
+    if (n < (ssize_t)sizeof(hdr) || hdr.magic != AGENT_MAGIC ||
+        hdr.len != n - sizeof(hdr) || !hdr.argc ||
+        hdr.argc > AGENT_MAX_ARGS || hdr.nenv > AGENT_MAX_ENV ||
+        (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || cmd->fds[2] < 0) {
+        close_fds(cmd->fds, 3);
+        return -EPROTO;
+    }
+
+    /* cwd, then argc arguments, then nenv variables */
+    cmd->buf[hdr.len] = '\0';
+    end = cmd->buf + hdr.len;
+    p = cmd->buf;
+    for (i = 0; i < 1 + hdr.argc + hdr.nenv; i++) {
+        if (p >= end) {
+            close_fds(cmd->fds, 3);
+            return -EPROTO;
+        }
+        if (!i) {
+            cmd->cwd = p;
+        } else if (i <= hdr.argc) {
+            cmd->argv[cmd->argc++] = p;
+        } else {
+            cmd->env[cmd->nenv++] = p;
+        }
+        p += strlen(p) + 1;
+    }
+    cmd->argv[cmd->argc] = NULL;
+
+    return 0;
+}
+
+/**
+ * @brief Send the return value of a test to the client.
+ *
+ * @param sock The client socket.
+ * @param status The return value of the test app main().
+ * @return 0 on success, error code on failure.
+ */
+int agent_send_status(int sock, int status)
+{
+    int32_t value = status;
+
+    if (send(sock, &value, sizeof(value), MSG_NOSIGNAL) != sizeof(value)) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Wait for the return value of a test.
+ *
+ * @param sock The socket from agent_connect().
+ * @param status Returns the return value of the test app main().
+ * @return 0 on success, error code on failure.
+ */
+int agent_recv_status(int sock, int *status)
+{
+    int32_t value = 0;
+    ssize_t n;
+
+    do {
+        n = recv(sock, &value, sizeof(value), 0);
+    } while (n < 0 && errno == EINTR);
+
+    if (n != sizeof(value)) {
+        return n < 0 ? -errno : -ECONNRESET;
+    }
+
+    *status = value;
+    return 0;
+}
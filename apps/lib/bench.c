@@ -0,0 +1,531 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <linux/limits.h>
+
+#include "./include/libfwtest.h"
+
+/*
+ * Benchmark environment: CPU affinity, SCHED_FIFO, locked memory and
+ * cpufreq limits, so perf numbers do not move with DVFS and migration.
+ * FWTEST_BENCH applies a spec to any app before main() and restores the
+ * cpufreq settings at exit; the first [P] line records what was in
+ * effect.
+ */
+
+#define CPU_DIR "/sys/devices/system/cpu"
+
+static struct bench_env bench_global;
+static char bench_reported;
+
+/**
+ * @brief Parse a CPU list, e.g. 0-3 or 1+3.
+ *
+ * @param list The list.
+ * @param mask Returns the CPU mask.
+ * @return 0 on success, -EINVAL on bad list.
+ */
+static int parse_cpus(const char *list, uint64_t *mask)
+{
+    char *end = NULL;
+    long first, last;
+
+    *mask = 0;
+    while (*list) {
+        first = strtol(list, &end, 10);
+        last = first;
+        if (end == list) {
+            return -EINVAL;
+        }
+        if (*end == '-') {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+            if (end == list) {
+                return -EINVAL;
+            }
+        }
+        if (first < 0 || last < first || last >= BENCH_MAX_CPUS) {
+            return -EINVAL;
+        }
+        for (; first <= last; first++) {
+            *mask |= 1ULL << first;
+        }
+        if (*end == '+') {
+            end++;
+        } else if (*end) {
+            return -EINVAL;
+        }
+        list = end;
+    }
+
+    return *mask ? 0 : -EINVAL;
+}
+
+/**
+ * @brief Parse a benchmark environment spec.
+ *
+ * Comma separated keys: cpus=LIST pins to the CPUs of LIST (0-3, 1+3),
+ * fifo=PRIO runs SCHED_FIFO, mlock locks all memory, governor=NAME,
+ * min=KHZ, max=KHZ and freq=KHZ set the cpufreq policies of the pinned
+ * CPUs (all CPUs without cpus), report only records the environment.
+ *
+ * @param env The environment to fill, cleared first.
+ * @param spec The spec.
+ * @return 0 on success, -EINVAL on bad spec.
+ */
+int bench_env_parse(struct bench_env *env, const char *spec)
+{
+    char buf[256];
+    char *tok, *save = NULL, *value;
+    long khz;
+
+    memset(env, 0, sizeof(*env));
+    snprintf(buf, sizeof(buf), "%s", spec);
+
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        value = strchr(tok, '=');
+        if (value != NULL) {
+            *value++ = '\0';
+        }
+        khz = value != NULL ? atol(value) : 0;
+
+        if (!strcmp(tok, "cpus") && value != NULL) {
+            if (parse_cpus(value, &env->cpus)) {
+                return -EINVAL;
+            }
+        } else if (!strcmp(tok, "fifo") && value != NULL) {
+            env->fifo = atoi(value);
+            if (env->fifo < 1 || env->fifo > 99) {
+                return -EINVAL;
+            }
+        } else if (!strcmp(tok, "mlock") && value == NULL) {
+            env->mlock = 1;
+        } else if (!strcmp(tok, "governor") && value != NULL && *value) {
+            snprintf(env->governor, sizeof(env->governor), "%s", value);
+        } else if (!strcmp(tok, "min") && khz > 0) {
+            env->min_khz = khz;
+        } else if (!strcmp(tok, "max") && khz > 0) {
+            env->max_khz = khz;
+        } else if (!strcmp(tok, "freq") && khz > 0) {
+            env->min_khz = khz;
+            env->max_khz = khz;
+        } else if (strcmp(tok, "report") || value != NULL) {
+            return -EINVAL;
+        }
+    }
+
+    if (env->min_khz && env->max_khz && env->min_khz > env->max_khz) {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+/* write a whole string to a sysfs file, only async-signal-safe calls */
+static int write_file(const char *path, const char *value)
+{
+    int fd, ret = 0;
+
+    fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+    if (write(fd, value, strlen(value)) < 0) {
+        ret = -errno;
+    }
+    close(fd);
+
+    return ret;
+}
+
+static int read_file(const char *path, char *value, int len)
+{
+    int fd, n;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+    n = read(fd, value, len - 1);
+    close(fd);
+    if (n < 0) {
+        return -errno;
+    }
+    value[n] = '\0';
+    value[strcspn(value, "\n")] = '\0';
+
+    return 0;
+}
+
+static int policy_attr(const struct bench_cpufreq *pol, const char *attr,
+                       char *value, int len)
+{
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s", pol->dir, attr);
+    return read_file(path, value, len);
+}
+
+/**
+ * @brief Set the limits of a cpufreq policy.
+ *
+ * The new min may be above the old max, or the new max below the old
+ * min; writing min, max and min again gets there either way.
+ *
+ * @param pol The policy.
+ * @param governor Governor, "" to keep it.
+ * @param min Min frequency in kHz as a string, "" to keep it.
+ * @param max Max frequency in kHz as a string, "" to keep it.
+ * @return 0 on success, -errno of the last failed write.
+ */
+static int policy_set(const struct bench_cpufreq *pol, const char *governor,
+                      const char *min, const char *max)
+{
+    char path[3][PATH_MAX];
+    int ret = 0, err = 0;
+
+    /* no snprintf(), this also runs in bench_signal() */
+    memcpy(path[0], pol->dir, sizeof(pol->dir));
+    strcat(path[0], "/scaling_governor");
+    memcpy(path[1], pol->dir, sizeof(pol->dir));
+    strcat(path[1], "/scaling_min_freq");
+    memcpy(path[2], pol->dir, sizeof(pol->dir));
+    strcat(path[2], "/scaling_max_freq");
+
+    if (governor[0]) {
+        ret = write_file(path[0], governor);
+    }
+    if (min[0]) {
+        write_file(path[1], min);
+    }
+    if (max[0]) {
+        err = write_file(path[2], max);
+        ret = err ? err : ret;
+    }
+    if (min[0]) {
+        err = write_file(path[1], min);
+        ret = err ? err : ret;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Find the cpufreq policies of the CPUs in mask.
+ *
+ * @param env The environment, policies filled.
+ * @param mask CPUs, 0 for all.
+ */
+static void find_policies(struct bench_env *env, uint64_t mask)
+{
+    char path[PATH_MAX], dir[PATH_MAX], cpus[256];
+    struct bench_cpufreq *pol;
+    char *tok, *save = NULL;
+    int cpu, i, dup;
+
+    env->npolicies = 0;
+    for (cpu = 0; cpu < BENCH_MAX_CPUS &&
+         env->npolicies < BENCH_MAX_POLICIES; cpu++) {
+        if (mask && !(mask & (1ULL << cpu))) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/cpu%d/cpufreq", CPU_DIR, cpu);
+        if (realpath(path, dir) == NULL ||
+            strlen(dir) >= sizeof(pol->dir)) {
+            continue;
+        }
+
+        /* CPUs of one cluster share the policy */
+        for (i = 0, dup = 0; i < env->npolicies; i++) {
+            dup |= !strcmp(env->policies[i].dir, dir);
+        }
+        if (dup) {
+            continue;
+        }
+
+        pol = &env->policies[env->npolicies++];
+        memset(pol, 0, sizeof(*pol));
+        memcpy(pol->dir, dir, strlen(dir) + 1);
+        pol->cpu = cpu;
+        if (!policy_attr(pol, "related_cpus", cpus, sizeof(cpus))) {
+            for (tok = strtok_r(cpus, " ", &save); tok != NULL;
+                 tok = strtok_r(NULL, " ", &save)) {
+                if (atoi(tok) < BENCH_MAX_CPUS) {
+                    pol->cpus |= 1ULL << atoi(tok);
+                }
+            }
+        }
+        policy_attr(pol, "scaling_governor", pol->governor,
+                    sizeof(pol->governor));
+        policy_attr(pol, "scaling_min_freq", pol->min, sizeof(pol->min));
+        policy_attr(pol, "scaling_max_freq", pol->max, sizeof(pol->max));
+    }
+}
+
+/**
+ * @brief Apply a benchmark environment to the calling thread.
+ *
+ * Affinity and scheduling policy are inherited by the threads created
+ * after it, cpufreq changes are system wide until bench_env_restore().
+ * Goes on after a failure, so as much as possible is in effect.
+ *
+ * @param env The parsed environment, the previous settings are saved in
+ * it.
+ * @return 0 on success, -errno of the last failure.
+ */
+int bench_env_apply(struct bench_env *env)
+{
+    struct sched_param param;
+    char min[16] = "", max[16] = "";
+    cpu_set_t set;
+    int cpu, i, err, ret = 0;
+
+    if (env->cpus) {
+        CPU_ZERO(&set);
+        for (cpu = 0; cpu < BENCH_MAX_CPUS; cpu++) {
+            if (env->cpus & (1ULL << cpu)) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        if (sched_setaffinity(0, sizeof(set), &set)) {
+            ret = -errno;
+        }
+    }
+
+    if (env->fifo) {
+        env->old_policy = sched_getscheduler(0);
+        sched_getparam(0, &param);
+        env->old_priority = param.sched_priority;
+        param.sched_priority = env->fifo;
+        if (sched_setscheduler(0, SCHED_FIFO, &param)) {
+            ret = -errno;
+        } else {
+            env->fifo_set = 1;
+        }
+    }
+
+    if (env->mlock) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+            ret = -errno;
+        } else {
+            env->mlock_set = 1;
+        }
+    }
+
+    find_policies(env, env->cpus);
+    env->active = 1;
+    if (!env->governor[0] && !env->min_khz && !env->max_khz) {
+        return ret;
+    }
+
+    if (env->min_khz) {
+        snprintf(min, sizeof(min), "%ld", env->min_khz);
+    }
+    if (env->max_khz) {
+        snprintf(max, sizeof(max), "%ld", env->max_khz);
+    }
+    for (i = 0; i < env->npolicies; i++) {
+        err = policy_set(&env->policies[i], env->governor, min, max);
+        ret = err ? err : ret;
+    }
+    env->cpufreq_set = 1;
+
+    return ret;
+}
+
+/**
+ * @brief Restore what bench_env_apply() changed.
+ *
+ * Only async-signal-safe calls, it also runs from a signal handler.
+ *
+ * @param env The applied environment.
+ */
+void bench_env_restore(struct bench_env *env)
+{
+    struct sched_param param;
+    int i;
+
+    if (env->cpufreq_set) {
+        for (i = 0; i < env->npolicies; i++) {
+            policy_set(&env->policies[i], env->policies[i].governor,
+                       env->policies[i].min, env->policies[i].max);
+        }
+        env->cpufreq_set = 0;
+    }
+    if (env->mlock_set) {
+        munlockall();
+        env->mlock_set = 0;
+    }
+    if (env->fifo_set) {
+        param.sched_priority = env->old_priority;
+        sched_setscheduler(0, env->old_policy, &param);
+        env->fifo_set = 0;
+    }
+}
+
+/**
+ * @brief Record the benchmark environment in effect.
+ *
+ * A [D] line and [P] values of the affinity, scheduling, locked memory
+ * and the governor and frequencies of every cpufreq policy, read back
+ * from the system, not taken from the spec.
+ *
+ * @param env The environment, its policies found by bench_env_apply().
+ * @param case_id Testrail test case ID of the lines.
+ */
+void bench_env_report(const struct bench_env *env, int case_id)
+{
+    char logbuf[256], metric[48], governor[BENCH_GOVERNOR_LEN];
+    char min[16], max[16], cur[16];
+    struct sched_param param;
+    uint64_t mask = 0;
+    cpu_set_t set;
+    int cpu, i, policy;
+
+    if (!sched_getaffinity(0, sizeof(set), &set)) {
+        for (cpu = 0; cpu < BENCH_MAX_CPUS; cpu++) {
+            mask |= CPU_ISSET(cpu, &set) ? 1ULL << cpu : 0;
+        }
+    }
+    policy = sched_getscheduler(0);
+    sched_getparam(0, &param);
+
+    snprintf(logbuf, sizeof(logbuf), "Bench environment: cpus=0x%llx "
+             "sched=%s prio=%d mlock=%d", (unsigned long long)mask,
+             policy == SCHED_FIFO ? "fifo" : policy == SCHED_RR ? "rr" :
+             "other", param.sched_priority, env->mlock_set);
+    print_test_case_log("bench", case_id, logbuf);
+    print_test_case_perf(case_id, "bench_cpus", mask, "mask");
+    print_test_case_perf(case_id, "bench_fifo",
+                         policy == SCHED_FIFO ? param.sched_priority : 0,
+                         "prio");
+    print_test_case_perf(case_id, "bench_mlock", env->mlock_set, "flag");
+
+    for (i = 0; i < env->npolicies; i++) {
+        const struct bench_cpufreq *pol = &env->policies[i];
+
+        if (policy_attr(pol, "scaling_governor", governor,
+                        sizeof(governor)) ||
+            policy_attr(pol, "scaling_min_freq", min, sizeof(min)) ||
+            policy_attr(pol, "scaling_max_freq", max, sizeof(max))) {
+            continue;
+        }
+        if (policy_attr(pol, "scaling_cur_freq", cur, sizeof(cur))) {
+            snprintf(cur, sizeof(cur), "0");
+        }
+
+        snprintf(logbuf, sizeof(logbuf), "Bench cpufreq cpus=0x%llx "
+                 "governor=%s min=%s max=%s cur=%s kHz",
+                 (unsigned long long)pol->cpus, governor, min, max, cur);
+        print_test_case_log("bench", case_id, logbuf);
+        snprintf(metric, sizeof(metric), "bench_cpu%d_min", pol->cpu);
+        print_test_case_perf(case_id, metric, atol(min), "kHz");
+        snprintf(metric, sizeof(metric), "bench_cpu%d_max", pol->cpu);
+        print_test_case_perf(case_id, metric, atol(max), "kHz");
+        snprintf(metric, sizeof(metric), "bench_cpu%d_cur", pol->cpu);
+        print_test_case_perf(case_id, metric, atol(cur), "kHz");
+    }
+}
+
+/**
+ * @brief Record the FWTEST_BENCH environment, once.
+ *
+ * Called by print_test_case_perf() before the first [P] line.
+ *
+ * @param case_id Testrail test case ID of the lines.
+ */
+void bench_env_note(int case_id)
+{
+    if (!bench_global.active ||
+        __atomic_test_and_set(&bench_reported, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    bench_env_report(&bench_global, case_id);
+}
+
+static void bench_exit(void)
+{
+    bench_env_restore(&bench_global);
+}
+
+static void bench_signal(int sig)
+{
+    bench_env_restore(&bench_global);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/**
+ * @brief Apply FWTEST_BENCH before main().
+ *
+ * Runs as a constructor, so the main thread and every thread the app
+ * creates get the affinity and priority. cpufreq settings are restored
+ * at exit, and on SIGINT, SIGTERM and SIGHUP unless the app handles
+ * those.
+ */
+static void __attribute__((constructor)) bench_init(void)
+{
+    const char *spec = getenv("FWTEST_BENCH");
+    char logbuf[64];
+    int ret;
+
+    if (spec == NULL || !*spec) {
+        return;
+    }
+
+    if (bench_env_parse(&bench_global, spec)) {
+        print_test_case_log("bench", 0, "Bad FWTEST_BENCH, ignored");
+        return;
+    }
+
+    ret = bench_env_apply(&bench_global);
+    if (ret) {
+        snprintf(logbuf, sizeof(logbuf), "FWTEST_BENCH partly applied: %s",
+                 strerror(-ret));
+        print_test_case_log("bench", 0, logbuf);
+    }
+
+    if (bench_global.cpufreq_set) {
+        atexit(bench_exit);
+        signal(SIGINT, bench_signal);
+        signal(SIGTERM, bench_signal);
+        signal(SIGHUP, bench_signal);
+    }
+}
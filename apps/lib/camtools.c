@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/videodev2.h>
+
+#include "./include/libfwtest.h"
+
+/**
+ * @brief open V4L2 video capture device.
+ *
+ * The node is opened non blocking, callers wait for frames with poll().
+ *
+ * @param path The video device node.
+ *
+ * @return file The new file descriptor, or -1 if an error occurred.
+ */
+int open_video_dev(const char *path)
+{
+    return open(path, O_RDWR | O_NONBLOCK);
+}
+
+/**
+ * @brief add the sizes of one pixel format to a mode list.
+ *
+ * Stepwise and continuous ranges add their smallest and largest size.
+ *
+ * @param file The file descriptor return from open_video_dev().
+ * @param pixelformat The pixel format.
+ * @param modes The mode list.
+ * @param n Number of modes already in the list.
+ * @param max The mode list size.
+ *
+ * @return the new number of modes in the list.
+ */
+static int enum_sizes(int file, uint32_t pixelformat, struct cam_mode *modes,
+                      int n, int max)
+{
+    struct v4l2_frmsizeenum fsize;
+
+    memset(&fsize, 0, sizeof(fsize));
+    fsize.pixel_format = pixelformat;
+
+    while (n < max && ioctl(file, VIDIOC_ENUM_FRAMESIZES, &fsize) == 0) {
+        modes[n].pixelformat = pixelformat;
+        if (fsize.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+            modes[n].width = fsize.discrete.width;
+            modes[n].height = fsize.discrete.height;
+            n++;
+        } else {
+            modes[n].width = fsize.stepwise.min_width;
+            modes[n].height = fsize.stepwise.min_height;
+            n++;
+            if (n < max) {
+                modes[n].pixelformat = pixelformat;
+                modes[n].width = fsize.stepwise.max_width;
+                modes[n].height = fsize.stepwise.max_height;
+                n++;
+            }
+            break;
+        }
+        fsize.index++;
+    }
+
+    return n;
+}
+
+/**
+ * @brief list the capture modes of a V4L2 device.
+ *
+ * A mode is a pixel format and frame size of the single planar video
+ * capture queue. A format without size enumeration is listed with the
+ * size VIDIOC_G_FMT reports for it.
+ *
+ * @param file The file descriptor return from open_video_dev().
+ * @param modes Returns the modes.
+ * @param max The mode list size.
+ *
+ * @return number of modes, or -error if fail.
+ */
+int cam_enum_modes(int file, struct cam_mode *modes, int max)
+{
+    struct v4l2_fmtdesc desc;
+    struct v4l2_format fmt;
+    int n = 0, before = 0;
+
+    memset(&desc, 0, sizeof(desc));
+    desc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    while (n < max && ioctl(file, VIDIOC_ENUM_FMT, &desc) == 0) {
+        before = n;
+        n = enum_sizes(file, desc.pixelformat, modes, n, max);
+        if (n == before) {
+            memset(&fmt, 0, sizeof(fmt));
+            fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            if (ioctl(file, VIDIOC_G_FMT, &fmt) < 0) {
+                return -errno;
+            }
+            modes[n].pixelformat = desc.pixelformat;
+            modes[n].width = fmt.fmt.pix.width;
+            modes[n].height = fmt.fmt.pix.height;
+            n++;
+        }
+        desc.index++;
+    }
+
+    if (!n && errno != EINVAL) {
+        return -errno;
+    }
+
+    return n;
+}
+
+/**
+ * @brief format a pixel format as its four character code.
+ *
+ * @param pixelformat The pixel format.
+ * @param buf Returns the code, at least 5 bytes.
+ *
+ * @return buf.
+ */
+char *cam_fourcc(uint32_t pixelformat, char *buf)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        buf[i] = (pixelformat >> (8 * i)) & 0xff;
+        if (buf[i] == ' ' || buf[i] < 0x20 || buf[i] > 0x7e) {
+            buf[i] = '_';
+        }
+    }
+    buf[4] = '\0';
+
+    return buf;
+}
@@ -0,0 +1,786 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <strings.h>
+#include <linux/limits.h>
+
+#include "./include/libfwtest.h"
+
+/* Default discovery cache file, FWTEST_CACHE_FILE overrides it */
+#define GB_CACHE_FILE "/data/local/tmp/fwtest_discovery.cache"
+
+#define GB_GPIO_CLASS   "/sys/class/gpio"
+#define GB_I2C_DEVICES  "/sys/bus/i2c/devices"
+#define GB_BUS_DEVICES  "/sys/bus/greybus/devices"
+#define GB_BOOT_ID      "/proc/sys/kernel/random/boot_id"
+#define GB_BLOCK_CLASS  "/sys/block"
+#define GB_SPIDEV_CLASS "/sys/class/spidev"
+#define GB_TTY_CLASS    "/sys/class/tty"
+#define GB_VIDEO_CLASS  "/sys/class/video4linux"
+#define GB_SOUND_CLASS  "/sys/class/sound"
+#define GB_LOOPBACK_CLASS "/sys/class/gb_loopback"
+#define GB_PWM_CLASS    "/sys/class/pwm"
+
+/* The greybus gpio and i2c drivers register their controllers with these */
+#define GB_GPIO_LABEL   "greybus_gpio"
+#define GB_I2C_NAME     "greybus"
+#define GB_TTY_NAME     "ttyGB"
+
+static struct gb_discovery discovery;
+static int discovery_valid;
+
+/**
+ * @brief Build the discovery cache key
+ *
+ * The key combines the boot id with a signature of the greybus device
+ * list, so it changes on reboot and whenever an interface or bundle comes
+ * or goes. GPIO exports and other unrelated uevents leave it unchanged.
+ *
+ * @param key The key buffer
+ * @param len The key buffer size
+ * @return None
+ */
+static void build_cache_key(char *key, int len)
+{
+    char boot_id[64] = "none";
+    uint32_t sig = 5381;
+    DIR *fdir;
+    struct dirent *ptr;
+    const char *c;
+    FILE *fp;
+
+    fp = fopen(GB_BOOT_ID, "r");
+    if (fp != NULL) {
+        if (fscanf(fp, "%63s", boot_id) != 1) {
+            snprintf(boot_id, sizeof(boot_id), "none");
+        }
+        fclose(fp);
+    }
+
+    fdir = opendir(GB_BUS_DEVICES);
+    if (fdir != NULL) {
+        while ((ptr = readdir(fdir)) != NULL) {
+            for (c = ptr->d_name; *c; c++) {
+                sig = sig * 33 + (uint8_t)*c;
+            }
+            sig = sig * 33 + '/';
+        }
+        closedir(fdir);
+    }
+
+    snprintf(key, len, "%s-%08x", boot_id, sig);
+}
+
+/**
+ * @brief Find the /dev/gpiochipN index of a GPIO controller
+ *
+ * @param chip_path The sysfs path of the controller
+ * @return chip index on success, -1 if the kernel has no gpio chardev
+ */
+static int find_gpio_chipnum(const char *chip_path)
+{
+    char path[PATH_MAX];
+    DIR *fdir;
+    struct dirent *ptr;
+    int chipnum = -1;
+
+    if (snprintf(path, sizeof(path), "%s/device", chip_path) >=
+        (int)sizeof(path)) {
+        return -1;
+    }
+    fdir = opendir(path);
+    if (fdir == NULL) {
+        return -1;
+    }
+
+    while ((ptr = readdir(fdir)) != NULL) {
+        if (sscanf(ptr->d_name, "gpiochip%d", &chipnum) == 1) {
+            break;
+        }
+        chipnum = -1;
+    }
+    closedir(fdir);
+
+    return chipnum;
+}
+
+/**
+ * @brief Scan sysfs for Greybus GPIO controllers
+ *
+ * @param disc The discovery result
+ * @return None
+ */
+static void scan_gpio_chips(struct gb_discovery *disc)
+{
+    char path[PATH_MAX], buf[32];
+    struct gb_gpio_chip *chip, tmp;
+    DIR *fdir;
+    struct dirent *ptr;
+    int i, j;
+
+    fdir = opendir(GB_GPIO_CLASS);
+    if (fdir == NULL) {
+        return;
+    }
+
+    while ((ptr = readdir(fdir)) != NULL &&
+           disc->ngpio_chips < GB_MAX_GPIO_CHIPS) {
+        if (ptr->d_type != DT_LNK || strncmp(ptr->d_name, "gpiochip", 8)) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", GB_GPIO_CLASS, ptr->d_name);
+        if (debugfs_get_attr(path, "label", buf, sizeof(buf)) ||
+            strcmp(buf, GB_GPIO_LABEL)) {
+            continue;
+        }
+
+        chip = &disc->gpio_chips[disc->ngpio_chips];
+        if (debugfs_get_attr(path, "base", buf, sizeof(buf))) {
+            continue;
+        }
+        chip->base = atoi(buf);
+        if (debugfs_get_attr(path, "ngpio", buf, sizeof(buf))) {
+            continue;
+        }
+        chip->ngpio = atoi(buf);
+        chip->chipnum = find_gpio_chipnum(path);
+        disc->ngpio_chips++;
+    }
+    closedir(fdir);
+
+    /* lookups by index follow the GPIO number order */
+    for (i = 1; i < disc->ngpio_chips; i++) {
+        tmp = disc->gpio_chips[i];
+        for (j = i; j > 0 && disc->gpio_chips[j - 1].base > tmp.base; j--) {
+            disc->gpio_chips[j] = disc->gpio_chips[j - 1];
+        }
+        disc->gpio_chips[j] = tmp;
+    }
+}
+
+/**
+ * @brief Scan sysfs for Greybus I2C adapters
+ *
+ * @param disc The discovery result
+ * @return None
+ */
+static void scan_i2c_adapters(struct gb_discovery *disc)
+{
+    char path[PATH_MAX], buf[64];
+    DIR *fdir;
+    struct dirent *ptr;
+    int busid, i, j;
+
+    fdir = opendir(GB_I2C_DEVICES);
+    if (fdir == NULL) {
+        return;
+    }
+
+    while ((ptr = readdir(fdir)) != NULL &&
+           disc->ni2c_adapters < GB_MAX_I2C_ADAPTERS) {
+        if (sscanf(ptr->d_name, "i2c-%d", &busid) != 1) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", GB_I2C_DEVICES, ptr->d_name);
+        if (debugfs_get_attr(path, "name", buf, sizeof(buf)) ||
+            strncasecmp(buf, GB_I2C_NAME, strlen(GB_I2C_NAME))) {
+            continue;
+        }
+
+        disc->i2c_busid[disc->ni2c_adapters++] = busid;
+    }
+    closedir(fdir);
+
+    for (i = 1; i < disc->ni2c_adapters; i++) {
+        busid = disc->i2c_busid[i];
+        for (j = i; j > 0 && disc->i2c_busid[j - 1] > busid; j--) {
+            disc->i2c_busid[j] = disc->i2c_busid[j - 1];
+        }
+        disc->i2c_busid[j] = busid;
+    }
+}
+
+/**
+ * @brief Scan the greybus bus for bundles
+ *
+ * @param disc The discovery result
+ * @return None
+ */
+static void scan_bundles(struct gb_discovery *disc)
+{
+    char path[PATH_MAX], buf[16];
+    struct gb_bundle *bundle;
+    DIR *fdir;
+    struct dirent *ptr;
+
+    fdir = opendir(GB_BUS_DEVICES);
+    if (fdir == NULL) {
+        return;
+    }
+
+    while ((ptr = readdir(fdir)) != NULL &&
+           disc->nbundles < GB_MAX_BUNDLES) {
+        /* bundle names are short, anything longer is not a bundle */
+        if (ptr->d_name[0] == '.' ||
+            strlen(ptr->d_name) >= sizeof(bundle->name)) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", GB_BUS_DEVICES, ptr->d_name);
+        if (debugfs_get_attr(path, "bundle_class", buf, sizeof(buf))) {
+            continue;
+        }
+
+        bundle = &disc->bundles[disc->nbundles++];
+        memcpy(bundle->name, ptr->d_name, strlen(ptr->d_name) + 1);
+        bundle->class_id = (int)strtol(buf, NULL, 0);
+    }
+    closedir(fdir);
+}
+
+/**
+ * @brief Get the discovery cache file name
+ *
+ * @return cache file path
+ */
+static const char *cache_file(void)
+{
+    const char *file = getenv("FWTEST_CACHE_FILE");
+
+    return (file != NULL && *file) ? file : GB_CACHE_FILE;
+}
+
+/**
+ * @brief Load the discovery result from the cache file
+ *
+ * The cache is only used when its key matches the current one and every
+ * cached controller still exists.
+ *
+ * @param disc The discovery result
+ * @param key The current cache key
+ * @return 0 on success, error code if the cache is missing or stale
+ */
+static int load_cache(struct gb_discovery *disc, const char *key)
+{
+    char line[128], word[16], path[PATH_MAX];
+    struct gb_gpio_chip *chip;
+    struct gb_bundle *bundle;
+    FILE *fp;
+    int ret = -ESTALE;
+
+    fp = fopen(cache_file(), "r");
+    if (fp == NULL) {
+        return -ENOENT;
+    }
+
+    memset(disc, 0, sizeof(*disc));
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "%15s", word) != 1) {
+            continue;
+        }
+
+        if (!strcmp(word, "key")) {
+            if (sscanf(line, "key %63s", disc->key) == 1 &&
+                !strcmp(disc->key, key)) {
+                ret = 0;
+            }
+        } else if (!strcmp(word, "gpio") &&
+                   disc->ngpio_chips < GB_MAX_GPIO_CHIPS) {
+            chip = &disc->gpio_chips[disc->ngpio_chips];
+            if (sscanf(line, "gpio %d %d %d", &chip->base, &chip->ngpio,
+                       &chip->chipnum) == 3) {
+                disc->ngpio_chips++;
+            }
+        } else if (!strcmp(word, "i2c") &&
+                   disc->ni2c_adapters < GB_MAX_I2C_ADAPTERS) {
+            if (sscanf(line, "i2c %d",
+                       &disc->i2c_busid[disc->ni2c_adapters]) == 1) {
+                disc->ni2c_adapters++;
+            }
+        } else if (!strcmp(word, "bundle") &&
+                   disc->nbundles < GB_MAX_BUNDLES) {
+            bundle = &disc->bundles[disc->nbundles];
+            if (sscanf(line, "bundle %31s %i", bundle->name,
+                       &bundle->class_id) == 2) {
+                disc->nbundles++;
+            }
+        }
+    }
+    fclose(fp);
+
+    if (ret) {
+        return ret;
+    }
+
+    /* one access() per controller catches a cache left by a swapped module */
+    for (chip = disc->gpio_chips;
+         chip < disc->gpio_chips + disc->ngpio_chips; chip++) {
+        snprintf(path, sizeof(path), "%s/gpiochip%d", GB_GPIO_CLASS,
+                 chip->base);
+        if (access(path, F_OK)) {
+            return -ESTALE;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Store the discovery result in the cache file
+ *
+ * A failing write only costs a rescan next time, so errors are ignored.
+ *
+ * @param disc The discovery result
+ * @return None
+ */
+static void save_cache(const struct gb_discovery *disc)
+{
+    char tmpfile[PATH_MAX];
+    FILE *fp;
+    int i;
+
+    snprintf(tmpfile, sizeof(tmpfile), "%s.%d", cache_file(), (int)getpid());
+    fp = fopen(tmpfile, "w");
+    if (fp == NULL) {
+        return;
+    }
+
+    fprintf(fp, "key %s\n", disc->key);
+    for (i = 0; i < disc->ngpio_chips; i++) {
+        fprintf(fp, "gpio %d %d %d\n", disc->gpio_chips[i].base,
+                disc->gpio_chips[i].ngpio, disc->gpio_chips[i].chipnum);
+    }
+    for (i = 0; i < disc->ni2c_adapters; i++) {
+        fprintf(fp, "i2c %d\n", disc->i2c_busid[i]);
+    }
+    for (i = 0; i < disc->nbundles; i++) {
+        fprintf(fp, "bundle %s 0x%02x\n", disc->bundles[i].name,
+                disc->bundles[i].class_id);
+    }
+
+    if (fclose(fp) || rename(tmpfile, cache_file())) {
+        unlink(tmpfile);
+    }
+}
+
+/**
+ * @brief Discover Greybus controllers
+ *
+ * Enumerates Greybus GPIO controllers, I2C adapters and bundles once per
+ * process. The result is kept in a cache file shared by all test apps and
+ * reused until the boot id or the greybus device list changes.
+ *
+ * @param rescan Ignore the cache file and scan sysfs again
+ * @return the discovery result, never NULL
+ */
+const struct gb_discovery *gb_discover(int rescan)
+{
+    char key[GB_KEY_LEN];
+
+    if (discovery_valid && !rescan) {
+        return &discovery;
+    }
+
+    build_cache_key(key, sizeof(key));
+    if (rescan || load_cache(&discovery, key)) {
+        memset(&discovery, 0, sizeof(discovery));
+        snprintf(discovery.key, sizeof(discovery.key), "%s", key);
+        scan_gpio_chips(&discovery);
+        scan_i2c_adapters(&discovery);
+        scan_bundles(&discovery);
+        save_cache(&discovery);
+    }
+
+    discovery_valid = 1;
+    return &discovery;
+}
+
+/**
+ * @brief Look up a Greybus GPIO controller
+ *
+ * @param index Controller index, in GPIO number order
+ * @param base Returns the controller base GPIO number
+ * @param ngpio Returns the controller line count
+ * @return 0 on success, -ENODEV if there is no such controller
+ */
+int gb_find_gpio_chip(int index, int *base, int *ngpio)
+{
+    const struct gb_discovery *disc = gb_discover(0);
+
+    if (index < 0 || index >= disc->ngpio_chips) {
+        return -ENODEV;
+    }
+
+    if (base != NULL) {
+        *base = disc->gpio_chips[index].base;
+    }
+    if (ngpio != NULL) {
+        *ngpio = disc->gpio_chips[index].ngpio;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Look up a Greybus I2C adapter
+ *
+ * @param index Adapter index, in bus number order
+ * @param busid Returns the /dev/i2c-N bus number
+ * @return 0 on success, -ENODEV if there is no such adapter
+ */
+int gb_find_i2c_adapter(int index, int *busid)
+{
+    const struct gb_discovery *disc = gb_discover(0);
+
+    if (index < 0 || index >= disc->ni2c_adapters) {
+        return -ENODEV;
+    }
+
+    *busid = disc->i2c_busid[index];
+    return 0;
+}
+
+/**
+ * @brief Look up a Greybus bundle by class
+ *
+ * @param index Index among the bundles of that class
+ * @param class_id Greybus bundle class, or -1 for any class
+ * @return the bundle on success, NULL if there is no such bundle
+ */
+const struct gb_bundle *gb_find_bundle(int index, int class_id)
+{
+    const struct gb_discovery *disc = gb_discover(0);
+    int i;
+
+    for (i = 0; i < disc->nbundles; i++) {
+        if (class_id >= 0 && disc->bundles[i].class_id != class_id) {
+            continue;
+        }
+        if (index-- == 0) {
+            return &disc->bundles[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Look up the block device of a card in a Greybus SD host
+ *
+ * Not cached, cards come and go with card detect. Only whole disks are
+ * returned, boot and rpmb partitions of eMMC are skipped.
+ *
+ * @param index Card index, in /sys/block order
+ * @param path Returns the device node, /dev/block/mmcblkN on Android
+ * @param len The path buffer size
+ * @return 0 on success, -ENODEV if there is no such card
+ */
+int gb_find_sd_blockdev(int index, char *path, int len)
+{
+    char link[PATH_MAX], target[PATH_MAX];
+    struct dirent *ptr;
+    DIR *fdir;
+    ssize_t n;
+    int ret = -ENODEV;
+
+    fdir = opendir(GB_BLOCK_CLASS);
+    if (fdir == NULL) {
+        return -ENODEV;
+    }
+
+    while ((ptr = readdir(fdir)) != NULL) {
+        if (strncmp(ptr->d_name, "mmcblk", strlen("mmcblk")) ||
+            strstr(ptr->d_name, "boot") || strstr(ptr->d_name, "rpmb")) {
+            continue;
+        }
+
+        snprintf(link, sizeof(link), "%s/%s", GB_BLOCK_CLASS, ptr->d_name);
+        n = readlink(link, target, sizeof(target) - 1);
+        if (n < 0) {
+            continue;
+        }
+        target[n] = '\0';
+        if (strstr(target, "/greybus") == NULL || index-- > 0) {
+            continue;
+        }
+
+        snprintf(path, len, "/dev/block/%s", ptr->d_name);
+        if (access(path, F_OK)) {
+            snprintf(path, len, "/dev/%s", ptr->d_name);
+        }
+        ret = 0;
+        break;
+    }
+    closedir(fdir);
+
+    return ret;
+}
+
+/**
+ * @brief Look up a spidev device on a Greybus SPI master
+ *
+ * Not cached, spidev nodes only exist while a driver is bound to the
+ * device.
+ *
+ * @param index Device index, in /sys/class/spidev order
+ * @param bus Returns the SPI bus number
+ * @param cs Returns the chip select, the node is /dev/spidev<bus>.<cs>
+ * @return 0 on success, -ENODEV if there is no such device
+ */
+int gb_find_spi_dev(int index, int *bus, int *cs)
+{
+    char link[PATH_MAX], target[PATH_MAX];
+    struct dirent *ptr;
+    DIR *fdir;
+    ssize_t n;
+    int ret = -ENODEV;
+
+    fdir = opendir(GB_SPIDEV_CLASS);
+    if (fdir == NULL) {
+        return -ENODEV;
+    }
+
+    while ((ptr = readdir(fdir)) != NULL) {
+        if (sscanf(ptr->d_name, "spidev%d.%d", bus, cs) != 2) {
+            continue;
+        }
+
+        snprintf(link, sizeof(link), "%s/%s", GB_SPIDEV_CLASS, ptr->d_name);
+        n = readlink(link, target, sizeof(target) - 1);
+        if (n < 0) {
+            continue;
+        }
+        target[n] = '\0';
+        if (strstr(target, "/greybus") == NULL || index-- > 0) {
+            continue;
+        }
+
+        ret = 0;
+        break;
+    }
+    closedir(fdir);
+
+    return ret;
+}
+
+/**
+ * @brief Look up the tty of a Greybus UART
+ *
+ * Not cached, like the other character devices.
+ *
+ * @param index UART index, the N of ttyGBN
+ * @param path Returns the device node
+ * @param len The path buffer size
+ * @return 0 on success, -ENODEV if there is no such UART
+ */
+int gb_find_uart_tty(int index, char *path, int len)
+{
+    char link[PATH_MAX];
+
+    snprintf(link, sizeof(link), "%s/%s%d", GB_TTY_CLASS, GB_TTY_NAME, index);
+    if (access(link, F_OK)) {
+        return -ENODEV;
+    }
+
+    snprintf(path, len, "/dev/%s%d", GB_TTY_NAME, index);
+    return 0;
+}
+
+/**
+ * @brief Look up a V4L2 video node of a Greybus camera
+ *
+ * Not cached, like the other character devices.
+ *
+ * @param index Device index, in /sys/class/video4linux order
+ * @param path Returns the device node
+ * @param len The path buffer size
+ * @return 0 on success, -ENODEV if there is no such device
+ */
+int gb_find_video_dev(int index, char *path, int len)
+{
+    char link[PATH_MAX], target[PATH_MAX];
+    struct dirent *ptr;
+    DIR *fdir;
+    ssize_t n;
+    int ret = -ENODEV;
+
+    fdir = opendir(GB_VIDEO_CLASS);
+    if (fdir == NULL) {
+        return -ENODEV;
+    }
+
+    while ((ptr = readdir(fdir)) != NULL) {
+        if (strncmp(ptr->d_name, "video", 5)) {
+            continue;
+        }
+
+        snprintf(link, sizeof(link), "%s/%s", GB_VIDEO_CLASS, ptr->d_name);
+        n = readlink(link, target, sizeof(target) - 1);
+        if (n < 0) {
+            continue;
+        }
+        target[n] = '\0';
+        if (strstr(target, "/greybus") == NULL || index-- > 0) {
+            continue;
+        }
+
+        snprintf(path, len, "/dev/%s", ptr->d_name);
+        ret = 0;
+        break;
+    }
+    closedir(fdir);
+
+    return ret;
+}
+
+/**
+ * @brief Look up the ALSA sound card of a Greybus audio module
+ *
+ * Not cached, like the other character devices.
+ *
+ * @param index Card index, in /sys/class/sound order
+ * @param card Returns the card number, its PCMs are /dev/snd/pcmC<card>D*
+ * @return 0 on success, -ENODEV if there is no such card
+ */
+int gb_find_sound_card(int index, int *card)
+{
+    char link[PATH_MAX], target[PATH_MAX];
+    struct dirent *ptr;
+    DIR *fdir;
+    ssize_t n;
+    char end;
+    int ret = -ENODEV;
+
+    fdir = opendir(GB_SOUND_CLASS);
+    if (fdir == NULL) {
+        return -ENODEV;
+    }
+
+    while ((ptr = readdir(fdir)) != NULL) {
+        if (sscanf(ptr->d_name, "card%d%c", card, &end) != 1) {
+            continue;
+        }
+
+        snprintf(link, sizeof(link), "%s/%s", GB_SOUND_CLASS, ptr->d_name);
+        n = readlink(link, target, sizeof(target) - 1);
+        if (n < 0) {
+            continue;
+        }
+        target[n] = '\0';
+        if (strstr(target, "/greybus") == NULL || index-- > 0) {
+            continue;
+        }
+
+        ret = 0;
+        break;
+    }
+    closedir(fdir);
+
+    return ret;
+}
+
+/**
+ * @brief Look up a Greybus loopback device
+ *
+ * Not cached, loopback devices come and go with the loopback bundle.
+ *
+ * @param index Device index, the N of gb_loopbackN
+ * @param path Returns the sysfs directory of the device
+ * @param len The path buffer size
+ * @return 0 on success, -ENODEV if there is no such device
+ */
+int gb_find_loopback(int index, char *path, int len)
+{
+    snprintf(path, len, "%s/gb_loopback%d", GB_LOOPBACK_CLASS, index);
+    if (access(path, F_OK)) {
+        path[0] = '\0';
+        return -ENODEV;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Look up a PWM controller of a Greybus PWM bundle
+ *
+ * Not cached, like the other per protocol devices.
+ *
+ * @param index Controller index, in /sys/class/pwm order
+ * @param chip Returns N of /sys/class/pwm/pwmchipN
+ * @param npwm Returns the number of channels
+ * @return 0 on success, -ENODEV if there is no such controller
+ */
+int gb_find_pwm_chip(int index, int *chip, int *npwm)
+{
+    char link[PATH_MAX], target[PATH_MAX], value[16];
+    struct dirent *ptr;
+    DIR *fdir;
+    ssize_t n;
+    char end;
+    int ret = -ENODEV;
+
+    fdir = opendir(GB_PWM_CLASS);
+    if (fdir == NULL) {
+        return -ENODEV;
+    }
+
+    while ((ptr = readdir(fdir)) != NULL) {
+        if (sscanf(ptr->d_name, "pwmchip%d%c", chip, &end) != 1) {
+            continue;
+        }
+
+        snprintf(link, sizeof(link), "%s/%s", GB_PWM_CLASS, ptr->d_name);
+        n = readlink(link, target, sizeof(target) - 1);
+        if (n < 0) {
+            continue;
+        }
+        target[n] = '\0';
+        if (strstr(target, "/greybus") == NULL || index-- > 0) {
+            continue;
+        }
+
+        if (debugfs_get_attr(link, "npwm", value, sizeof(value) - 1)) {
+            continue;
+        }
+        *npwm = atoi(value);
+        ret = 0;
+        break;
+    }
+    closedir(fdir);
+
+    return ret;
+}
@@ -0,0 +1,387 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "./include/libfwtest.h"
+
+/*
+ * One pass enumeration of the Greybus devices of a set of classes. Each
+ * class directory is opened once and walked with readlinkat() relative to
+ * its fd, keeping the entries that sit below a greybus host device. Then
+ * the class attributes of every kept entry are read with openat() by a
+ * small pool of threads, so a fully populated endo costs a few
+ * milliseconds instead of one path walk per attribute.
+ */
+
+/* Worker threads besides the caller, for the attribute reads */
+#define GB_ENUM_THREADS 3
+/* Attribute reads per thread below which the caller reads them alone */
+#define GB_ENUM_ITEMS_PER_THREAD 16
+
+struct gb_enum_class_info {
+    const char *name;
+    const char *dir;
+    /** sscanf format of the entry names, parses num[0] and num[1] */
+    const char *format;
+    /** number of conversions format must make */
+    int nconv;
+    /** device node, from num[0] and num[1], NULL if there is none */
+    const char *node;
+    const char *attrs[GB_ENUM_MAX_ATTRS];
+};
+
+static const struct gb_enum_class_info enum_classes[GB_ENUM_NCLASSES] = {
+    [GB_ENUM_GPIO] = {
+        "gpio", "/sys/class/gpio", "gpiochip%d%c", 1, NULL,
+        { "label", "base", "ngpio" },
+    },
+    [GB_ENUM_I2C] = {
+        "i2c", "/sys/bus/i2c/devices", "i2c-%d%c", 1, "/dev/i2c-%d",
+        { "name" },
+    },
+    [GB_ENUM_SPI] = {
+        "spi", "/sys/class/spidev", "spidev%d.%d%c", 2, "/dev/spidev%d.%d",
+        { "dev", "device/modalias" },
+    },
+    [GB_ENUM_SD] = {
+        "sd", "/sys/block", "mmcblk%d%c", 1, "/dev/block/mmcblk%d",
+        { "size", "ro", "queue/logical_block_size",
+          "queue/max_hw_sectors_kb", "device/type", "device/name" },
+    },
+    [GB_ENUM_UART] = {
+        "uart", "/sys/class/tty", "ttyGB%d%c", 1, "/dev/ttyGB%d",
+        { "dev" },
+    },
+    [GB_ENUM_VIDEO] = {
+        "video", "/sys/class/video4linux", "video%d%c", 1, "/dev/video%d",
+        { "name", "index" },
+    },
+    [GB_ENUM_SOUND] = {
+        "sound", "/sys/class/sound", "card%d%c", 1, "/dev/snd/controlC%d",
+        { "id", "number" },
+    },
+    [GB_ENUM_PWM] = {
+        "pwm", "/sys/class/pwm", "pwmchip%d%c", 1, NULL,
+        { "npwm" },
+    },
+};
+
+struct gb_enum_job {
+    struct gb_enum_dev *devs;
+    /** class directory fd of each device */
+    const int *dirfd;
+    int nitems;
+    int next;
+};
+
+/**
+ * @brief Pick the greybus device name out of a sysfs link target
+ *
+ * @param target The link target
+ * @param bundle Returns the last "<bus>-<intf>.<bundle>" component
+ * @param len The bundle buffer size
+ * @return None
+ */
+static void enum_bundle_name(const char *target, char *bundle, int len)
+{
+    const char *c, *end;
+    int bus, intf, id, n;
+
+    bundle[0] = '\0';
+    for (c = target; c != NULL && *c; c = end) {
+        c += *c == '/';
+        end = strchr(c, '/');
+        n = end != NULL ? end - c : (int)strlen(c);
+        if (sscanf(c, "%d-%d.%d", &bus, &intf, &id) == 3 &&
+            strspn(c, "0123456789-.") == (size_t)n) {
+            snprintf(bundle, len, "%.*s", n, c);
+        }
+    }
+}
+
+/**
+ * @brief Read one attribute of one device
+ *
+ * @param job The enumeration job
+ * @param item Device index times GB_ENUM_MAX_ATTRS plus attribute index
+ * @return None
+ */
+static void enum_read_item(struct gb_enum_job *job, int item)
+{
+    struct gb_enum_dev *dev = &job->devs[item / GB_ENUM_MAX_ATTRS];
+    const char *attr;
+    char path[GB_ENUM_NAME_LEN + 64];
+    char *value = dev->attr[item % GB_ENUM_MAX_ATTRS];
+    ssize_t n;
+    int fd;
+
+    attr = enum_classes[dev->dev_class].attrs[item % GB_ENUM_MAX_ATTRS];
+    if (attr == NULL) {
+        return;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", dev->name, attr);
+    fd = openat(job->dirfd[item / GB_ENUM_MAX_ATTRS], path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    n = read(fd, value, GB_ENUM_ATTR_LEN - 1);
+    close(fd);
+    if (n < 0) {
+        n = 0;
+    }
+    while (n > 0 && (value[n - 1] == '\n' || value[n - 1] == ' ')) {
+        n--;
+    }
+    value[n] = '\0';
+}
+
+static void *enum_worker(void *arg)
+{
+    struct gb_enum_job *job = arg;
+    int item;
+
+    while ((item = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) <
+           job->nitems) {
+        enum_read_item(job, item);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Walk one class directory
+ *
+ * @param dev_class The class
+ * @param dirfd The class directory fd
+ * @param devs The device array to append to
+ * @param ndevs Number of devices in the array
+ * @param max The device array size
+ * @return the new number of devices
+ */
+static int enum_walk_class(int dev_class, int dirfd, struct gb_enum_dev *devs,
+                           int ndevs, int max)
+{
+    const struct gb_enum_class_info *info = &enum_classes[dev_class];
+    char target[512], end;
+    struct gb_enum_dev *dev;
+    struct dirent *ptr;
+    DIR *fdir;
+    ssize_t n;
+    int num[2];
+
+    /* fdopendir() takes the fd, keep the original for openat() */
+    fdir = fdopendir(dup(dirfd));
+    if (fdir == NULL) {
+        return ndevs;
+    }
+
+    while ((ptr = readdir(fdir)) != NULL && ndevs < max) {
+        num[0] = num[1] = 0;
+        if (info->nconv == 2 ?
+            sscanf(ptr->d_name, info->format, &num[0], &num[1], &end) != 2 :
+            sscanf(ptr->d_name, info->format, &num[0], &end) != 1) {
+            continue;
+        }
+
+        n = readlinkat(dirfd, ptr->d_name, target, sizeof(target) - 1);
+        if (n < 0) {
+            continue;
+        }
+        target[n] = '\0';
+        if (strstr(target, "/greybus") == NULL) {
+            continue;
+        }
+
+        dev = &devs[ndevs++];
+        memset(dev, 0, sizeof(*dev));
+        dev->dev_class = dev_class;
+        dev->num[0] = num[0];
+        dev->num[1] = num[1];
+        snprintf(dev->name, sizeof(dev->name), "%.*s", GB_ENUM_NAME_LEN - 1,
+                 ptr->d_name);
+        enum_bundle_name(target, dev->bundle, sizeof(dev->bundle));
+        if (info->node != NULL) {
+            snprintf(dev->node, sizeof(dev->node), info->node, num[0],
+                     num[1]);
+        }
+        /* Android keeps block nodes in /dev/block */
+        if (dev_class == GB_ENUM_SD && access(dev->node, F_OK)) {
+            snprintf(dev->node, sizeof(dev->node), "/dev/%s", dev->name);
+        }
+    }
+    closedir(fdir);
+
+    return ndevs;
+}
+
+static int enum_compare(const void *a, const void *b)
+{
+    const struct gb_enum_dev *da = a, *db = b;
+
+    if (da->dev_class != db->dev_class) {
+        return da->dev_class - db->dev_class;
+    }
+    if (da->num[0] != db->num[0]) {
+        return da->num[0] - db->num[0];
+    }
+
+    return da->num[1] - db->num[1];
+}
+
+/**
+ * @brief Enumerate the Greybus devices of a set of classes
+ *
+ * Not cached, every call walks sysfs again. The devices are sorted by
+ * class, then by the numbers of their names.
+ *
+ * @param classes Bit mask of the classes, GB_ENUM_MASK(GB_ENUM_I2C) | ...
+ * @param devs Returns the devices
+ * @param max The devs array size
+ * @return number of devices on success, error code on failure
+ */
+int gb_enum(unsigned int classes, struct gb_enum_dev *devs, int max)
+{
+    int dirfd[GB_ENUM_MAX_DEVS];
+    int classfd[GB_ENUM_NCLASSES];
+    pthread_t threads[GB_ENUM_THREADS];
+    struct gb_enum_job job;
+    int c, i, nthreads = 0, ndevs = 0;
+
+    if (max > GB_ENUM_MAX_DEVS) {
+        max = GB_ENUM_MAX_DEVS;
+    }
+
+    for (c = 0; c < GB_ENUM_NCLASSES; c++) {
+        classfd[c] = -1;
+        if (!(classes & GB_ENUM_MASK(c))) {
+            continue;
+        }
+        classfd[c] = open(enum_classes[c].dir, O_RDONLY | O_DIRECTORY);
+        if (classfd[c] >= 0) {
+            ndevs = enum_walk_class(c, classfd[c], devs, ndevs, max);
+        }
+    }
+
+    qsort(devs, ndevs, sizeof(*devs), enum_compare);
+    for (i = 0; i < ndevs; i++) {
+        dirfd[i] = classfd[devs[i].dev_class];
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.devs = devs;
+    job.dirfd = dirfd;
+    job.nitems = ndevs * GB_ENUM_MAX_ATTRS;
+    while (nthreads < GB_ENUM_THREADS &&
+           job.nitems > (nthreads + 1) * GB_ENUM_ITEMS_PER_THREAD &&
+           !pthread_create(&threads[nthreads], NULL, enum_worker, &job)) {
+        nthreads++;
+    }
+    enum_worker(&job);
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (c = 0; c < GB_ENUM_NCLASSES; c++) {
+        if (classfd[c] >= 0) {
+            close(classfd[c]);
+        }
+    }
+
+    return ndevs;
+}
+
+/**
+ * @brief Get the name of an enumeration class
+ *
+ * @param dev_class The class
+ * @return the class name, "?" for an unknown class
+ */
+const char *gb_enum_class_name(int dev_class)
+{
+    if (dev_class < 0 || dev_class >= GB_ENUM_NCLASSES) {
+        return "?";
+    }
+
+    return enum_classes[dev_class].name;
+}
+
+/**
+ * @brief Get an attribute of an enumerated device
+ *
+ * @param dev The device
+ * @param attr The attribute, relative to the sysfs entry of the device
+ * @return the value, "" if it could not be read, NULL if the class does
+ * not read that attribute
+ */
+const char *gb_enum_attr(const struct gb_enum_dev *dev, const char *attr)
+{
+    const char *const *attrs = enum_classes[dev->dev_class].attrs;
+    int i;
+
+    for (i = 0; i < GB_ENUM_MAX_ATTRS && attrs[i] != NULL; i++) {
+        if (!strcmp(attrs[i], attr)) {
+            return dev->attr[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Print an enumerated device on one line
+ *
+ * "<tag>: <name> bundle <bundle> node <node> <attr>=<value> ..."
+ *
+ * @param tag Line prefix, the app name
+ * @param dev The device
+ * @return None
+ */
+void gb_enum_print(const char *tag, const struct gb_enum_dev *dev)
+{
+    const char *const *attrs = enum_classes[dev->dev_class].attrs;
+    int i;
+
+    printf("%s: %s bundle %s node %s", tag, dev->name,
+           dev->bundle[0] ? dev->bundle : "-",
+           dev->node[0] ? dev->node : "-");
+    for (i = 0; i < GB_ENUM_MAX_ATTRS && attrs[i] != NULL; i++) {
+        printf(" %s=\"%s\"", attrs[i], dev->attr[i]);
+    }
+    printf("\n");
+}
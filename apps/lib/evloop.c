@@ -0,0 +1,280 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "./include/libfwtest.h"
+
+/*
+ * Event loop driving many device sources from one thread: epoll for fd
+ * readiness and a single timerfd armed at the earliest rate tick, so the
+ * cost per wakeup does not grow with a thread per device. Ticks keep the
+ * rate of each source on an absolute schedule; a tick more than a period
+ * late is dropped and counted instead of being made up with a burst.
+ */
+
+/* Max epoll events handled per wakeup */
+#define EVLOOP_BATCH 32
+/* Longest epoll wait, bounds how late evloop_stop() is seen */
+#define EVLOOP_MAX_WAIT_MS 100
+
+static uint64_t evloop_now(void)
+{
+    struct timespec ts;
+
+    /* timerfd has no CLOCK_MONOTONIC_RAW */
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Create an event loop.
+ *
+ * @param loop The loop.
+ * @return 0 on success, -errno on failure.
+ */
+int evloop_init(struct evloop *loop)
+{
+    struct epoll_event ev;
+
+    memset(loop, 0, sizeof(*loop));
+    loop->timer_fd = -1;
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        return -errno;
+    }
+
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+                                    TFD_NONBLOCK | TFD_CLOEXEC);
+    if (loop->timer_fd < 0) {
+        goto err;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->timer_fd, &ev) < 0) {
+        goto err;
+    }
+
+    return 0;
+
+err:
+    evloop_close(loop);
+    return -errno;
+}
+
+/**
+ * @brief Close an event loop, the fds of its sources stay open.
+ *
+ * @param loop The loop.
+ */
+void evloop_close(struct evloop *loop)
+{
+    int err = errno;
+
+    if (loop->timer_fd >= 0) {
+        close(loop->timer_fd);
+    }
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+    }
+    loop->timer_fd = -1;
+    loop->epoll_fd = -1;
+    loop->nsources = 0;
+    errno = err;
+}
+
+/**
+ * @brief Add a source to an event loop.
+ *
+ * Set fd, events, rate, fn and priv of the source first. fn runs with
+ * the epoll events when fd is ready and with 0 on each rate tick. The
+ * first tick is one period after the loop starts.
+ *
+ * @param loop The loop, not running.
+ * @param src The source, -1 fd for ticks only.
+ * @return 0 on success, -errno on failure.
+ */
+int evloop_add(struct evloop *loop, struct evloop_source *src)
+{
+    struct epoll_event ev;
+
+    if (loop->nsources >= EVLOOP_MAX_SOURCES || !src->fn ||
+        (src->rate < 0 && src->rate != EVLOOP_BACK_TO_BACK)) {
+        return -EINVAL;
+    }
+
+    src->period_ns = src->rate > 0 ? 1e9 / src->rate : 0;
+    src->next_ns = 0;
+    src->ticks = 0;
+    src->missed = 0;
+    src->wakeups = 0;
+    src->errors = 0;
+    stats_hist_init(&src->late);
+
+    if (src->fd >= 0) {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = src->events;
+        ev.data.ptr = src;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, src->fd, &ev) < 0) {
+            return -errno;
+        }
+    }
+
+    loop->sources[loop->nsources++] = src;
+    return 0;
+}
+
+/**
+ * @brief Make evloop_run() return, from any thread.
+ *
+ * @param loop The loop.
+ */
+void evloop_stop(struct evloop *loop)
+{
+    __atomic_store_n(&loop->stop, 1, __ATOMIC_RELAXED);
+}
+
+static void evloop_call(struct evloop_source *src, uint32_t events)
+{
+    if (src->fn(src, events) < 0) {
+        src->errors++;
+    }
+}
+
+/*
+ * Run the due ticks and return the next tick time of any source, 0 when
+ * no source is paced.
+ */
+static uint64_t evloop_ticks(struct evloop *loop, uint64_t now)
+{
+    struct evloop_source *src;
+    uint64_t next = 0, late;
+    int i;
+
+    for (i = 0; i < loop->nsources; i++) {
+        src = loop->sources[i];
+        if (!src->period_ns) {
+            continue;
+        }
+
+        if (now >= src->next_ns) {
+            late = now - src->next_ns;
+            stats_hist_record(&src->late, late);
+            src->missed += late / src->period_ns;
+            src->next_ns += (late / src->period_ns + 1) * src->period_ns;
+            src->ticks++;
+            evloop_call(src, 0);
+        }
+
+        if (!next || src->next_ns < next) {
+            next = src->next_ns;
+        }
+    }
+
+    return next;
+}
+
+/**
+ * @brief Run an event loop until evloop_stop().
+ *
+ * Sources at EVLOOP_BACK_TO_BACK tick once per wakeup round robin, and
+ * the loop then only polls, so mixing them with paced sources trades
+ * the tick accuracy for throughput.
+ *
+ * @param loop The loop.
+ * @return 0 when stopped, -errno if epoll or the timer failed.
+ */
+int evloop_run(struct evloop *loop)
+{
+    struct epoll_event evs[EVLOOP_BATCH];
+    struct itimerspec its;
+    struct evloop_source *src;
+    uint64_t start, next, armed = 0, expired;
+    int i, n, wait, free_running = 0;
+
+    start = evloop_now();
+    for (i = 0; i < loop->nsources; i++) {
+        src = loop->sources[i];
+        src->next_ns = start + src->period_ns;
+        free_running += src->rate == EVLOOP_BACK_TO_BACK;
+    }
+
+    while (!__atomic_load_n(&loop->stop, __ATOMIC_RELAXED)) {
+        next = evloop_ticks(loop, evloop_now());
+
+        /* re-arm only when the earliest tick moved */
+        if (next && next != armed) {
+            memset(&its, 0, sizeof(its));
+            its.it_value.tv_sec = next / 1000000000ULL;
+            its.it_value.tv_nsec = next % 1000000000ULL;
+            if (timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &its,
+                                NULL) < 0) {
+                return -errno;
+            }
+            armed = next;
+        }
+
+        wait = free_running ? 0 : EVLOOP_MAX_WAIT_MS;
+        n = epoll_wait(loop->epoll_fd, evs, EVLOOP_BATCH, wait);
+        if (n < 0 && errno != EINTR) {
+            return -errno;
+        }
+        loop->wakeups++;
+
+        for (i = 0; i < n; i++) {
+            src = evs[i].data.ptr;
+            if (!src) {
+                if (read(loop->timer_fd, &expired, sizeof(expired)) > 0) {
+                    armed = 0;
+                }
+                continue;
+            }
+            src->wakeups++;
+            evloop_call(src, evs[i].events);
+        }
+
+        for (i = 0; free_running && i < loop->nsources; i++) {
+            src = loop->sources[i];
+            if (src->rate == EVLOOP_BACK_TO_BACK) {
+                src->ticks++;
+                evloop_call(src, 0);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -129,3 +129,150 @@ int debugfs_set_attr(char *class_path, const char *attr, char *value, int len)
     close(fd);
     return 0;
 }
+
+/**
+ * @brief Open a debugfs attribute for repeated access
+ *
+ * The returned descriptor stays valid until debugfs_close_attr() and can be
+ * passed to debugfs_read_attr()/debugfs_write_attr() any number of times.
+ * Each access is then a single pread/pwrite at offset 0 instead of a full
+ * open/read/close cycle.
+ *
+ * @param class_path Class path string
+ * @param attr The class attribute
+ * @param flags open() access mode (O_RDONLY, O_WRONLY or O_RDWR)
+ * @return file descriptor on success, error code on failure
+ */
+int debugfs_open_attr(char *class_path, const char *attr, int flags)
+{
+    char sysbuf[PATH_MAX];
+    int fd = 0;
+
+    if (class_path == NULL || *class_path == null_byte || attr == NULL) {
+        return -EINVAL;
+    }
+
+    snprintf(sysbuf, sizeof(sysbuf), "%s/%s", class_path, attr);
+
+    fd = open(sysbuf, flags);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Open a debugfs directory as a handle on its attributes
+ *
+ * The attributes are then opened with debugfs_openat_attr() by their
+ * short name, so the full path is only built once per directory. Close
+ * the handle with debugfs_close_attr().
+ *
+ * @param path Directory path string
+ * @return file descriptor on success, error code on failure
+ */
+int debugfs_open_dir(const char *path)
+{
+    int fd = 0;
+
+    if (path == NULL || *path == null_byte) {
+        return -EINVAL;
+    }
+
+    fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Open an attribute of a debugfs directory handle
+ *
+ * @param dirfd Descriptor returned by debugfs_open_dir()
+ * @param attr The attribute name
+ * @param flags open() access mode (O_RDONLY, O_WRONLY or O_RDWR)
+ * @return file descriptor on success, error code on failure
+ */
+int debugfs_openat_attr(int dirfd, const char *attr, int flags)
+{
+    int fd = 0;
+
+    if (dirfd < 0 || attr == NULL) {
+        return -EINVAL;
+    }
+
+    fd = openat(dirfd, attr, flags | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Read value from an opened debugfs attribute
+ *
+ * @param fd Descriptor returned by debugfs_open_attr()
+ * @param value The value is read from debugfs
+ * @param len The value buffer size
+ * @return 0 on success, error code on failure
+ */
+int debugfs_read_attr(int fd, char *value, int len)
+{
+    int nread = 0;
+
+    if (fd < 0 || value == NULL || len < 1) {
+        return -EINVAL;
+    }
+
+    /* sysfs regenerates the attribute on every read from offset 0 */
+    nread = pread(fd, value, len - 1, 0);
+    if (nread < 0) {
+        return -errno;
+    }
+
+    while (nread > 0 && (value[nread - 1] == new_line ||
+           value[nread - 1] == carriage_return)) {
+        nread = nread - 1;
+    }
+    value[nread] = null_byte;
+
+    return 0;
+}
+
+/**
+ * @brief Write value to an opened debugfs attribute
+ *
+ * @param fd Descriptor returned by debugfs_open_attr()
+ * @param value The value is write to debugfs
+ * @param len The value buffer size
+ * @return 0 on success, error code on failure
+ */
+int debugfs_write_attr(int fd, char *value, int len)
+{
+    if (fd < 0 || value == NULL || len < 1) {
+        return -EINVAL;
+    }
+
+    if (pwrite(fd, value, len, 0) < 0) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Close a debugfs attribute opened by debugfs_open_attr()
+ *
+ * @param fd Descriptor returned by debugfs_open_attr()
+ * @return None
+ */
+void debugfs_close_attr(int fd)
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+}
@@ -0,0 +1,819 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+
+#ifdef HAVE_LINUX_GPIO_H
+#include <linux/gpio.h>
+#endif
+
+#include "./include/libfwtest.h"
+
+#define GPIO_CLASS "/sys/class/gpio"
+
+/* Max number of GPIO pins whose attributes are kept open at the same time */
+#define GPIO_ATTR_CACHE_SIZE 64
+
+/* "/sys/class/gpio/gpioN" for any int N */
+#define GPIO_PATH_LEN 32
+
+static const char *gpio_attr_name[GPIO_ATTR_MAX] = {
+    "direction",
+    "value",
+    "edge",
+};
+
+enum gpio_slot {
+    GPIO_SLOT_FREE,
+    GPIO_SLOT_USED,
+    /* released, lookups probe past it */
+    GPIO_SLOT_DELETED,
+};
+
+struct gpio_attr_cache {
+    int state;
+    int gpio;
+    /* the gpioN directory, attributes are opened relative to it */
+    int dirfd;
+    int fd[GPIO_ATTR_MAX];
+};
+
+/* open addressed on the GPIO number, a lookup is usually one entry */
+static struct gpio_attr_cache attr_cache[GPIO_ATTR_CACHE_SIZE];
+
+/* export and unexport, kept open so exporting is a single write */
+static int class_fd[2] = { -1, -1 };
+
+/**
+ * @brief Find the attribute cache entry of a GPIO
+ *
+ * @param gpio GPIO number
+ * @param create Non-zero to add an entry when there is none
+ * @return the entry, NULL if there is none or the cache is full
+ */
+static struct gpio_attr_cache *gpio_attr_lookup(int gpio, int create)
+{
+    struct gpio_attr_cache *entry = NULL, *unused = NULL;
+    unsigned int slot = (unsigned int)gpio % GPIO_ATTR_CACHE_SIZE;
+    int i = 0;
+
+    for (i = 0; i < GPIO_ATTR_CACHE_SIZE; i++) {
+        entry = &attr_cache[(slot + i) % GPIO_ATTR_CACHE_SIZE];
+        if (entry->state == GPIO_SLOT_USED && entry->gpio == gpio) {
+            return entry;
+        }
+        if (entry->state != GPIO_SLOT_USED && unused == NULL) {
+            unused = entry;
+        }
+        if (entry->state == GPIO_SLOT_FREE) {
+            break;
+        }
+    }
+
+    if (!create || unused == NULL) {
+        return NULL;
+    }
+
+    unused->state = GPIO_SLOT_USED;
+    unused->gpio = gpio;
+    unused->dirfd = -1;
+    for (i = 0; i < GPIO_ATTR_MAX; i++) {
+        unused->fd[i] = -1;
+    }
+
+    return unused;
+}
+
+/**
+ * @brief Get the cached file descriptor of a GPIO attribute
+ *
+ * The gpioN directory is opened on the first use of the GPIO and its
+ * attributes on their first use, relative to it. All stay open until the
+ * GPIO is exported or unexported again, so repeated accesses cost one
+ * syscall and build no path.
+ *
+ * @param gpio GPIO number
+ * @param attr The GPIO attribute
+ * @return file descriptor on success, -ENOSPC if the cache is full, error
+ * code on other failures
+ */
+int gpio_attr_fd(int gpio, enum gpio_attr attr)
+{
+    struct gpio_attr_cache *entry = NULL;
+    char gpiostr[GPIO_PATH_LEN];
+    int fd = 0;
+
+    if (attr < 0 || attr >= GPIO_ATTR_MAX) {
+        return -EINVAL;
+    }
+
+    entry = gpio_attr_lookup(gpio, 1);
+    if (entry == NULL) {
+        return -ENOSPC;
+    }
+
+    if (entry->fd[attr] >= 0) {
+        return entry->fd[attr];
+    }
+
+    if (entry->dirfd < 0) {
+        snprintf(gpiostr, sizeof(gpiostr), "%s/gpio%d", GPIO_CLASS, gpio);
+        fd = debugfs_open_dir(gpiostr);
+        if (fd < 0) {
+            /* not exported, nothing to keep */
+            entry->state = GPIO_SLOT_DELETED;
+            return fd;
+        }
+        entry->dirfd = fd;
+    }
+
+    fd = debugfs_openat_attr(entry->dirfd, gpio_attr_name[attr], O_RDWR);
+    if (fd < 0) {
+        return fd;
+    }
+    entry->fd[attr] = fd;
+
+    return fd;
+}
+
+/**
+ * @brief Close all cached attribute file descriptors of a GPIO
+ *
+ * @param gpio GPIO number
+ * @return None
+ */
+void gpio_attr_release(int gpio)
+{
+    struct gpio_attr_cache *entry = gpio_attr_lookup(gpio, 0);
+    int i = 0;
+
+    if (entry == NULL) {
+        return;
+    }
+
+    for (i = 0; i < GPIO_ATTR_MAX; i++) {
+        debugfs_close_attr(entry->fd[i]);
+    }
+    debugfs_close_attr(entry->dirfd);
+    entry->state = GPIO_SLOT_DELETED;
+}
+
+/**
+ * @brief Read a GPIO attribute
+ *
+ * Uses the cached attribute descriptor, falls back on debugfs_get_attr()
+ * when the cache is full.
+ *
+ * @param gpio GPIO number
+ * @param attr The GPIO attribute
+ * @param value The value is read from debugfs
+ * @param len The value buffer size
+ * @return 0 on success, error code on failure
+ */
+int gpio_get_attr(int gpio, enum gpio_attr attr, char *value, int len)
+{
+    int fd = 0;
+    char gpiostr[GPIO_PATH_LEN];
+
+    fd = gpio_attr_fd(gpio, attr);
+    if (fd >= 0) {
+        return debugfs_read_attr(fd, value, len);
+    } else if (fd != -ENOSPC) {
+        return fd;
+    }
+
+    snprintf(gpiostr, sizeof(gpiostr), "%s/gpio%d", GPIO_CLASS, gpio);
+    return debugfs_get_attr(gpiostr, gpio_attr_name[attr], value, len);
+}
+
+/**
+ * @brief Write a GPIO attribute
+ *
+ * Uses the cached attribute descriptor, falls back on debugfs_set_attr()
+ * when the cache is full.
+ *
+ * @param gpio GPIO number
+ * @param attr The GPIO attribute
+ * @param value The value is write to debugfs
+ * @param len The value buffer size
+ * @return 0 on success, error code on failure
+ */
+int gpio_set_attr(int gpio, enum gpio_attr attr, char *value, int len)
+{
+    int fd = 0;
+    char gpiostr[GPIO_PATH_LEN];
+
+    fd = gpio_attr_fd(gpio, attr);
+    if (fd >= 0) {
+        return debugfs_write_attr(fd, value, len);
+    } else if (fd != -ENOSPC) {
+        return fd;
+    }
+
+    snprintf(gpiostr, sizeof(gpiostr), "%s/gpio%d", GPIO_CLASS, gpio);
+    return debugfs_set_attr(gpiostr, gpio_attr_name[attr], value, len);
+}
+
+/**
+ * @brief Write a GPIO number to the export or unexport attribute
+ *
+ * @param which 0 for export, 1 for unexport
+ * @param gpio GPIO number
+ * @return 0 on success, error code on failure
+ */
+static int gpio_class_write(int which, int gpio)
+{
+    static const char * const class_attr[] = { "export", "unexport" };
+    char gpiostr[16];
+    int fd = class_fd[which], expected = -1, len = 0;
+
+    if (fd < 0) {
+        fd = debugfs_open_attr(GPIO_CLASS, class_attr[which], O_WRONLY);
+        if (fd < 0) {
+            return fd;
+        }
+        /* threads exporting at the same time keep the first descriptor */
+        if (!__atomic_compare_exchange_n(&class_fd[which], &expected, fd, 0,
+                                         __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE)) {
+            debugfs_close_attr(fd);
+            fd = expected;
+        }
+    }
+
+    len = snprintf(gpiostr, sizeof(gpiostr), "%d\n", gpio);
+    return debugfs_write_attr(fd, gpiostr, len);
+}
+
+/**
+ * @brief Export a GPIO to sysfs
+ *
+ * @param gpio GPIO number
+ * @return 0 on success, error code on failure
+ */
+int gpio_export(int gpio)
+{
+    gpio_attr_release(gpio);
+    return gpio_class_write(0, gpio);
+}
+
+/**
+ * @brief Unexport a GPIO from sysfs
+ *
+ * @param gpio GPIO number
+ * @return 0 on success, error code on failure
+ */
+int gpio_unexport(int gpio)
+{
+    gpio_attr_release(gpio);
+    return gpio_class_write(1, gpio);
+}
+
+/**
+ * @brief Read the sysfs state of a GPIO pin
+ *
+ * Whether the pin is exported is a sysfs lookup, direction and edge are
+ * kept by gpiolib. Only the value of an output goes to the controller.
+ *
+ * @param gpio GPIO number
+ * @param st The pin state
+ * @return 0 on success, error code on failure
+ */
+static int gpio_read_state(int gpio, struct gpio_pin_state *st)
+{
+    char gpiostr[GPIO_PATH_LEN];
+    int ret = 0;
+
+    memset(st, 0, sizeof(*st));
+    st->gpio = gpio;
+
+    snprintf(gpiostr, sizeof(gpiostr), "%s/gpio%d", GPIO_CLASS, gpio);
+    if (access(gpiostr, F_OK)) {
+        return errno == ENOENT ? 0 : -errno;
+    }
+    st->exported = 1;
+
+    ret = gpio_get_attr(gpio, GPIO_ATTR_DIRECTION, st->direction,
+                        sizeof(st->direction));
+    if (ret) {
+        return ret;
+    }
+
+    /* lines that cannot interrupt have no edge attribute */
+    ret = gpio_get_attr(gpio, GPIO_ATTR_EDGE, st->edge, sizeof(st->edge));
+    if (ret == -ENOENT) {
+        st->edge[0] = '\0';
+    } else if (ret) {
+        return ret;
+    }
+
+    if (!strcmp(st->direction, "out")) {
+        return gpio_get_attr(gpio, GPIO_ATTR_VALUE, st->value,
+                             sizeof(st->value));
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Clear a GPIO pin state snapshot
+ *
+ * @param snap The snapshot
+ * @return None
+ */
+void gpio_snapshot_init(struct gpio_snapshot *snap)
+{
+    memset(snap, 0, sizeof(*snap));
+}
+
+/**
+ * @brief Record the state of a GPIO pin before it is first used
+ *
+ * Pins already in the snapshot keep their first recorded state, so this
+ * can be called before every use of the pin.
+ *
+ * @param snap The snapshot
+ * @param gpio GPIO number
+ * @return 0 on success, -ENOSPC if the snapshot is full, error code on
+ * other failures
+ */
+int gpio_snapshot_add(struct gpio_snapshot *snap, int gpio)
+{
+    int i = 0, ret = 0;
+
+    for (i = 0; i < snap->count; i++) {
+        if (snap->pins[i].gpio == gpio) {
+            return 0;
+        }
+    }
+
+    if (snap->count >= GPIO_SNAPSHOT_MAX) {
+        return -ENOSPC;
+    }
+
+    ret = gpio_read_state(gpio, &snap->pins[snap->count]);
+    if (!ret) {
+        snap->count++;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Bring one GPIO pin back to its recorded state
+ *
+ * An output is restored with a single "high" or "low" direction write,
+ * which sets direction and level at once. An edge is cleared first when
+ * the direction changes, gpiolib does not change the direction of a line
+ * used as an interrupt.
+ *
+ * @param want The recorded pin state
+ * @param changes Incremented for every attribute written
+ * @return 0 on success, error code on failure
+ */
+static int gpio_restore_pin(const struct gpio_pin_state *want, int *changes)
+{
+    struct gpio_pin_state cur;
+    char buf[8];
+    int ret = 0, output = 0;
+
+    ret = gpio_read_state(want->gpio, &cur);
+    if (ret) {
+        return ret;
+    }
+
+    if (cur.exported != want->exported) {
+        ret = want->exported ? gpio_export(want->gpio) :
+                               gpio_unexport(want->gpio);
+        if (ret) {
+            return ret;
+        }
+        (*changes)++;
+        if (!want->exported) {
+            return 0;
+        }
+        ret = gpio_read_state(want->gpio, &cur);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    if (!want->exported) {
+        return 0;
+    }
+
+    output = !strcmp(want->direction, "out");
+    if (strcmp(cur.direction, want->direction) ||
+        (output && strcmp(cur.value, want->value))) {
+        if (cur.edge[0] != '\0' && strcmp(cur.edge, "none")) {
+            snprintf(buf, sizeof(buf), "%s", "none");
+            ret = gpio_set_attr(want->gpio, GPIO_ATTR_EDGE, buf,
+                                strlen(buf));
+            if (ret) {
+                return ret;
+            }
+            (*changes)++;
+            snprintf(cur.edge, sizeof(cur.edge), "%s", buf);
+        }
+
+        snprintf(buf, sizeof(buf), "%s", !output ? want->direction :
+                 strcmp(want->value, "0") ? "high" : "low");
+        ret = gpio_set_attr(want->gpio, GPIO_ATTR_DIRECTION, buf,
+                            strlen(buf));
+        if (ret) {
+            return ret;
+        }
+        (*changes)++;
+    }
+
+    if (want->edge[0] != '\0' && strcmp(cur.edge, want->edge)) {
+        snprintf(buf, sizeof(buf), "%s", want->edge);
+        ret = gpio_set_attr(want->gpio, GPIO_ATTR_EDGE, buf, strlen(buf));
+        if (ret) {
+            return ret;
+        }
+        (*changes)++;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Bring every pin of a snapshot back to its recorded state
+ *
+ * Each pin is compared with its recorded state and only the differences
+ * are written: pins exported since the snapshot are unexported, pins
+ * that were exported get their direction, output level and edge back.
+ * Pins that did not change cost no greybus operation.
+ *
+ * @param snap The snapshot
+ * @param changes Number of sysfs writes done, may be NULL
+ * @return 0 on success, error code of the first failing pin
+ */
+int gpio_snapshot_restore(const struct gpio_snapshot *snap, int *changes)
+{
+    int i = 0, ret = 0, err = 0, count = 0;
+
+    for (i = 0; i < snap->count; i++) {
+        err = gpio_restore_pin(&snap->pins[i], &count);
+        if (err && !ret) {
+            ret = err;
+        }
+    }
+
+    if (changes != NULL) {
+        *changes = count;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Wait for an edge on an exported input GPIO
+ *
+ * The edge attribute must be armed first, and the value read once to clear
+ * the pending state. The value is read again after the wakeup, which both
+ * returns the new level and re-arms the notification.
+ *
+ * @param gpio GPIO number
+ * @param timeout_ms poll() timeout, -1 waits forever
+ * @return 0 or 1 level on edge, -ETIMEDOUT on timeout, error code on failure
+ */
+int gpio_wait_edge(int gpio, int timeout_ms)
+{
+    struct pollfd pfd;
+    char value[8];
+    int ret = 0;
+
+    pfd.fd = gpio_attr_fd(gpio, GPIO_ATTR_VALUE);
+    if (pfd.fd < 0) {
+        return pfd.fd;
+    }
+    pfd.events = POLLPRI | POLLERR;
+    pfd.revents = 0;
+
+    ret = poll(&pfd, 1, timeout_ms);
+    if (ret < 0) {
+        return -errno;
+    } else if (ret == 0) {
+        return -ETIMEDOUT;
+    }
+
+    ret = debugfs_read_attr(pfd.fd, value, sizeof(value));
+    return ret ? ret : value[0] == '1';
+}
+
+#ifdef HAVE_LINUX_GPIO_H
+/**
+ * @brief Request GPIO lines through the gpio chardev
+ *
+ * All lines are configured by one GPIO_GET_LINEHANDLE_IOCTL and share the
+ * returned line handle. The lines must not be exported to sysfs.
+ *
+ * @param chipnum N of /dev/gpiochipN
+ * @param offsets Line offsets within the controller
+ * @param nlines Number of lines, up to GPIOHANDLES_MAX
+ * @param output Non-zero to request outputs, zero for inputs
+ * @param values Initial output values, NULL for all low
+ * @param consumer Consumer label shown by the kernel
+ * @return line handle file descriptor on success, error code on failure
+ */
+int gpio_cdev_request(int chipnum, const int *offsets, int nlines, int output,
+                      const uint8_t *values, const char *consumer)
+{
+    struct gpiohandle_request req;
+    char devname[32];
+    int fd, ret, i;
+
+    if (chipnum < 0 || offsets == NULL || nlines < 1 ||
+        nlines > GPIOHANDLES_MAX) {
+        return -EINVAL;
+    }
+
+    snprintf(devname, sizeof(devname), "/dev/gpiochip%d", chipnum);
+    fd = open(devname, O_RDWR);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    memset(&req, 0, sizeof(req));
+    for (i = 0; i < nlines; i++) {
+        req.lineoffsets[i] = offsets[i];
+        req.default_values[i] = values ? values[i] : 0;
+    }
+    req.lines = nlines;
+    req.flags = output ? GPIOHANDLE_REQUEST_OUTPUT : GPIOHANDLE_REQUEST_INPUT;
+    snprintf(req.consumer_label, sizeof(req.consumer_label), "%s",
+             consumer ? consumer : "fwtest");
+
+    ret = ioctl(fd, GPIO_GET_LINEHANDLE_IOCTL, &req);
+    if (ret < 0) {
+        ret = -errno;
+    }
+    close(fd);
+
+    return ret < 0 ? ret : req.fd;
+}
+
+/**
+ * @brief Set the values of all lines of a line handle
+ *
+ * @param fd Line handle returned by gpio_cdev_request()
+ * @param values One value per requested line
+ * @param nlines Number of requested lines
+ * @return 0 on success, error code on failure
+ */
+int gpio_cdev_set_values(int fd, const uint8_t *values, int nlines)
+{
+    struct gpiohandle_data data;
+
+    if (nlines < 1 || nlines > GPIOHANDLES_MAX) {
+        return -EINVAL;
+    }
+
+    memcpy(data.values, values, nlines);
+    if (ioctl(fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the values of all lines of a line handle
+ *
+ * @param fd Line handle returned by gpio_cdev_request()
+ * @param values One value per requested line
+ * @param nlines Number of requested lines
+ * @return 0 on success, error code on failure
+ */
+int gpio_cdev_get_values(int fd, uint8_t *values, int nlines)
+{
+    struct gpiohandle_data data;
+
+    if (nlines < 1 || nlines > GPIOHANDLES_MAX) {
+        return -EINVAL;
+    }
+
+    if (ioctl(fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0) {
+        return -errno;
+    }
+    memcpy(values, data.values, nlines);
+
+    return 0;
+}
+
+/**
+ * @brief Get the direction of GPIO lines through the gpio chardev
+ *
+ * Works for lines that are not requested by anyone, the chip is opened
+ * once for all lines.
+ *
+ * @param chipnum N of /dev/gpiochipN
+ * @param offsets Line offsets within the controller
+ * @param nlines Number of lines
+ * @param output Returns 1 per output line, 0 per input line
+ * @return 0 on success, error code on failure
+ */
+int gpio_cdev_get_directions(int chipnum, const int *offsets, int nlines,
+                             uint8_t *output)
+{
+    struct gpioline_info linfo;
+    char devname[32];
+    int fd, i, ret = 0;
+
+    if (chipnum < 0 || offsets == NULL || output == NULL || nlines < 1) {
+        return -EINVAL;
+    }
+
+    snprintf(devname, sizeof(devname), "/dev/gpiochip%d", chipnum);
+    fd = open(devname, O_RDWR);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    for (i = 0; i < nlines; i++) {
+        memset(&linfo, 0, sizeof(linfo));
+        linfo.line_offset = offsets[i];
+        if (ioctl(fd, GPIO_GET_LINEINFO_IOCTL, &linfo) < 0) {
+            ret = -errno;
+            break;
+        }
+        output[i] = !!(linfo.flags & GPIOLINE_FLAG_IS_OUT);
+    }
+    close(fd);
+
+    return ret;
+}
+
+/**
+ * @brief Request one GPIO line as edge event source through the gpio chardev
+ *
+ * @param chipnum N of /dev/gpiochipN
+ * @param offset Line offset within the controller
+ * @param edge GPIO_EDGE_RISING, GPIO_EDGE_FALLING or GPIO_EDGE_BOTH
+ * @param consumer Consumer label shown by the kernel
+ * @return line event file descriptor on success, error code on failure
+ */
+int gpio_cdev_request_event(int chipnum, int offset, int edge,
+                            const char *consumer)
+{
+    struct gpioevent_request req;
+    char devname[32];
+    int fd, ret;
+
+    if (chipnum < 0 || offset < 0 || !(edge & GPIO_EDGE_BOTH)) {
+        return -EINVAL;
+    }
+
+    snprintf(devname, sizeof(devname), "/dev/gpiochip%d", chipnum);
+    fd = open(devname, O_RDWR);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.lineoffset = offset;
+    req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    if (edge & GPIO_EDGE_RISING) {
+        req.eventflags |= GPIOEVENT_REQUEST_RISING_EDGE;
+    }
+    if (edge & GPIO_EDGE_FALLING) {
+        req.eventflags |= GPIOEVENT_REQUEST_FALLING_EDGE;
+    }
+    snprintf(req.consumer_label, sizeof(req.consumer_label), "%s",
+             consumer ? consumer : "fwtest");
+
+    ret = ioctl(fd, GPIO_GET_LINEEVENT_IOCTL, &req);
+    if (ret < 0) {
+        ret = -errno;
+    }
+    close(fd);
+
+    return ret < 0 ? ret : req.fd;
+}
+
+/**
+ * @brief Wait for and read one line event
+ *
+ * The timestamp is taken by the kernel in the interrupt handler. Kernels
+ * before 5.7 use CLOCK_REALTIME, later ones CLOCK_MONOTONIC.
+ *
+ * @param fd Line event descriptor returned by gpio_cdev_request_event()
+ * @param timeout_ms poll() timeout, -1 waits forever
+ * @param timestamp Returns the event time in nanoseconds, may be NULL
+ * @param edge Returns GPIO_EDGE_RISING or GPIO_EDGE_FALLING, may be NULL
+ * @return 0 on success, -ETIMEDOUT on timeout, error code on failure
+ */
+int gpio_cdev_read_event(int fd, int timeout_ms, uint64_t *timestamp,
+                         int *edge)
+{
+    struct gpioevent_data event;
+    struct pollfd pfd;
+    int ret = 0;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    ret = poll(&pfd, 1, timeout_ms);
+    if (ret < 0) {
+        return -errno;
+    } else if (ret == 0) {
+        return -ETIMEDOUT;
+    }
+
+    if (read(fd, &event, sizeof(event)) != sizeof(event)) {
+        return -EIO;
+    }
+
+    if (timestamp != NULL) {
+        *timestamp = event.timestamp;
+    }
+    if (edge != NULL) {
+        *edge = event.id == GPIOEVENT_EVENT_RISING_EDGE ?
+                GPIO_EDGE_RISING : GPIO_EDGE_FALLING;
+    }
+
+    return 0;
+}
+#else
+int gpio_cdev_request(int chipnum, const int *offsets, int nlines, int output,
+                      const uint8_t *values, const char *consumer)
+{
+    return -ENOSYS;
+}
+
+int gpio_cdev_set_values(int fd, const uint8_t *values, int nlines)
+{
+    return -ENOSYS;
+}
+
+int gpio_cdev_get_values(int fd, uint8_t *values, int nlines)
+{
+    return -ENOSYS;
+}
+
+int gpio_cdev_get_directions(int chipnum, const int *offsets, int nlines,
+                             uint8_t *output)
+{
+    return -ENOSYS;
+}
+
+int gpio_cdev_request_event(int chipnum, int offset, int edge,
+                            const char *consumer)
+{
+    return -ENOSYS;
+}
+
+int gpio_cdev_read_event(int fd, int timeout_ms, uint64_t *timestamp,
+                         int *edge)
+{
+    return -ENOSYS;
+}
+#endif
+
+/**
+ * @brief Release a line handle returned by gpio_cdev_request()
+ *
+ * @param fd Line handle
+ * @return None
+ */
+void gpio_cdev_release(int fd)
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+}
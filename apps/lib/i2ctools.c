@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "./include/libfwtest.h"
+
+/* Max length of I2C device node name */
+#define I2C_DEVNAME_LEN 32
+
+/**
+ * @brief open I2C devices.
+ *
+ * @param i2cbus HW I2C bus.
+ *
+ * @return file The new file descriptor, or -1 if an error occurred.
+ */
+int open_i2c_dev(int i2cbus)
+{
+    int file;
+    char devname[I2C_DEVNAME_LEN];
+    size_t size = sizeof(devname);
+
+    snprintf(devname, size, "/dev/i2c-%d", i2cbus);
+    file = open(devname, O_RDWR);
+
+    if (file < 0 && (errno == ENOENT || errno == ENOTDIR))
+    {
+        snprintf(devname, size, "/dev/i2c/%d", i2cbus);
+        file = open(devname, O_RDWR);
+    }
+
+    return file;
+}
+
+/**
+ * @brief set I2C devuce as slave.
+ *
+ * @param file The file descriptor return from open().
+ *
+ * @param address The I2C device address.
+ *
+ * @return 0 for success, -error if fail.
+ */
+int force_set_slave_addr(int file, int address)
+{
+    if (ioctl(file, I2C_SLAVE_FORCE, address) < 0) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief read I2C registers with one combined transaction.
+ *
+ * Issues the register index write and the data read as two segments of a
+ * single I2C_RDWR ioctl (repeated start), so the whole register access is
+ * one syscall and one greybus I2C transfer operation.
+ *
+ * @param file The file descriptor return from open().
+ * @param address The I2C device address.
+ * @param index The first register index.
+ * @param buf The buffer receiving the register values.
+ * @param len Number of registers to read.
+ *
+ * @return 0 for success, -error if fail.
+ */
+int i2c_rdwr_read_regs(int file, int address, uint8_t index, uint8_t *buf,
+                       int len)
+{
+    struct i2c_msg msgs[2];
+    struct i2c_rdwr_ioctl_data data;
+
+    msgs[0].addr = address;
+    msgs[0].flags = 0;
+    msgs[0].len = 1;
+    msgs[0].buf = &index;
+
+    msgs[1].addr = address;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len = len;
+    msgs[1].buf = buf;
+
+    data.msgs = msgs;
+    data.nmsgs = 2;
+
+    if (ioctl(file, I2C_RDWR, &data) < 0) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief set the transfer timeout of the I2C adapter.
+ *
+ * The setting is per adapter, not per file, and the kernel keeps it in
+ * units of 10 ms.
+ *
+ * @param file The file descriptor return from open().
+ * @param timeout_ms The timeout, rounded up to 10 ms.
+ *
+ * @return 0 for success, -error if fail.
+ */
+int i2c_set_timeout(int file, int timeout_ms)
+{
+    if (ioctl(file, I2C_TIMEOUT, (timeout_ms + 9) / 10) < 0) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief set the number of retries of the I2C adapter.
+ *
+ * The I2C core retries a transfer the adapter fails with -EAGAIN, e.g. on
+ * lost arbitration. The setting is per adapter, not per file.
+ *
+ * @param file The file descriptor return from open().
+ * @param retries Retries after the first attempt.
+ *
+ * @return 0 for success, -error if fail.
+ */
+int i2c_set_retries(int file, int retries)
+{
+    if (ioctl(file, I2C_RETRIES, retries) < 0) {
+        return -errno;
+    }
+
+    return 0;
+}
@@ -26,14 +26,676 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifndef __LIBFWTEST_H__
+#define __LIBFWTEST_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <termios.h>
+
 /* libfwtest.h */
 void dumpargs(int argc, char **argv);
 
 /* implement in log.c */
+#define LOG_LEVEL_RESULT 0
+#define LOG_LEVEL_DEBUG  1
+
+/*
+ * Startup marks, written to the FWTEST_STARTUP_FD pipe set up by
+ * startup_time. libfwtest sends the main and result marks by itself.
+ */
+enum startup_mark_type {
+    /** by startup_time, right before execve() */
+    STARTUP_MARK_EXEC,
+    /** constructor, after the binary and libc started, before main() */
+    STARTUP_MARK_MAIN,
+    /** first [A] line */
+    STARTUP_MARK_RESULT,
+};
+
+struct startup_mark {
+    uint32_t type;
+    uint32_t reserved;
+    /** stats_now_ns() */
+    uint64_t ts;
+};
+
+void log_set_level(int level);
+int log_get_level(void);
+void log_set_buffered(int buffered);
+void log_flush(void);
 void print_test_case_result(char *TAG, int case_id, int result, char *data);
 void print_test_case_result_only(int case_id, int result);
 void print_test_case_log(char *TAG, int case_id, char *data);
+void print_test_case_perf(int case_id, const char *metric, double value,
+                          const char *unit);
+void print_test_case_check(int case_id, const char *check, int result);
+
+/* results */
+#define RESULTS_MAGIC    0x52545746 /* "FWTR" little endian */
+#define RESULTS_VERSION  1
+#define RESULTS_NAME_LEN 64
+#define RESULTS_UNIT_LEN 16
+#define RESULTS_TEXT_LEN 1024
+
+enum results_rec_type {
+    /** body: uint32_t id, then the name and unit strings */
+    RESULTS_REC_METRIC = 1,
+    /** body: struct results_rec_value */
+    RESULTS_REC_VALUE,
+    /** body: int32_t result, then the tag and data strings */
+    RESULTS_REC_RESULT,
+    /** body: int32_t result, then the check name */
+    RESULTS_REC_CHECK,
+};
+
+struct results_file_hdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t hdr_len;
+};
+
+/* every record starts with this, len includes it and is a multiple of 8 */
+struct results_rec_hdr {
+    uint16_t len;
+    uint8_t type;
+    uint8_t reserved;
+    int32_t case_id;
+    /** stats_now_ns() */
+    uint64_t ts;
+};
+
+struct results_rec_value {
+    uint32_t id;
+    uint32_t reserved;
+    double value;
+};
+
+int results_open(const char *path);
+void results_close(void);
+void results_flush(void);
+int results_enabled(void);
+int results_metric_id(const char *metric, const char *unit);
+void results_value(int case_id, int metric_id, double value);
+void results_result(const char *tag, int case_id, int result,
+                    const char *data);
+void results_check(int case_id, const char *check, int result);
+
+/* stats */
+/* log2 sub-buckets per power of two of the latency histogram */
+#define STATS_SUB_BITS  5
+#define STATS_SUB_COUNT (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS   ((64 - STATS_SUB_BITS + 1) * STATS_SUB_COUNT)
+
+/* log-linear histogram, about 3% resolution over the whole uint64_t range */
+struct stats_hist {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[STATS_BUCKETS];
+};
+
+/* streaming mean and variance */
+struct stats_running {
+    uint64_t n;
+    double mean;
+    double m2;
+};
+
+uint64_t stats_now_ns(void);
+void stats_hist_init(struct stats_hist *hist);
+void stats_hist_record(struct stats_hist *hist, uint64_t value);
+void stats_hist_merge(struct stats_hist *dst, const struct stats_hist *src);
+uint64_t stats_hist_percentile(const struct stats_hist *hist, double pct);
+double stats_hist_mean(const struct stats_hist *hist);
+void stats_hist_report(int case_id, const char *name,
+                       const struct stats_hist *hist);
+void stats_hist_dump(const char *prefix, const struct stats_hist *hist);
+void stats_running_init(struct stats_running *run);
+void stats_running_add(struct stats_running *run, double value);
+double stats_running_mean(const struct stats_running *run);
+double stats_running_variance(const struct stats_running *run);
+
+/* CPU counters of measured regions, see perfcnt.c */
+enum stats_perf_counter {
+    STATS_PERF_CYCLES,
+    STATS_PERF_INSTRUCTIONS,
+    STATS_PERF_CTX_SWITCHES,
+    STATS_PERF_CACHE_MISSES,
+    STATS_PERF_MAX,
+};
+
+/* perf_event_open() group of the calling thread */
+struct stats_perf {
+    int leader;
+    int fd[STATS_PERF_MAX];
+    /** position in the group read, -1 if the counter did not open */
+    int slot[STATS_PERF_MAX];
+    int nslots;
+    /** kernel work is not counted */
+    int user_only;
+};
+
+/* counter values at the start of an operation */
+struct stats_perf_snap {
+    int valid;
+    uint64_t value[STATS_PERF_MAX];
+    uint64_t enabled;
+    uint64_t running;
+};
+
+/* counts of a region, summed over its operations */
+struct stats_perf_count {
+    uint64_t ops;
+    uint64_t value[STATS_PERF_MAX];
+    /** group enabled and running time, for multiplexing */
+    uint64_t enabled;
+    uint64_t running;
+};
+
+int stats_perf_open(struct stats_perf *perf);
+void stats_perf_close(struct stats_perf *perf);
+int stats_perf_begin(const struct stats_perf *perf,
+                     struct stats_perf_snap *snap);
+void stats_perf_end(const struct stats_perf *perf,
+                    const struct stats_perf_snap *snap,
+                    struct stats_perf_count *count);
+void stats_perf_count_init(struct stats_perf_count *count);
+void stats_perf_count_merge(struct stats_perf_count *dst,
+                            const struct stats_perf_count *src);
+void stats_perf_report(int case_id, const char *name,
+                       const struct stats_perf *perf,
+                       const struct stats_perf_count *count);
+
+/* event loop, see evloop.c */
+#define EVLOOP_MAX_SOURCES 64
+/* rate of a source that ticks whenever the loop wakes up */
+#define EVLOOP_BACK_TO_BACK (-1.0)
+
+struct evloop_source;
+
+/*
+ * Source callback, events are the epoll events of the fd or 0 for a rate
+ * tick. A negative return counts as an error of the source.
+ */
+typedef int (*evloop_fn)(struct evloop_source *src, uint32_t events);
+
+struct evloop_source {
+    /* set by the caller */
+    int fd;
+    uint32_t events;
+    /** ticks per second, 0 for none or EVLOOP_BACK_TO_BACK */
+    double rate;
+    evloop_fn fn;
+    void *priv;
+
+    /* kept by the loop */
+    uint64_t period_ns;
+    uint64_t next_ns;
+    uint64_t ticks;
+    /** ticks dropped because the loop was a period or more late */
+    uint64_t missed;
+    uint64_t wakeups;
+    uint64_t errors;
+    /** how late each tick ran */
+    struct stats_hist late;
+};
+
+struct evloop {
+    int epoll_fd;
+    int timer_fd;
+    int stop;
+    int nsources;
+    struct evloop_source *sources[EVLOOP_MAX_SOURCES];
+    uint64_t wakeups;
+};
+
+int evloop_init(struct evloop *loop);
+void evloop_close(struct evloop *loop);
+int evloop_add(struct evloop *loop, struct evloop_source *src);
+void evloop_stop(struct evloop *loop);
+int evloop_run(struct evloop *loop);
+
+/* lock-free sample ring, see ring.c */
+#define SAMPLE_RING_ALIGN 64
+
+/* one measured operation */
+struct sample_rec {
+    /** latency in ns */
+    uint64_t ns;
+    uint32_t bytes;
+    /** 0 or the -errno of a failed operation */
+    int32_t ret;
+};
+
+struct sample_ring {
+    struct sample_rec *recs;
+    uint64_t mask;
+    /* producer side */
+    uint64_t head __attribute__((aligned(SAMPLE_RING_ALIGN)));
+    uint64_t tail_cache;
+    uint64_t dropped;
+    /* consumer side */
+    uint64_t tail __attribute__((aligned(SAMPLE_RING_ALIGN)));
+    uint64_t head_cache;
+} __attribute__((aligned(SAMPLE_RING_ALIGN)));
+
+int sample_ring_init(struct sample_ring *ring, size_t size);
+void sample_ring_free(struct sample_ring *ring);
+int sample_ring_push(struct sample_ring *ring, const struct sample_rec *rec);
+size_t sample_ring_pop(struct sample_ring *ring, struct sample_rec *recs,
+                       size_t max);
+uint64_t sample_ring_dropped(const struct sample_ring *ring);
+
+/* sweep */
+/* Max number of values in one sweep list */
+#define SWEEP_MAX 32
+
+struct sweep {
+    int count;
+    int value[SWEEP_MAX];
+};
+
+int sweep_parse(struct sweep *sweep, const char *list, int min, int max);
+
+/* bench */
+#define BENCH_MAX_CPUS      64
+#define BENCH_MAX_POLICIES  8
+#define BENCH_GOVERNOR_LEN  32
+
+/* a cpufreq policy and its settings before bench_env_apply() */
+struct bench_cpufreq {
+    /** first CPU of the policy */
+    int cpu;
+    /** mask of its related_cpus */
+    uint64_t cpus;
+    char dir[64];
+    char governor[BENCH_GOVERNOR_LEN];
+    /** scaling_min_freq and scaling_max_freq, in kHz */
+    char min[16];
+    char max[16];
+};
+
+/* benchmark environment, from bench_env_parse() */
+struct bench_env {
+    /** CPUs to pin to, 0 keeps the affinity */
+    uint64_t cpus;
+    /** SCHED_FIFO priority, 0 keeps the policy */
+    int fifo;
+    int mlock;
+    /** cpufreq settings, "" and 0 keep them */
+    char governor[BENCH_GOVERNOR_LEN];
+    long min_khz;
+    long max_khz;
+    /* set by bench_env_apply() */
+    int active;
+    int fifo_set;
+    int old_policy;
+    int old_priority;
+    int mlock_set;
+    int cpufreq_set;
+    int npolicies;
+    struct bench_cpufreq policies[BENCH_MAX_POLICIES];
+};
+
+int bench_env_parse(struct bench_env *env, const char *spec);
+int bench_env_apply(struct bench_env *env);
+void bench_env_restore(struct bench_env *env);
+void bench_env_report(const struct bench_env *env, int case_id);
+void bench_env_note(int case_id);
+
+/* pattern */
+uint32_t crc32_update(uint32_t crc, const void *buf, size_t len);
+void pattern_fill(void *buf, size_t len, uint64_t offset, uint64_t seed);
+int64_t pattern_check(const void *buf, size_t len, uint64_t offset,
+                      uint64_t seed);
+
+/* byte stream patterns, see pattern.c */
+enum pattern_type {
+    PATTERN_TYPE_LBA,
+    PATTERN_TYPE_INCR,
+    PATTERN_TYPE_PRBS31,
+    PATTERN_TYPE_MAX,
+};
+
+struct pattern_stream {
+    enum pattern_type type;
+    uint64_t seed;
+    /** stream offset of the next byte */
+    uint64_t offset;
+    /** PRBS31 generator register */
+    uint64_t prbs;
+    /** last 4 bytes checked, PRBS31 */
+    uint32_t hist;
+};
+
+int pattern_type_parse(const char *name);
+const char *pattern_type_name(enum pattern_type type);
+void pattern_stream_init(struct pattern_stream *ps, enum pattern_type type,
+                         uint64_t seed);
+void pattern_stream_fill(struct pattern_stream *ps, void *buf, size_t len);
+int64_t pattern_stream_check(struct pattern_stream *ps, const void *buf,
+                             size_t len);
 
 /* fwtools */
 int debugfs_get_attr(char *class_path, const char *attr, char *value, int len);
 int debugfs_set_attr(char *class_path, const char *attr, char *value, int len);
+int debugfs_open_attr(char *class_path, const char *attr, int flags);
+int debugfs_open_dir(const char *path);
+int debugfs_openat_attr(int dirfd, const char *attr, int flags);
+int debugfs_read_attr(int fd, char *value, int len);
+int debugfs_write_attr(int fd, char *value, int len);
+void debugfs_close_attr(int fd);
+
+/* i2ctools */
+int open_i2c_dev(int i2cbus);
+int force_set_slave_addr(int file, int address);
+int i2c_rdwr_read_regs(int file, int address, uint8_t index, uint8_t *buf,
+                       int len);
+int i2c_set_timeout(int file, int timeout_ms);
+int i2c_set_retries(int file, int retries);
+
+/* spitools */
+/* SPI_IOC_MESSAGE() encodes the array size in 14 bits */
+#define SPI_MAX_MESSAGE_XFERS 511
+struct spi_ioc_transfer;
+int open_spi_dev(int bus, int cs);
+int spi_setup(int file, uint8_t mode, uint8_t bits, uint32_t speed_hz);
+int spi_transfer_message(int file, struct spi_ioc_transfer *xfers, int n);
+int spi_get_bufsiz(void);
+
+/* uarttools */
+int uart_baud_to_speed(int baud, speed_t *speed);
+int open_uart_tty(const char *path);
+int uart_set_raw(int file, int baud, int flow);
+int uart_set_line(int file, int baud, int bits, char parity, int stop,
+                  int flow);
+
+/*
+ * Loopback test frame: magic, flags, 32 bit little endian sequence
+ * number, payload derived from the sequence number, checksum of all bytes
+ * before it.
+ */
+#define UART_FRAME_SIZE 32
+#define UART_FRAME_MAGIC 0xa5
+/* flags, the first frame of a burst */
+#define UART_FRAME_FIRST 0x01
+#define UART_FRAME_HDR_LEN 6
+
+void uart_frame_build(uint8_t *frame, uint32_t seq, uint8_t flags);
+int uart_frame_check(const uint8_t *frame, uint32_t *seq);
+
+/* camtools */
+/* a pixel format and frame size of a V4L2 capture device */
+struct cam_mode {
+    uint32_t pixelformat;
+    uint32_t width;
+    uint32_t height;
+};
+
+int open_video_dev(const char *path);
+int cam_enum_modes(int file, struct cam_mode *modes, int max);
+char *cam_fourcc(uint32_t pixelformat, char *buf);
+
+/* pcmtools */
+int open_pcm_dev(int card, int device);
+int pcm_set_params(int file, int rate, int channels, int *period_frames,
+                   int *periods);
+int pcm_prepare(int file);
+int pcm_write_frames(int file, const void *buf, int frames);
+int pcm_delay(int file, long *frames);
+
+/* tracing */
+/* trace_marker prefix of the call marks, "fwtest:B name" */
+#define TRACE_MARK_PREFIX "fwtest:"
+
+/* layout of a trace_pipe_raw ring buffer page, from events/header_page */
+struct trace_page_layout {
+    int page_size;
+    int ts_offset;
+    int commit_offset;
+    int commit_size;
+    int data_offset;
+};
+
+typedef void (*trace_event_fn)(void *ctx, int cpu, uint64_t ts,
+                               const uint8_t *data, int len);
+
+const char *tracefs_dir(void);
+int tracefs_read(const char *file, char *buf, int len);
+int tracefs_write(const char *file, const char *value);
+int trace_event_id(const char *system, const char *event);
+int trace_event_field(const char *system, const char *event,
+                      const char *field, int *offset, int *size);
+int trace_page_layout(struct trace_page_layout *layout);
+int trace_parse_page(const struct trace_page_layout *layout,
+                     const uint8_t *page, int cpu, trace_event_fn fn,
+                     void *ctx);
+int trace_drain(const struct trace_page_layout *layout, trace_event_fn fn,
+                void *ctx);
+void trace_call_begin(const char *name);
+void trace_call_end(const char *name);
+
+/* uevent */
+#define UEVENT_BUF_LEN 4096
+
+/* a kernel uevent, the strings point into buf and are "" when absent */
+struct uevent {
+    /** arrival time, stats_now_ns() */
+    uint64_t ts;
+    const char *action;
+    const char *devpath;
+    const char *subsystem;
+    const char *devtype;
+    const char *devname;
+    int len;
+    char buf[UEVENT_BUF_LEN];
+};
+
+/* uevent_wait() filter, NULL members match anything */
+struct uevent_filter {
+    /** "add", "remove", "change", "bind", ... */
+    const char *action;
+    const char *subsystem;
+    const char *devtype;
+    /** substring of DEVPATH */
+    const char *devpath;
+    /** "KEY=value" the uevent must carry, or just "KEY" */
+    const char *env;
+};
+
+int uevent_open(void);
+void uevent_close(int sock);
+int uevent_recv(int sock, struct uevent *ev, int timeout_ms);
+const char *uevent_get(const struct uevent *ev, const char *key);
+int uevent_match(const struct uevent *ev, const struct uevent_filter *filter);
+int uevent_wait(int sock, const struct uevent_filter *filter, int timeout_ms,
+                struct uevent *ev);
+int uevent_wait_sysfs(const char *path, int present, int timeout_ms);
+int uevent_wait_devnode(const char *path, int timeout_ms);
+
+/* discovery */
+#define GB_MAX_GPIO_CHIPS   8
+#define GB_MAX_I2C_ADAPTERS 8
+#define GB_MAX_BUNDLES      32
+#define GB_KEY_LEN          64
+
+struct gb_gpio_chip {
+    /** first GPIO number of the controller */
+    int base;
+    /** number of GPIO lines */
+    int ngpio;
+    /** N of /dev/gpiochipN, -1 if the kernel has no gpio chardev */
+    int chipnum;
+};
+
+struct gb_bundle {
+    /** greybus device name, e.g. "1-2.2" */
+    char name[32];
+    /** greybus bundle class */
+    int class_id;
+};
+
+struct gb_discovery {
+    char key[GB_KEY_LEN];
+    int ngpio_chips;
+    struct gb_gpio_chip gpio_chips[GB_MAX_GPIO_CHIPS];
+    int ni2c_adapters;
+    int i2c_busid[GB_MAX_I2C_ADAPTERS];
+    int nbundles;
+    struct gb_bundle bundles[GB_MAX_BUNDLES];
+};
+
+const struct gb_discovery *gb_discover(int rescan);
+int gb_find_gpio_chip(int index, int *base, int *ngpio);
+int gb_find_i2c_adapter(int index, int *busid);
+const struct gb_bundle *gb_find_bundle(int index, int class_id);
+int gb_find_sd_blockdev(int index, char *path, int len);
+int gb_find_spi_dev(int index, int *bus, int *cs);
+int gb_find_uart_tty(int index, char *path, int len);
+int gb_find_video_dev(int index, char *path, int len);
+int gb_find_sound_card(int index, int *card);
+int gb_find_loopback(int index, char *path, int len);
+int gb_find_pwm_chip(int index, int *chip, int *npwm);
+
+/* enum */
+#define GB_ENUM_MAX_DEVS  64
+#define GB_ENUM_MAX_ATTRS 6
+#define GB_ENUM_ATTR_LEN  32
+#define GB_ENUM_NAME_LEN  32
+#define GB_ENUM_MASK(c)   (1U << (c))
+
+enum gb_enum_class {
+    GB_ENUM_GPIO,
+    GB_ENUM_I2C,
+    GB_ENUM_SPI,
+    GB_ENUM_SD,
+    GB_ENUM_UART,
+    GB_ENUM_VIDEO,
+    GB_ENUM_SOUND,
+    GB_ENUM_PWM,
+    GB_ENUM_NCLASSES,
+};
+
+/* a Greybus device found by gb_enum() */
+struct gb_enum_dev {
+    int dev_class;
+    /** numbers of the sysfs entry name, e.g. 1 and 0 of spidev1.0 */
+    int num[2];
+    /** sysfs entry name in the class directory */
+    char name[GB_ENUM_NAME_LEN];
+    /** greybus bundle the device belongs to, e.g. "1-2.2" */
+    char bundle[16];
+    /** device node, "" if the class has none */
+    char node[GB_ENUM_NAME_LEN + 16];
+    /** class attributes, in the order of the class table */
+    char attr[GB_ENUM_MAX_ATTRS][GB_ENUM_ATTR_LEN];
+};
+
+int gb_enum(unsigned int classes, struct gb_enum_dev *devs, int max);
+const char *gb_enum_class_name(int dev_class);
+const char *gb_enum_attr(const struct gb_enum_dev *dev, const char *attr);
+void gb_enum_print(const char *tag, const struct gb_enum_dev *dev);
+
+/* agent */
+/* Default fwtestd socket, FWTESTD_SOCKET overrides it */
+#define AGENT_SOCKET   "/data/local/tmp/fwtestd.sock"
+#define AGENT_MSG_LEN  4096
+#define AGENT_CWD_LEN  256
+#define AGENT_MAX_ARGS 64
+#define AGENT_MAX_ENV  16
+#define AGENT_MAX_JOBS 16
+
+/* a test command received by fwtestd */
+struct agent_cmd {
+    const char *cwd;
+    int argc;
+    char *argv[AGENT_MAX_ARGS + 1];
+    int nenv;
+    char *env[AGENT_MAX_ENV];
+    /** stdin, stdout and stderr of the client */
+    int fds[3];
+    char buf[AGENT_MSG_LEN];
+};
+
+const char *agent_socket(void);
+int agent_listen(const char *path);
+int agent_connect(const char *path);
+int agent_send_cmd(int sock, int argc, char **argv, char **envp);
+int agent_recv_cmd(int sock, struct agent_cmd *cmd);
+int agent_send_status(int sock, int status);
+int agent_recv_status(int sock, int *status);
+
+/* gpio */
+enum gpio_attr {
+    GPIO_ATTR_DIRECTION,
+    GPIO_ATTR_VALUE,
+    GPIO_ATTR_EDGE,
+    GPIO_ATTR_MAX,
+};
+
+/* line event edges, for gpio_cdev_request_event() */
+#define GPIO_EDGE_RISING  0x1
+#define GPIO_EDGE_FALLING 0x2
+#define GPIO_EDGE_BOTH    (GPIO_EDGE_RISING | GPIO_EDGE_FALLING)
+
+/* Max number of GPIO pins one snapshot records */
+#define GPIO_SNAPSHOT_MAX 64
+
+/* sysfs state of one GPIO pin, attributes are empty when not exported */
+struct gpio_pin_state {
+    int gpio;
+    int exported;
+    char direction[8];
+    /* only recorded for outputs, the level of an input is not ours */
+    char value[8];
+    char edge[8];
+};
+
+struct gpio_snapshot {
+    int count;
+    struct gpio_pin_state pins[GPIO_SNAPSHOT_MAX];
+};
+
+int gpio_attr_fd(int gpio, enum gpio_attr attr);
+void gpio_attr_release(int gpio);
+int gpio_get_attr(int gpio, enum gpio_attr attr, char *value, int len);
+int gpio_set_attr(int gpio, enum gpio_attr attr, char *value, int len);
+int gpio_export(int gpio);
+int gpio_unexport(int gpio);
+void gpio_snapshot_init(struct gpio_snapshot *snap);
+int gpio_snapshot_add(struct gpio_snapshot *snap, int gpio);
+int gpio_snapshot_restore(const struct gpio_snapshot *snap, int *changes);
+int gpio_wait_edge(int gpio, int timeout_ms);
+int gpio_cdev_request(int chipnum, const int *offsets, int nlines, int output,
+                      const uint8_t *values, const char *consumer);
+int gpio_cdev_set_values(int fd, const uint8_t *values, int nlines);
+int gpio_cdev_get_values(int fd, uint8_t *values, int nlines);
+int gpio_cdev_get_directions(int chipnum, const int *offsets, int nlines,
+                             uint8_t *output);
+int gpio_cdev_request_event(int chipnum, int offset, int edge,
+                            const char *consumer);
+int gpio_cdev_read_event(int fd, int timeout_ms, uint64_t *timestamp,
+                         int *edge);
+void gpio_cdev_release(int fd);
+
+/* pwm */
+enum pwm_attr {
+    PWM_ATTR_PERIOD,
+    PWM_ATTR_DUTY_CYCLE,
+    PWM_ATTR_ENABLE,
+    PWM_ATTR_POLARITY,
+    PWM_ATTR_MAX,
+};
+
+int pwm_attr_fd(int chip, int channel, enum pwm_attr attr);
+void pwm_attr_release(int chip, int channel);
+int pwm_get_attr(int chip, int channel, enum pwm_attr attr, char *value,
+                 int len);
+int pwm_set_attr(int chip, int channel, enum pwm_attr attr, char *value,
+                 int len);
+int pwm_export(int chip, int channel);
+int pwm_unexport(int chip, int channel);
+
+#endif
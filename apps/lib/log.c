@@ -27,8 +27,197 @@
  */
 
 #include "stdio.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include "./include/libfwtest.h"
 
+/* Size of the in-memory [D] line buffer */
+#define LOG_BUF_SIZE (64 * 1024)
+
+static int log_level = -1;
+static int log_buffered;
+static char log_buf[LOG_BUF_SIZE];
+static size_t log_len;
+/* the buffer may be filled from several threads */
+static char log_lock;
+/* FWTEST_STARTUP_FD when run by startup_time, until the first [A] line */
+static int startup_fd = -1;
+
+static void log_flush_locked(void)
+{
+    if (log_len) {
+        fwrite(log_buf, 1, log_len, stdout);
+        log_len = 0;
+    }
+    fflush(stdout);
+}
+
+/**
+ * @brief Write all buffered [D] lines to stdout.
+ */
+void log_flush(void)
+{
+    while (__atomic_test_and_set(&log_lock, __ATOMIC_ACQUIRE)) {
+    }
+    log_flush_locked();
+    __atomic_clear(&log_lock, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Apply the FWTEST_LOG_LEVEL and FWTEST_LOG_BUFFER environment
+ * variables, once.
+ */
+static void log_init(void)
+{
+    const char *env;
+
+    if (log_level >= 0) {
+        return;
+    }
+
+    log_level = LOG_LEVEL_DEBUG;
+    env = getenv("FWTEST_LOG_LEVEL");
+    if (env != NULL && *env) {
+        log_level = atoi(env);
+    }
+
+    env = getenv("FWTEST_LOG_BUFFER");
+    if (env != NULL && *env) {
+        log_buffered = atoi(env);
+    }
+
+    atexit(log_flush);
+}
+
+/**
+ * @brief Set the log level.
+ *
+ * LOG_LEVEL_RESULT only prints [A], [I] and [P] lines, LOG_LEVEL_DEBUG
+ * (the default) also prints [D] lines.
+ *
+ * @param level The log level.
+ */
+void log_set_level(int level)
+{
+    log_init();
+    log_level = level;
+}
+
+/**
+ * @brief Get the log level.
+ *
+ * @return the log level, LOG_LEVEL_RESULT or LOG_LEVEL_DEBUG.
+ */
+int log_get_level(void)
+{
+    log_init();
+    return log_level;
+}
+
+/**
+ * @brief Keep [D] lines in memory instead of printing them one by one.
+ *
+ * Buffered lines are written in bulk before the next [A] line, on a
+ * failing result, when the buffer is full and at exit. Turning buffering
+ * off flushes the buffer.
+ *
+ * @param buffered Non-zero to buffer [D] lines.
+ */
+void log_set_buffered(int buffered)
+{
+    log_init();
+    if (!buffered) {
+        log_flush();
+    }
+    log_buffered = buffered;
+}
+
+/**
+ * @brief Print a [D] line to stdout or the buffer.
+ */
+static void log_debug_line(const char *fmt, ...)
+{
+    char line[512];
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+
+    if (len < 0) {
+        return;
+    } else if (len >= (int)sizeof(line)) {
+        len = sizeof(line) - 1;
+    }
+
+    if (!log_buffered) {
+        fwrite(line, 1, len, stdout);
+        return;
+    }
+
+    while (__atomic_test_and_set(&log_lock, __ATOMIC_ACQUIRE)) {
+    }
+    if (log_len + len > sizeof(log_buf)) {
+        log_flush_locked();
+    }
+    memcpy(log_buf + log_len, line, len);
+    log_len += len;
+    __atomic_clear(&log_lock, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Send a startup mark to startup_time.
+ */
+static void startup_mark(uint32_t type)
+{
+    struct startup_mark mark = { type, 0, stats_now_ns() };
+
+    if (write(startup_fd, &mark, sizeof(mark)) != sizeof(mark)) {
+        close(startup_fd);
+        startup_fd = -1;
+    }
+}
+
+/**
+ * @brief Send the main mark when run by startup_time.
+ *
+ * Runs as a constructor, once the kernel loaded the binary and libc
+ * finished its startup. Apps this one runs are not measured.
+ */
+static void __attribute__((constructor)) startup_init(void)
+{
+    const char *fd = getenv("FWTEST_STARTUP_FD");
+
+    if (fd == NULL) {
+        return;
+    }
+
+    unsetenv("FWTEST_STARTUP_FD");
+    startup_fd = atoi(fd);
+    fcntl(startup_fd, F_SETFD, FD_CLOEXEC);
+    startup_mark(STARTUP_MARK_MAIN);
+}
+
+/**
+ * @brief print the [A] line of a test case.
+ */
+static void print_result_line(int case_id, int result)
+{
+    if (startup_fd >= 0) {
+        startup_mark(STARTUP_MARK_RESULT);
+        close(startup_fd);
+        startup_fd = -1;
+    }
+    log_flush();
+    printf("\n[A][ARA-%d][%s]\n", case_id, result? "fail": "pass");
+    fflush(stdout);
+    results_flush();
+}
+
 /**
  * @brief print test case result.
  *
@@ -42,12 +231,14 @@ void print_test_case_result(char *TAG, int case_id, int result, char *data)
     if (!TAG)
         TAG = "NONE";
 
+    results_result(TAG, case_id, result, result ? data : NULL);
     if (!result || !data)
-        return print_test_case_result_only(case_id, result);
+        return print_result_line(case_id, result);
     else
     {
+        log_flush();
         printf("\n[I][%s-%d][fail][%s]\n", TAG, case_id, data);
-        print_test_case_result_only(case_id, result);
+        print_result_line(case_id, result);
      }
 }
 
@@ -59,12 +250,35 @@ void print_test_case_result(char *TAG, int case_id, int result, char *data)
  */
 void print_test_case_result_only(int case_id, int result)
 {
-    printf("\n[A][ARA-%d][%s]\n", case_id, result? "fail": "pass");
+    results_result("", case_id, result, NULL);
+    print_result_line(case_id, result);
+}
+
+/**
+ * @brief print the result of one check within a test case.
+ *
+ * The line parses as a LAVA test case named ARA-<case_id>-<check>, next
+ * to the overall ARA-<case_id> result.
+ *
+ * @param case_id The testlink id for test case.
+ * @param check The check name.
+ * @param result The check result.
+ */
+void print_test_case_check(int case_id, const char *check, int result)
+{
+    if (!check)
+        check = "NONE";
+
+    results_check(case_id, check, result);
+    log_flush();
+    printf("\n[A][ARA-%d-%s][%s]\n", case_id, check, result? "fail": "pass");
 }
 
 /**
  * @brief print debug message.
  *
+ * Skipped below LOG_LEVEL_DEBUG, kept in memory when buffered.
+ *
  * @param TAG The test module name.
  * @param case_id The testlink id for test case.
  * @param data The debug message.
@@ -77,5 +291,40 @@ void print_test_case_log(char *TAG, int case_id, char *data)
     if (!data)
         data = "NONE";
 
-    printf("\n[D][%s-%d][%s]\n", TAG, case_id, data);
+    log_init();
+    if (log_level < LOG_LEVEL_DEBUG)
+        return;
+
+    log_debug_line("\n[D][%s-%d][%s]\n", TAG, case_id, data);
+}
+
+/**
+ * @brief print test case performance measurement.
+ *
+ * The line parses as a LAVA test case named ARA-<case_id>-<metric> with
+ * a measurement and units.
+ *
+ * @param case_id The testlink id for test case.
+ * @param metric The measured metric name.
+ * @param value The measured value.
+ * @param unit The unit of the value, "none" if NULL or empty.
+ */
+void print_test_case_perf(int case_id, const char *metric, double value,
+                          const char *unit)
+{
+    if (!metric)
+        metric = "NONE";
+
+    /* an empty unit field does not match the [P] line pattern */
+    if (!unit || !unit[0])
+        unit = "none";
+
+    /* the FWTEST_BENCH environment goes before the first value */
+    bench_env_note(case_id);
+
+    if (results_enabled())
+        results_value(case_id, results_metric_id(metric, unit), value);
+
+    log_flush();
+    printf("\n[P][ARA-%d-%s][pass][%.3f][%s]\n", case_id, metric, value, unit);
 }
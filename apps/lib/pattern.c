@@ -0,0 +1,578 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <endian.h>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+/* not exported by every libc's <sys/auxv.h> */
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
+#include "./include/libfwtest.h"
+
+/*
+ * Test data pattern: the 64-bit little endian word at byte offset off of a
+ * file is seed ^ (off / 8). Every word of a file is unique, so misplaced
+ * and stale blocks are caught as well as bit errors, and the pattern can
+ * be generated and checked at any offset without state.
+ *
+ * Byte streams (UART, SPI, I2C) can also use an incrementing byte pattern
+ * or PRBS31 through the pattern_stream functions. PRBS31 is the
+ * x^31 + x^28 + 1 sequence sent LSB first, every bit is the XOR of the
+ * bits 28 and 31 before it, so a receiver checks it without knowing the
+ * seed or where the stream started.
+ */
+
+#define CRC32_POLY 0xedb88320
+
+/* PRBS31 taps, as bit distances back from the new bit */
+#define PRBS31_TAP_A 28
+#define PRBS31_TAP_B 31
+
+static const char *pattern_type_names[PATTERN_TYPE_MAX] = {
+    "lba",
+    "incr",
+    "prbs31",
+};
+
+static uint32_t crc32_table[256];
+static int crc32_hw = -1;
+
+static void crc32_init(void)
+{
+    uint32_t c;
+    int i, j;
+
+    for (i = 0; i < 256; i++) {
+        c = i;
+        for (j = 0; j < 8; j++) {
+            c = c & 1 ? (c >> 1) ^ CRC32_POLY : c >> 1;
+        }
+        crc32_table[i] = c;
+    }
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    crc32_hw = !!(getauxval(AT_HWCAP) & HWCAP_CRC32);
+#else
+    crc32_hw = 0;
+#endif
+}
+
+static uint32_t crc32_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    while (len--) {
+        crc = crc32_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+static uint32_t crc32_arm(uint32_t crc, const uint8_t *p, size_t len)
+{
+    uint64_t v;
+
+    while (len && ((uintptr_t)p & 7)) {
+        crc = __crc32b(crc, *p++);
+        len--;
+    }
+    while (len >= 8) {
+        memcpy(&v, p, 8);
+        crc = __crc32d(crc, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = __crc32b(crc, *p++);
+    }
+
+    return crc;
+}
+#endif
+
+/**
+ * @brief Update a CRC-32 (IEEE 802.3, as zlib) over a buffer
+ *
+ * Uses the ARMv8 CRC32 instructions when the CPU has them.
+ *
+ * @param crc CRC of the previous data, 0 to start
+ * @param buf The data
+ * @param len The data length in bytes
+ * @return the updated CRC
+ */
+uint32_t crc32_update(uint32_t crc, const void *buf, size_t len)
+{
+    if (crc32_hw < 0) {
+        crc32_init();
+    }
+
+    crc = ~crc;
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    if (crc32_hw) {
+        return ~crc32_arm(crc, buf, len);
+    }
+#endif
+
+    return ~crc32_sw(crc, buf, len);
+}
+
+/**
+ * @brief Fill a buffer with the test data pattern
+ *
+ * @param buf The buffer, 8 byte aligned
+ * @param len The buffer length, a multiple of 8
+ * @param offset File offset of the buffer, a multiple of 8
+ * @param seed Pattern seed
+ * @return None
+ */
+void pattern_fill(void *buf, size_t len, uint64_t offset, uint64_t seed)
+{
+    uint64_t *w = buf;
+    uint64_t idx = offset / 8;
+    size_t n = len / 8, i = 0;
+
+#if defined(__aarch64__)
+    uint64x2_t vidx = vcombine_u64(vcreate_u64(idx), vcreate_u64(idx + 1));
+    uint64x2_t vseed = vdupq_n_u64(seed);
+    uint64x2_t vtwo = vdupq_n_u64(2);
+
+    for (; i + 2 <= n; i += 2) {
+        vst1q_u64(w + i, veorq_u64(vidx, vseed));
+        vidx = vaddq_u64(vidx, vtwo);
+    }
+#endif
+
+    for (; i < n; i++) {
+        w[i] = seed ^ (idx + i);
+    }
+}
+
+/**
+ * @brief Check a buffer against the test data pattern
+ *
+ * @param buf The buffer, 8 byte aligned
+ * @param len The buffer length, a multiple of 8
+ * @param offset File offset of the buffer, a multiple of 8
+ * @param seed Pattern seed
+ * @return -1 if the buffer matches, else the byte offset in the buffer of
+ * the first mismatching word
+ */
+int64_t pattern_check(const void *buf, size_t len, uint64_t offset,
+                      uint64_t seed)
+{
+    const uint64_t *w = buf;
+    uint64_t idx = offset / 8;
+    size_t n = len / 8, i = 0;
+
+#if defined(__aarch64__)
+    /* 8 words per step, bail out to the scalar loop on the first error */
+    uint64x2_t vidx = vcombine_u64(vcreate_u64(idx), vcreate_u64(idx + 1));
+    uint64x2_t vseed = vdupq_n_u64(seed);
+    uint64x2_t vtwo = vdupq_n_u64(2);
+    uint64x2_t e0, e1, e2, e3, diff;
+
+    for (; i + 8 <= n; i += 8) {
+        e0 = veorq_u64(vidx, vseed);
+        vidx = vaddq_u64(vidx, vtwo);
+        e1 = veorq_u64(vidx, vseed);
+        vidx = vaddq_u64(vidx, vtwo);
+        e2 = veorq_u64(vidx, vseed);
+        vidx = vaddq_u64(vidx, vtwo);
+        e3 = veorq_u64(vidx, vseed);
+        vidx = vaddq_u64(vidx, vtwo);
+
+        diff = vorrq_u64(vorrq_u64(veorq_u64(vld1q_u64(w + i), e0),
+                                   veorq_u64(vld1q_u64(w + i + 2), e1)),
+                         vorrq_u64(veorq_u64(vld1q_u64(w + i + 4), e2),
+                                   veorq_u64(vld1q_u64(w + i + 6), e3)));
+        if (vgetq_lane_u64(diff, 0) | vgetq_lane_u64(diff, 1)) {
+            break;
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        if (w[i] != (seed ^ (idx + i))) {
+            return (int64_t)(i * 8);
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Look up a pattern type by name
+ *
+ * @param name "lba", "incr" or "prbs31"
+ * @return the pattern type, -EINVAL on an unknown name
+ */
+int pattern_type_parse(const char *name)
+{
+    int i;
+
+    for (i = 0; i < PATTERN_TYPE_MAX; i++) {
+        if (!strcmp(name, pattern_type_names[i])) {
+            return i;
+        }
+    }
+
+    return -EINVAL;
+}
+
+/**
+ * @brief Name of a pattern type
+ *
+ * @param type The pattern type
+ * @return the name, "?" for an unknown type
+ */
+const char *pattern_type_name(enum pattern_type type)
+{
+    return type < PATTERN_TYPE_MAX ? pattern_type_names[type] : "?";
+}
+
+/**
+ * @brief Start a pattern stream at byte 0
+ *
+ * A generator and a checker of the same data each use their own stream.
+ *
+ * @param ps The stream
+ * @param type The pattern type
+ * @param seed Pattern seed, the low 31 bits seed PRBS31 (0 is taken as 1)
+ * @return None
+ */
+void pattern_stream_init(struct pattern_stream *ps, enum pattern_type type,
+                         uint64_t seed)
+{
+    uint64_t prbs = seed & 0x7fffffff;
+
+    memset(ps, 0, sizeof(*ps));
+    ps->type = type;
+    ps->seed = seed;
+    /* the register holds the last 64 sequence bits, newest at bit 63 */
+    ps->prbs = (prbs ? prbs : 1) << (64 - PRBS31_TAP_B);
+}
+
+static uint8_t lba_byte(uint64_t off, uint64_t seed)
+{
+    return (seed ^ (off / 8)) >> (8 * (off % 8));
+}
+
+static void lba_fill(uint8_t *p, size_t len, uint64_t off, uint64_t seed)
+{
+    uint64_t v;
+    size_t i, n;
+
+    for (; len && (off & 7); len--) {
+        *p++ = lba_byte(off++, seed);
+    }
+
+    n = len & ~(size_t)7;
+    if (!((uintptr_t)p & 7)) {
+        pattern_fill(p, n, off, seed);
+    } else {
+        for (i = 0; i < n; i += 8) {
+            v = seed ^ ((off + i) / 8);
+            memcpy(p + i, &v, 8);
+        }
+    }
+    p += n;
+    off += n;
+    len -= n;
+
+    while (len--) {
+        *p++ = lba_byte(off++, seed);
+    }
+}
+
+static int64_t lba_check(const uint8_t *p, size_t len, uint64_t off,
+                         uint64_t seed)
+{
+    int64_t bad;
+    size_t i = 0, n;
+    uint64_t v;
+
+    for (; i < len && ((off + i) & 7); i++) {
+        if (p[i] != lba_byte(off + i, seed)) {
+            return i;
+        }
+    }
+
+    n = (len - i) & ~(size_t)7;
+    if (!((uintptr_t)(p + i) & 7)) {
+        /* the scalar loop finds the bad byte of a bad word */
+        bad = pattern_check(p + i, n, off + i, seed);
+        i += bad >= 0 ? (size_t)bad : n;
+    } else {
+        for (; n; n -= 8, i += 8) {
+            memcpy(&v, p + i, 8);
+            if (v != (seed ^ ((off + i) / 8))) {
+                break;
+            }
+        }
+    }
+
+    for (; i < len; i++) {
+        if (p[i] != lba_byte(off + i, seed)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void incr_fill(uint8_t *p, size_t len, uint8_t start)
+{
+    size_t i = 0;
+
+#if defined(__aarch64__)
+    static const uint8_t iota[16] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+    };
+    uint8x16_t v = vaddq_u8(vld1q_u8(iota), vdupq_n_u8(start));
+    uint8x16_t vsixteen = vdupq_n_u8(16);
+
+    for (; i + 16 <= len; i += 16) {
+        vst1q_u8(p + i, v);
+        v = vaddq_u8(v, vsixteen);
+    }
+#endif
+
+    for (; i < len; i++) {
+        p[i] = start + i;
+    }
+}
+
+static int64_t incr_check(const uint8_t *p, size_t len, uint8_t start)
+{
+    size_t i = 0;
+
+#if defined(__aarch64__)
+    static const uint8_t iota[16] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+    };
+    uint8x16_t v = vaddq_u8(vld1q_u8(iota), vdupq_n_u8(start));
+    uint8x16_t vsixteen = vdupq_n_u8(16);
+
+    /* bail out to the scalar loop on the first error */
+    for (; i + 16 <= len; i += 16) {
+        if (vminvq_u8(vceqq_u8(vld1q_u8(p + i), v)) != 0xff) {
+            break;
+        }
+        v = vaddq_u8(v, vsixteen);
+    }
+#endif
+
+    for (; i < len; i++) {
+        if (p[i] != (uint8_t)(start + i)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void prbs31_fill(uint64_t *reg, uint8_t *p, size_t len)
+{
+    uint64_t r = *reg, x, w;
+    int k;
+
+    /* 16 new bits per step, the taps reach back 28 and 31 bits */
+    for (; len >= 8; len -= 8, p += 8) {
+        for (w = 0, k = 0; k < 64; k += 16) {
+            x = ((r >> (64 - PRBS31_TAP_A)) ^ (r >> (64 - PRBS31_TAP_B))) &
+                0xffff;
+            r = (r >> 16) | (x << 48);
+            w |= x << k;
+        }
+        w = htole64(w);
+        memcpy(p, &w, 8);
+    }
+
+    while (len--) {
+        x = ((r >> (64 - PRBS31_TAP_A)) ^ (r >> (64 - PRBS31_TAP_B))) & 0xff;
+        r = (r >> 8) | (x << 56);
+        *p++ = x;
+    }
+
+    *reg = r;
+}
+
+/*
+ * PRBS31 check of 4 bytes: l is the 8 bytes starting 4 bytes before them,
+ * little endian, the result has a bit set for each bad bit.
+ */
+static inline uint32_t prbs31_err(uint64_t l)
+{
+    return (l >> 32) ^ (l >> (32 - PRBS31_TAP_A)) ^
+           (l >> (32 - PRBS31_TAP_B));
+}
+
+static int64_t prbs31_check(uint32_t *hist, int have, const uint8_t *p,
+                            size_t len)
+{
+    uint64_t l;
+    uint32_t e, h;
+    size_t i = 0;
+
+    /* bytes whose 4 byte history is in the previous buffer */
+    for (; i < len && i < 4; i++, have++) {
+        l = *hist | (uint64_t)p[i] << 32;
+        *hist = (*hist >> 8) | (uint32_t)p[i] << 24;
+        if (have >= 4 && (prbs31_err(l) & 0xff)) {
+            goto bad;
+        }
+    }
+
+#if defined(__aarch64__)
+    {
+        uint64x2_t vmask = vdupq_n_u64(0xffffffff);
+        uint64x2_t a, b, e2;
+
+        /* a checks bytes 0-3 and 8-11 of each 16, b bytes 4-7 and 12-15 */
+        for (; have >= 4 && i + 16 <= len; i += 16) {
+            a = vreinterpretq_u64_u8(vld1q_u8(p + i - 4));
+            b = vreinterpretq_u64_u8(vld1q_u8(p + i));
+            a = veorq_u64(veorq_u64(vshrq_n_u64(a, 32),
+                                    vshrq_n_u64(a, 32 - PRBS31_TAP_A)),
+                          vshrq_n_u64(a, 32 - PRBS31_TAP_B));
+            b = veorq_u64(veorq_u64(vshrq_n_u64(b, 32),
+                                    vshrq_n_u64(b, 32 - PRBS31_TAP_A)),
+                          vshrq_n_u64(b, 32 - PRBS31_TAP_B));
+            e2 = vandq_u64(vorrq_u64(a, b), vmask);
+            if (vgetq_lane_u64(e2, 0) | vgetq_lane_u64(e2, 1)) {
+                break;
+            }
+        }
+    }
+#endif
+
+    for (; have >= 4 && i + 4 <= len; i += 4) {
+        memcpy(&l, p + i - 4, 8);
+        e = prbs31_err(le64toh(l));
+        if (e) {
+            i += __builtin_ctz(e) / 8;
+            goto bad;
+        }
+    }
+
+    for (; i < len; i++) {
+        memcpy(&h, p + i - 4, 4);
+        l = le32toh(h) | (uint64_t)p[i] << 32;
+        if (prbs31_err(l) & 0xff) {
+            goto bad;
+        }
+    }
+
+    if (len >= 4) {
+        memcpy(hist, p + len - 4, 4);
+        *hist = le32toh(*hist);
+    }
+    return -1;
+
+bad:
+    /* resynchronize on the received data */
+    if (len >= 4) {
+        memcpy(hist, p + len - 4, 4);
+        *hist = le32toh(*hist);
+    }
+    return i;
+}
+
+/**
+ * @brief Generate the next bytes of a pattern stream
+ *
+ * @param ps The stream
+ * @param buf Returns the data, any alignment
+ * @param len Bytes to generate, any length
+ * @return None
+ */
+void pattern_stream_fill(struct pattern_stream *ps, void *buf, size_t len)
+{
+    switch (ps->type) {
+        case PATTERN_TYPE_LBA:
+            lba_fill(buf, len, ps->offset, ps->seed);
+            break;
+        case PATTERN_TYPE_INCR:
+            incr_fill(buf, len, ps->seed + ps->offset);
+            break;
+        case PATTERN_TYPE_PRBS31:
+        default:
+            prbs31_fill(&ps->prbs, buf, len);
+            break;
+    }
+    ps->offset += len;
+}
+
+/**
+ * @brief Check the next bytes of a pattern stream
+ *
+ * The stream moves on by len bytes whatever the result. A PRBS31 checker
+ * does not need the seed: the first 4 bytes of the stream are taken as
+ * they are and after an error it continues from the received data, so a
+ * lost byte costs one error instead of every later buffer.
+ *
+ * @param ps The stream
+ * @param buf The data, any alignment
+ * @param len Bytes to check, any length
+ * @return -1 if the data matches, else the byte offset in the buffer of
+ * the first mismatching byte
+ */
+int64_t pattern_stream_check(struct pattern_stream *ps, const void *buf,
+                             size_t len)
+{
+    int have = ps->offset < 4 ? ps->offset : 4;
+    int64_t bad;
+
+    switch (ps->type) {
+        case PATTERN_TYPE_LBA:
+            bad = lba_check(buf, len, ps->offset, ps->seed);
+            break;
+        case PATTERN_TYPE_INCR:
+            bad = incr_check(buf, len, ps->seed + ps->offset);
+            break;
+        case PATTERN_TYPE_PRBS31:
+        default:
+            bad = prbs31_check(&ps->hist, have, buf, len);
+            break;
+    }
+    ps->offset += len;
+
+    return bad;
+}
@@ -0,0 +1,234 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sound/asound.h>
+
+#include "./include/libfwtest.h"
+
+/*
+ * Minimal ALSA PCM playback on the kernel ioctl interface, the calls
+ * tinyalsa makes, for a fixed S16_LE interleaved format.
+ */
+
+static struct snd_mask *param_mask(struct snd_pcm_hw_params *params, int n)
+{
+    return &params->masks[n - SNDRV_PCM_HW_PARAM_FIRST_MASK];
+}
+
+static struct snd_interval *param_interval(struct snd_pcm_hw_params *params,
+                                           int n)
+{
+    return &params->intervals[n - SNDRV_PCM_HW_PARAM_FIRST_INTERVAL];
+}
+
+static void param_set_mask(struct snd_pcm_hw_params *params, int n,
+                           unsigned int bit)
+{
+    struct snd_mask *mask = param_mask(params, n);
+
+    memset(mask->bits, 0, sizeof(mask->bits));
+    mask->bits[bit >> 5] |= 1U << (bit & 31);
+}
+
+static void param_set_int(struct snd_pcm_hw_params *params, int n,
+                          unsigned int value)
+{
+    struct snd_interval *interval = param_interval(params, n);
+
+    interval->min = value;
+    interval->max = value;
+    interval->integer = 1;
+}
+
+/**
+ * @brief start a hw_params with every configuration allowed.
+ *
+ * @param params The hw_params.
+ */
+static void param_init(struct snd_pcm_hw_params *params)
+{
+    int n;
+
+    memset(params, 0, sizeof(*params));
+    for (n = SNDRV_PCM_HW_PARAM_FIRST_MASK;
+         n <= SNDRV_PCM_HW_PARAM_LAST_MASK; n++) {
+        memset(param_mask(params, n)->bits, 0xff,
+               sizeof(param_mask(params, n)->bits));
+    }
+    for (n = SNDRV_PCM_HW_PARAM_FIRST_INTERVAL;
+         n <= SNDRV_PCM_HW_PARAM_LAST_INTERVAL; n++) {
+        param_interval(params, n)->min = 0;
+        param_interval(params, n)->max = UINT_MAX;
+    }
+    params->rmask = ~0U;
+    params->info = ~0U;
+}
+
+/**
+ * @brief open ALSA PCM playback device.
+ *
+ * @param card The sound card number.
+ * @param device The PCM device number of the card.
+ *
+ * @return file The new file descriptor, or -1 if an error occurred.
+ */
+int open_pcm_dev(int card, int device)
+{
+    char path[32];
+
+    snprintf(path, sizeof(path), "/dev/snd/pcmC%dD%dp", card, device);
+    return open(path, O_RDWR);
+}
+
+/**
+ * @brief configure a PCM playback device.
+ *
+ * The format is S16_LE, interleaved. Playback starts when the buffer is
+ * full and stops with an underrun as soon as it runs empty.
+ *
+ * @param file The file descriptor return from open_pcm_dev().
+ * @param rate Sample rate in Hz.
+ * @param channels Number of channels.
+ * @param period_frames Period size in frames, returns the size the driver
+ * chose.
+ * @param periods Number of periods in the buffer, returns the number the
+ * driver chose.
+ *
+ * @return 0 for success, -error if fail.
+ */
+int pcm_set_params(int file, int rate, int channels, int *period_frames,
+                   int *periods)
+{
+    struct snd_pcm_hw_params hw;
+    struct snd_pcm_sw_params sw;
+    unsigned int buffer;
+
+    param_init(&hw);
+    param_set_mask(&hw, SNDRV_PCM_HW_PARAM_ACCESS,
+                   SNDRV_PCM_ACCESS_RW_INTERLEAVED);
+    param_set_mask(&hw, SNDRV_PCM_HW_PARAM_FORMAT, SNDRV_PCM_FORMAT_S16_LE);
+    param_set_mask(&hw, SNDRV_PCM_HW_PARAM_SUBFORMAT,
+                   SNDRV_PCM_SUBFORMAT_STD);
+    param_set_int(&hw, SNDRV_PCM_HW_PARAM_SAMPLE_BITS, 16);
+    param_set_int(&hw, SNDRV_PCM_HW_PARAM_FRAME_BITS, 16 * channels);
+    param_set_int(&hw, SNDRV_PCM_HW_PARAM_CHANNELS, channels);
+    param_set_int(&hw, SNDRV_PCM_HW_PARAM_RATE, rate);
+    param_set_int(&hw, SNDRV_PCM_HW_PARAM_PERIOD_SIZE, *period_frames);
+    param_set_int(&hw, SNDRV_PCM_HW_PARAM_PERIODS, *periods);
+
+    if (ioctl(file, SNDRV_PCM_IOCTL_HW_PARAMS, &hw) < 0) {
+        return -errno;
+    }
+    *period_frames =
+        param_interval(&hw, SNDRV_PCM_HW_PARAM_PERIOD_SIZE)->max;
+    *periods = param_interval(&hw, SNDRV_PCM_HW_PARAM_PERIODS)->max;
+    buffer = *period_frames * *periods;
+
+    memset(&sw, 0, sizeof(sw));
+    sw.tstamp_mode = SNDRV_PCM_TSTAMP_NONE;
+    sw.period_step = 1;
+    sw.avail_min = *period_frames;
+    sw.start_threshold = buffer;
+    sw.stop_threshold = buffer;
+    sw.boundary = buffer;
+    while (sw.boundary * 2 <= INT_MAX - buffer) {
+        sw.boundary *= 2;
+    }
+
+    if (ioctl(file, SNDRV_PCM_IOCTL_SW_PARAMS, &sw) < 0) {
+        return -errno;
+    }
+
+    return pcm_prepare(file);
+}
+
+/**
+ * @brief prepare a PCM device to start, also recovers from an underrun.
+ *
+ * @param file The file descriptor return from open_pcm_dev().
+ *
+ * @return 0 for success, -error if fail.
+ */
+int pcm_prepare(int file)
+{
+    return ioctl(file, SNDRV_PCM_IOCTL_PREPARE) < 0 ? -errno : 0;
+}
+
+/**
+ * @brief write interleaved frames to a PCM device.
+ *
+ * Blocks until all frames are queued.
+ *
+ * @param file The file descriptor return from open_pcm_dev().
+ * @param buf The frames.
+ * @param frames Number of frames.
+ *
+ * @return 0 for success, -EPIPE on underrun, -error if fail.
+ */
+int pcm_write_frames(int file, const void *buf, int frames)
+{
+    struct snd_xferi xfer;
+
+    memset(&xfer, 0, sizeof(xfer));
+    xfer.buf = (void *)buf;
+    xfer.frames = frames;
+
+    if (ioctl(file, SNDRV_PCM_IOCTL_WRITEI_FRAMES, &xfer) < 0) {
+        return -errno;
+    }
+
+    return xfer.result == frames ? 0 : -EIO;
+}
+
+/**
+ * @brief get the playback delay of a PCM device.
+ *
+ * @param file The file descriptor return from open_pcm_dev().
+ * @param frames Returns the frames queued ahead of the next write.
+ *
+ * @return 0 for success, -error if fail.
+ */
+int pcm_delay(int file, long *frames)
+{
+    snd_pcm_sframes_t delay = 0;
+
+    if (ioctl(file, SNDRV_PCM_IOCTL_DELAY, &delay) < 0) {
+        return -errno;
+    }
+    *frames = delay;
+
+    return 0;
+}
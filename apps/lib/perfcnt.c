@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "./include/libfwtest.h"
+
+/*
+ * CPU cost of measured regions: cycles, instructions, context switches
+ * and cache misses of the calling thread, through one perf_event_open()
+ * group read with a single read() at each end of a region. Kernel work
+ * done on behalf of the thread is counted when perf_event_paranoid
+ * allows it, which is most of the cost of a greybus operation.
+ */
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+} perf_events[STATS_PERF_MAX] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "ctx_switches" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache_misses" },
+};
+
+/* group read with PERF_FORMAT_GROUP and the enabled/running times */
+struct perf_group_read {
+    uint64_t nr;
+    uint64_t enabled;
+    uint64_t running;
+    uint64_t value[STATS_PERF_MAX];
+};
+
+static int perf_open_one(int i, int group, int user_only)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = perf_events[i].type;
+    attr.config = perf_events[i].config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = user_only;
+    attr.exclude_hv = 1;
+
+    return syscall(__NR_perf_event_open, &attr, 0, -1, group,
+                   PERF_FLAG_FD_CLOEXEC);
+}
+
+/**
+ * @brief Open the CPU counters of the calling thread.
+ *
+ * Counters the CPU or kernel does not have are left out, the others
+ * still count. Kernel work is left out too when the kernel's
+ * perf_event_paranoid does not allow counting it.
+ *
+ * @param perf The counters to open.
+ * @return 0 if at least one counter opened, -errno of the first one else.
+ */
+int stats_perf_open(struct stats_perf *perf)
+{
+    int i, fd, ret = 0;
+
+    memset(perf, 0, sizeof(*perf));
+    perf->leader = -1;
+    for (i = 0; i < STATS_PERF_MAX; i++) {
+        perf->fd[i] = -1;
+        perf->slot[i] = -1;
+    }
+
+    for (i = 0; i < STATS_PERF_MAX; i++) {
+        fd = perf_open_one(i, perf->leader, perf->user_only);
+        if (fd < 0 && (errno == EACCES || errno == EPERM) &&
+            !perf->user_only && perf->leader < 0) {
+            perf->user_only = 1;
+            fd = perf_open_one(i, perf->leader, perf->user_only);
+        }
+        if (fd < 0) {
+            ret = ret ? ret : -errno;
+            continue;
+        }
+
+        perf->fd[i] = fd;
+        perf->slot[i] = perf->nslots++;
+        if (perf->leader < 0) {
+            perf->leader = fd;
+        }
+    }
+
+    return perf->nslots ? 0 : ret;
+}
+
+/**
+ * @brief Close the CPU counters.
+ *
+ * @param perf The counters.
+ */
+void stats_perf_close(struct stats_perf *perf)
+{
+    int i;
+
+    for (i = 0; i < STATS_PERF_MAX; i++) {
+        if (perf->fd[i] >= 0) {
+            close(perf->fd[i]);
+        }
+        perf->fd[i] = -1;
+        perf->slot[i] = -1;
+    }
+    perf->leader = -1;
+    perf->nslots = 0;
+}
+
+/**
+ * @brief Read all counters at the start of an operation.
+ *
+ * @param perf The counters, closed ones read nothing.
+ * @param snap Returns the counter values.
+ * @return 0 on success, -errno on failure.
+ */
+int stats_perf_begin(const struct stats_perf *perf,
+                     struct stats_perf_snap *snap)
+{
+    struct perf_group_read rd;
+    int i;
+
+    snap->valid = 0;
+    if (perf->leader < 0) {
+        return -EBADF;
+    }
+    if (read(perf->leader, &rd, sizeof(rd)) < 0) {
+        return -errno;
+    }
+
+    for (i = 0; i < STATS_PERF_MAX; i++) {
+        snap->value[i] = perf->slot[i] >= 0 ? rd.value[perf->slot[i]] : 0;
+    }
+    snap->enabled = rd.enabled;
+    snap->running = rd.running;
+    snap->valid = 1;
+
+    return 0;
+}
+
+/**
+ * @brief Read all counters at the end of an operation and add the
+ * difference to a count.
+ *
+ * @param perf The counters.
+ * @param snap Values from stats_perf_begin(), nothing is added if it
+ * failed.
+ * @param count The count of the region.
+ */
+void stats_perf_end(const struct stats_perf *perf,
+                    const struct stats_perf_snap *snap,
+                    struct stats_perf_count *count)
+{
+    struct perf_group_read rd;
+    int i;
+
+    if (!snap->valid || read(perf->leader, &rd, sizeof(rd)) < 0) {
+        return;
+    }
+
+    for (i = 0; i < STATS_PERF_MAX; i++) {
+        if (perf->slot[i] >= 0) {
+            count->value[i] += rd.value[perf->slot[i]] - snap->value[i];
+        }
+    }
+    count->enabled += rd.enabled - snap->enabled;
+    count->running += rd.running - snap->running;
+    count->ops++;
+}
+
+void stats_perf_count_init(struct stats_perf_count *count)
+{
+    memset(count, 0, sizeof(*count));
+}
+
+void stats_perf_count_merge(struct stats_perf_count *dst,
+                            const struct stats_perf_count *src)
+{
+    int i;
+
+    for (i = 0; i < STATS_PERF_MAX; i++) {
+        dst->value[i] += src->value[i];
+    }
+    dst->enabled += src->enabled;
+    dst->running += src->running;
+    dst->ops += src->ops;
+}
+
+/**
+ * @brief Print the CPU cost per operation of a region.
+ *
+ * Prints name_<counter>_per_op for every counter that opened and
+ * name_ipc, with a "user" unit when kernel work is not counted. Counts
+ * are scaled up when the kernel multiplexed the group with other
+ * counters.
+ *
+ * @param case_id Testrail test case ID of the [P] lines.
+ * @param name Region name, metric prefix.
+ * @param perf The counters the count was taken with.
+ * @param count The count of the region.
+ */
+void stats_perf_report(int case_id, const char *name,
+                       const struct stats_perf *perf,
+                       const struct stats_perf_count *count)
+{
+    double scale = 1.0, value[STATS_PERF_MAX];
+    char metric[64], unit[32];
+    int i;
+
+    if (!count->ops || perf->leader < 0) {
+        return;
+    }
+    if (count->running && count->running < count->enabled) {
+        scale = (double)count->enabled / count->running;
+    }
+
+    for (i = 0; i < STATS_PERF_MAX; i++) {
+        if (perf->slot[i] < 0) {
+            continue;
+        }
+        value[i] = count->value[i] * scale / count->ops;
+        snprintf(metric, sizeof(metric), "%s_%s_per_op", name,
+                 perf_events[i].name);
+        snprintf(unit, sizeof(unit), "%s%s/op",
+                 perf->user_only ? "user " : "", perf_events[i].name);
+        print_test_case_perf(case_id, metric, value[i], unit);
+    }
+
+    if (perf->slot[STATS_PERF_CYCLES] >= 0 &&
+        perf->slot[STATS_PERF_INSTRUCTIONS] >= 0 &&
+        value[STATS_PERF_CYCLES] > 0) {
+        snprintf(metric, sizeof(metric), "%s_ipc", name);
+        print_test_case_perf(case_id, metric,
+                             value[STATS_PERF_INSTRUCTIONS] /
+                             value[STATS_PERF_CYCLES], "ipc");
+    }
+}
@@ -0,0 +1,232 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/limits.h>
+
+#include "./include/libfwtest.h"
+
+#define PWM_CLASS "/sys/class/pwm"
+
+/* Max number of PWM channels whose attributes are kept open at once */
+#define PWM_ATTR_CACHE_SIZE 16
+
+static const char *pwm_attr_name[PWM_ATTR_MAX] = {
+    "period",
+    "duty_cycle",
+    "enable",
+    "polarity",
+};
+
+struct pwm_attr_cache {
+    int in_use;
+    int chip;
+    int channel;
+    int fd[PWM_ATTR_MAX];
+};
+
+static struct pwm_attr_cache attr_cache[PWM_ATTR_CACHE_SIZE];
+
+/**
+ * @brief Get the cached file descriptor of a PWM channel attribute
+ *
+ * The attribute is opened on first use and stays open until the channel
+ * is exported or unexported again, so repeated updates cost one syscall.
+ *
+ * @param chip N of /sys/class/pwm/pwmchipN
+ * @param channel PWM channel of the chip
+ * @param attr The PWM attribute
+ * @return file descriptor on success, -ENOSPC if the cache is full, error
+ * code on other failures
+ */
+int pwm_attr_fd(int chip, int channel, enum pwm_attr attr)
+{
+    int i = 0, fd = 0;
+    struct pwm_attr_cache *entry = NULL, *unused = NULL;
+    char pwmstr[PATH_MAX];
+
+    if (attr < 0 || attr >= PWM_ATTR_MAX) {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < PWM_ATTR_CACHE_SIZE; i++) {
+        if (attr_cache[i].in_use && attr_cache[i].chip == chip &&
+            attr_cache[i].channel == channel) {
+            entry = &attr_cache[i];
+            break;
+        }
+        if (!attr_cache[i].in_use && unused == NULL) {
+            unused = &attr_cache[i];
+        }
+    }
+
+    if (entry == NULL) {
+        if (unused == NULL) {
+            return -ENOSPC;
+        }
+        entry = unused;
+        entry->in_use = 1;
+        entry->chip = chip;
+        entry->channel = channel;
+        for (i = 0; i < PWM_ATTR_MAX; i++) {
+            entry->fd[i] = -1;
+        }
+    }
+
+    if (entry->fd[attr] < 0) {
+        snprintf(pwmstr, sizeof(pwmstr), "%s/pwmchip%d/pwm%d", PWM_CLASS,
+                 chip, channel);
+        fd = debugfs_open_attr(pwmstr, pwm_attr_name[attr], O_RDWR);
+        if (fd < 0) {
+            return fd;
+        }
+        entry->fd[attr] = fd;
+    }
+
+    return entry->fd[attr];
+}
+
+/**
+ * @brief Close all cached attribute file descriptors of a PWM channel
+ *
+ * @param chip N of /sys/class/pwm/pwmchipN
+ * @param channel PWM channel of the chip
+ * @return None
+ */
+void pwm_attr_release(int chip, int channel)
+{
+    int i = 0, j = 0;
+
+    for (i = 0; i < PWM_ATTR_CACHE_SIZE; i++) {
+        if (attr_cache[i].in_use && attr_cache[i].chip == chip &&
+            attr_cache[i].channel == channel) {
+            for (j = 0; j < PWM_ATTR_MAX; j++) {
+                debugfs_close_attr(attr_cache[i].fd[j]);
+            }
+            attr_cache[i].in_use = 0;
+        }
+    }
+}
+
+/**
+ * @brief Read a PWM channel attribute
+ *
+ * @param chip N of /sys/class/pwm/pwmchipN
+ * @param channel PWM channel of the chip
+ * @param attr The PWM attribute
+ * @param value The value read
+ * @param len The value buffer size
+ * @return 0 on success, error code on failure
+ */
+int pwm_get_attr(int chip, int channel, enum pwm_attr attr, char *value,
+                 int len)
+{
+    int fd = 0;
+    char pwmstr[PATH_MAX];
+
+    fd = pwm_attr_fd(chip, channel, attr);
+    if (fd >= 0) {
+        return debugfs_read_attr(fd, value, len);
+    } else if (fd != -ENOSPC) {
+        return fd;
+    }
+
+    snprintf(pwmstr, sizeof(pwmstr), "%s/pwmchip%d/pwm%d", PWM_CLASS, chip,
+             channel);
+    return debugfs_get_attr(pwmstr, pwm_attr_name[attr], value, len);
+}
+
+/**
+ * @brief Write a PWM channel attribute
+ *
+ * The kernel rejects a duty cycle above the period, so order the writes
+ * of a new configuration accordingly.
+ *
+ * @param chip N of /sys/class/pwm/pwmchipN
+ * @param channel PWM channel of the chip
+ * @param attr The PWM attribute
+ * @param value The value to write
+ * @param len The value length
+ * @return 0 on success, error code on failure
+ */
+int pwm_set_attr(int chip, int channel, enum pwm_attr attr, char *value,
+                 int len)
+{
+    int fd = 0;
+    char pwmstr[PATH_MAX];
+
+    fd = pwm_attr_fd(chip, channel, attr);
+    if (fd >= 0) {
+        return debugfs_write_attr(fd, value, len);
+    } else if (fd != -ENOSPC) {
+        return fd;
+    }
+
+    snprintf(pwmstr, sizeof(pwmstr), "%s/pwmchip%d/pwm%d", PWM_CLASS, chip,
+             channel);
+    return debugfs_set_attr(pwmstr, pwm_attr_name[attr], value, len);
+}
+
+/**
+ * @brief Export a PWM channel to sysfs
+ *
+ * @param chip N of /sys/class/pwm/pwmchipN
+ * @param channel PWM channel of the chip
+ * @return 0 on success, error code on failure
+ */
+int pwm_export(int chip, int channel)
+{
+    char pwmstr[PATH_MAX], value[16];
+
+    pwm_attr_release(chip, channel);
+    snprintf(pwmstr, sizeof(pwmstr), "%s/pwmchip%d", PWM_CLASS, chip);
+    snprintf(value, sizeof(value), "%d\n", channel);
+    return debugfs_set_attr(pwmstr, "export", value, strlen(value));
+}
+
+/**
+ * @brief Unexport a PWM channel from sysfs
+ *
+ * @param chip N of /sys/class/pwm/pwmchipN
+ * @param channel PWM channel of the chip
+ * @return 0 on success, error code on failure
+ */
+int pwm_unexport(int chip, int channel)
+{
+    char pwmstr[PATH_MAX], value[16];
+
+    pwm_attr_release(chip, channel);
+    snprintf(pwmstr, sizeof(pwmstr), "%s/pwmchip%d", PWM_CLASS, chip);
+    snprintf(value, sizeof(value), "%d\n", channel);
+    return debugfs_set_attr(pwmstr, "unexport", value, strlen(value));
+}
@@ -0,0 +1,401 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "./include/libfwtest.h"
+
+/*
+ * Binary results sink. Every [A], [P] and check line is also appended to
+ * the results file as a fixed header record, and apps with high rate
+ * samples call results_value() to store them without any formatting.
+ * Metric names and units are stored once, in a RESULTS_REC_METRIC record,
+ * and referred to by id after that. The fwresults app turns a file back
+ * into the text lines.
+ */
+
+/* Size of the record buffer, written out with one write() when full */
+#define RESULTS_BUF_SIZE (64 * 1024)
+/* Slots of the metric id table, a power of 2 */
+#define RESULTS_METRIC_SLOTS 1024
+
+struct results_metric {
+    uint32_t hash;
+    int id;
+    char name[RESULTS_NAME_LEN];
+    char unit[RESULTS_UNIT_LEN];
+};
+
+static int results_fd = -2;
+static int results_next_id;
+static uint8_t results_buf[RESULTS_BUF_SIZE];
+static size_t results_len;
+static struct results_metric results_metrics[RESULTS_METRIC_SLOTS];
+/* records may be added from several threads */
+static char results_lock;
+
+static void results_flush_locked(void)
+{
+    size_t off = 0;
+    ssize_t n;
+
+    while (results_fd >= 0 && off < results_len) {
+        n = write(results_fd, results_buf + off, results_len - off);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            /* out of space or similar, stop recording rather than block */
+            close(results_fd);
+            results_fd = -1;
+            break;
+        }
+        off += n;
+    }
+    results_len = 0;
+}
+
+/**
+ * @brief Start a record in the buffer.
+ *
+ * Called with the lock held.
+ *
+ * @param type The record type.
+ * @param case_id Testrail test case ID.
+ * @param len Record length, header included.
+ * @return the record, NULL if recording is off
+ */
+static uint8_t *results_begin(int type, int case_id, size_t len)
+{
+    struct results_rec_hdr hdr;
+    uint8_t *rec;
+
+    if (results_fd < 0) {
+        return NULL;
+    }
+    if (results_len + len > sizeof(results_buf)) {
+        results_flush_locked();
+        if (results_fd < 0) {
+            return NULL;
+        }
+    }
+
+    hdr.len = len;
+    hdr.type = type;
+    hdr.reserved = 0;
+    hdr.case_id = case_id;
+    hdr.ts = stats_now_ns();
+
+    rec = results_buf + results_len;
+    memcpy(rec, &hdr, sizeof(hdr));
+    results_len += len;
+
+    return rec;
+}
+
+static void results_lock_acquire(void)
+{
+    while (__atomic_test_and_set(&results_lock, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+static void results_lock_release(void)
+{
+    __atomic_clear(&results_lock, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Append a record of a fixed part and up to two strings.
+ *
+ * Called with the lock held.
+ */
+static void results_add(int type, int case_id, const void *body,
+                        size_t body_len, const char *s1, const char *s2)
+{
+    size_t l1 = s1 != NULL ? strlen(s1) + 1 : 0;
+    size_t l2 = s2 != NULL ? strlen(s2) + 1 : 0;
+    size_t len = sizeof(struct results_rec_hdr) + body_len;
+    uint8_t *rec;
+
+    /* the length is 16 bits, cut the strings down if it comes to that */
+    if (l1 > RESULTS_TEXT_LEN) {
+        l1 = RESULTS_TEXT_LEN;
+    }
+    if (l2 > RESULTS_TEXT_LEN) {
+        l2 = RESULTS_TEXT_LEN;
+    }
+    /* keep records 8 byte aligned, the padding is zeros */
+    len = (len + l1 + l2 + 7) & ~(size_t)7;
+
+    rec = results_begin(type, case_id, len);
+    if (rec == NULL) {
+        return;
+    }
+
+    memset(rec + sizeof(struct results_rec_hdr), 0,
+           len - sizeof(struct results_rec_hdr));
+    rec += sizeof(struct results_rec_hdr);
+    memcpy(rec, body, body_len);
+    rec += body_len;
+    if (l1) {
+        memcpy(rec, s1, l1 - 1);
+        rec += l1;
+    }
+    if (l2) {
+        memcpy(rec, s2, l2 - 1);
+    }
+}
+
+/**
+ * @brief Open the results file named by FWTEST_RESULTS_FILE, once.
+ */
+static void results_init(void)
+{
+    const char *env;
+
+    if (results_fd != -2) {
+        return;
+    }
+
+    results_fd = -1;
+    env = getenv("FWTEST_RESULTS_FILE");
+    if (env != NULL && *env) {
+        results_open(env);
+    }
+}
+
+/**
+ * @brief Open a binary results file.
+ *
+ * All following results are recorded in it, until results_close(). The
+ * FWTEST_RESULTS_FILE environment variable opens one at the first result.
+ *
+ * @param path The file, truncated if it exists.
+ * @return 0 on success, error code on failure.
+ */
+int results_open(const char *path)
+{
+    struct results_file_hdr hdr;
+    int fd;
+
+    results_close();
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    hdr.magic = RESULTS_MAGIC;
+    hdr.version = RESULTS_VERSION;
+    hdr.hdr_len = sizeof(hdr);
+    if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+        close(fd);
+        return -EIO;
+    }
+
+    results_lock_acquire();
+    memset(results_metrics, 0, sizeof(results_metrics));
+    results_next_id = 0;
+    results_len = 0;
+    results_fd = fd;
+    results_lock_release();
+
+    atexit(results_close);
+    return 0;
+}
+
+/**
+ * @brief Flush and close the binary results file.
+ */
+void results_close(void)
+{
+    results_lock_acquire();
+    if (results_fd >= 0) {
+        results_flush_locked();
+    }
+    if (results_fd >= 0) {
+        close(results_fd);
+    }
+    results_fd = -1;
+    results_lock_release();
+}
+
+/**
+ * @brief Write the buffered records to the results file.
+ */
+void results_flush(void)
+{
+    results_lock_acquire();
+    results_flush_locked();
+    results_lock_release();
+}
+
+/**
+ * @brief Check if results are recorded.
+ *
+ * @return non-zero if a results file is open.
+ */
+int results_enabled(void)
+{
+    results_init();
+    return results_fd >= 0;
+}
+
+/**
+ * @brief Get the id of a metric.
+ *
+ * The first call for a name and unit stores them in the file, later
+ * calls return the same id.
+ *
+ * @param metric The metric name.
+ * @param unit The unit of the values.
+ * @return the metric id, -1 if results are not recorded.
+ */
+int results_metric_id(const char *metric, const char *unit)
+{
+    struct results_metric *m = NULL;
+    uint32_t hash = 5381, slot = 0, id = 0;
+    const char *c;
+    int i;
+
+    if (!results_enabled()) {
+        return -1;
+    }
+
+    for (c = metric; *c; c++) {
+        hash = hash * 33 + (uint8_t)*c;
+    }
+    for (c = unit; *c; c++) {
+        hash = hash * 33 + (uint8_t)*c;
+    }
+    hash |= 1;
+
+    results_lock_acquire();
+    for (i = 0; i < RESULTS_METRIC_SLOTS; i++) {
+        slot = (hash + i) & (RESULTS_METRIC_SLOTS - 1);
+        m = &results_metrics[slot];
+        if (!m->hash ||
+            (m->hash == hash && !strncmp(m->name, metric, sizeof(m->name)) &&
+             !strncmp(m->unit, unit, sizeof(m->unit)))) {
+            break;
+        }
+        m = NULL;
+    }
+
+    if (m != NULL && m->hash) {
+        results_lock_release();
+        return m->id;
+    }
+
+    /* a full table still works, the metric is just stored again */
+    id = results_next_id++;
+    if (m != NULL) {
+        m->hash = hash;
+        m->id = id;
+        snprintf(m->name, sizeof(m->name), "%s", metric);
+        snprintf(m->unit, sizeof(m->unit), "%s", unit);
+    }
+    results_add(RESULTS_REC_METRIC, 0, &id, sizeof(id), metric, unit);
+    results_lock_release();
+
+    return id;
+}
+
+/**
+ * @brief Record one value of a metric.
+ *
+ * The fast path for high rate samples, no formatting and no text output.
+ *
+ * @param case_id Testrail test case ID.
+ * @param metric_id The id from results_metric_id().
+ * @param value The value.
+ */
+void results_value(int case_id, int metric_id, double value)
+{
+    struct results_rec_value body;
+
+    if (metric_id < 0) {
+        return;
+    }
+
+    body.id = metric_id;
+    body.reserved = 0;
+    body.value = value;
+
+    results_lock_acquire();
+    results_add(RESULTS_REC_VALUE, case_id, &body, sizeof(body), NULL, NULL);
+    results_lock_release();
+}
+
+/**
+ * @brief Record the result of a test case.
+ *
+ * @param tag The test module name.
+ * @param case_id Testrail test case ID.
+ * @param result The test result.
+ * @param data The error reason, NULL for none.
+ */
+void results_result(const char *tag, int case_id, int result,
+                    const char *data)
+{
+    int32_t body = result;
+
+    if (!results_enabled()) {
+        return;
+    }
+
+    results_lock_acquire();
+    results_add(RESULTS_REC_RESULT, case_id, &body, sizeof(body), tag,
+                data != NULL ? data : "");
+    results_lock_release();
+}
+
+/**
+ * @brief Record the result of one check within a test case.
+ *
+ * @param case_id Testrail test case ID.
+ * @param check The check name.
+ * @param result The check result.
+ */
+void results_check(int case_id, const char *check, int result)
+{
+    int32_t body = result;
+
+    if (!results_enabled()) {
+        return;
+    }
+
+    results_lock_acquire();
+    results_add(RESULTS_REC_CHECK, case_id, &body, sizeof(body), check, NULL);
+    results_lock_release();
+}
@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "./include/libfwtest.h"
+
+/*
+ * Single producer, single consumer ring of sample records. The producer
+ * is a measurement thread and must not make syscalls or take locks, so a
+ * push is a copy and one release store. Each side keeps a copy of the
+ * other side's index on its own cache line and only reloads it when the
+ * ring looks full or empty, so the two threads rarely share a line.
+ */
+
+/**
+ * @brief Create a sample ring.
+ *
+ * The records are allocated, touched and locked in memory here, so a
+ * push never page faults. Locking is best effort.
+ *
+ * @param ring The ring.
+ * @param size Number of records, a power of 2.
+ * @return 0 on success, -EINVAL on a bad size, -ENOMEM on failure.
+ */
+int sample_ring_init(struct sample_ring *ring, size_t size)
+{
+    memset(ring, 0, sizeof(*ring));
+    if (size < 2 || (size & (size - 1))) {
+        return -EINVAL;
+    }
+
+    ring->recs = malloc(size * sizeof(*ring->recs));
+    if (!ring->recs) {
+        return -ENOMEM;
+    }
+    memset(ring->recs, 0, size * sizeof(*ring->recs));
+    mlock(ring->recs, size * sizeof(*ring->recs));
+    ring->mask = size - 1;
+
+    return 0;
+}
+
+void sample_ring_free(struct sample_ring *ring)
+{
+    if (ring->recs) {
+        munlock(ring->recs, (ring->mask + 1) * sizeof(*ring->recs));
+    }
+    free(ring->recs);
+    ring->recs = NULL;
+}
+
+/**
+ * @brief Add a record, producer side.
+ *
+ * @param ring The ring.
+ * @param rec The record.
+ * @return 0 on success, -ENOBUFS when the ring is full, the record is
+ * dropped and counted.
+ */
+int sample_ring_push(struct sample_ring *ring, const struct sample_rec *rec)
+{
+    uint64_t head = ring->head;
+
+    if (head - ring->tail_cache > ring->mask) {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head - ring->tail_cache > ring->mask) {
+            __atomic_store_n(&ring->dropped, ring->dropped + 1,
+                             __ATOMIC_RELAXED);
+            return -ENOBUFS;
+        }
+    }
+
+    ring->recs[head & ring->mask] = *rec;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * @brief Take records, consumer side.
+ *
+ * @param ring The ring.
+ * @param recs Returns the records, oldest first.
+ * @param max Size of recs.
+ * @return the number of records taken, 0 if the ring is empty.
+ */
+size_t sample_ring_pop(struct sample_ring *ring, struct sample_rec *recs,
+                       size_t max)
+{
+    uint64_t tail = ring->tail;
+    size_t n, i;
+
+    if (ring->head_cache == tail) {
+        ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    }
+
+    n = ring->head_cache - tail;
+    if (n > max) {
+        n = max;
+    }
+    for (i = 0; i < n; i++) {
+        recs[i] = ring->recs[(tail + i) & ring->mask];
+    }
+    __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+
+    return n;
+}
+
+/**
+ * @brief Records dropped because the ring was full.
+ *
+ * @param ring The ring.
+ * @return the drop count, read from the consumer side.
+ */
+uint64_t sample_ring_dropped(const struct sample_ring *ring)
+{
+    return __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+}
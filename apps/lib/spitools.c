@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include <linux/spi/spidev.h>
+
+#include "./include/libfwtest.h"
+
+/* Max length of SPI device node name */
+#define SPI_DEVNAME_LEN 32
+/* spidev module parameters */
+#define SPIDEV_PARAMS "/sys/module/spidev/parameters"
+
+/**
+ * @brief open spidev device.
+ *
+ * @param bus SPI bus number.
+ * @param cs Chip select of the device on the bus.
+ *
+ * @return file The new file descriptor, or -1 if an error occurred.
+ */
+int open_spi_dev(int bus, int cs)
+{
+    char devname[SPI_DEVNAME_LEN];
+
+    snprintf(devname, sizeof(devname), "/dev/spidev%d.%d", bus, cs);
+    return open(devname, O_RDWR);
+}
+
+/**
+ * @brief set the default transfer parameters of a spidev device.
+ *
+ * @param file The file descriptor return from open_spi_dev().
+ * @param mode SPI mode bits, SPI_MODE_0 ... SPI_MODE_3 and flags.
+ * @param bits Bits per word.
+ * @param speed_hz Max clock rate in Hz.
+ *
+ * @return 0 for success, -error if fail.
+ */
+int spi_setup(int file, uint8_t mode, uint8_t bits, uint32_t speed_hz)
+{
+    if (ioctl(file, SPI_IOC_WR_MODE, &mode) < 0 ||
+        ioctl(file, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+        ioctl(file, SPI_IOC_WR_MAX_SPEED_HZ, &speed_hz) < 0) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief run several transfers as one SPI message.
+ *
+ * All transfers go down in a single SPI_IOC_MESSAGE(n) ioctl, so the
+ * syscall and the greybus SPI transfer operation are paid once per
+ * message rather than once per transfer.
+ *
+ * @param file The file descriptor return from open_spi_dev().
+ * @param xfers The transfers, in order.
+ * @param n Number of transfers, up to SPI_MAX_MESSAGE_XFERS.
+ *
+ * @return 0 for success, -error if fail.
+ */
+int spi_transfer_message(int file, struct spi_ioc_transfer *xfers, int n)
+{
+    if (n < 1 || n > SPI_MAX_MESSAGE_XFERS) {
+        return -EINVAL;
+    }
+
+    if (ioctl(file, SPI_IOC_MESSAGE(n), xfers) < 0) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief get the max bytes of one spidev SPI message.
+ *
+ * spidev rejects a message whose transfers add up to more than its
+ * bufsiz module parameter with -EMSGSIZE.
+ *
+ * @return bufsiz in bytes, or -error if it can not be read.
+ */
+int spi_get_bufsiz(void)
+{
+    char value[16];
+    int ret = 0;
+
+    ret = debugfs_get_attr(SPIDEV_PARAMS, "bufsiz", value,
+                           sizeof(value) - 1);
+    if (ret) {
+        return ret;
+    }
+
+    ret = atoi(value);
+    return ret > 0 ? ret : -EINVAL;
+}
@@ -0,0 +1,346 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "./include/libfwtest.h"
+
+/**
+ * @brief Read the raw monotonic clock
+ *
+ * CLOCK_MONOTONIC_RAW is not slewed by NTP, so intervals measured during a
+ * long benchmark stay comparable. Falls back on CLOCK_MONOTONIC for
+ * kernels without it.
+ *
+ * @return current time in nanoseconds
+ */
+uint64_t stats_now_ns(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts)) {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+    }
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Get the histogram bucket of a value
+ *
+ * Values below STATS_SUB_COUNT get a bucket each. Above, every power of
+ * two range is split in STATS_SUB_COUNT linear sub-buckets, which bounds
+ * the relative error by 1 / STATS_SUB_COUNT.
+ *
+ * @param value The recorded value
+ * @return bucket index
+ */
+static int bucket_index(uint64_t value)
+{
+    int msb = 0;
+
+    if (value < STATS_SUB_COUNT) {
+        return (int)value;
+    }
+
+    msb = 63 - __builtin_clzll(value);
+    return ((msb - STATS_SUB_BITS + 1) << STATS_SUB_BITS) +
+           (int)((value >> (msb - STATS_SUB_BITS)) - STATS_SUB_COUNT);
+}
+
+/**
+ * @brief Get the highest value that lands in a bucket
+ *
+ * @param index Bucket index
+ * @return value
+ */
+static uint64_t bucket_value(int index)
+{
+    int group = index >> STATS_SUB_BITS;
+    uint64_t sub = index & (STATS_SUB_COUNT - 1);
+
+    if (group == 0) {
+        return sub;
+    }
+
+    return ((STATS_SUB_COUNT + sub + 1) << (group - 1)) - 1;
+}
+
+/**
+ * @brief Reset a histogram
+ *
+ * @param hist The histogram
+ * @return None
+ */
+void stats_hist_init(struct stats_hist *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+    hist->min = UINT64_MAX;
+}
+
+/**
+ * @brief Record one value in a histogram
+ *
+ * Lock-free, several threads may record in the same histogram.
+ *
+ * @param hist The histogram
+ * @param value The value, usually a latency in nanoseconds
+ * @return None
+ */
+void stats_hist_record(struct stats_hist *hist, uint64_t value)
+{
+    uint64_t cur;
+
+    __atomic_fetch_add(&hist->buckets[bucket_index(value)], 1,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum, value, __ATOMIC_RELAXED);
+
+    cur = __atomic_load_n(&hist->min, __ATOMIC_RELAXED);
+    while (value < cur &&
+           !__atomic_compare_exchange_n(&hist->min, &cur, value, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    cur = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    while (value > cur &&
+           !__atomic_compare_exchange_n(&hist->max, &cur, value, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * @brief Add all values of a histogram to another one
+ *
+ * @param dst The histogram to add to
+ * @param src The histogram to add
+ * @return None
+ */
+void stats_hist_merge(struct stats_hist *dst, const struct stats_hist *src)
+{
+    int i = 0;
+
+    for (i = 0; i < STATS_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+/**
+ * @brief Get a percentile of the recorded values
+ *
+ * @param hist The histogram
+ * @param pct Percentile, 0 to 100
+ * @return the highest value of the percentile's bucket, capped to the
+ * recorded max, 0 for an empty histogram
+ */
+uint64_t stats_hist_percentile(const struct stats_hist *hist, double pct)
+{
+    uint64_t target, seen = 0, value;
+    int i = 0;
+
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    if (pct <= 0.0) {
+        return hist->min;
+    } else if (pct >= 100.0) {
+        return hist->max;
+    }
+
+    target = (uint64_t)(pct / 100.0 * hist->count);
+    if (target < pct / 100.0 * hist->count || target == 0) {
+        target++;
+    }
+    for (i = 0; i < STATS_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target) {
+            break;
+        }
+    }
+
+    value = bucket_value(i);
+    if (value > hist->max) {
+        value = hist->max;
+    }
+    if (value < hist->min) {
+        value = hist->min;
+    }
+
+    return value;
+}
+
+/**
+ * @brief Get the mean of the recorded values
+ *
+ * @param hist The histogram
+ * @return mean, 0 for an empty histogram
+ */
+double stats_hist_mean(const struct stats_hist *hist)
+{
+    return hist->count ? (double)hist->sum / hist->count : 0.0;
+}
+
+/**
+ * @brief Print the summary of a latency histogram as [P] lines
+ *
+ * Values are recorded in nanoseconds and printed in microseconds.
+ *
+ * @param case_id The testlink id for test case.
+ * @param name Metric name prefix
+ * @param hist The histogram
+ * @return None
+ */
+void stats_hist_report(int case_id, const char *name,
+                       const struct stats_hist *hist)
+{
+    static const struct {
+        const char *suffix;
+        double pct;
+    } points[] = {
+        { "p50", 50.0 },
+        { "p90", 90.0 },
+        { "p99", 99.0 },
+        { "p999", 99.9 },
+        { "max", 100.0 },
+    };
+    char metric[64];
+    unsigned int i = 0;
+
+    snprintf(metric, sizeof(metric), "%s_count", name);
+    print_test_case_perf(case_id, metric, (double)hist->count, "samples");
+    if (hist->count == 0) {
+        return;
+    }
+
+    snprintf(metric, sizeof(metric), "%s_min", name);
+    print_test_case_perf(case_id, metric, hist->min / 1000.0, "us");
+    snprintf(metric, sizeof(metric), "%s_mean", name);
+    print_test_case_perf(case_id, metric, stats_hist_mean(hist) / 1000.0,
+                         "us");
+    for (i = 0; i < sizeof(points) / sizeof(points[0]); i++) {
+        snprintf(metric, sizeof(metric), "%s_%s", name, points[i].suffix);
+        print_test_case_perf(case_id, metric,
+                             stats_hist_percentile(hist, points[i].pct) /
+                             1000.0, "us");
+    }
+}
+
+/**
+ * @brief Print the non-empty power of two ranges of a latency histogram
+ *
+ * Values are recorded in nanoseconds and printed in microseconds, one
+ * "<prefix> hist_us[low-high)=count" line per range.
+ *
+ * @param prefix Line prefix
+ * @param hist The histogram
+ * @return None
+ */
+void stats_hist_dump(const char *prefix, const struct stats_hist *hist)
+{
+    uint64_t count = 0, low = 0, high = 0;
+    int group = 0, i = 0;
+
+    for (group = 0; group <= STATS_BUCKETS / STATS_SUB_COUNT - 1; group++) {
+        count = 0;
+        for (i = 0; i < STATS_SUB_COUNT; i++) {
+            count += hist->buckets[group * STATS_SUB_COUNT + i];
+        }
+        if (!count) {
+            continue;
+        }
+
+        low = group ? 1ULL << (group + STATS_SUB_BITS - 1) : 0;
+        high = bucket_value(group * STATS_SUB_COUNT + STATS_SUB_COUNT - 1) + 1;
+        printf("%s hist_us[%.3f-%.3f)=%llu\n", prefix, low / 1000.0,
+               high / 1000.0, (unsigned long long)count);
+    }
+}
+
+/**
+ * @brief Reset a streaming mean and variance
+ *
+ * @param run The running statistics
+ * @return None
+ */
+void stats_running_init(struct stats_running *run)
+{
+    memset(run, 0, sizeof(*run));
+}
+
+/**
+ * @brief Add one value to a streaming mean and variance
+ *
+ * Uses Welford's update, which stays accurate over long runs. Not thread
+ * safe.
+ *
+ * @param run The running statistics
+ * @param value The value
+ * @return None
+ */
+void stats_running_add(struct stats_running *run, double value)
+{
+    double delta = value - run->mean;
+
+    run->n++;
+    run->mean += delta / run->n;
+    run->m2 += delta * (value - run->mean);
+}
+
+/**
+ * @brief Get the mean of a streaming mean and variance
+ *
+ * @param run The running statistics
+ * @return mean, 0 without values
+ */
+double stats_running_mean(const struct stats_running *run)
+{
+    return run->mean;
+}
+
+/**
+ * @brief Get the sample variance of a streaming mean and variance
+ *
+ * @param run The running statistics
+ * @return variance, 0 with less than two values
+ */
+double stats_running_variance(const struct stats_running *run)
+{
+    return run->n > 1 ? run->m2 / (run->n - 1) : 0.0;
+}
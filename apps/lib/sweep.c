@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "./include/libfwtest.h"
+
+/**
+ * @brief Parse a comma separated sweep list, like "1,2,4,8".
+ *
+ * @param sweep The sweep to fill.
+ * @param list The list from command line.
+ * @param min Min value allowed.
+ * @param max Max value allowed.
+ * @return 0 on success, -EINVAL on an empty or bad list, a value out of
+ * range or more than SWEEP_MAX values.
+ */
+int sweep_parse(struct sweep *sweep, const char *list, int min, int max)
+{
+    char buf[256];
+    char *tok, *end, *save = NULL;
+    long value;
+
+    sweep->count = 0;
+    if (snprintf(buf, sizeof(buf), "%s", list) >= (int)sizeof(buf)) {
+        return -EINVAL;
+    }
+
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        errno = 0;
+        value = strtol(tok, &end, 10);
+        if (errno || end == tok || *end != '\0' || value < min ||
+            value > max || sweep->count >= SWEEP_MAX) {
+            return -EINVAL;
+        }
+        sweep->value[sweep->count++] = (int)value;
+    }
+
+    return sweep->count ? 0 : -EINVAL;
+}
@@ -0,0 +1,439 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/limits.h>
+
+#include "./include/libfwtest.h"
+
+/*
+ * Kernel trace support: tracefs control, trace event formats and the
+ * binary ring buffer pages of trace_pipe_raw.
+ *
+ * Apps mark their calls with trace_call_begin()/trace_call_end(). The
+ * marks go through trace_marker into the same ring buffer, with the same
+ * clock, as the kernel events, so a trace decoder can attribute events to
+ * calls without any clock correlation. Marking is off unless the app runs
+ * with FWTEST_TRACE set, then each mark costs one write().
+ */
+
+#define TRACEFS_DIR      "/sys/kernel/tracing"
+#define TRACEFS_DEBUGFS  "/sys/kernel/debug/tracing"
+/* Max size of a format file */
+#define FORMAT_LEN 8192
+
+/* ring buffer event types, see kernel/trace/ring_buffer.c */
+#define RB_TYPE_DATA_MAX   28
+#define RB_TYPE_PADDING    29
+#define RB_TYPE_TIME_EXTEND 30
+#define RB_TYPE_TIME_STAMP 31
+#define RB_TIME_SHIFT      27
+/* commit field flags, the low bits are the data length */
+#define RB_MISSED_EVENTS   (1ULL << 31)
+#define RB_COMMIT_MASK     0xfffffULL
+
+static int marker_fd = -2;
+
+/**
+ * @brief Get the tracefs mount point.
+ *
+ * @return the tracefs directory, NULL when tracing is not available.
+ */
+const char *tracefs_dir(void)
+{
+    if (!access(TRACEFS_DIR "/trace", F_OK)) {
+        return TRACEFS_DIR;
+    }
+    if (!access(TRACEFS_DEBUGFS "/trace", F_OK)) {
+        return TRACEFS_DEBUGFS;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Write a tracefs control file.
+ *
+ * @param file Path of the file under the tracefs directory.
+ * @param value The value.
+ * @return 0 on success, -errno on failure.
+ */
+int tracefs_write(const char *file, const char *value)
+{
+    char path[PATH_MAX];
+    int fd = -1, ret = 0;
+
+    if (tracefs_dir() == NULL) {
+        return -ENOENT;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", tracefs_dir(), file);
+    fd = open(path, O_WRONLY | O_TRUNC);
+    if (fd < 0) {
+        return -errno;
+    }
+    if (write(fd, value, strlen(value)) < 0) {
+        ret = -errno;
+    }
+    close(fd);
+
+    return ret;
+}
+
+/**
+ * @brief Read a tracefs file.
+ *
+ * @param file Path of the file under the tracefs directory.
+ * @param buf Returns the content, NUL terminated.
+ * @param len The buffer size.
+ * @return 0 on success, -errno on failure.
+ */
+int tracefs_read(const char *file, char *buf, int len)
+{
+    char path[PATH_MAX];
+    int fd = -1, n = 0, total = 0;
+
+    if (tracefs_dir() == NULL) {
+        return -ENOENT;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", tracefs_dir(), file);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -errno;
+    }
+    while (total < len - 1 && (n = read(fd, buf + total,
+                                        len - 1 - total)) > 0) {
+        total += n;
+    }
+    close(fd);
+    buf[total] = '\0';
+
+    return n < 0 ? -errno : 0;
+}
+
+/**
+ * @brief Get the offset and size of a field in a format description.
+ *
+ * Lines look like "field:unsigned short operation_id; offset:10; size:2;".
+ *
+ * @param format The format file content.
+ * @param field The field name.
+ * @param offset Returns the field offset.
+ * @param size Returns the field size.
+ * @return 0 on success, -ENOENT if there is no such field.
+ */
+static int parse_field(const char *format, const char *field, int *offset,
+                       int *size)
+{
+    const char *line = format, *decl = NULL, *semi = NULL, *name = NULL;
+    size_t len = strlen(field);
+
+    while ((line = strstr(line, "field:")) != NULL) {
+        decl = line + strlen("field:");
+        semi = strchr(decl, ';');
+        if (semi == NULL) {
+            break;
+        }
+
+        /* the name is the last word of the declaration, before any [] */
+        name = semi;
+        while (name > decl && name[-1] == ']') {
+            while (name > decl && *--name != '[') {
+            }
+        }
+        if ((size_t)(name - decl) >= len &&
+            !strncmp(name - len, field, len) &&
+            (name - len == decl || name[-len - 1] == ' ' ||
+             name[-len - 1] == '*') &&
+            sscanf(semi, "; offset:%d; size:%d;", offset, size) == 2) {
+            return 0;
+        }
+        line = semi;
+    }
+
+    return -ENOENT;
+}
+
+/**
+ * @brief Get the ID of a trace event.
+ *
+ * @param system The event system, e.g. "greybus".
+ * @param event The event name.
+ * @return the event ID, -errno on failure.
+ */
+int trace_event_id(const char *system, const char *event)
+{
+    char file[PATH_MAX / 2], buf[32];
+    int ret = 0;
+
+    snprintf(file, sizeof(file), "events/%s/%s/id", system, event);
+    ret = tracefs_read(file, buf, sizeof(buf));
+
+    return ret ? ret : atoi(buf);
+}
+
+/**
+ * @brief Get the offset and size of a trace event field.
+ *
+ * @param system The event system.
+ * @param event The event name.
+ * @param field The field name.
+ * @param offset Returns the offset in the event record.
+ * @param size Returns the field size.
+ * @return 0 on success, -errno on failure.
+ */
+int trace_event_field(const char *system, const char *event,
+                      const char *field, int *offset, int *size)
+{
+    static char format[FORMAT_LEN];
+    char file[PATH_MAX / 2];
+    int ret = 0;
+
+    snprintf(file, sizeof(file), "events/%s/%s/format", system, event);
+    ret = tracefs_read(file, format, sizeof(format));
+
+    return ret ? ret : parse_field(format, field, offset, size);
+}
+
+/**
+ * @brief Get the layout of the ring buffer pages of trace_pipe_raw.
+ *
+ * @param layout Returns the layout.
+ * @return 0 on success, -errno on failure.
+ */
+int trace_page_layout(struct trace_page_layout *layout)
+{
+    static char format[FORMAT_LEN];
+    int ts_size = 0, data_size = 0, ret = 0;
+
+    ret = tracefs_read("events/header_page", format, sizeof(format));
+    if (!ret) {
+        ret = parse_field(format, "timestamp", &layout->ts_offset, &ts_size);
+    }
+    if (!ret) {
+        ret = parse_field(format, "commit", &layout->commit_offset,
+                          &layout->commit_size);
+    }
+    if (!ret) {
+        ret = parse_field(format, "data", &layout->data_offset, &data_size);
+    }
+    if (ret) {
+        return ret;
+    }
+
+    layout->page_size = layout->data_offset + data_size;
+
+    return 0;
+}
+
+static uint32_t read_u32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * @brief Decode the events of one ring buffer page.
+ *
+ * @param layout The page layout.
+ * @param page The page as read from trace_pipe_raw.
+ * @param cpu The CPU of the page.
+ * @param fn Called for each event record, with its ring buffer timestamp.
+ * @param ctx Passed to fn.
+ * @return 1 if the kernel lost events before this page, else 0.
+ */
+int trace_parse_page(const struct trace_page_layout *layout,
+                     const uint8_t *page, int cpu, trace_event_fn fn,
+                     void *ctx)
+{
+    const uint8_t *p = page + layout->data_offset, *end = NULL;
+    uint64_t ts = 0, commit = 0;
+    uint32_t hdr = 0, type_len = 0, delta = 0, len = 0;
+
+    memcpy(&ts, page + layout->ts_offset, sizeof(ts));
+    memcpy(&commit, page + layout->commit_offset,
+           layout->commit_size < 8 ? layout->commit_size : 8);
+
+    end = p + (commit & RB_COMMIT_MASK);
+    if (end > page + layout->page_size) {
+        end = page + layout->page_size;
+    }
+
+    while (p + 4 <= end) {
+        hdr = read_u32(p);
+        type_len = hdr & 0x1f;
+        delta = hdr >> 5;
+
+        switch (type_len) {
+            case RB_TYPE_PADDING:
+                if (!delta || p + 8 > end) {
+                    /* the rest of the page is unused */
+                    return !!(commit & RB_MISSED_EVENTS);
+                }
+                ts += delta;
+                p += 4 + read_u32(p + 4);
+                break;
+            case RB_TYPE_TIME_EXTEND:
+                ts += ((uint64_t)read_u32(p + 4) << RB_TIME_SHIFT) + delta;
+                p += 8;
+                break;
+            case RB_TYPE_TIME_STAMP:
+                ts = ((uint64_t)read_u32(p + 4) << RB_TIME_SHIFT) + delta;
+                p += 8;
+                break;
+            case 0:
+                ts += delta;
+                len = read_u32(p + 4);
+                if (len < 4 || p + 4 + len > end) {
+                    return !!(commit & RB_MISSED_EVENTS);
+                }
+                fn(ctx, cpu, ts, p + 8, len - 4);
+                p += 4 + len;
+                break;
+            default:
+                ts += delta;
+                len = type_len * 4;
+                if (p + 4 + len > end) {
+                    return !!(commit & RB_MISSED_EVENTS);
+                }
+                fn(ctx, cpu, ts, p + 4, len);
+                p += 4 + len;
+                break;
+        }
+    }
+
+    return !!(commit & RB_MISSED_EVENTS);
+}
+
+/**
+ * @brief Read and decode the pages the ring buffer holds, on every CPU.
+ *
+ * Reading consumes the events, so a drain with tracing off leaves the
+ * buffer empty for the next measurement.
+ *
+ * @param layout The page layout.
+ * @param fn Called for each event record.
+ * @param ctx Passed to fn.
+ * @return number of pages with lost events before them, -errno on failure.
+ */
+int trace_drain(const struct trace_page_layout *layout, trace_event_fn fn,
+                void *ctx)
+{
+    char path[PATH_MAX];
+    uint8_t *page = NULL;
+    int cpu = 0, fd = -1, lost = 0;
+
+    if (tracefs_dir() == NULL) {
+        return -ENOENT;
+    }
+    page = malloc(layout->page_size);
+    if (page == NULL) {
+        return -ENOMEM;
+    }
+
+    for (cpu = 0; ; cpu++) {
+        snprintf(path, sizeof(path), "%s/per_cpu/cpu%d/trace_pipe_raw",
+                 tracefs_dir(), cpu);
+        fd = open(path, O_RDONLY | O_NONBLOCK);
+        if (fd < 0) {
+            break;
+        }
+        while (1) {
+            memset(page, 0, layout->page_size);
+            if (read(fd, page, layout->page_size) <= 0) {
+                break;
+            }
+            lost += trace_parse_page(layout, page, cpu, fn, ctx);
+        }
+        close(fd);
+    }
+    free(page);
+
+    return lost;
+}
+
+/**
+ * @brief Write a call mark to the trace.
+ *
+ * @param phase 'B' for the start of a call, 'E' for its end.
+ * @param name The call name.
+ */
+static void trace_call_mark(char phase, const char *name)
+{
+    char path[PATH_MAX], buf[64];
+    int len = 0;
+
+    if (marker_fd == -2) {
+        marker_fd = -1;
+        if (getenv("FWTEST_TRACE") != NULL && tracefs_dir() != NULL) {
+            snprintf(path, sizeof(path), "%s/trace_marker", tracefs_dir());
+            marker_fd = open(path, O_WRONLY);
+        }
+    }
+    if (marker_fd < 0) {
+        return;
+    }
+
+    len = snprintf(buf, sizeof(buf), "%s%c %s", TRACE_MARK_PREFIX, phase,
+                   name);
+    if (write(marker_fd, buf, len) < 0) {
+        close(marker_fd);
+        marker_fd = -1;
+    }
+}
+
+/**
+ * @brief Mark the start of an app level call in the kernel trace.
+ *
+ * @param name The call name, marks nest by name per thread.
+ * @return None
+ */
+void trace_call_begin(const char *name)
+{
+    trace_call_mark('B', name);
+}
+
+/**
+ * @brief Mark the end of an app level call in the kernel trace.
+ *
+ * @param name The call name given to trace_call_begin().
+ * @return None
+ */
+void trace_call_end(const char *name)
+{
+    trace_call_mark('E', name);
+}
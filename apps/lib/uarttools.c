@@ -0,0 +1,290 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "./include/libfwtest.h"
+
+struct uart_baud {
+    int baud;
+    speed_t speed;
+};
+
+static const struct uart_baud uart_bauds[] = {
+    { 9600, B9600 },
+    { 19200, B19200 },
+    { 38400, B38400 },
+    { 57600, B57600 },
+    { 115200, B115200 },
+    { 230400, B230400 },
+    { 460800, B460800 },
+    { 921600, B921600 },
+    { 1000000, B1000000 },
+    { 1500000, B1500000 },
+    { 2000000, B2000000 },
+    { 3000000, B3000000 },
+    { 4000000, B4000000 },
+};
+
+/**
+ * @brief map a baud rate to its termios speed.
+ *
+ * @param baud Baud rate in bits per second.
+ * @param speed Returns the termios speed constant.
+ *
+ * @return 0 for success, -EINVAL if the rate has no termios constant.
+ */
+int uart_baud_to_speed(int baud, speed_t *speed)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(uart_bauds) / sizeof(uart_bauds[0]); i++) {
+        if (uart_bauds[i].baud == baud) {
+            *speed = uart_bauds[i].speed;
+            return 0;
+        }
+    }
+
+    return -EINVAL;
+}
+
+/**
+ * @brief open UART tty device.
+ *
+ * The tty does not become the controlling terminal of the test.
+ *
+ * @param path The tty device node.
+ *
+ * @return file The new file descriptor, or -1 if an error occurred.
+ */
+int open_uart_tty(const char *path)
+{
+    return open(path, O_RDWR | O_NOCTTY);
+}
+
+/**
+ * @brief fill in a raw termios with line settings.
+ *
+ * @param tio The termios, from tcgetattr().
+ * @param speed termios speed constant.
+ * @param bits Word size, 5 to 8.
+ * @param parity 'n'one, 'e'ven, 'o'dd, 'm'ark or 's'pace.
+ * @param stop Stop bits, 1 or 2.
+ * @param flow Non zero to enable RTS/CTS hardware flow control.
+ *
+ * @return 0 for success, -EINVAL on bad settings.
+ */
+static int uart_make_termios(struct termios *tio, speed_t speed, int bits,
+                             char parity, int stop, int flow)
+{
+    static const tcflag_t sizes[] = { CS5, CS6, CS7, CS8 };
+
+    if (bits < 5 || bits > 8 || stop < 1 || stop > 2 ||
+        !strchr("neoms", parity) || parity == '\0') {
+        return -EINVAL;
+    }
+
+    cfmakeraw(tio);
+    tio->c_cflag |= CLOCAL | CREAD;
+    tio->c_cflag &= ~(CSIZE | CSTOPB | PARENB | PARODD | CMSPAR | CRTSCTS);
+    tio->c_cflag |= sizes[bits - 5];
+    if (stop == 2) {
+        tio->c_cflag |= CSTOPB;
+    }
+    if (parity != 'n') {
+        tio->c_cflag |= PARENB;
+    }
+    if (parity == 'o' || parity == 'm') {
+        tio->c_cflag |= PARODD;
+    }
+    if (parity == 'm' || parity == 's') {
+        tio->c_cflag |= CMSPAR;
+    }
+    if (flow) {
+        tio->c_cflag |= CRTSCTS;
+    }
+    tio->c_cc[VMIN] = 0;
+    tio->c_cc[VTIME] = 0;
+    cfsetispeed(tio, speed);
+    cfsetospeed(tio, speed);
+
+    return 0;
+}
+
+/**
+ * @brief put a UART tty in raw 8N1 mode.
+ *
+ * Reads return whatever has arrived without waiting (VMIN and VTIME 0),
+ * callers wait with poll(). Both queues are flushed.
+ *
+ * @param file The file descriptor return from open_uart_tty().
+ * @param baud Baud rate in bits per second.
+ * @param flow Non zero to enable RTS/CTS hardware flow control.
+ *
+ * @return 0 for success, -error if fail.
+ */
+int uart_set_raw(int file, int baud, int flow)
+{
+    struct termios tio;
+    speed_t speed;
+    int ret;
+
+    ret = uart_baud_to_speed(baud, &speed);
+    if (ret) {
+        return ret;
+    }
+
+    if (tcgetattr(file, &tio) < 0) {
+        return -errno;
+    }
+
+    uart_make_termios(&tio, speed, 8, 'n', 1, flow);
+
+    if (tcsetattr(file, TCSANOW, &tio) < 0 || tcflush(file, TCIOFLUSH) < 0) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief switch the line settings of a raw UART tty.
+ *
+ * For changing settings on a tty in use: the queues are not flushed,
+ * the new settings apply once the output queue has drained. tcsetattr()
+ * succeeds when any of the settings was taken, so they are read back.
+ *
+ * @param file The file descriptor return from open_uart_tty().
+ * @param baud Baud rate in bits per second.
+ * @param bits Word size, 5 to 8.
+ * @param parity 'n'one, 'e'ven, 'o'dd, 'm'ark or 's'pace.
+ * @param stop Stop bits, 1 or 2.
+ * @param flow Non zero to enable RTS/CTS hardware flow control.
+ *
+ * @return 0 for success, -EOPNOTSUPP if the driver did not take all
+ * settings, -error if fail.
+ */
+int uart_set_line(int file, int baud, int bits, char parity, int stop,
+                  int flow)
+{
+    const tcflag_t mask = CSIZE | CSTOPB | PARENB | PARODD | CMSPAR | CRTSCTS;
+    struct termios tio, got;
+    speed_t speed;
+    int ret;
+
+    ret = uart_baud_to_speed(baud, &speed);
+    if (ret) {
+        return ret;
+    }
+
+    if (tcgetattr(file, &tio) < 0) {
+        return -errno;
+    }
+
+    ret = uart_make_termios(&tio, speed, bits, parity, stop, flow);
+    if (ret) {
+        return ret;
+    }
+
+    if (tcsetattr(file, TCSADRAIN, &tio) < 0 || tcgetattr(file, &got) < 0) {
+        return -errno;
+    }
+
+    if ((got.c_cflag & mask) != (tio.c_cflag & mask) ||
+        cfgetospeed(&got) != speed) {
+        return -EOPNOTSUPP;
+    }
+
+    return 0;
+}
+
+static uint8_t uart_frame_sum(const uint8_t *frame)
+{
+    uint8_t sum = 0;
+    int i;
+
+    for (i = 0; i < UART_FRAME_SIZE - 1; i++) {
+        sum += frame[i];
+    }
+    return ~sum;
+}
+
+/**
+ * @brief Build one loopback test frame.
+ *
+ * @param frame The frame buffer, UART_FRAME_SIZE bytes.
+ * @param seq Sequence number.
+ * @param flags Frame flags.
+ */
+void uart_frame_build(uint8_t *frame, uint32_t seq, uint8_t flags)
+{
+    int i;
+
+    frame[0] = UART_FRAME_MAGIC;
+    frame[1] = flags;
+    frame[2] = seq & 0xff;
+    frame[3] = (seq >> 8) & 0xff;
+    frame[4] = (seq >> 16) & 0xff;
+    frame[5] = (seq >> 24) & 0xff;
+    for (i = UART_FRAME_HDR_LEN; i < UART_FRAME_SIZE - 1; i++) {
+        frame[i] = (uint8_t)(seq * 7 + i);
+    }
+    frame[UART_FRAME_SIZE - 1] = uart_frame_sum(frame);
+}
+
+/**
+ * @brief Check one received loopback test frame.
+ *
+ * @param frame The frame, UART_FRAME_SIZE bytes.
+ * @param seq Returns the sequence number.
+ * @return 0 on success, -EBADMSG on a bad checksum or payload.
+ */
+int uart_frame_check(const uint8_t *frame, uint32_t *seq)
+{
+    int i;
+
+    if (frame[UART_FRAME_SIZE - 1] != uart_frame_sum(frame)) {
+        return -EBADMSG;
+    }
+
+    *seq = frame[2] | frame[3] << 8 | frame[4] << 16 |
+           (uint32_t)frame[5] << 24;
+    for (i = UART_FRAME_HDR_LEN; i < UART_FRAME_SIZE - 1; i++) {
+        if (frame[i] != (uint8_t)(*seq * 7 + i)) {
+            return -EBADMSG;
+        }
+    }
+
+    return 0;
+}
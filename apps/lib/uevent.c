@@ -0,0 +1,384 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <libgen.h>
+#include <sys/socket.h>
+#include <sys/inotify.h>
+#include <linux/limits.h>
+#include <linux/netlink.h>
+
+#include "./include/libfwtest.h"
+
+/*
+ * Kernel uevents, to wait for devices instead of sleeping or polling
+ * sysfs. Open the socket before the action that makes the device come or
+ * go, then wait on it, so the uevent cannot be missed.
+ */
+
+/* socket receive buffer, module insertion is bursty */
+#define UEVENT_RCVBUF (1024 * 1024)
+
+static const char empty[] = "";
+
+/**
+ * @brief Open a socket on the kernel uevents.
+ *
+ * @return the socket, -errno on failure.
+ */
+int uevent_open(void)
+{
+    struct sockaddr_nl addr;
+    int sock = -1, size = UEVENT_RCVBUF;
+
+    sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+                  NETLINK_KOBJECT_UEVENT);
+    if (sock < 0) {
+        return -errno;
+    }
+
+    /* RCVBUFFORCE needs privileges, RCVBUF is the fallback */
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size))) {
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1;
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(sock);
+        return -errno;
+    }
+
+    return sock;
+}
+
+/**
+ * @brief Close a uevent socket.
+ *
+ * @param sock The socket from uevent_open().
+ * @return None
+ */
+void uevent_close(int sock)
+{
+    if (sock >= 0) {
+        close(sock);
+    }
+}
+
+/**
+ * @brief Get a value of a uevent.
+ *
+ * @param ev The uevent.
+ * @param key The key, e.g. "DRIVER".
+ * @return the value, "" if the uevent has no such key.
+ */
+const char *uevent_get(const struct uevent *ev, const char *key)
+{
+    const char *p = ev->buf, *end = ev->buf + ev->len;
+    size_t len = strlen(key);
+
+    /* the first string is the "action@devpath" header */
+    for (p += strlen(p) + 1; p < end; p += strlen(p) + 1) {
+        if (!strncmp(p, key, len) && p[len] == '=') {
+            return p + len + 1;
+        }
+    }
+
+    return empty;
+}
+
+/**
+ * @brief Parse a message received on a uevent socket.
+ *
+ * @param ev The uevent, buf and len set.
+ * @return 0 on success, -EINVAL if this is not a kernel uevent.
+ */
+static int parse_uevent(struct uevent *ev)
+{
+    /* udev's own messages start with "libudev" */
+    if (strchr(ev->buf, '@') == NULL) {
+        return -EINVAL;
+    }
+
+    ev->action = uevent_get(ev, "ACTION");
+    ev->devpath = uevent_get(ev, "DEVPATH");
+    ev->subsystem = uevent_get(ev, "SUBSYSTEM");
+    ev->devtype = uevent_get(ev, "DEVTYPE");
+    ev->devname = uevent_get(ev, "DEVNAME");
+
+    return ev->action[0] && ev->devpath[0] ? 0 : -EINVAL;
+}
+
+/**
+ * @brief Receive the next kernel uevent.
+ *
+ * @param sock The socket from uevent_open().
+ * @param ev Returns the uevent, time stamped on arrival.
+ * @param timeout_ms Give up time, -1 to wait forever.
+ * @return 0 on success, -ETIMEDOUT or -errno on failure.
+ */
+int uevent_recv(int sock, struct uevent *ev, int timeout_ms)
+{
+    struct pollfd fds;
+    uint64_t deadline = 0, now = 0;
+    ssize_t n;
+    int ret = 0, wait = timeout_ms;
+
+    if (timeout_ms >= 0) {
+        deadline = stats_now_ns() + timeout_ms * 1000000ULL;
+    }
+
+    while (1) {
+        fds.fd = sock;
+        fds.events = POLLIN;
+        ret = poll(&fds, 1, wait);
+        if (ret < 0 && errno != EINTR) {
+            return -errno;
+        }
+        if (!ret) {
+            return -ETIMEDOUT;
+        }
+
+        if (ret > 0) {
+            n = recv(sock, ev->buf, sizeof(ev->buf) - 1, MSG_DONTWAIT);
+            if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                return -errno;
+            }
+            if (n > 0) {
+                ev->ts = stats_now_ns();
+                ev->buf[n] = '\0';
+                ev->len = n;
+                if (!parse_uevent(ev)) {
+                    return 0;
+                }
+            }
+        }
+
+        if (timeout_ms >= 0) {
+            now = stats_now_ns();
+            if (now >= deadline) {
+                return -ETIMEDOUT;
+            }
+            wait = (deadline - now + 999999) / 1000000;
+        }
+    }
+}
+
+/**
+ * @brief Check a uevent against a filter.
+ *
+ * @param ev The uevent.
+ * @param filter The filter, NULL members match anything.
+ * @return 1 if the uevent matches, else 0.
+ */
+int uevent_match(const struct uevent *ev, const struct uevent_filter *filter)
+{
+    const char *eq = NULL;
+    char key[64];
+    size_t len = 0;
+
+    if ((filter->action && strcmp(ev->action, filter->action)) ||
+        (filter->subsystem && strcmp(ev->subsystem, filter->subsystem)) ||
+        (filter->devtype && strcmp(ev->devtype, filter->devtype)) ||
+        (filter->devpath && !strstr(ev->devpath, filter->devpath))) {
+        return 0;
+    }
+
+    if (filter->env != NULL) {
+        eq = strchr(filter->env, '=');
+        if (eq == NULL) {
+            return uevent_get(ev, filter->env)[0] != '\0';
+        }
+        len = eq - filter->env;
+        if (len >= sizeof(key)) {
+            return 0;
+        }
+        memcpy(key, filter->env, len);
+        key[len] = '\0';
+        return !strcmp(uevent_get(ev, key), eq + 1);
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Wait for a uevent that matches a filter.
+ *
+ * @param sock The socket from uevent_open(), opened before the action that
+ * makes the uevent.
+ * @param filter The filter.
+ * @param timeout_ms Give up time, -1 to wait forever.
+ * @param ev Returns the matching uevent, may be NULL.
+ * @return 0 on success, -ETIMEDOUT or -errno on failure.
+ */
+int uevent_wait(int sock, const struct uevent_filter *filter, int timeout_ms,
+                struct uevent *ev)
+{
+    static struct uevent scratch;
+    uint64_t deadline = 0, now = 0;
+    int ret = 0, wait = timeout_ms;
+
+    if (ev == NULL) {
+        ev = &scratch;
+    }
+    if (timeout_ms >= 0) {
+        deadline = stats_now_ns() + timeout_ms * 1000000ULL;
+    }
+
+    while (1) {
+        ret = uevent_recv(sock, ev, wait);
+        if (ret) {
+            return ret;
+        }
+        if (uevent_match(ev, filter)) {
+            return 0;
+        }
+        if (timeout_ms >= 0) {
+            now = stats_now_ns();
+            if (now >= deadline) {
+                return -ETIMEDOUT;
+            }
+            wait = (deadline - now + 999999) / 1000000;
+        }
+    }
+}
+
+/**
+ * @brief Wait for a sysfs path to appear or go.
+ *
+ * Sysfs entries exist by the time their uevent is sent, so the path is
+ * checked again after every uevent, never polled.
+ *
+ * @param path The sysfs path.
+ * @param present 1 to wait for the path to exist, 0 for it to go.
+ * @param timeout_ms Give up time, -1 to wait forever.
+ * @return 0 on success, -ETIMEDOUT or -errno on failure.
+ */
+int uevent_wait_sysfs(const char *path, int present, int timeout_ms)
+{
+    static struct uevent ev;
+    uint64_t deadline = 0, now = 0;
+    int sock = -1, ret = 0, wait = timeout_ms;
+
+    sock = uevent_open();
+    if (sock < 0) {
+        return sock;
+    }
+
+    if (timeout_ms >= 0) {
+        deadline = stats_now_ns() + timeout_ms * 1000000ULL;
+    }
+
+    while ((access(path, F_OK) == 0) != present) {
+        ret = uevent_recv(sock, &ev, wait);
+        if (ret) {
+            break;
+        }
+        if (timeout_ms >= 0) {
+            now = stats_now_ns();
+            wait = now < deadline ? (deadline - now + 999999) / 1000000 : 0;
+        }
+    }
+    uevent_close(sock);
+
+    /* a last look, the uevent may have raced the timeout */
+    if (ret == -ETIMEDOUT && (access(path, F_OK) == 0) == present) {
+        ret = 0;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Wait for a device node to appear.
+ *
+ * Nodes are made by ueventd or udev after the uevent, so the directory of
+ * the node is watched with inotify.
+ *
+ * @param path The node, e.g. "/dev/block/mmcblk1".
+ * @param timeout_ms Give up time, -1 to wait forever.
+ * @return 0 on success, -ETIMEDOUT or -errno on failure.
+ */
+int uevent_wait_devnode(const char *path, int timeout_ms)
+{
+    char dir[PATH_MAX], buf[4096];
+    struct pollfd fds;
+    uint64_t deadline = 0, now = 0;
+    int fd = -1, ret = 0, wait = timeout_ms;
+
+    if (!access(path, F_OK)) {
+        return 0;
+    }
+
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+    snprintf(dir, sizeof(dir), "%s", path);
+    if (inotify_add_watch(fd, dirname(dir), IN_CREATE | IN_MOVED_TO) < 0) {
+        ret = -errno;
+        close(fd);
+        return ret;
+    }
+
+    if (timeout_ms >= 0) {
+        deadline = stats_now_ns() + timeout_ms * 1000000ULL;
+    }
+
+    /* checked again once watched, it may have come in between */
+    while (access(path, F_OK)) {
+        fds.fd = fd;
+        fds.events = POLLIN;
+        ret = poll(&fds, 1, wait);
+        if (ret < 0 && errno != EINTR) {
+            ret = -errno;
+            break;
+        }
+        if (!ret) {
+            ret = -ETIMEDOUT;
+            break;
+        }
+        while (read(fd, buf, sizeof(buf)) > 0) {
+        }
+        ret = 0;
+        if (timeout_ms >= 0) {
+            now = stats_now_ns();
+            wait = now < deadline ? (deadline - now + 999999) / 1000000 : 0;
+        }
+    }
+    close(fd);
+
+    return access(path, F_OK) ? ret : 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define APP_NAME "fwbox"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <linux/limits.h>
+
+#include "libfwtest.h"
+
+/* a test app linked into the binary */
+struct app {
+    const char *name;
+    int (*main)(int argc, char **argv);
+};
+
+#define FWBOX_APP(name) int name##_main(int argc, char **argv);
+#include "apps.h"
+#undef FWBOX_APP
+
+static const struct app apps[] = {
+#define FWBOX_APP(name) { #name, name##_main },
+#include "apps.h"
+#undef FWBOX_APP
+};
+
+#define NAPPS ((int)(sizeof(apps) / sizeof(apps[0])))
+
+void usage()
+{
+    fprintf(stdout, "\nUsage: %s [-l] [-i dir] [app [args...]]\n",
+            APP_NAME);
+    fprintf(stdout, "    -l: list the test apps.\n");
+    fprintf(stdout, "    -i: link every test app name in dir to %s.\n",
+            APP_NAME);
+    fprintf(stdout, "Runs the test app %s was started as, through a link "
+            "named after the app,\nor the one given as first argument. "
+            "All apps share this one binary, which\nis read into the page "
+            "cache once instead of once per app.\n", APP_NAME);
+    fprintf(stdout, "Example: %s gpiotest -c all\n", APP_NAME);
+}
+
+/**
+ * @brief Find a test app by name.
+ *
+ * @param name The app name.
+ * @return the app, NULL if there is no such app.
+ */
+static const struct app *find_app(const char *name)
+{
+    int i = 0;
+
+    for (i = 0; i < NAPPS; i++) {
+        if (!strcmp(apps[i].name, name)) {
+            return &apps[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Link every test app name in a directory to this binary.
+ *
+ * Files of the same name, such as the standalone binaries, are replaced.
+ *
+ * @param dir The directory.
+ * @return 0 on success, error code on failure.
+ */
+static int install_links(const char *dir)
+{
+    char self[PATH_MAX], path[PATH_MAX];
+    ssize_t len = 0;
+    int i = 0;
+
+    len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len < 0) {
+        return -errno;
+    }
+    self[len] = '\0';
+
+    for (i = 0; i < NAPPS; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, apps[i].name);
+        if (unlink(path) && errno != ENOENT) {
+            fprintf(stderr, "%s: %s: %s\n", APP_NAME, path, strerror(errno));
+            return -errno;
+        }
+        if (symlink(self, path)) {
+            fprintf(stderr, "%s: %s: %s\n", APP_NAME, path, strerror(errno));
+            return -errno;
+        }
+    }
+
+    fprintf(stdout, "%s: linked %d apps in %s\n", APP_NAME, NAPPS, dir);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const struct app *app = NULL;
+    const char *name = strrchr(argv[0], '/');
+    int options = 0, i = 0;
+
+    app = find_app(name != NULL ? name + 1 : argv[0]);
+    if (app != NULL) {
+        return app->main(argc, argv);
+    }
+
+    while ((options = getopt(argc, argv, "+li:")) != -1) {
+        switch (options) {
+            case 'l':
+                for (i = 0; i < NAPPS; i++) {
+                    fprintf(stdout, "%s\n", apps[i].name);
+                }
+                return 0;
+            case 'i':
+                return install_links(optarg);
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (optind >= argc) {
+        usage();
+        return -EINVAL;
+    }
+
+    app = find_app(argv[optind]);
+    if (app == NULL) {
+        fprintf(stderr, "%s: %s: no such app\n", APP_NAME, argv[optind]);
+        return -ENOENT;
+    }
+
+    argc -= optind;
+    argv += optind;
+    /* the app parses its own options from the start */
+    optind = 0;
+
+    return app->main(argc, argv);
+}
@@ -0,0 +1,405 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define APP_NAME "fwresults"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "libfwtest.h"
+
+/* Slots of the summary table, a power of 2 */
+#define SUMMARY_SLOTS 4096
+
+struct metric {
+    const char *name;
+    const char *unit;
+};
+
+/* values of one metric of one test case, for -s */
+struct summary {
+    int used;
+    int case_id;
+    uint32_t id;
+    uint64_t count;
+    double min;
+    double max;
+    double sum;
+};
+
+struct decoder {
+    int summarize;
+    int case_id;
+    struct metric *metrics;
+    uint32_t nmetrics;
+    struct summary *summary;
+    /** summary slots in order of first use */
+    int *order;
+    int norder;
+};
+
+void usage()
+{
+    fprintf(stdout, "\nUsage: %s [-s] [-c case_id] results_file\n", APP_NAME);
+    fprintf(stdout, "    -s: one count, min, mean and max per metric "
+            "instead of every value.\n");
+    fprintf(stdout, "    -c: only the records of this Testrail test case "
+            "ID.\n");
+    fprintf(stdout, "Prints a binary results file, FWTEST_RESULTS_FILE of a "
+            "test app, as the\n[A], [I] and [P] lines LAVA parses.\n");
+}
+
+/**
+ * @brief Store the name and unit of a metric id.
+ *
+ * @param dec The decoder.
+ * @param id The metric id.
+ * @param name The name, in the mapped file.
+ * @param unit The unit, in the mapped file.
+ * @return 0 on success, -ENOMEM on failure.
+ */
+static int add_metric(struct decoder *dec, uint32_t id, const char *name,
+                      const char *unit)
+{
+    struct metric *metrics;
+    uint32_t n;
+
+    if (id >= dec->nmetrics) {
+        n = id < 64 ? 128 : id * 2;
+        metrics = realloc(dec->metrics, n * sizeof(*metrics));
+        if (metrics == NULL) {
+            return -ENOMEM;
+        }
+        memset(metrics + dec->nmetrics, 0,
+               (n - dec->nmetrics) * sizeof(*metrics));
+        dec->metrics = metrics;
+        dec->nmetrics = n;
+    }
+
+    dec->metrics[id].name = name;
+    dec->metrics[id].unit = unit;
+    return 0;
+}
+
+/**
+ * @brief Add a value to the summary of its metric.
+ *
+ * @return 0 on success, -ENOSPC if the table is full.
+ */
+static int summarize(struct decoder *dec, int case_id, uint32_t id,
+                     double value)
+{
+    struct summary *s = NULL;
+    uint32_t hash = id * 2654435761u ^ (uint32_t)case_id;
+    int i;
+
+    for (i = 0; i < SUMMARY_SLOTS; i++) {
+        s = &dec->summary[(hash + i) & (SUMMARY_SLOTS - 1)];
+        if (!s->used || (s->case_id == case_id && s->id == id)) {
+            break;
+        }
+        s = NULL;
+    }
+    if (s == NULL) {
+        return -ENOSPC;
+    }
+
+    if (!s->used) {
+        s->used = 1;
+        s->case_id = case_id;
+        s->id = id;
+        s->min = s->max = value;
+        dec->order[dec->norder++] = s - dec->summary;
+    }
+    s->count++;
+    s->sum += value;
+    s->min = value < s->min ? value : s->min;
+    s->max = value > s->max ? value : s->max;
+
+    return 0;
+}
+
+/**
+ * @brief Print and clear the summaries.
+ *
+ * @param dec The decoder.
+ */
+static void print_summary(struct decoder *dec)
+{
+    const struct summary *s;
+    const struct metric *m;
+    char name[RESULTS_NAME_LEN + 8];
+    int i;
+
+    for (i = 0; i < dec->norder; i++) {
+        s = &dec->summary[dec->order[i]];
+        m = &dec->metrics[s->id];
+        if (s->count == 1) {
+            print_test_case_perf(s->case_id, m->name, s->sum, m->unit);
+            continue;
+        }
+        snprintf(name, sizeof(name), "%s_count", m->name);
+        print_test_case_perf(s->case_id, name, s->count, "samples");
+        snprintf(name, sizeof(name), "%s_min", m->name);
+        print_test_case_perf(s->case_id, name, s->min, m->unit);
+        snprintf(name, sizeof(name), "%s_mean", m->name);
+        print_test_case_perf(s->case_id, name, s->sum / s->count, m->unit);
+        snprintf(name, sizeof(name), "%s_max", m->name);
+        print_test_case_perf(s->case_id, name, s->max, m->unit);
+    }
+
+    memset(dec->summary, 0, SUMMARY_SLOTS * sizeof(*dec->summary));
+    dec->norder = 0;
+}
+
+/**
+ * @brief Get the strings that follow the fixed part of a record.
+ *
+ * @param body First byte after the fixed part.
+ * @param end End of the record.
+ * @param s1 Returns the first string.
+ * @param s2 Returns the second string, NULL if it is not wanted.
+ * @return 0 on success, -EINVAL if the strings do not fit in the record.
+ */
+static int rec_strings(const char *body, const char *end, const char **s1,
+                       const char **s2)
+{
+    const char *nul;
+
+    nul = memchr(body, '\0', end - body);
+    if (nul == NULL) {
+        return -EINVAL;
+    }
+    *s1 = body;
+    if (s2 == NULL) {
+        return 0;
+    }
+
+    body = nul + 1;
+    if (body >= end || memchr(body, '\0', end - body) == NULL) {
+        return -EINVAL;
+    }
+    *s2 = body;
+
+    return 0;
+}
+
+/**
+ * @brief Print one record.
+ *
+ * @param dec The decoder.
+ * @param rec The record, 8 byte aligned in the mapped file.
+ * @return 0 on success, -EINVAL on a malformed record.
+ */
+static int decode_record(struct decoder *dec, const uint8_t *rec)
+{
+    const struct results_rec_hdr *hdr = (const void *)rec;
+    const char *body = (const char *)rec + sizeof(*hdr);
+    const char *end = (const char *)rec + hdr->len;
+    struct results_rec_value value;
+    const char *s1 = NULL, *s2 = NULL;
+    int32_t num = 0;
+
+    if (hdr->type != RESULTS_REC_METRIC && dec->case_id >= 0 &&
+        hdr->case_id != dec->case_id) {
+        return 0;
+    }
+
+    switch (hdr->type) {
+        case RESULTS_REC_METRIC:
+            if (end - body < (long)sizeof(uint32_t)) {
+                return -EINVAL;
+            }
+            memcpy(&num, body, sizeof(num));
+            if (rec_strings(body + sizeof(num), end, &s1, &s2)) {
+                return -EINVAL;
+            }
+            return add_metric(dec, num, s1, s2);
+        case RESULTS_REC_VALUE:
+            if (end - body < (long)sizeof(value)) {
+                return -EINVAL;
+            }
+            memcpy(&value, body, sizeof(value));
+            if (value.id >= dec->nmetrics ||
+                dec->metrics[value.id].name == NULL) {
+                return -EINVAL;
+            }
+            if (dec->summarize &&
+                !summarize(dec, hdr->case_id, value.id, value.value)) {
+                return 0;
+            }
+            print_test_case_perf(hdr->case_id, dec->metrics[value.id].name,
+                                 value.value, dec->metrics[value.id].unit);
+            return 0;
+        case RESULTS_REC_RESULT:
+            if (end - body < (long)sizeof(num)) {
+                return -EINVAL;
+            }
+            memcpy(&num, body, sizeof(num));
+            if (rec_strings(body + sizeof(num), end, &s1, &s2)) {
+                return -EINVAL;
+            }
+            /* the [P] lines of a case go before its [A] line */
+            if (dec->summarize) {
+                print_summary(dec);
+            }
+            if (s1[0]) {
+                print_test_case_result((char *)s1, hdr->case_id, num,
+                                       s2[0] ? (char *)s2 : NULL);
+            } else {
+                print_test_case_result_only(hdr->case_id, num);
+            }
+            return 0;
+        case RESULTS_REC_CHECK:
+            if (end - body < (long)sizeof(num)) {
+                return -EINVAL;
+            }
+            memcpy(&num, body, sizeof(num));
+            if (rec_strings(body + sizeof(num), end, &s1, NULL)) {
+                return -EINVAL;
+            }
+            print_test_case_check(hdr->case_id, s1, num);
+            return 0;
+        default:
+            /* newer record types, skipped */
+            return 0;
+    }
+}
+
+/**
+ * @brief Print a results file.
+ *
+ * @param dec The decoder.
+ * @param path The file.
+ * @return number of records on success, error code on failure.
+ */
+static int decode_file(struct decoder *dec, const char *path)
+{
+    const struct results_file_hdr *fhdr;
+    const struct results_rec_hdr *hdr;
+    const uint8_t *map, *p, *end;
+    struct stat st;
+    int fd, n = 0, ret = 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -errno;
+    }
+    if (fstat(fd, &st) || st.st_size < (off_t)sizeof(*fhdr)) {
+        close(fd);
+        return -EINVAL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -errno;
+    }
+
+    fhdr = (const void *)map;
+    if (fhdr->magic != RESULTS_MAGIC || fhdr->version != RESULTS_VERSION ||
+        fhdr->hdr_len < sizeof(*fhdr) || fhdr->hdr_len > st.st_size) {
+        munmap((void *)map, st.st_size);
+        return -EINVAL;
+    }
+
+    /* records are 8 byte aligned from the end of the file header */
+    end = map + st.st_size;
+    for (p = map + fhdr->hdr_len; p + sizeof(*hdr) <= end && !ret;
+         p += hdr->len, n++) {
+        hdr = (const void *)p;
+        if (hdr->len < sizeof(*hdr) || hdr->len & 7) {
+            ret = -EINVAL;
+            break;
+        }
+        if (p + hdr->len > end) {
+            /* a test app that died leaves a cut record at the end */
+            fprintf(stderr, "%s: %s: truncated after %d records\n",
+                    APP_NAME, path, n);
+            break;
+        }
+        ret = decode_record(dec, p);
+    }
+    if (dec->summarize) {
+        print_summary(dec);
+    }
+
+    munmap((void *)map, st.st_size);
+    return ret ? ret : n;
+}
+
+int main(int argc, char **argv)
+{
+    static struct decoder dec;
+    int options = 0, ret = 0;
+
+    /* the lines printed here must not be recorded again */
+    unsetenv("FWTEST_RESULTS_FILE");
+
+    dec.case_id = -1;
+    while ((options = getopt(argc, argv, "c:s")) != -1) {
+        switch (options) {
+            case 'c':
+                dec.case_id = atoi(optarg);
+                break;
+            case 's':
+                dec.summarize = 1;
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    dec.summary = calloc(SUMMARY_SLOTS, sizeof(*dec.summary));
+    dec.order = calloc(SUMMARY_SLOTS, sizeof(*dec.order));
+    if (dec.summary == NULL || dec.order == NULL) {
+        return -ENOMEM;
+    }
+
+    ret = decode_file(&dec, argv[optind]);
+    if (ret < 0) {
+        fprintf(stderr, "%s: %s: %s\n", APP_NAME, argv[optind],
+                strerror(-ret));
+        return ret;
+    }
+
+    return 0;
+}
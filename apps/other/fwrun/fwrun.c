@@ -0,0 +1,588 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define APP_NAME "fwrun"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include <linux/limits.h>
+
+#include "libfwtest.h"
+
+/* Default max number of cases running at the same time */
+#define DEFAULT_JOBS 8
+#define MAX_CASES 128
+#define MAX_RES 8
+#define MAX_ARGS 32
+#define NAME_LEN 32
+#define LINE_LEN 512
+/* Output read size, a case output buffer grows by this much */
+#define OUT_CHUNK 4096
+
+extern char **environ;
+
+enum case_state {
+    CASE_WAITING,
+    CASE_RUNNING,
+    CASE_DONE,
+};
+
+/*
+ * One line of the case list:
+ *
+ *   <name> <resources> <app> [args...]
+ *
+ * resources is a comma separated list of the things the case uses, e.g.
+ * "gpio8,gpio9" or "i2c1". Two cases that share a resource run in list
+ * order, cases on disjoint resources run at the same time. "after=<name>"
+ * waits for another case, "*" runs the case alone and "-" is no resource.
+ */
+struct run_case {
+    char name[NAME_LEN];
+    int nres;
+    char res[MAX_RES][NAME_LEN];
+    int nafter;
+    char after[MAX_RES][NAME_LEN];
+    int exclusive;
+    int argc;
+    char *argv[MAX_ARGS + 1];
+    char line[LINE_LEN];
+
+    enum case_state state;
+    pid_t pid;
+    int out_fd;
+    char *out;
+    size_t out_len;
+    size_t out_cap;
+    uint64_t start;
+    uint64_t end;
+    int status;
+};
+
+struct run_info {
+    int case_id;
+    int jobs;
+    int timeout;
+    const char *bindir;
+    /** fwtestd socket, NULL to run the binaries */
+    const char *agent;
+    int ncases;
+    struct run_case cases[MAX_CASES];
+};
+
+void usage()
+{
+    fprintf(stdout, "\nUsage: %s [-j jobs] [-d bindir] [-a] [-s socket] "
+            "[-t seconds] [-c case_id]\n        case_list\n", APP_NAME);
+    fprintf(stdout, "    -j: max cases running at the same time (default "
+            "%d).\n", DEFAULT_JOBS);
+    fprintf(stdout, "    -d: directory of the test apps (default the "
+            "directory of %s).\n", APP_NAME);
+    fprintf(stdout, "    -a: run the cases in fwtestd.\n");
+    fprintf(stdout, "    -s: fwtestd socket, implies -a.\n");
+    fprintf(stdout, "    -t: kill a case after this many seconds (default "
+            "none).\n");
+    fprintf(stdout, "    -c: Testrail test case ID of the run summary.\n");
+    fprintf(stdout, "Case list lines are \"<name> <resources> <app> "
+            "[args...]\". Cases on disjoint\nresources run concurrently, "
+            "the output of each case is printed in one piece\nwhen it "
+            "ends. Resources: e.g. gpio8,i2c1, after=<name>, * for alone, "
+            "- for none.\n");
+    fprintf(stdout, "Example line: i2c-1001 i2c1 i2ctest -c 1001 -b 1 "
+            "-d 60001\n");
+}
+
+/**
+ * @brief Parse one case list line.
+ *
+ * @param c Returns the case.
+ * @param line The line.
+ * @return 1 for a case, 0 for a blank or comment line, -EINVAL on error.
+ */
+static int parse_case(struct run_case *c, const char *line)
+{
+    char *tok, *res, *save = NULL, *rsave = NULL;
+
+    memset(c, 0, sizeof(*c));
+    c->out_fd = -1;
+    snprintf(c->line, sizeof(c->line), "%s", line);
+
+    tok = strtok_r(c->line, " \t\n", &save);
+    if (tok == NULL || tok[0] == '#') {
+        return 0;
+    }
+    snprintf(c->name, sizeof(c->name), "%s", tok);
+
+    tok = strtok_r(NULL, " \t\n", &save);
+    if (tok == NULL) {
+        return -EINVAL;
+    }
+    for (res = strtok_r(tok, ",", &rsave); res != NULL;
+         res = strtok_r(NULL, ",", &rsave)) {
+        if (!strcmp(res, "-")) {
+            continue;
+        } else if (!strcmp(res, "*")) {
+            c->exclusive = 1;
+        } else if (!strncmp(res, "after=", 6) && c->nafter < MAX_RES) {
+            snprintf(c->after[c->nafter++], NAME_LEN, "%s", res + 6);
+        } else if (c->nres < MAX_RES) {
+            snprintf(c->res[c->nres++], NAME_LEN, "%s", res);
+        } else {
+            return -EINVAL;
+        }
+    }
+
+    while ((tok = strtok_r(NULL, " \t\n", &save)) != NULL &&
+           c->argc < MAX_ARGS) {
+        c->argv[c->argc++] = tok;
+    }
+    c->argv[c->argc] = NULL;
+
+    return c->argc ? 1 : -EINVAL;
+}
+
+/**
+ * @brief Read the case list.
+ *
+ * @param info The run info.
+ * @param path The case list file, - for stdin.
+ * @return 0 on success, error code on failure.
+ */
+static int read_cases(struct run_info *info, const char *path)
+{
+    char line[LINE_LEN];
+    FILE *fp;
+    int n = 0, ret = 0;
+
+    fp = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (fp == NULL) {
+        return -errno;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL && !ret) {
+        n++;
+        if (info->ncases >= MAX_CASES) {
+            ret = -E2BIG;
+            break;
+        }
+        ret = parse_case(&info->cases[info->ncases], line);
+        if (ret > 0) {
+            info->ncases++;
+            ret = 0;
+        } else if (ret < 0) {
+            fprintf(stderr, "%s: %s:%d: bad case line\n", APP_NAME, path, n);
+        }
+    }
+    if (fp != stdin) {
+        fclose(fp);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Check if a case has to wait for an earlier one.
+ *
+ * @param a The earlier case.
+ * @param b The later case.
+ * @return non-zero if b may only start once a is done.
+ */
+static int conflicts(const struct run_case *a, const struct run_case *b)
+{
+    int i, j;
+
+    if (a->exclusive || b->exclusive) {
+        return 1;
+    }
+    for (i = 0; i < b->nafter; i++) {
+        if (!strcmp(b->after[i], a->name)) {
+            return 1;
+        }
+    }
+    for (i = 0; i < a->nres; i++) {
+        for (j = 0; j < b->nres; j++) {
+            if (!strcmp(a->res[i], b->res[j])) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Check if a waiting case can start.
+ *
+ * @param info The run info.
+ * @param n The case index.
+ * @return non-zero if every earlier conflicting case is done.
+ */
+static int case_ready(const struct run_info *info, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (info->cases[i].state != CASE_DONE &&
+            conflicts(&info->cases[i], &info->cases[n])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Run a case in fwtestd from the child process.
+ *
+ * @param sock The socket from agent_connect().
+ * @param c The case.
+ * @return the test result, or error code if the daemon failed.
+ */
+static int run_in_agent(int sock, struct run_case *c)
+{
+    int status = 0, ret = 0;
+
+    ret = agent_send_cmd(sock, c->argc, c->argv, environ);
+    if (!ret) {
+        ret = agent_recv_status(sock, &status);
+    }
+    close(sock);
+
+    return ret ? ret : status;
+}
+
+/**
+ * @brief Start a case, its stdout and stderr go to a pipe.
+ *
+ * @param info The run info.
+ * @param c The case.
+ * @return 0 on success, error code on failure.
+ */
+static int start_case(const struct run_info *info, struct run_case *c)
+{
+    char path[PATH_MAX];
+    int pipefd[2], devnull, sock;
+
+    if (pipe(pipefd)) {
+        return -errno;
+    }
+
+    fflush(NULL);
+    c->pid = fork();
+    if (c->pid < 0) {
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return -errno;
+    }
+
+    if (c->pid == 0) {
+        /* own process group, a timeout kills whatever the case started */
+        setpgid(0, 0);
+        devnull = open("/dev/null", O_RDONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDIN_FILENO);
+        }
+        dup2(pipefd[1], STDOUT_FILENO);
+        dup2(pipefd[1], STDERR_FILENO);
+        close(pipefd[0]);
+        close(pipefd[1]);
+
+        /* without a daemon the binary runs, like fwtestc does it */
+        if (info->agent != NULL &&
+            (sock = agent_connect(info->agent)) >= 0) {
+            _exit(run_in_agent(sock, c));
+        }
+        snprintf(path, sizeof(path), "%s/%s", info->bindir, c->argv[0]);
+        c->argv[0] = path;
+        execv(path, c->argv);
+        fprintf(stderr, "%s: %s: %s\n", APP_NAME, path, strerror(errno));
+        _exit(127);
+    }
+
+    /* both sides set it, so a kill right after the fork finds the group */
+    setpgid(c->pid, c->pid);
+    close(pipefd[1]);
+    /* the other cases must not keep this one's pipe open */
+    fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+    c->out_fd = pipefd[0];
+    c->start = stats_now_ns();
+    c->state = CASE_RUNNING;
+
+    return 0;
+}
+
+/**
+ * @brief Read the pending output of a running case.
+ *
+ * @param c The case.
+ * @return 0 while the case runs, 1 at the end of its output.
+ */
+static int read_output(struct run_case *c)
+{
+    char *out;
+    ssize_t n;
+
+    if (c->out_cap - c->out_len < OUT_CHUNK) {
+        out = realloc(c->out, c->out_cap + OUT_CHUNK * 4);
+        if (out == NULL) {
+            /* keep what we have, drop the rest */
+            c->out_len = 0;
+        } else {
+            c->out = out;
+            c->out_cap += OUT_CHUNK * 4;
+        }
+    }
+
+    n = read(c->out_fd, c->out + c->out_len, c->out_cap - c->out_len);
+    if (n < 0 && errno == EINTR) {
+        return 0;
+    }
+    if (n <= 0) {
+        return 1;
+    }
+    c->out_len += n;
+
+    return 0;
+}
+
+/**
+ * @brief Reap a case and print its output in one piece.
+ *
+ * @param c The case.
+ * @return None
+ */
+static void finish_case(struct run_case *c)
+{
+    int status = 0;
+    size_t off = 0;
+    ssize_t n;
+
+    close(c->out_fd);
+    c->out_fd = -1;
+    while (waitpid(c->pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    c->end = stats_now_ns();
+    c->state = CASE_DONE;
+    if (WIFEXITED(status)) {
+        c->status = (signed char)WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        c->status = 128 + WTERMSIG(status);
+    }
+
+    fflush(stdout);
+    while (off < c->out_len) {
+        n = write(STDOUT_FILENO, c->out + off, c->out_len - off);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        off += n;
+    }
+    printf("\n%s: %s returned %d in %.3f s\n", APP_NAME, c->name, c->status,
+           (c->end - c->start) / 1e9);
+    fflush(stdout);
+
+    free(c->out);
+    c->out = NULL;
+    c->out_len = c->out_cap = 0;
+}
+
+/**
+ * @brief Run all cases.
+ *
+ * @param info The run info.
+ * @return 0 on success, error code on failure.
+ */
+static int run_cases(struct run_info *info)
+{
+    struct pollfd pfds[MAX_CASES];
+    int index[MAX_CASES];
+    struct run_case *c;
+    uint64_t now = 0, limit = 0;
+    int i, n, running = 0, ndone = 0, timeout_ms = -1, ret = 0;
+
+    while (ndone < info->ncases) {
+        for (i = 0; i < info->ncases && running < info->jobs; i++) {
+            c = &info->cases[i];
+            if (c->state != CASE_WAITING || !case_ready(info, i)) {
+                continue;
+            }
+            ret = start_case(info, c);
+            if (ret) {
+                return ret;
+            }
+            running++;
+        }
+
+        n = 0;
+        timeout_ms = -1;
+        now = stats_now_ns();
+        for (i = 0; i < info->ncases; i++) {
+            c = &info->cases[i];
+            if (c->state != CASE_RUNNING) {
+                continue;
+            }
+            pfds[n].fd = c->out_fd;
+            pfds[n].events = POLLIN;
+            index[n++] = i;
+            if (info->timeout > 0) {
+                limit = c->start + info->timeout * 1000000000ULL;
+                if (now >= limit) {
+                    kill(-c->pid, SIGKILL);
+                } else if (timeout_ms < 0 ||
+                           timeout_ms > (int)((limit - now) / 1000000) + 1) {
+                    timeout_ms = (limit - now) / 1000000 + 1;
+                }
+            }
+        }
+
+        if (poll(pfds, n, timeout_ms) < 0 && errno != EINTR) {
+            return -errno;
+        }
+
+        for (i = 0; i < n; i++) {
+            if (pfds[i].revents && read_output(&info->cases[index[i]])) {
+                finish_case(&info->cases[index[i]]);
+                running--;
+                ndone++;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Print the run summary.
+ *
+ * The cases print their own [A] lines, here each case also gets a check
+ * on its exit code.
+ *
+ * @param info The run info.
+ * @param wall_ns Run time of the whole list.
+ * @return the number of failed cases.
+ */
+static int print_summary(const struct run_info *info, uint64_t wall_ns)
+{
+    uint64_t serial = 0;
+    int i, failed = 0;
+
+    for (i = 0; i < info->ncases; i++) {
+        serial += info->cases[i].end - info->cases[i].start;
+        failed += info->cases[i].status != 0;
+        print_test_case_check(info->case_id, info->cases[i].name,
+                              info->cases[i].status);
+    }
+
+    print_test_case_perf(info->case_id, "cases", info->ncases, "cases");
+    print_test_case_perf(info->case_id, "wall_time", wall_ns / 1e9, "s");
+    print_test_case_perf(info->case_id, "serial_time", serial / 1e9, "s");
+    if (wall_ns) {
+        print_test_case_perf(info->case_id, "speedup",
+                             (double)serial / wall_ns, "x");
+    }
+
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    static struct run_info info;
+    static char bindir[PATH_MAX];
+    const char *slash = strrchr(argv[0], '/');
+    uint64_t start = 0;
+    int options = 0, ret = 0;
+
+    info.jobs = DEFAULT_JOBS;
+    if (slash != NULL) {
+        snprintf(bindir, sizeof(bindir), "%.*s", (int)(slash - argv[0]),
+                 argv[0]);
+    } else {
+        snprintf(bindir, sizeof(bindir), ".");
+    }
+    info.bindir = bindir;
+
+    while ((options = getopt(argc, argv, "ac:d:j:s:t:")) != -1) {
+        switch (options) {
+            case 'a':
+                info.agent = agent_socket();
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                info.bindir = optarg;
+                break;
+            case 'j':
+                info.jobs = atoi(optarg);
+                break;
+            case 's':
+                info.agent = optarg;
+                break;
+            case 't':
+                info.timeout = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (optind != argc - 1 || info.jobs < 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    ret = read_cases(&info, argv[optind]);
+    if (!ret && !info.ncases) {
+        ret = -ENOENT;
+    }
+
+    if (!ret) {
+        start = stats_now_ns();
+        ret = run_cases(&info);
+    }
+    if (!ret && print_summary(&info, stats_now_ns() - start)) {
+        ret = -EIO;
+    }
+
+    print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+
+    return ret;
+}
@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define APP_NAME "fwtestc"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <linux/limits.h>
+
+#include "libfwtest.h"
+
+extern char **environ;
+
+void usage()
+{
+    fprintf(stdout, "\nUsage: %s [-s socket] [-w seconds] app [args...]\n",
+            APP_NAME);
+    fprintf(stdout, "    -s: fwtestd socket (default FWTESTD_SOCKET or "
+            "%s).\n", AGENT_SOCKET);
+    fprintf(stdout, "    -w: wait this long for the daemon to come up.\n");
+    fprintf(stdout, "Runs a test app in fwtestd, the output and the exit "
+            "code are those of\nthe app. Without a daemon the app binary "
+            "next to %s is run instead.\n", APP_NAME);
+    fprintf(stdout, "Example: %s i2ctest -c 1001 -b 1 -d 60001\n",
+            APP_NAME);
+}
+
+/**
+ * @brief Run the standalone binary of a test app.
+ *
+ * @param self argv[0] of this client.
+ * @param argv The app and its arguments.
+ * @return error code, only if the binary could not be run.
+ */
+static int exec_app(const char *self, char **argv)
+{
+    char path[PATH_MAX];
+    const char *slash = strrchr(self, '/');
+
+    if (slash != NULL) {
+        snprintf(path, sizeof(path), "%.*s/%s", (int)(slash - self), self,
+                 argv[0]);
+    } else {
+        snprintf(path, sizeof(path), "./%s", argv[0]);
+    }
+
+    execv(path, argv);
+    fprintf(stderr, "%s: %s: %s\n", APP_NAME, path, strerror(errno));
+    return -errno;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = agent_socket();
+    uint64_t deadline = 0;
+    int options = 0, wait_s = 0, sock = -1, status = 0, ret = 0;
+
+    /* stop at the app name, the rest are its own options */
+    while ((options = getopt(argc, argv, "+s:w:")) != -1) {
+        switch (options) {
+            case 's':
+                path = optarg;
+                break;
+            case 'w':
+                wait_s = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (optind >= argc) {
+        usage();
+        return -EINVAL;
+    }
+
+    deadline = stats_now_ns() + wait_s * 1000000000ULL;
+    while ((sock = agent_connect(path)) < 0 && stats_now_ns() < deadline) {
+        usleep(50000);
+    }
+
+    if (sock < 0) {
+        if (!strcmp(argv[optind], "list") || !strcmp(argv[optind], "quit")) {
+            fprintf(stderr, "%s: %s: %s\n", APP_NAME, path, strerror(-sock));
+            return sock;
+        }
+        return exec_app(argv[0], argv + optind);
+    }
+
+    ret = agent_send_cmd(sock, argc - optind, argv + optind, environ);
+    if (!ret) {
+        /* the test writes to our stdout and stderr directly */
+        ret = agent_recv_status(sock, &status);
+    }
+    close(sock);
+
+    if (ret) {
+        fprintf(stderr, "%s: %s\n", APP_NAME, strerror(-ret));
+        return ret;
+    }
+
+    return status;
+}
@@ -0,0 +1,453 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define APP_NAME "fwtestd"
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "libfwtest.h"
+
+/* Max length of one stdin command line */
+#define LINE_LEN 1024
+/* A client gets this long to send its command after connecting */
+#define RECV_TIMEOUT_MS 1000
+
+struct module {
+    const char *name;
+    int (*main)(int argc, char **argv);
+};
+
+/* the test apps linked in, see MODULES in the Makefile */
+#define FWTESTD_MODULE(name) int name##_main(int argc, char **argv);
+#include "modules.h"
+#undef FWTESTD_MODULE
+
+static const struct module modules[] = {
+#define FWTESTD_MODULE(name) { #name, name##_main },
+#include "modules.h"
+#undef FWTESTD_MODULE
+};
+
+#define NMODULES ((int)(sizeof(modules) / sizeof(modules[0])))
+
+/* a test running in a child process */
+struct job {
+    pid_t pid;
+    /** client socket, -1 once the client is gone or in stdin mode */
+    int client;
+    /** read end of a pipe the child holds open until it exits */
+    int exit_fd;
+};
+
+static struct job jobs[AGENT_MAX_JOBS];
+static int njobs;
+static int listen_fd = -1;
+static int quit;
+
+void usage()
+{
+    fprintf(stdout, "\nUsage: %s [-s socket] [-i]\n", APP_NAME);
+    fprintf(stdout, "    -s: command socket (default FWTESTD_SOCKET or "
+            "%s).\n", AGENT_SOCKET);
+    fprintf(stdout, "    -i: read commands from stdin, one per line, "
+            "instead of the socket.\n");
+    fprintf(stdout, "Runs the linked in test apps on request, fwtestc "
+            "sends the commands.\nEach test runs in a fork of the "
+            "daemon, which has already done discovery.\nBuilt in "
+            "commands: list, quit.\n");
+}
+
+/**
+ * @brief Look up a test app.
+ *
+ * @param name The app name, a leading directory is ignored.
+ * @return the module, NULL if it is not linked in.
+ */
+static const struct module *find_module(const char *name)
+{
+    const char *base = strrchr(name, '/');
+    int i;
+
+    base = base != NULL ? base + 1 : name;
+    for (i = 0; i < NMODULES; i++) {
+        if (!strcmp(modules[i].name, base)) {
+            return &modules[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Run a test app in the child process.
+ *
+ * @param mod The test app.
+ * @param cmd The command.
+ * @return never returns.
+ */
+static void run_child(const struct module *mod, struct agent_cmd *cmd)
+{
+    int i;
+
+    signal(SIGPIPE, SIG_DFL);
+
+    /* only the own exit pipe may stay open, the parent waits for it */
+    if (listen_fd >= 0) {
+        close(listen_fd);
+    }
+    for (i = 0; i < njobs; i++) {
+        if (jobs[i].client >= 0) {
+            close(jobs[i].client);
+        }
+        close(jobs[i].exit_fd);
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (cmd->fds[i] != i) {
+            dup2(cmd->fds[i], i);
+            close(cmd->fds[i]);
+        }
+    }
+    if (cmd->cwd != NULL && chdir(cmd->cwd)) {
+        dprintf(STDERR_FILENO, "%s: chdir %s: %s\n", APP_NAME, cmd->cwd,
+                strerror(errno));
+    }
+    for (i = 0; i < cmd->nenv; i++) {
+        putenv(cmd->env[i]);
+    }
+
+    /* the first getopt() of the app must start from scratch */
+    optind = 0;
+    exit(mod->main(cmd->argc, cmd->argv));
+}
+
+/**
+ * @brief Start a command.
+ *
+ * @param cmd The command, the fds a client sent are closed.
+ * @param client The client socket, -1 in stdin mode.
+ * @param status Returns the result of a built in or failed command.
+ * @return 1 if a job was started, 0 if the command is done.
+ */
+static int start_job(struct agent_cmd *cmd, int client, int *status)
+{
+    const struct module *mod = find_module(cmd->argv[0]);
+    int pipefd[2], i, started = 0;
+    pid_t pid;
+
+    *status = 0;
+    if (!strcmp(cmd->argv[0], "list")) {
+        for (i = 0; i < NMODULES; i++) {
+            dprintf(cmd->fds[1], "%s\n", modules[i].name);
+        }
+    } else if (!strcmp(cmd->argv[0], "quit")) {
+        quit = 1;
+    } else if (mod == NULL) {
+        dprintf(cmd->fds[2], "%s: %s: no such test app\n", APP_NAME,
+                cmd->argv[0]);
+        *status = -ENOENT;
+    } else if (pipe2(pipefd, O_CLOEXEC)) {
+        *status = -errno;
+    } else {
+        /* nothing buffered may be written twice */
+        fflush(NULL);
+        pid = fork();
+        if (pid == 0) {
+            close(pipefd[0]);
+            run_child(mod, cmd);
+        }
+        close(pipefd[1]);
+        if (pid < 0) {
+            *status = -errno;
+            close(pipefd[0]);
+        } else {
+            jobs[njobs].pid = pid;
+            jobs[njobs].client = client;
+            jobs[njobs].exit_fd = pipefd[0];
+            njobs++;
+            started = 1;
+        }
+    }
+
+    for (i = 0; i < 3 && client >= 0; i++) {
+        close(cmd->fds[i]);
+    }
+
+    return started;
+}
+
+/**
+ * @brief Reap a finished job.
+ *
+ * @param job The job, removed from the job list.
+ * @return the return value of the test app main(), 128 plus the signal
+ * number if it was killed, like a shell reports it.
+ */
+static int finish_job(struct job *job)
+{
+    int status = 0, ret = 0;
+
+    while (waitpid(job->pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    if (WIFEXITED(status)) {
+        /* main() returns -errno, exit() keeps the low 8 bits */
+        ret = (signed char)WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        ret = 128 + WTERMSIG(status);
+    }
+
+    if (job->client >= 0) {
+        agent_send_status(job->client, ret);
+        close(job->client);
+    }
+    close(job->exit_fd);
+    *job = jobs[--njobs];
+
+    return ret;
+}
+
+/**
+ * @brief Accept a client and start its command.
+ *
+ * @return None
+ */
+static void accept_client(void)
+{
+    static struct agent_cmd cmd;
+    struct timeval tv = { RECV_TIMEOUT_MS / 1000, 0 };
+    int client, status = 0;
+
+    client = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (client < 0) {
+        return;
+    }
+
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (agent_recv_cmd(client, &cmd)) {
+        close(client);
+        return;
+    }
+
+    if (!start_job(&cmd, client, &status)) {
+        agent_send_status(client, status);
+        close(client);
+    }
+}
+
+/**
+ * @brief Serve commands from the socket.
+ *
+ * Tests of several clients run at the same time. After quit the daemon
+ * exits once the running tests are done.
+ *
+ * @return 0 on success, error code on failure.
+ */
+static int serve_socket(void)
+{
+    struct pollfd pfds[1 + 2 * AGENT_MAX_JOBS];
+    int i, n, ready;
+
+    while (!quit || njobs) {
+        n = 0;
+        if (!quit && njobs < AGENT_MAX_JOBS) {
+            pfds[n].fd = listen_fd;
+            pfds[n++].events = POLLIN;
+        }
+        for (i = 0; i < njobs; i++) {
+            pfds[n].fd = jobs[i].exit_fd;
+            pfds[n++].events = POLLIN;
+            /* a closed fd is ignored by poll() */
+            pfds[n].fd = jobs[i].client;
+            pfds[n++].events = POLLIN;
+        }
+
+        ready = poll(pfds, n, -1);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        } else if (ready < 0) {
+            return -errno;
+        }
+
+        /* jobs first, finish_job() reorders the list */
+        for (i = njobs - 1; i >= 0; i--) {
+            n = pfds[0].fd == listen_fd ? 1 + 2 * i : 2 * i;
+            if (pfds[n].revents) {
+                finish_job(&jobs[i]);
+            } else if (pfds[n + 1].revents && jobs[i].client >= 0) {
+                /* the client never sends more, so it hung up or was killed */
+                kill(jobs[i].pid, SIGKILL);
+                close(jobs[i].client);
+                jobs[i].client = -1;
+            }
+        }
+        if (pfds[0].fd == listen_fd && pfds[0].revents) {
+            accept_client();
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Split a command line into arguments.
+ *
+ * Blanks separate the arguments, double quotes group them.
+ *
+ * @param line The line, modified.
+ * @param argv Returns the arguments.
+ * @param max The argv array size, including the NULL end.
+ * @return number of arguments.
+ */
+static int split_line(char *line, char **argv, int max)
+{
+    char *src = line, *dst = line;
+    int argc = 0, quoted = 0;
+
+    while (*src && argc < max - 1) {
+        while (*src == ' ' || *src == '\t' || *src == '\n') {
+            src++;
+        }
+        if (!*src) {
+            break;
+        }
+        argv[argc++] = dst;
+        for (; *src && (quoted || !strchr(" \t\n", *src)); src++) {
+            if (*src == '"') {
+                quoted = !quoted;
+            } else {
+                *dst++ = *src;
+            }
+        }
+        if (*src) {
+            src++;
+        }
+        *dst++ = '\0';
+    }
+    argv[argc] = NULL;
+
+    return argc;
+}
+
+/**
+ * @brief Serve commands from stdin, one at a time.
+ *
+ * @return the first non-zero test result, 0 if all passed.
+ */
+static int serve_stdin(void)
+{
+    static struct agent_cmd cmd;
+    char line[LINE_LEN];
+    int devnull, status = 0, ret = 0;
+
+    devnull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    while (!quit && fgets(line, sizeof(line), stdin) != NULL) {
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.argc = split_line(line, cmd.argv, AGENT_MAX_ARGS + 1);
+        if (!cmd.argc || cmd.argv[0][0] == '#') {
+            continue;
+        }
+        /* the tests must not eat the command lines */
+        cmd.fds[0] = devnull >= 0 ? devnull : STDIN_FILENO;
+        cmd.fds[1] = STDOUT_FILENO;
+        cmd.fds[2] = STDERR_FILENO;
+
+        if (start_job(&cmd, -1, &status)) {
+            status = finish_job(&jobs[0]);
+        }
+        if (status) {
+            fprintf(stderr, "%s: %s returned %d\n", APP_NAME, cmd.argv[0],
+                    status);
+        }
+        if (status && !ret) {
+            ret = status;
+        }
+    }
+    if (devnull >= 0) {
+        close(devnull);
+    }
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = agent_socket();
+    int options = 0, use_stdin = 0, ret = 0;
+
+    while ((options = getopt(argc, argv, "is:")) != -1) {
+        switch (options) {
+            case 'i':
+                use_stdin = 1;
+                break;
+            case 's':
+                path = optarg;
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    /* a gone client must not kill the daemon */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* every test forked from here starts with the discovery done */
+    gb_discover(0);
+
+    if (use_stdin) {
+        return serve_stdin();
+    }
+
+    listen_fd = agent_listen(path);
+    if (listen_fd < 0) {
+        fprintf(stderr, "%s: %s: %s\n", APP_NAME, path,
+                strerror(-listen_fd));
+        return listen_fd;
+    }
+    fprintf(stderr, "%s: %d test apps, listening on %s\n", APP_NAME,
+            NMODULES, path);
+
+    ret = serve_socket();
+    close(listen_fd);
+    unlink(path);
+
+    return ret;
+}
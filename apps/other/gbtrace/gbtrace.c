@@ -0,0 +1,762 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define APP_NAME "gbtrace"
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <linux/limits.h>
+
+#include "libfwtest.h"
+
+/*
+ * Greybus operation latency tracer.
+ *
+ * Records the greybus message tracepoints and the fwtest call marks of an
+ * app (see trace_call_begin()) from the per CPU trace_pipe_raw files. The
+ * pages are spliced from the ring buffer to files without passing through
+ * user space, then decoded from an mmap of those files. Each marked call
+ * is split into:
+ *   host:   time of the call outside of greybus operations, i.e. the app
+ *           and the kernel stack above greybus
+ *   submit: gb_message_send to gb_message_submit, the greybus core and
+ *           host device driver queuing the request
+ *   link:   gb_message_submit to gb_message_recv_response, the transport,
+ *           the bridges and the module firmware
+ */
+
+#define GB_SYSTEM "greybus"
+/* Default recording dir */
+#define DEFAULT_DIR "/data/local/tmp/gbtrace"
+/* Default recording time without a command, in seconds */
+#define DEFAULT_DURATION 10
+/* Default per CPU ring buffer size, in KB */
+#define DEFAULT_BUFFER_KB 4096
+#define MAX_CPUS 32
+/* Max number of distinct call names */
+#define MAX_CALLS 8
+#define CALL_NAME_LEN 32
+/* Max number of calls in progress at once, over all threads */
+#define MAX_OPEN 16
+/* Max number of greybus operations in one call */
+#define MAX_SPAN_OPS 16
+/* Idle poll interval of the recorder, in us */
+#define POLL_US 10000
+/* response bit of the greybus message type */
+#define GB_TYPE_RESPONSE 0x80
+
+enum rec_kind {
+    REC_BEGIN,
+    REC_END,
+    REC_SEND,
+    REC_SUBMIT,
+    REC_RESPONSE,
+};
+
+/* one decoded trace event */
+struct trace_rec {
+    uint64_t ts;
+    int kind;
+    int pid;
+    int call;
+    uint16_t op_id;
+    uint8_t type;
+};
+
+/* event IDs and the field offsets of the records */
+struct trace_ids {
+    int print;
+    int send;
+    int submit;
+    int response;
+    int pid_off;
+    int buf_off;
+    int op_off;
+    int type_off;
+};
+
+struct call_stats {
+    char name[CALL_NAME_LEN];
+    long calls;
+    long ops;
+    long unmatched;
+    struct stats_hist total;
+    struct stats_hist host;
+    struct stats_hist submit;
+    struct stats_hist link;
+};
+
+struct gb_op {
+    uint16_t id;
+    uint64_t send;
+    uint64_t submit;
+    uint64_t response;
+};
+
+/* a call in progress */
+struct span {
+    int active;
+    int pid;
+    int call;
+    uint64_t begin;
+    int nops;
+    struct gb_op ops[MAX_SPAN_OPS];
+};
+
+struct trace_ctx {
+    struct trace_ids ids;
+    struct trace_rec *recs;
+    long nrecs;
+    long size;
+    long lost_pages;
+    int ncalls;
+    struct call_stats calls[MAX_CALLS];
+    struct span open[MAX_OPEN];
+};
+
+struct gbtrace_info {
+    int case_id;
+    char dir[PATH_MAX / 2];
+    int duration;
+    int buffer_kb;
+    char **cmd;
+    int ncpus;
+    struct trace_page_layout layout;
+};
+
+static struct trace_ctx ctx;
+
+void usage()
+{
+    fprintf(stdout, "\nUsage: %s [-o dir] [-t seconds] [-b kb] [-c case_id] "
+            "[-- command [args]]\n", APP_NAME);
+    fprintf(stdout, "    -o: dir for the raw per CPU trace (default %s).\n",
+            DEFAULT_DIR);
+    fprintf(stdout, "    -t: recording time without a command (default "
+            "%d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -b: per CPU ring buffer size in KB (default %d).\n",
+            DEFAULT_BUFFER_KB);
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "The command runs with FWTEST_TRACE=1 so its calls are "
+            "marked. Without a\ncommand the calls of any app run with "
+            "FWTEST_TRACE=1 are traced.\n");
+    fprintf(stdout, "Example: %s -- gpiotest -c 1002 -p 1\n", APP_NAME);
+}
+
+/**
+ * @brief Get the event IDs and field offsets used by the decoder.
+ *
+ * @param ids Returns the IDs, -1 for events the kernel does not have.
+ * @return 0 on success, -errno if the greybus events are missing.
+ */
+static int get_trace_ids(struct trace_ids *ids)
+{
+    int size = 0, ret = 0;
+
+    ids->print = trace_event_id("ftrace", "print");
+    ids->send = trace_event_id(GB_SYSTEM, "gb_message_send");
+    ids->submit = trace_event_id(GB_SYSTEM, "gb_message_submit");
+    ids->response = trace_event_id(GB_SYSTEM, "gb_message_recv_response");
+    if (ids->print < 0 || ids->send < 0 || ids->response < 0) {
+        return -ENOENT;
+    }
+
+    ret = trace_event_field("ftrace", "print", "buf", &ids->buf_off, &size);
+    if (!ret) {
+        ret = trace_event_field(GB_SYSTEM, "gb_message_send", "common_pid",
+                                &ids->pid_off, &size);
+    }
+    if (!ret) {
+        ret = trace_event_field(GB_SYSTEM, "gb_message_send", "operation_id",
+                                &ids->op_off, &size);
+    }
+    if (!ret) {
+        ret = trace_event_field(GB_SYSTEM, "gb_message_send", "type",
+                                &ids->type_off, &size);
+    }
+
+    return ret;
+}
+
+static int find_call(struct trace_ctx *tc, const char *name, int len)
+{
+    int i;
+
+    if (len >= CALL_NAME_LEN) {
+        len = CALL_NAME_LEN - 1;
+    }
+    for (i = 0; i < tc->ncalls; i++) {
+        if (!strncmp(tc->calls[i].name, name, len) &&
+            !tc->calls[i].name[len]) {
+            return i;
+        }
+    }
+    if (tc->ncalls == MAX_CALLS) {
+        return -1;
+    }
+
+    memcpy(tc->calls[i].name, name, len);
+    tc->calls[i].name[len] = '\0';
+    stats_hist_init(&tc->calls[i].total);
+    stats_hist_init(&tc->calls[i].host);
+    stats_hist_init(&tc->calls[i].submit);
+    stats_hist_init(&tc->calls[i].link);
+
+    return tc->ncalls++;
+}
+
+/**
+ * @brief trace_parse_page() callback, keeps the records of interest.
+ */
+static void on_event(void *arg, int cpu, uint64_t ts, const uint8_t *data,
+                     int len)
+{
+    struct trace_ctx *tc = arg;
+    const struct trace_ids *ids = &tc->ids;
+    struct trace_rec rec, *recs = NULL;
+    const char *buf = NULL, *name = NULL, *end = NULL;
+    uint16_t id = 0;
+    int32_t pid = 0;
+
+    /* records are merged by timestamp, the cpu does not matter */
+    (void)cpu;
+
+    if (len < ids->pid_off + 4) {
+        return;
+    }
+
+    memset(&rec, 0, sizeof(rec));
+    memcpy(&id, data, sizeof(id));
+    memcpy(&pid, data + ids->pid_off, sizeof(pid));
+    rec.ts = ts;
+    rec.pid = pid;
+
+    if (id == ids->print) {
+        buf = (const char *)data + ids->buf_off;
+        end = (const char *)data + len;
+        if (buf + strlen(TRACE_MARK_PREFIX) + 2 > end ||
+            strncmp(buf, TRACE_MARK_PREFIX, strlen(TRACE_MARK_PREFIX))) {
+            return;
+        }
+        buf += strlen(TRACE_MARK_PREFIX);
+        rec.kind = *buf == 'B' ? REC_BEGIN : REC_END;
+        name = buf + 2;
+        for (buf = name; buf < end && *buf && *buf != '\n'; buf++) {
+        }
+        rec.call = find_call(tc, name, buf - name);
+        if (rec.call < 0) {
+            return;
+        }
+    } else if (id == ids->send || id == ids->submit || id == ids->response) {
+        if (len < ids->op_off + 2 || len < ids->type_off + 1) {
+            return;
+        }
+        memcpy(&rec.op_id, data + ids->op_off, sizeof(rec.op_id));
+        rec.type = data[ids->type_off];
+        /* unidirectional operations have no response */
+        if (!rec.op_id) {
+            return;
+        }
+        if (id == ids->response) {
+            rec.kind = REC_RESPONSE;
+        } else if (rec.type & GB_TYPE_RESPONSE) {
+            /* responses to module requests are not part of a call */
+            return;
+        } else {
+            rec.kind = id == ids->send ? REC_SEND : REC_SUBMIT;
+        }
+    } else {
+        return;
+    }
+
+    if (tc->nrecs == tc->size) {
+        recs = realloc(tc->recs, (tc->size ? tc->size * 2 : 4096) *
+                       sizeof(*recs));
+        if (recs == NULL) {
+            return;
+        }
+        tc->recs = recs;
+        tc->size = tc->size ? tc->size * 2 : 4096;
+    }
+    tc->recs[tc->nrecs++] = rec;
+}
+
+static int compare_rec(const void *a, const void *b)
+{
+    const struct trace_rec *ra = a, *rb = b;
+
+    return ra->ts < rb->ts ? -1 : ra->ts > rb->ts;
+}
+
+/**
+ * @brief Decode the recorded pages of all CPUs.
+ *
+ * @param info The tracer info.
+ * @param tc Returns the records, sorted by time.
+ * @return 0 on success, -errno on failure.
+ */
+static int decode(struct gbtrace_info *info, struct trace_ctx *tc)
+{
+    char path[PATH_MAX];
+    struct stat st;
+    uint8_t *map = NULL;
+    off_t off = 0;
+    int cpu = 0, fd = -1;
+
+    for (cpu = 0; cpu < info->ncpus; cpu++) {
+        snprintf(path, sizeof(path), "%s/cpu%d.raw", info->dir, cpu);
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            continue;
+        }
+        if (fstat(fd, &st) || st.st_size < info->layout.page_size) {
+            close(fd);
+            continue;
+        }
+
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            return -errno;
+        }
+        for (off = 0; off + info->layout.page_size <= st.st_size;
+             off += info->layout.page_size) {
+            tc->lost_pages += trace_parse_page(&info->layout, map + off, cpu,
+                                               on_event, tc);
+        }
+        munmap(map, st.st_size);
+    }
+
+    qsort(tc->recs, tc->nrecs, sizeof(*tc->recs), compare_rec);
+
+    return 0;
+}
+
+/* the innermost call in progress of a thread */
+static struct span *find_span(struct trace_ctx *tc, int pid, int call)
+{
+    struct span *best = NULL;
+    int i;
+
+    for (i = 0; i < MAX_OPEN; i++) {
+        if (tc->open[i].active && tc->open[i].pid == pid &&
+            (call < 0 || tc->open[i].call == call) &&
+            (best == NULL || tc->open[i].begin > best->begin)) {
+            best = &tc->open[i];
+        }
+    }
+
+    return best;
+}
+
+/* the oldest operation in progress with an ID, for a submit or response */
+static struct gb_op *find_op(struct trace_ctx *tc, uint16_t op_id, int kind)
+{
+    struct gb_op *op = NULL, *best = NULL;
+    int i, j;
+
+    for (i = 0; i < MAX_OPEN; i++) {
+        for (j = 0; tc->open[i].active && j < tc->open[i].nops; j++) {
+            op = &tc->open[i].ops[j];
+            if (op->id != op_id || op->response ||
+                (kind == REC_SUBMIT && op->submit)) {
+                continue;
+            }
+            if (best == NULL || op->send < best->send) {
+                best = op;
+            }
+        }
+    }
+
+    return best;
+}
+
+static void finish_span(struct trace_ctx *tc, struct span *span, uint64_t end)
+{
+    struct call_stats *cs = &tc->calls[span->call];
+    struct gb_op *op = NULL;
+    uint64_t total = end - span->begin, in_ops = 0, start = 0;
+    int i;
+
+    for (i = 0; i < span->nops; i++) {
+        op = &span->ops[i];
+        if (!op->response) {
+            cs->unmatched++;
+            continue;
+        }
+        start = op->submit ? op->submit : op->send;
+        if (op->submit) {
+            stats_hist_record(&cs->submit, op->submit - op->send);
+        }
+        stats_hist_record(&cs->link, op->response - start);
+        in_ops += op->response - op->send;
+        cs->ops++;
+    }
+
+    cs->calls++;
+    stats_hist_record(&cs->total, total);
+    stats_hist_record(&cs->host, in_ops < total ? total - in_ops : 0);
+    span->active = 0;
+}
+
+/**
+ * @brief Attribute the greybus operations to the marked calls.
+ *
+ * @param tc The decoded records.
+ * @return None
+ */
+static void correlate(struct trace_ctx *tc)
+{
+    struct trace_rec *rec = NULL;
+    struct span *span = NULL;
+    struct gb_op *op = NULL;
+    long i;
+    int j;
+
+    for (i = 0; i < tc->nrecs; i++) {
+        rec = &tc->recs[i];
+        switch (rec->kind) {
+            case REC_BEGIN:
+                for (j = 0; j < MAX_OPEN && tc->open[j].active; j++) {
+                }
+                if (j == MAX_OPEN) {
+                    break;
+                }
+                span = &tc->open[j];
+                memset(span, 0, sizeof(*span));
+                span->active = 1;
+                span->pid = rec->pid;
+                span->call = rec->call;
+                span->begin = rec->ts;
+                break;
+            case REC_END:
+                span = find_span(tc, rec->pid, rec->call);
+                if (span != NULL) {
+                    finish_span(tc, span, rec->ts);
+                }
+                break;
+            case REC_SEND:
+                span = find_span(tc, rec->pid, -1);
+                if (span != NULL && span->nops < MAX_SPAN_OPS) {
+                    op = &span->ops[span->nops++];
+                    op->id = rec->op_id;
+                    op->send = rec->ts;
+                }
+                break;
+            case REC_SUBMIT:
+                op = find_op(tc, rec->op_id, rec->kind);
+                if (op != NULL) {
+                    op->submit = rec->ts;
+                }
+                break;
+            case REC_RESPONSE:
+                op = find_op(tc, rec->op_id, rec->kind);
+                if (op != NULL) {
+                    op->response = rec->ts;
+                }
+                break;
+        }
+    }
+}
+
+static void report(struct gbtrace_info *info, struct trace_ctx *tc)
+{
+    struct call_stats *cs = NULL;
+    char name[CALL_NAME_LEN + 16];
+    int i;
+
+    for (i = 0; i < tc->ncalls; i++) {
+        cs = &tc->calls[i];
+        if (!cs->calls) {
+            continue;
+        }
+
+        snprintf(name, sizeof(name), "%s_calls", cs->name);
+        print_test_case_perf(info->case_id, name, cs->calls, "calls");
+        snprintf(name, sizeof(name), "%s_ops_per_call", cs->name);
+        print_test_case_perf(info->case_id, name,
+                             (double)cs->ops / cs->calls, "ops");
+        if (cs->unmatched) {
+            snprintf(name, sizeof(name), "%s_unmatched_ops", cs->name);
+            print_test_case_perf(info->case_id, name, cs->unmatched, "ops");
+        }
+        snprintf(name, sizeof(name), "%s_total", cs->name);
+        stats_hist_report(info->case_id, name, &cs->total);
+        snprintf(name, sizeof(name), "%s_host", cs->name);
+        stats_hist_report(info->case_id, name, &cs->host);
+        if (cs->submit.count) {
+            snprintf(name, sizeof(name), "%s_submit", cs->name);
+            stats_hist_report(info->case_id, name, &cs->submit);
+        }
+        if (cs->link.count) {
+            snprintf(name, sizeof(name), "%s_link", cs->name);
+            stats_hist_report(info->case_id, name, &cs->link);
+        }
+    }
+
+    if (tc->lost_pages) {
+        print_test_case_perf(info->case_id, "lost_pages", tc->lost_pages,
+                             "pages");
+    }
+}
+
+/* move one or more full ring buffer pages to the file, without copying */
+static int splice_pages(int raw, int *pipefd, int out, int page_size)
+{
+    ssize_t n = 0, m = 0;
+
+    n = splice(raw, NULL, pipefd[1], NULL, page_size, SPLICE_F_NONBLOCK);
+    if (n <= 0) {
+        return n < 0 && errno != EAGAIN ? -errno : 0;
+    }
+    while (n > 0) {
+        m = splice(pipefd[0], NULL, out, NULL, n, SPLICE_F_MOVE);
+        if (m <= 0) {
+            return -EIO;
+        }
+        n -= m;
+    }
+
+    return 1;
+}
+
+/* copy the partial pages left once tracing is off, splice only takes full */
+static void drain_pages(int raw, int out, uint8_t *page, int page_size)
+{
+    while (1) {
+        memset(page, 0, page_size);
+        if (read(raw, page, page_size) <= 0 ||
+            write(out, page, page_size) != page_size) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Record the greybus events and call marks.
+ *
+ * @param info The tracer info.
+ * @param status Returns the command exit status.
+ * @return 0 on success, -errno on failure.
+ */
+static int record(struct gbtrace_info *info, int *status)
+{
+    static int raw[MAX_CPUS], out[MAX_CPUS], pipes[MAX_CPUS][2];
+    char path[PATH_MAX], buf[16];
+    uint8_t *page = NULL;
+    uint64_t deadline = 0;
+    pid_t child = -1;
+    int cpu = 0, moved = 0, running = 1, ret = 0;
+
+    page = malloc(info->layout.page_size);
+    if (page == NULL) {
+        return -ENOMEM;
+    }
+
+    snprintf(buf, sizeof(buf), "%d", info->buffer_kb);
+    tracefs_write("tracing_on", "0");
+    tracefs_write("buffer_size_kb", buf);
+    tracefs_write("trace", "");
+    ret = tracefs_write("events/" GB_SYSTEM "/enable", "1");
+    if (ret) {
+        free(page);
+        return ret;
+    }
+
+    /* the cleanup below looks at every cpu, also after a failed open */
+    for (cpu = 0; cpu < info->ncpus; cpu++) {
+        raw[cpu] = out[cpu] = pipes[cpu][0] = pipes[cpu][1] = -1;
+    }
+
+    mkdir(info->dir, 0755);
+    for (cpu = 0; cpu < info->ncpus; cpu++) {
+        snprintf(path, sizeof(path), "%s/per_cpu/cpu%d/trace_pipe_raw",
+                 tracefs_dir(), cpu);
+        raw[cpu] = open(path, O_RDONLY | O_NONBLOCK);
+        if (raw[cpu] < 0) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/cpu%d.raw", info->dir, cpu);
+        out[cpu] = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out[cpu] < 0 || pipe(pipes[cpu])) {
+            ret = -errno;
+            break;
+        }
+    }
+
+    if (!ret) {
+        tracefs_write("tracing_on", "1");
+        if (info->cmd != NULL) {
+            setenv("FWTEST_TRACE", "1", 1);
+            child = fork();
+            if (child == 0) {
+                execvp(info->cmd[0], info->cmd);
+                _exit(127);
+            }
+            if (child < 0) {
+                ret = -errno;
+                running = 0;
+            }
+        } else {
+            deadline = stats_now_ns() + info->duration * 1000000000ULL;
+        }
+    } else {
+        running = 0;
+    }
+
+    while (running) {
+        moved = 0;
+        for (cpu = 0; cpu < info->ncpus; cpu++) {
+            if (raw[cpu] >= 0 && out[cpu] >= 0 &&
+                splice_pages(raw[cpu], pipes[cpu], out[cpu],
+                             info->layout.page_size) > 0) {
+                moved = 1;
+            }
+        }
+        if (child > 0) {
+            running = waitpid(child, status, WNOHANG) == 0;
+        } else {
+            running = stats_now_ns() < deadline;
+        }
+        if (running && !moved) {
+            usleep(POLL_US);
+        }
+    }
+
+    tracefs_write("tracing_on", "0");
+    tracefs_write("events/" GB_SYSTEM "/enable", "0");
+
+    for (cpu = 0; cpu < info->ncpus; cpu++) {
+        if (raw[cpu] >= 0 && out[cpu] >= 0) {
+            while (splice_pages(raw[cpu], pipes[cpu], out[cpu],
+                                info->layout.page_size) > 0) {
+            }
+            drain_pages(raw[cpu], out[cpu], page, info->layout.page_size);
+        }
+        if (raw[cpu] >= 0) {
+            close(raw[cpu]);
+        }
+        if (out[cpu] >= 0) {
+            close(out[cpu]);
+        }
+        if (pipes[cpu][0] >= 0) {
+            close(pipes[cpu][0]);
+            close(pipes[cpu][1]);
+        }
+    }
+    free(page);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    struct gbtrace_info info;
+    int options = 0, status = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    snprintf(info.dir, sizeof(info.dir), "%s", DEFAULT_DIR);
+    info.duration = DEFAULT_DURATION;
+    info.buffer_kb = DEFAULT_BUFFER_KB;
+
+    while ((options = getopt(argc, argv, "+b:c:o:t:")) != -1) {
+        switch (options) {
+            case 'b':
+                info.buffer_kb = atoi(optarg);
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'o':
+                snprintf(info.dir, sizeof(info.dir), "%s", optarg);
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+    if (optind < argc) {
+        info.cmd = &argv[optind];
+    }
+
+    if (info.duration < 1 || info.buffer_kb < 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    info.ncpus = sysconf(_SC_NPROCESSORS_CONF);
+    if (info.ncpus > MAX_CPUS) {
+        info.ncpus = MAX_CPUS;
+    }
+
+    if (tracefs_dir() == NULL) {
+        ret = -ENOENT;
+    }
+    if (!ret) {
+        ret = trace_page_layout(&info.layout);
+    }
+    if (!ret) {
+        ret = get_trace_ids(&ctx.ids);
+    }
+    if (!ret) {
+        ret = record(&info, &status);
+    }
+    if (!ret) {
+        ret = decode(&info, &ctx);
+    }
+    if (!ret) {
+        correlate(&ctx);
+        report(&info, &ctx);
+        if (info.cmd != NULL &&
+            (!WIFEXITED(status) || WEXITSTATUS(status))) {
+            ret = -ECHILD;
+        } else if (!ctx.ncalls) {
+            ret = -ENODATA;
+        }
+    }
+    free(ctx.recs);
+
+    print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+
+    return ret;
+}
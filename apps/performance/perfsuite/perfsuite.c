@@ -0,0 +1,702 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define APP_NAME "perfsuite"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <sys/wait.h>
+#include <linux/limits.h>
+
+#include "libfwtest.h"
+
+/* Default report path prefix, .json and .csv are appended */
+#define DEFAULT_REPORT "/data/local/tmp/perfsuite"
+/* Default regression tolerance, in percent */
+#define DEFAULT_TOLERANCE 10.0
+/* Max number of benchmarks in a profile */
+#define MAX_BENCHES 16
+/* Max number of metrics of a whole run or baseline */
+#define MAX_METRICS 2048
+/* Max arguments of one benchmark */
+#define MAX_ARGS 32
+
+#define NAME_LEN 64
+#define UNIT_LEN 16
+#define ARGS_LEN 256
+/* report prefix and bindir, leave room for the bench name suffix */
+#define REPORT_LEN (PATH_MAX - NAME_LEN - 8)
+
+struct bench {
+    char name[NAME_LEN];
+    char args[ARGS_LEN];
+    int result;
+};
+
+enum better {
+    BETTER_HIGHER,
+    BETTER_LOWER,
+    BETTER_NONE,
+};
+
+struct metric {
+    char bench[NAME_LEN];
+    char name[NAME_LEN];
+    char unit[UNIT_LEN];
+    double value;
+    double tolerance;
+    enum better better;
+};
+
+struct suite_info {
+    int case_id;
+    char bindir[REPORT_LEN];
+    char report[REPORT_LEN];
+    char baseline[PATH_MAX];
+    char only[ARGS_LEN];
+    double tolerance;
+    int update;
+    int nbenches;
+    struct bench benches[MAX_BENCHES];
+};
+
+struct metric_set {
+    int count;
+    struct metric m[MAX_METRICS];
+};
+
+/*
+ * standard profiles, overridden by -p. spi_readperf stays within the
+ * default spidev bufsiz of 4096 bytes per message.
+ */
+static const struct bench default_benches[] = {
+    { "i2c_readperf", "-a 41 -s 1,16,64 -t 5", 0 },
+    { "sd_readperf", "-p all -s 4096,65536,1048576 -t 5", 0 },
+    { "spi_readperf", "-f 1000000,8000000 -s 16,256,512 -n 1,8 -t 2", 0 },
+    { "gpio_toggle", "-t 5", 0 },
+    { "uart_burst", "-b 115200,921600 -s 32,4096 -t 5 -a", 0 },
+};
+
+static const char *better_name[] = {
+    "higher",
+    "lower",
+    "none",
+};
+
+void usage()
+{
+    fprintf(stdout, "\nUsage: %s [-d bindir] [-p profile] [-o benches] "
+            "[-r report] [-b baseline] [-t tolerance] [-u] [-c case_id]\n",
+            APP_NAME);
+    fprintf(stdout, "    -d: directory of the benchmarks (default the "
+            "directory of\n        %s).\n", APP_NAME);
+    fprintf(stdout, "    -p: profile file, one \"<bench> <args>\" per line, "
+            "replaces\n        the standard profiles.\n");
+    fprintf(stdout, "    -o: comma separated benchmarks to run (default "
+            "all).\n");
+    fprintf(stdout, "    -r: report path prefix, .json, .csv and per bench "
+            ".log files\n        are written (default %s).\n",
+            DEFAULT_REPORT);
+    fprintf(stdout, "    -b: baseline csv to check the run against.\n");
+    fprintf(stdout, "    -t: tolerance in percent for baseline entries "
+            "without one\n        (default %.0f).\n", DEFAULT_TOLERANCE);
+    fprintf(stdout, "    -u: write the run as the new baseline instead of "
+            "checking it.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Baseline csv: bench,metric,value,unit,tolerance,better "
+            "where better\nis higher, lower or none. The report csv is a "
+            "valid baseline.\n");
+    fprintf(stdout, "Example: %s -b /data/local/tmp/perf_baseline.csv\n",
+            APP_NAME);
+}
+
+/**
+ * @brief Guess which way a metric improves from its name and unit.
+ *
+ * Used when a baseline entry does not say, latencies and loss counters go
+ * down, rates go up and sample counts are not checked.
+ *
+ * @param name The metric name.
+ * @param unit The metric unit.
+ * @return the direction.
+ */
+static enum better guess_better(const char *name, const char *unit)
+{
+    static const char *lower_names[] = {
+        "lost", "dropped", "reordered", "mismatch", "error",
+    };
+    size_t i;
+
+    if (!strcmp(unit, "samples")) {
+        return BETTER_NONE;
+    }
+
+    if (!strcmp(unit, "ns") || !strcmp(unit, "us") || !strcmp(unit, "ms") ||
+        !strcmp(unit, "s")) {
+        return BETTER_LOWER;
+    }
+
+    for (i = 0; i < sizeof(lower_names) / sizeof(lower_names[0]); i++) {
+        if (strstr(name, lower_names[i])) {
+            return BETTER_LOWER;
+        }
+    }
+
+    return BETTER_HIGHER;
+}
+
+/**
+ * @brief Load the benchmark profile file.
+ *
+ * @param info The suite info to fill.
+ * @param path The profile file.
+ * @return 0 on success, error code on failure.
+ */
+static int load_profile(struct suite_info *info, const char *path)
+{
+    char line[ARGS_LEN + NAME_LEN];
+    struct bench *b;
+    FILE *fp;
+    int n;
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        return -errno;
+    }
+
+    info->nbenches = 0;
+    while (fgets(line, sizeof(line), fp) && info->nbenches < MAX_BENCHES) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0') {
+            continue;
+        }
+
+        b = &info->benches[info->nbenches];
+        memset(b, 0, sizeof(*b));
+        if (sscanf(line, "%63s %n", b->name, &n) != 1) {
+            continue;
+        }
+        snprintf(b->args, sizeof(b->args), "%s", line + n);
+        info->nbenches++;
+    }
+
+    fclose(fp);
+    return info->nbenches ? 0 : -EINVAL;
+}
+
+/**
+ * @brief Check if a benchmark is selected with -o.
+ *
+ * @param info The suite info.
+ * @param name The benchmark name.
+ * @return 1 if it should run, 0 if not.
+ */
+static int bench_selected(const struct suite_info *info, const char *name)
+{
+    char buf[ARGS_LEN];
+    char *tok, *save = NULL;
+
+    if (!info->only[0]) {
+        return 1;
+    }
+
+    snprintf(buf, sizeof(buf), "%s", info->only);
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        if (!strcmp(tok, name)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Parse one benchmark output line into a metric.
+ *
+ * Only [P][ARA-<case>-<metric>][pass][<value>][<unit>] lines count.
+ *
+ * @param line The output line.
+ * @param m Returns the metric name, value and unit.
+ * @return 1 for a metric line, 0 otherwise.
+ */
+static int parse_perf_line(const char *line, struct metric *m)
+{
+    return sscanf(line, "[P][ARA-%*d-%63[^]]][pass][%lf][%15[^]]]",
+                  m->name, &m->value, m->unit) == 3;
+}
+
+/**
+ * @brief Run one benchmark and collect its metrics.
+ *
+ * The benchmark output goes to <report>-<bench>.log rather than the
+ * console, so LAVA only parses the suite's own lines.
+ *
+ * @param info The suite info.
+ * @param b The benchmark.
+ * @param set The metric set to append to.
+ * @return 0 if the benchmark passed, error code otherwise.
+ */
+static int run_bench(const struct suite_info *info, const struct bench *b,
+                     struct metric_set *set)
+{
+    char path[PATH_MAX], logpath[PATH_MAX], args[ARGS_LEN];
+    char line[512];
+    char *argv[MAX_ARGS + 2];
+    char *tok, *save = NULL;
+    struct metric *m;
+    FILE *out, *log;
+    int fds[2], argc = 0, status = 0;
+    pid_t pid;
+
+    snprintf(path, sizeof(path), "%s/%s", info->bindir, b->name);
+    if (access(path, X_OK)) {
+        return -errno;
+    }
+
+    snprintf(args, sizeof(args), "%s", b->args);
+    argv[argc++] = path;
+    for (tok = strtok_r(args, " \t", &save); tok && argc <= MAX_ARGS;
+         tok = strtok_r(NULL, " \t", &save)) {
+        argv[argc++] = tok;
+    }
+    argv[argc] = NULL;
+
+    if (pipe(fds)) {
+        return -errno;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -errno;
+    }
+
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execv(path, argv);
+        _exit(127);
+    }
+
+    close(fds[1]);
+    out = fdopen(fds[0], "r");
+    if (!out) {
+        close(fds[0]);
+        waitpid(pid, &status, 0);
+        return -ENOMEM;
+    }
+
+    snprintf(logpath, sizeof(logpath), "%s-%s.log", info->report, b->name);
+    log = fopen(logpath, "w");
+
+    while (fgets(line, sizeof(line), out)) {
+        if (log) {
+            fputs(line, log);
+        }
+        if (set->count >= MAX_METRICS) {
+            continue;
+        }
+
+        m = &set->m[set->count];
+        memset(m, 0, sizeof(*m));
+        if (parse_perf_line(line, m)) {
+            snprintf(m->bench, sizeof(m->bench), "%s", b->name);
+            m->better = guess_better(m->name, m->unit);
+            m->tolerance = info->tolerance;
+            set->count++;
+        }
+    }
+
+    if (log) {
+        fclose(log);
+    }
+    fclose(out);
+
+    if (waitpid(pid, &status, 0) < 0) {
+        return -errno;
+    }
+
+    if (!WIFEXITED(status)) {
+        return -EINTR;
+    }
+    if (WEXITSTATUS(status) == 127) {
+        return -ENOEXEC;
+    }
+
+    return WEXITSTATUS(status) ? -EIO : 0;
+}
+
+/**
+ * @brief Write a string as the inside of a JSON string.
+ *
+ * @param fp The file.
+ * @param str The string.
+ */
+static void json_write_str(FILE *fp, const char *str)
+{
+    const unsigned char *c;
+
+    for (c = (const unsigned char *)str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(fp, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(fp, "\\u%04x", *c);
+        } else {
+            fputc(*c, fp);
+        }
+    }
+}
+
+/**
+ * @brief Write the metrics as csv, in the baseline format.
+ *
+ * @param path The csv file.
+ * @param set The metrics.
+ * @return 0 on success, error code on failure.
+ */
+static int write_csv(const char *path, const struct metric_set *set)
+{
+    const struct metric *m;
+    FILE *fp;
+    int i;
+
+    fp = fopen(path, "w");
+    if (!fp) {
+        return -errno;
+    }
+
+    fprintf(fp, "# bench,metric,value,unit,tolerance,better\n");
+    for (i = 0; i < set->count; i++) {
+        m = &set->m[i];
+        fprintf(fp, "%s,%s,%.3f,%s,%.1f,%s\n", m->bench, m->name, m->value,
+                m->unit, m->tolerance, better_name[m->better]);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief Write the run as json.
+ *
+ * Names come from the benchmarks' own [P] lines and never need escaping.
+ *
+ * @param info The suite info.
+ * @param set The metrics.
+ * @return 0 on success, error code on failure.
+ */
+static int write_json(const struct suite_info *info,
+                      const struct metric_set *set)
+{
+    char path[PATH_MAX];
+    const struct bench *b;
+    const struct metric *m;
+    FILE *fp;
+    int i, j, first;
+
+    snprintf(path, sizeof(path), "%s.json", info->report);
+    fp = fopen(path, "w");
+    if (!fp) {
+        return -errno;
+    }
+
+    fprintf(fp, "{\n  \"suite\": \"%s\",\n  \"benches\": [", APP_NAME);
+    for (i = 0; i < info->nbenches; i++) {
+        b = &info->benches[i];
+        fprintf(fp, "%s\n    {\n      \"name\": \"%s\",\n"
+                "      \"args\": \"", i ? "," : "", b->name);
+        json_write_str(fp, b->args);
+        fprintf(fp, "\",\n      \"result\": %d,\n      \"metrics\": [",
+                b->result);
+
+        first = 1;
+        for (j = 0; j < set->count; j++) {
+            m = &set->m[j];
+            if (strcmp(m->bench, b->name)) {
+                continue;
+            }
+            fprintf(fp, "%s\n        { \"name\": \"%s\", \"value\": %.3f, "
+                    "\"unit\": \"%s\" }", first ? "" : ",", m->name,
+                    m->value, m->unit);
+            first = 0;
+        }
+        fprintf(fp, "\n      ]\n    }");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief Load a baseline csv.
+ *
+ * Tolerance and direction are optional per line, -t and the metric name
+ * and unit fill them in.
+ *
+ * @param info The suite info.
+ * @param set Returns the baseline metrics.
+ * @return 0 on success, error code on failure.
+ */
+static int load_baseline(const struct suite_info *info,
+                         struct metric_set *set)
+{
+    char line[256], better[16];
+    struct metric *m;
+    FILE *fp;
+    int n;
+
+    fp = fopen(info->baseline, "r");
+    if (!fp) {
+        return -errno;
+    }
+
+    set->count = 0;
+    while (fgets(line, sizeof(line), fp) && set->count < MAX_METRICS) {
+        if (line[0] == '#') {
+            continue;
+        }
+
+        m = &set->m[set->count];
+        memset(m, 0, sizeof(*m));
+        better[0] = '\0';
+        m->tolerance = info->tolerance;
+        n = sscanf(line, "%63[^,],%63[^,],%lf,%15[^,\n],%lf,%15[^,\n]",
+                   m->bench, m->name, &m->value, m->unit, &m->tolerance,
+                   better);
+        if (n < 4) {
+            continue;
+        }
+
+        if (!strcmp(better, "higher")) {
+            m->better = BETTER_HIGHER;
+        } else if (!strcmp(better, "lower")) {
+            m->better = BETTER_LOWER;
+        } else if (!strcmp(better, "none")) {
+            m->better = BETTER_NONE;
+        } else {
+            m->better = guess_better(m->name, m->unit);
+        }
+        set->count++;
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief Check the run against the baseline.
+ *
+ * Each checked baseline metric prints an [A] line. Metrics of benchmarks
+ * that were not run are skipped, metrics missing from a run benchmark
+ * fail.
+ *
+ * @param info The suite info.
+ * @param base The baseline.
+ * @param run The metrics of this run.
+ * @return number of regressions.
+ */
+static int check_baseline(const struct suite_info *info,
+                          const struct metric_set *base,
+                          const struct metric_set *run)
+{
+    const struct metric *b, *r;
+    char check[2 * NAME_LEN], logbuf[256];
+    double limit;
+    int i, j, k, fail, regressions = 0;
+
+    for (i = 0; i < base->count; i++) {
+        b = &base->m[i];
+        if (b->better == BETTER_NONE) {
+            continue;
+        }
+
+        for (k = 0; k < info->nbenches; k++) {
+            if (!strcmp(info->benches[k].name, b->bench)) {
+                break;
+            }
+        }
+        if (k == info->nbenches) {
+            continue;
+        }
+
+        r = NULL;
+        for (j = 0; j < run->count; j++) {
+            if (!strcmp(run->m[j].bench, b->bench) &&
+                !strcmp(run->m[j].name, b->name)) {
+                r = &run->m[j];
+                break;
+            }
+        }
+
+        if (b->better == BETTER_HIGHER) {
+            limit = b->value * (1.0 - b->tolerance / 100.0);
+            fail = !r || r->value < limit;
+        } else {
+            limit = b->value * (1.0 + b->tolerance / 100.0);
+            fail = !r || r->value > limit;
+        }
+
+        snprintf(check, sizeof(check), "%s.%s", b->bench, b->name);
+        if (fail) {
+            regressions++;
+            if (r) {
+                snprintf(logbuf, sizeof(logbuf), "%s: %.3f %s, baseline "
+                         "%.3f, limit %.3f", check, r->value, r->unit,
+                         b->value, limit);
+            } else {
+                snprintf(logbuf, sizeof(logbuf), "%s: missing", check);
+            }
+            print_test_case_log(APP_NAME, info->case_id, logbuf);
+        }
+        print_test_case_check(info->case_id, check, fail);
+    }
+
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    static struct suite_info info;
+    static struct metric_set run, base;
+    char path[PATH_MAX], logbuf[128];
+    struct bench *b;
+    int options = 0, i = 0, n = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    snprintf(path, sizeof(path), "%s", argv[0]);
+    snprintf(info.bindir, sizeof(info.bindir), "%s", dirname(path));
+    snprintf(info.report, sizeof(info.report), "%s", DEFAULT_REPORT);
+    info.tolerance = DEFAULT_TOLERANCE;
+    info.nbenches = sizeof(default_benches) / sizeof(default_benches[0]);
+    memcpy(info.benches, default_benches, sizeof(default_benches));
+
+    while ((options = getopt(argc, argv, "b:c:d:o:p:r:t:u")) != -1) {
+        switch (options) {
+            case 'b':
+                snprintf(info.baseline, sizeof(info.baseline), "%s", optarg);
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'd':
+                snprintf(info.bindir, sizeof(info.bindir), "%s", optarg);
+                break;
+            case 'o':
+                snprintf(info.only, sizeof(info.only), "%s", optarg);
+                break;
+            case 'p':
+                if (load_profile(&info, optarg)) {
+                    usage();
+                    return -EINVAL;
+                }
+                break;
+            case 'r':
+                snprintf(info.report, sizeof(info.report), "%s", optarg);
+                break;
+            case 't':
+                info.tolerance = atof(optarg);
+                break;
+            case 'u':
+                info.update = 1;
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (info.tolerance < 0 || (info.update && !info.baseline[0])) {
+        usage();
+        return -EINVAL;
+    }
+
+    /* drop the benchmarks not selected, the report lists what ran */
+    for (i = 0; i < info.nbenches; i++) {
+        if (bench_selected(&info, info.benches[i].name)) {
+            info.benches[n++] = info.benches[i];
+        }
+    }
+    info.nbenches = n;
+
+    for (i = 0; i < info.nbenches; i++) {
+        b = &info.benches[i];
+        n = run.count;
+        b->result = run_bench(&info, b, &run);
+
+        snprintf(logbuf, sizeof(logbuf), "%s: %d metrics, result %d",
+                 b->name, run.count - n, b->result);
+        print_test_case_log(APP_NAME, info.case_id, logbuf);
+        print_test_case_check(info.case_id, b->name, b->result);
+        if (b->result) {
+            ret = -EIO;
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s.csv", info.report);
+    if (write_csv(path, &run) || write_json(&info, &run)) {
+        ret = -EIO;
+        print_test_case_log(APP_NAME, info.case_id, "report write failed");
+    }
+
+    if (info.update) {
+        if (write_csv(info.baseline, &run)) {
+            ret = -EIO;
+        }
+    } else if (info.baseline[0]) {
+        if (load_baseline(&info, &base)) {
+            ret = -ENOENT;
+        } else {
+            n = check_baseline(&info, &base, &run);
+            printf("\n%s: %d benches, %d metrics, %d regressions\n",
+                   APP_NAME, info.nbenches, run.count, n);
+            if (n) {
+                ret = -ERANGE;
+            }
+        }
+    }
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
+}
@@ -0,0 +1,406 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define APP_NAME "startup_time"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "libfwtest.h"
+
+#define STARTUP_MAX_CMDS 64
+#define STARTUP_MAX_ARGS 32
+#define STARTUP_LINE_LEN 256
+#define STARTUP_DEFAULT_RUNS 10
+
+/* a binary to measure, with its arguments */
+struct command {
+    char line[STARTUP_LINE_LEN];
+    char *argv[STARTUP_MAX_ARGS + 1];
+    const char *name;
+    struct stats_hist to_main;
+    struct stats_hist to_result;
+    int failed;
+};
+
+struct startup_info {
+    int case_id;
+    int runs;
+    int cold;
+    int verbose;
+    int count;
+    struct command cmds[STARTUP_MAX_CMDS];
+};
+
+void usage()
+{
+    fprintf(stdout, "\nUsage: %s [-n runs] [-C] [-v] [-f file] "
+            "[-c case_id] [binary [args...]]\n", APP_NAME);
+    fprintf(stdout, "    -n: runs per binary (default %d).\n",
+            STARTUP_DEFAULT_RUNS);
+    fprintf(stdout, "    -C: drop the page cache before every run, "
+            "needs root.\n");
+    fprintf(stdout, "    -v: keep the output of the binaries.\n");
+    fprintf(stdout, "    -f: file of binaries with their arguments, one "
+            "per line.\n");
+    fprintf(stdout, "    -c: Testrail test case ID used for the "
+            "results.\n");
+    fprintf(stdout, "Reports for each binary the exec-to-main and the "
+            "main-to-first-[A] time,\nas sent by libfwtest, and the file "
+            "size. The footprint counts every\nbinary file once, links to "
+            "a multi-call fwbox share one file.\n");
+    fprintf(stdout, "Example: %s -n 20 -C ./gpio_enum ./i2c_enum -n 0\n",
+            APP_NAME);
+}
+
+/**
+ * @brief Split a command line into its arguments.
+ *
+ * @param cmd The command, cmd->line holds the line.
+ * @return 0 on success, -EINVAL on an empty line or too many arguments.
+ */
+static int parse_command(struct command *cmd)
+{
+    char *save = NULL, *tok = NULL, *slash = NULL;
+    int argc = 0;
+
+    for (tok = strtok_r(cmd->line, " \t\n", &save); tok != NULL;
+         tok = strtok_r(NULL, " \t\n", &save)) {
+        if (argc >= STARTUP_MAX_ARGS) {
+            return -EINVAL;
+        }
+        cmd->argv[argc++] = tok;
+    }
+    cmd->argv[argc] = NULL;
+    if (!argc) {
+        return -EINVAL;
+    }
+
+    slash = strrchr(cmd->argv[0], '/');
+    cmd->name = slash != NULL ? slash + 1 : cmd->argv[0];
+    stats_hist_init(&cmd->to_main);
+    stats_hist_init(&cmd->to_result);
+
+    return 0;
+}
+
+/**
+ * @brief Add the command given on the command line.
+ *
+ * @param info The app info.
+ * @param argc Number of arguments.
+ * @param argv The binary and its arguments.
+ * @return 0 on success, -EINVAL if the command does not fit.
+ */
+static int add_args(struct startup_info *info, int argc, char **argv)
+{
+    struct command *cmd = &info->cmds[info->count];
+    size_t len = 0;
+    int i = 0;
+
+    for (i = 0; i < argc; i++) {
+        len += snprintf(cmd->line + len, sizeof(cmd->line) - len, "%s ",
+                        argv[i]);
+        if (len >= sizeof(cmd->line)) {
+            return -EINVAL;
+        }
+    }
+
+    if (parse_command(cmd)) {
+        return -EINVAL;
+    }
+    info->count++;
+
+    return 0;
+}
+
+/**
+ * @brief Add the commands of a file, skipping blank and # lines.
+ *
+ * @param info The app info.
+ * @param path The file.
+ * @return 0 on success, error code on failure.
+ */
+static int add_file(struct startup_info *info, const char *path)
+{
+    char line[STARTUP_LINE_LEN];
+    FILE *fp = NULL;
+    int ret = 0;
+
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -errno;
+    }
+
+    while (!ret && fgets(line, sizeof(line), fp) != NULL) {
+        if (line[strspn(line, " \t\n")] == '\0' ||
+            line[strspn(line, " \t")] == '#') {
+            continue;
+        }
+        if (info->count >= STARTUP_MAX_CMDS) {
+            ret = -E2BIG;
+            break;
+        }
+        snprintf(info->cmds[info->count].line, STARTUP_LINE_LEN, "%s", line);
+        ret = parse_command(&info->cmds[info->count]);
+        if (!ret) {
+            info->count++;
+        }
+    }
+
+    fclose(fp);
+    return ret;
+}
+
+/**
+ * @brief Drop the page cache, so the next run reads the binary again.
+ *
+ * @return 0 on success, error code on failure.
+ */
+static int drop_caches(void)
+{
+    char value[] = "3";
+
+    sync();
+    return debugfs_set_attr("/proc/sys/vm", "drop_caches", value,
+                            strlen(value));
+}
+
+/**
+ * @brief Run a command once and read its startup marks.
+ *
+ * The child sends the exec mark itself right before execve(), libfwtest
+ * in the binary the main and first result marks. The pipe closes when the
+ * binary exits.
+ *
+ * @param info The app info.
+ * @param cmd The command.
+ * @return 0 on success, -ENOEXEC if the binary could not be run,
+ * -ENODATA if it sent no main mark, as binaries not printing through
+ * libfwtest do, error code on other failures.
+ */
+static int run_once(struct startup_info *info, struct command *cmd)
+{
+    struct startup_mark mark;
+    uint64_t ts[STARTUP_MARK_RESULT + 1] = { 0 };
+    char fdstr[16];
+    int pipefd[2], devnull = -1, status = 0;
+    pid_t pid = 0;
+
+    if (pipe(pipefd)) {
+        return -errno;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return -errno;
+    }
+
+    if (pid == 0) {
+        close(pipefd[0]);
+        if (!info->verbose) {
+            devnull = open("/dev/null", O_RDWR);
+            dup2(devnull, STDOUT_FILENO);
+            dup2(devnull, STDERR_FILENO);
+        }
+        snprintf(fdstr, sizeof(fdstr), "%d", pipefd[1]);
+        setenv("FWTEST_STARTUP_FD", fdstr, 1);
+        mark.type = STARTUP_MARK_EXEC;
+        mark.reserved = 0;
+        mark.ts = stats_now_ns();
+        if (write(pipefd[1], &mark, sizeof(mark)) != sizeof(mark)) {
+            _exit(127);
+        }
+        execv(cmd->argv[0], cmd->argv);
+        _exit(127);
+    }
+
+    close(pipefd[1]);
+    while (read(pipefd[0], &mark, sizeof(mark)) == sizeof(mark)) {
+        if (mark.type <= STARTUP_MARK_RESULT) {
+            ts[mark.type] = mark.ts;
+        }
+    }
+    close(pipefd[0]);
+    waitpid(pid, &status, 0);
+
+    if (!ts[STARTUP_MARK_MAIN]) {
+        /* 127 is the exit code of the child when execv() failed */
+        return WIFEXITED(status) && WEXITSTATUS(status) == 127 ?
+               -ENOEXEC : -ENODATA;
+    }
+
+    stats_hist_record(&cmd->to_main,
+                      ts[STARTUP_MARK_MAIN] - ts[STARTUP_MARK_EXEC]);
+    if (ts[STARTUP_MARK_RESULT]) {
+        stats_hist_record(&cmd->to_result,
+                          ts[STARTUP_MARK_RESULT] - ts[STARTUP_MARK_MAIN]);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Print the startup times and size of every command, and the
+ * footprint of all binaries.
+ *
+ * @param info The app info.
+ * @return None
+ */
+static void report(struct startup_info *info)
+{
+    struct stat st, seen[STARTUP_MAX_CMDS];
+    char metric[64];
+    uint64_t footprint = 0;
+    int i = 0, j = 0, files = 0;
+
+    for (i = 0; i < info->count; i++) {
+        struct command *cmd = &info->cmds[i];
+
+        snprintf(metric, sizeof(metric), "%s_exec_to_main", cmd->name);
+        stats_hist_report(info->case_id, metric, &cmd->to_main);
+        if (cmd->to_result.count) {
+            snprintf(metric, sizeof(metric), "%s_main_to_result",
+                     cmd->name);
+            stats_hist_report(info->case_id, metric, &cmd->to_result);
+        }
+
+        if (stat(cmd->argv[0], &st)) {
+            continue;
+        }
+        snprintf(metric, sizeof(metric), "%s_size", cmd->name);
+        print_test_case_perf(info->case_id, metric, st.st_size, "bytes");
+
+        for (j = 0; j < files; j++) {
+            if (seen[j].st_dev == st.st_dev && seen[j].st_ino == st.st_ino) {
+                break;
+            }
+        }
+        if (j == files) {
+            seen[files++] = st;
+            footprint += st.st_size;
+        }
+    }
+
+    print_test_case_perf(info->case_id, "binaries", files, "files");
+    print_test_case_perf(info->case_id, "footprint", footprint, "bytes");
+}
+
+int main(int argc, char **argv)
+{
+    static struct startup_info info;
+    char msg[128];
+    int options = 0, i = 0, run = 0, ret = 0, err = 0;
+
+    info.runs = STARTUP_DEFAULT_RUNS;
+
+    while ((options = getopt(argc, argv, "+n:Cvf:c:")) != -1) {
+        switch (options) {
+            case 'n':
+                info.runs = atoi(optarg);
+                break;
+            case 'C':
+                info.cold = 1;
+                break;
+            case 'v':
+                info.verbose = 1;
+                break;
+            case 'f':
+                ret = add_file(&info, optarg);
+                if (ret) {
+                    fprintf(stderr, "%s: %s: %s\n", APP_NAME, optarg,
+                            strerror(-ret));
+                    return ret;
+                }
+                break;
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -EINVAL;
+        }
+    }
+
+    if (optind < argc && (info.count >= STARTUP_MAX_CMDS ||
+                          add_args(&info, argc - optind, argv + optind))) {
+        usage();
+        return -EINVAL;
+    }
+
+    if (!info.count || info.runs < 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    for (i = 0; i < info.count; i++) {
+        for (run = 0; run < info.runs; run++) {
+            err = info.cold ? drop_caches() : 0;
+            if (!err) {
+                err = run_once(&info, &info.cmds[i]);
+            }
+            if (err) {
+                info.cmds[i].failed = err;
+                break;
+            }
+        }
+        if (err == -ENODATA) {
+            /* only binaries that print through libfwtest send marks */
+            snprintf(msg, sizeof(msg), "%s: no startup marks",
+                     info.cmds[i].name);
+            print_test_case_log(APP_NAME, info.case_id, msg);
+        } else if (err) {
+            snprintf(msg, sizeof(msg), "%s: %s", info.cmds[i].name,
+                     strerror(-err));
+            print_test_case_log(APP_NAME, info.case_id, msg);
+            if (!ret) {
+                ret = err;
+            }
+        }
+    }
+
+    report(&info);
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
+}
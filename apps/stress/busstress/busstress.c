@@ -0,0 +1,945 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#include "busstress.h"
+
+/* Default run time of the concurrent phase, in seconds */
+#define DEFAULT_DURATION 3600
+/* Default run time of each worker alone before it, in seconds */
+#define DEFAULT_SOLO 10
+/* Default report interval, in seconds */
+#define DEFAULT_INTERVAL 60
+/* Pause of a worker after a failed operation, in us */
+#define ERROR_BACKOFF_US 1000
+/* Max number of CPUs in the -C list */
+#define MAX_CPUS 32
+/* Max number of event loop threads */
+#define MAX_LOOPS 8
+/* Event loop operation timeout, in ns */
+#define ASYNC_TIMEOUT_NS 1000000000ULL
+/* Sample ring records per worker, a power of 2 */
+#define SAMPLE_RING_SIZE 16384
+/* Sample ring drain interval of the main thread, in us */
+#define DRAIN_INTERVAL_US 10000
+/* Records drained per sample_ring_pop() */
+#define DRAIN_BATCH 256
+
+struct stress_info {
+    int case_id;
+    int duration;
+    int solo;
+    int interval;
+    int ncpus;
+    int cpus[MAX_CPUS];
+    int nworkers;
+};
+
+static struct worker workers[MAX_WORKERS];
+static struct stats_hist snapshot;
+static int stop_workers;
+static volatile sig_atomic_t interrupted;
+
+/* event loop threads, thread per worker when 0 */
+static int nloops;
+static int loops_running;
+static struct evloop loops[MAX_LOOPS];
+static pthread_t loop_threads[MAX_LOOPS];
+static int loop_cpu[MAX_LOOPS];
+
+/* process CPU use over the concurrent phase */
+static struct rusage usage_start;
+static struct rusage usage_end;
+
+void usage()
+{
+    fprintf(stdout, "\nUsage: %s -w type[:key=value,...] [-w ...] "
+            "[-t seconds] [-s seconds]\n        [-i seconds] [-C cpus] "
+            "[-e loops] [-c case_id]\n", APP_NAME);
+    fprintf(stdout, "    -w: add a worker, up to %d. Every worker takes "
+            "cpu=<N> to pin\n        it and rate=<ops/s> to pace it "
+            "(default back to back), the\n        other keys depend on "
+            "the type:\n", MAX_WORKERS);
+    worker_list_types();
+    fprintf(stdout, "    -t: run time of all workers together in seconds "
+            "(default %d).\n", DEFAULT_DURATION);
+    fprintf(stdout, "    -s: run time of each worker alone first, the "
+            "reference for the\n        slowdown (default %d, 0 skips "
+            "it).\n", DEFAULT_SOLO);
+    fprintf(stdout, "    -i: report interval in seconds (default %d).\n",
+            DEFAULT_INTERVAL);
+    fprintf(stdout, "    -C: comma separated CPUs the workers are pinned "
+            "to round robin,\n        or none (default all online "
+            "CPUs).\n");
+    fprintf(stdout, "    -e: run the workers on this many event loop "
+            "threads, up to %d,\n        instead of a thread each. Loop "
+            "i is pinned to the CPU of worker i.\n", MAX_LOOPS);
+    fprintf(stdout, "    -c: Testrail test case ID used for the result.\n");
+    fprintf(stdout, "Example: %s -w i2c:addr=41 -w spi:len=1024 -w gpio:pin=8 "
+            "-w sd -t 7200\n", APP_NAME);
+}
+
+/**
+ * @brief Find the value of a key in the worker parameters.
+ *
+ * @param w The worker.
+ * @param key The key.
+ * @param value Returns the value.
+ * @param len The value buffer size.
+ * @return 0 on success, -ENOENT if the key is not set.
+ */
+int worker_param_str(const struct worker *w, const char *key, char *value,
+                     int len)
+{
+    char buf[PARAM_LEN];
+    char *tok, *save = NULL;
+    size_t klen = strlen(key);
+
+    snprintf(buf, sizeof(buf), "%s", w->params);
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        if (!strncmp(tok, key, klen) && tok[klen] == '=') {
+            snprintf(value, len, "%s", tok + klen + 1);
+            return 0;
+        }
+    }
+
+    return -ENOENT;
+}
+
+/**
+ * @brief Get an integer worker parameter.
+ *
+ * @param w The worker.
+ * @param key The key.
+ * @param def Value if the key is not set.
+ * @return the value.
+ */
+int worker_param_int(const struct worker *w, const char *key, int def)
+{
+    char value[32];
+
+    if (worker_param_str(w, key, value, sizeof(value))) {
+        return def;
+    }
+    return atoi(value);
+}
+
+/**
+ * @brief Parse a -w worker spec.
+ *
+ * @param info The stress info.
+ * @param spec type[:key=value,...]
+ * @return 0 on success, -EINVAL on bad spec.
+ */
+static int add_worker(struct stress_info *info, const char *spec)
+{
+    struct worker *w;
+    char type[WORKER_NAME_LEN / 2];
+    const char *params;
+    int i, same = 0;
+
+    if (info->nworkers >= MAX_WORKERS) {
+        return -EINVAL;
+    }
+
+    params = strchr(spec, ':');
+    snprintf(type, sizeof(type), "%.*s",
+             params ? (int)(params - spec) : (int)strlen(spec), spec);
+
+    w = &workers[info->nworkers];
+    w->ops = worker_find_ops(type);
+    if (!w->ops) {
+        return -EINVAL;
+    }
+    snprintf(w->params, sizeof(w->params), "%s", params ? params + 1 : "");
+
+    for (i = 0; i < info->nworkers; i++) {
+        same += workers[i].ops == w->ops;
+    }
+    snprintf(w->name, sizeof(w->name), "%s%d", type, same);
+
+    info->nworkers++;
+    return 0;
+}
+
+/**
+ * @brief Parse the -C CPU list.
+ *
+ * @param info The stress info.
+ * @param list The CPU list or none.
+ * @return 0 on success, -EINVAL on bad list.
+ */
+static int parse_cpus(struct stress_info *info, const char *list)
+{
+    char buf[128];
+    char *tok, *save = NULL;
+
+    info->ncpus = 0;
+    if (!strcmp(list, "none")) {
+        return 0;
+    }
+
+    snprintf(buf, sizeof(buf), "%s", list);
+    for (tok = strtok_r(buf, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        if (info->ncpus >= MAX_CPUS || atoi(tok) < 0) {
+            return -EINVAL;
+        }
+        info->cpus[info->ncpus++] = atoi(tok);
+    }
+
+    return info->ncpus ? 0 : -EINVAL;
+}
+
+static void stress_signal(int sig)
+{
+    (void)sig;
+    interrupted = 1;
+}
+
+/**
+ * @brief Pin the calling thread to a CPU.
+ *
+ * @param name Worker or loop name for the log.
+ * @param cpu The CPU, -1 for none.
+ */
+static void pin_thread(const char *name, int cpu)
+{
+    char logbuf[64];
+    cpu_set_t set;
+
+    if (cpu < 0) {
+        return;
+    }
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set)) {
+        snprintf(logbuf, sizeof(logbuf), "%s: pinning to cpu %d failed",
+                 name, cpu);
+        print_test_case_log(APP_NAME, workers[0].case_id, logbuf);
+    }
+}
+
+/**
+ * @brief Count one operation of a worker.
+ *
+ * Only the thread running the worker calls this, it hands the operation
+ * to the main thread through the worker sample ring without a syscall.
+ *
+ * @param w The worker.
+ * @param ret The operation result.
+ * @param bytes Bytes moved by the operation.
+ * @param ns Latency of the operation.
+ */
+static void worker_account(struct worker *w, int ret, uint64_t bytes,
+                           uint64_t ns)
+{
+    struct sample_rec rec;
+
+    rec.ns = ns;
+    rec.bytes = bytes;
+    rec.ret = ret;
+    sample_ring_push(&w->ring, &rec);
+}
+
+/**
+ * @brief Worker thread, run operations until the phase ends.
+ *
+ * A paced worker keeps an absolute schedule, when it is a period or more
+ * behind it starts over from now instead of catching up with a burst.
+ */
+static void *worker_thread(void *arg)
+{
+    struct worker *w = arg;
+    uint64_t t0, t1, bytes, next, period;
+    struct timespec ts;
+    int ret;
+
+    pin_thread(w->name, w->cpu);
+
+    period = w->rate > 0 ? 1e9 / w->rate : 0;
+    next = stats_now_ns();
+    while (!__atomic_load_n(&stop_workers, __ATOMIC_RELAXED)) {
+        if (period) {
+            next += period;
+            t0 = stats_now_ns();
+            if (t0 < next) {
+                ts.tv_sec = (next - t0) / 1000000000ULL;
+                ts.tv_nsec = (next - t0) % 1000000000ULL;
+                nanosleep(&ts, NULL);
+            } else if (t0 - next >= period) {
+                next = t0;
+            }
+        }
+
+        bytes = 0;
+        t0 = stats_now_ns();
+        ret = w->ops->run_op(w, &bytes);
+        t1 = stats_now_ns();
+        worker_account(w, ret, bytes, t1 - t0);
+
+        if (ret) {
+            usleep(ERROR_BACKOFF_US);
+        }
+    }
+
+    return NULL;
+}
+
+static int worker_async(const struct worker *w)
+{
+    return w->ops->start_op && w->ops->complete_op && w->event_fd >= 0;
+}
+
+/**
+ * @brief Event loop callback of a worker.
+ *
+ * A tick runs a synchronous operation or starts an asynchronous one, an
+ * event continues it.
+ *
+ * @param src The worker source.
+ * @param events epoll events of the worker fd, 0 for a tick.
+ * @return 0 on success, error code of a failed operation.
+ */
+static int worker_event(struct evloop_source *src, uint32_t events)
+{
+    struct worker *w = src->priv;
+    uint64_t now = stats_now_ns(), bytes = 0;
+    int ret;
+
+    if (events) {
+        ret = w->ops->complete_op(w, &bytes);
+        if (ret == -EAGAIN || !w->op_start) {
+            return 0;
+        }
+        worker_account(w, ret, bytes, now - w->op_start);
+        w->op_start = 0;
+    } else if (now < w->retry_ns) {
+        return 0;
+    } else if (!worker_async(w)) {
+        ret = w->ops->run_op(w, &bytes);
+        worker_account(w, ret, bytes, stats_now_ns() - now);
+    } else {
+        if (w->op_start && now - w->op_start < ASYNC_TIMEOUT_NS) {
+            return 0;
+        }
+        if (w->op_start) {
+            worker_account(w, -ETIMEDOUT, 0, 0);
+        }
+        ret = w->ops->start_op(w);
+        w->op_start = ret ? 0 : now;
+        if (ret) {
+            worker_account(w, ret, 0, 0);
+        }
+    }
+
+    if (ret) {
+        /* as the thread backoff, without blocking the other workers */
+        w->retry_ns = stats_now_ns() + ERROR_BACKOFF_US * 1000ULL;
+    }
+    return ret;
+}
+
+static void *loop_thread(void *arg)
+{
+    struct evloop *loop = arg;
+    char name[16], logbuf[64];
+    int ret;
+
+    snprintf(name, sizeof(name), "loop%d", (int)(loop - loops));
+    pin_thread(name, loop_cpu[loop - loops]);
+
+    ret = evloop_run(loop);
+    if (ret) {
+        snprintf(logbuf, sizeof(logbuf), "%s: event loop failed (%s)",
+                 name, strerror(-ret));
+        print_test_case_log(APP_NAME, workers[0].case_id, logbuf);
+    }
+
+    return NULL;
+}
+
+static void join_loops(void)
+{
+    int i;
+
+    for (i = 0; i < loops_running; i++) {
+        evloop_stop(&loops[i]);
+        pthread_join(loop_threads[i], NULL);
+        evloop_close(&loops[i]);
+    }
+    loops_running = 0;
+}
+
+/**
+ * @brief Start some workers on the event loop threads, round robin.
+ *
+ * @param w The first worker.
+ * @param n Number of workers.
+ * @return 0 on success, error code on failure.
+ */
+static int start_loops(struct worker *w, int n)
+{
+    struct evloop_source *src;
+    int i, used = n < nloops ? n : nloops, ret = 0;
+
+    for (i = 0; i < used; i++) {
+        loop_cpu[i] = w[i].cpu;
+        ret = evloop_init(&loops[i]);
+        if (ret) {
+            while (i--) {
+                evloop_close(&loops[i]);
+            }
+            return ret;
+        }
+    }
+
+    for (i = 0; i < n && !ret; i++) {
+        src = &w[i].src;
+        src->fd = worker_async(&w[i]) ? w[i].event_fd : -1;
+        src->events = EPOLLIN;
+        src->rate = w[i].rate > 0 ? w[i].rate : EVLOOP_BACK_TO_BACK;
+        src->fn = worker_event;
+        src->priv = &w[i];
+        w[i].op_start = 0;
+        w[i].retry_ns = 0;
+        ret = evloop_add(&loops[i % used], src);
+    }
+
+    for (i = 0; i < used && !ret; i++) {
+        ret = -pthread_create(&loop_threads[i], NULL, loop_thread, &loops[i]);
+        if (!ret) {
+            loops_running = i + 1;
+        }
+    }
+    if (ret) {
+        for (i = loops_running; i < used; i++) {
+            evloop_close(&loops[i]);
+        }
+        join_loops();
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Start the threads of some workers.
+ *
+ * @param w The first worker.
+ * @param n Number of workers.
+ * @return 0 on success, error code on failure.
+ */
+static int start_workers(struct worker *w, int n)
+{
+    int i, ret;
+
+    if (nloops) {
+        return start_loops(w, n);
+    }
+
+    __atomic_store_n(&stop_workers, 0, __ATOMIC_RELAXED);
+    for (i = 0; i < n; i++) {
+        ret = pthread_create(&w[i].thread, NULL, worker_thread, &w[i]);
+        if (ret) {
+            __atomic_store_n(&stop_workers, 1, __ATOMIC_RELAXED);
+            while (i--) {
+                pthread_join(w[i].thread, NULL);
+            }
+            return -ret;
+        }
+    }
+
+    return 0;
+}
+
+static void join_workers(struct worker *w, int n)
+{
+    int i;
+
+    if (nloops) {
+        join_loops();
+        return;
+    }
+
+    __atomic_store_n(&stop_workers, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < n; i++) {
+        pthread_join(w[i].thread, NULL);
+    }
+}
+
+/**
+ * @brief Move the operations in the sample ring of a worker to its
+ * counters, its interval histogram and the results file.
+ *
+ * @param w The worker.
+ */
+static void drain_worker(struct worker *w)
+{
+    struct sample_rec recs[DRAIN_BATCH];
+    size_t n, i;
+
+    while ((n = sample_ring_pop(&w->ring, recs, DRAIN_BATCH)) > 0) {
+        for (i = 0; i < n; i++) {
+            if (recs[i].ret) {
+                w->errors++;
+                w->last_error = recs[i].ret;
+                continue;
+            }
+            w->ops_count++;
+            w->bytes += recs[i].bytes;
+            stats_hist_record(&w->interval, recs[i].ns);
+            if (w->sample_metric >= 0) {
+                results_value(w->case_id, w->sample_metric, recs[i].ns);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Take the interval samples and counters of a worker.
+ *
+ * The samples go to the file scope snapshot, the interval histogram of
+ * the worker starts over.
+ *
+ * @param w The worker.
+ * @param ops Returns the operation count.
+ * @param bytes Returns the byte count.
+ */
+static void collect_worker(struct worker *w, uint64_t *ops, uint64_t *bytes)
+{
+    drain_worker(w);
+    memcpy(&snapshot, &w->interval, sizeof(snapshot));
+    stats_hist_init(&w->interval);
+    *ops = w->ops_count;
+    *bytes = w->bytes;
+}
+
+static void reset_worker(struct worker *w)
+{
+    drain_worker(w);
+    w->ops_count = 0;
+    w->bytes = 0;
+    w->errors = 0;
+    stats_hist_init(&w->interval);
+
+    w->last_ops = 0;
+    w->last_bytes = 0;
+    w->worst_ops_s = -1.0;
+    stats_hist_init(&w->total);
+}
+
+/**
+ * @brief Sleep until a deadline, or until the test is interrupted,
+ * draining the sample rings of the workers meanwhile.
+ *
+ * @param deadline Deadline in stats_now_ns() time.
+ */
+static void wait_until(uint64_t deadline)
+{
+    int i;
+
+    while (!interrupted && stats_now_ns() < deadline) {
+        usleep(DRAIN_INTERVAL_US);
+        for (i = 0; i < MAX_WORKERS && workers[i].ops; i++) {
+            drain_worker(&workers[i]);
+        }
+    }
+}
+
+/**
+ * @brief Run every worker alone to get its uncontended reference.
+ *
+ * @param info The stress info.
+ * @return 0 on success, error code on failure.
+ */
+static int run_solo(const struct stress_info *info)
+{
+    struct worker *w;
+    uint64_t start, ops, bytes;
+    double secs;
+    int i, ret;
+
+    for (i = 0; i < info->nworkers && !interrupted; i++) {
+        w = &workers[i];
+        reset_worker(w);
+
+        start = stats_now_ns();
+        ret = start_workers(w, 1);
+        if (ret) {
+            return ret;
+        }
+        wait_until(start + info->solo * 1000000000ULL);
+        join_workers(w, 1);
+        secs = (stats_now_ns() - start) / 1e9;
+
+        collect_worker(w, &ops, &bytes);
+        w->solo_ops_s = ops / secs;
+        w->solo_bytes_s = bytes / secs;
+        w->solo_p99 = stats_hist_percentile(&snapshot, 99.0);
+
+        printf("%s: solo %s ops_per_s=%.1f bytes_per_s=%.1f p99_us=%.1f "
+               "errors=%llu\n", APP_NAME, w->name, w->solo_ops_s,
+               w->solo_bytes_s, w->solo_p99 / 1000.0,
+               (unsigned long long)w->errors);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Fold one interval of every worker into its totals and print it.
+ *
+ * @param info The stress info.
+ * @param elapsed Seconds since the concurrent phase started.
+ * @param dt Seconds since the last interval.
+ */
+static void report_interval(const struct stress_info *info, double elapsed,
+                            double dt)
+{
+    struct worker *w;
+    uint64_t ops, bytes;
+    double ops_s, bytes_s, total_bytes_s = 0.0;
+    int i;
+
+    for (i = 0; i < info->nworkers; i++) {
+        w = &workers[i];
+        collect_worker(w, &ops, &bytes);
+        stats_hist_merge(&w->total, &snapshot);
+
+        ops_s = dt > 0 ? (ops - w->last_ops) / dt : 0.0;
+        bytes_s = dt > 0 ? (bytes - w->last_bytes) / dt : 0.0;
+        w->last_ops = ops;
+        w->last_bytes = bytes;
+        if (w->worst_ops_s < 0 || ops_s < w->worst_ops_s) {
+            w->worst_ops_s = ops_s;
+        }
+        total_bytes_s += bytes_s;
+
+        printf("%s: t=%.0fs %s ops_per_s=%.1f bytes_per_s=%.1f p50_us=%.1f "
+               "p99_us=%.1f errors=%llu\n", APP_NAME, elapsed, w->name,
+               ops_s, bytes_s, stats_hist_percentile(&snapshot, 50.0) / 1000.0,
+               stats_hist_percentile(&snapshot, 99.0) / 1000.0,
+               (unsigned long long)w->errors);
+    }
+
+    printf("%s: t=%.0fs aggregate bytes_per_s=%.1f\n", APP_NAME, elapsed,
+           total_bytes_s);
+    fflush(stdout);
+}
+
+/**
+ * @brief Run all workers together, reporting every interval.
+ *
+ * @param info The stress info.
+ * @param elapsed Returns the run time in seconds.
+ * @return 0 on success, error code on failure.
+ */
+static int run_concurrent(const struct stress_info *info, double *elapsed)
+{
+    uint64_t start, end, last, next, now;
+    int i, ret;
+
+    for (i = 0; i < info->nworkers; i++) {
+        reset_worker(&workers[i]);
+    }
+
+    getrusage(RUSAGE_SELF, &usage_start);
+    start = stats_now_ns();
+    end = start + info->duration * 1000000000ULL;
+    ret = start_workers(workers, info->nworkers);
+    if (ret) {
+        return ret;
+    }
+
+    for (last = start; last < end && !interrupted; last = now) {
+        next = last + info->interval * 1000000000ULL;
+        wait_until(next < end ? next : end);
+        now = stats_now_ns();
+        if (now >= end || interrupted) {
+            join_workers(workers, info->nworkers);
+            now = stats_now_ns();
+            getrusage(RUSAGE_SELF, &usage_end);
+        }
+        report_interval(info, (now - start) / 1e9, (now - last) / 1e9);
+    }
+
+    *elapsed = (last - start) / 1e9;
+    return 0;
+}
+
+/**
+ * @brief Print the [P] lines of one worker.
+ *
+ * @param info The stress info.
+ * @param w The worker.
+ * @param elapsed Run time of the concurrent phase in seconds.
+ * @return bytes/s of the worker.
+ */
+static double report_worker(const struct stress_info *info,
+                            const struct worker *w, double elapsed)
+{
+    double ops_s = elapsed > 0 ? w->last_ops / elapsed : 0.0;
+    double bytes_s = elapsed > 0 ? w->last_bytes / elapsed : 0.0;
+    uint64_t p99 = stats_hist_percentile(&w->total, 99.0);
+    char metric[64];
+
+    snprintf(metric, sizeof(metric), "%s_ops_per_s", w->name);
+    print_test_case_perf(info->case_id, metric, ops_s, "ops/s");
+    if (w->last_bytes) {
+        snprintf(metric, sizeof(metric), "%s_bytes_per_s", w->name);
+        print_test_case_perf(info->case_id, metric, bytes_s, "B/s");
+    }
+    snprintf(metric, sizeof(metric), "%s_worst_interval_ops_per_s", w->name);
+    print_test_case_perf(info->case_id, metric,
+                         w->worst_ops_s > 0 ? w->worst_ops_s : 0.0, "ops/s");
+    snprintf(metric, sizeof(metric), "%s_latency", w->name);
+    stats_hist_report(info->case_id, metric, &w->total);
+    snprintf(metric, sizeof(metric), "%s_errors", w->name);
+    print_test_case_perf(info->case_id, metric, w->errors, "errors");
+    if (sample_ring_dropped(&w->ring)) {
+        /* the main thread fell behind, the counts above are short */
+        snprintf(metric, sizeof(metric), "%s_dropped_samples", w->name);
+        print_test_case_perf(info->case_id, metric,
+                             sample_ring_dropped(&w->ring), "samples");
+    }
+
+    if (w->rate > 0) {
+        snprintf(metric, sizeof(metric), "%s_rate_achieved", w->name);
+        print_test_case_perf(info->case_id, metric, ops_s / w->rate * 100.0,
+                             "%");
+    }
+    if (nloops && w->rate > 0) {
+        snprintf(metric, sizeof(metric), "%s_tick_late", w->name);
+        stats_hist_report(info->case_id, metric, &w->src.late);
+        snprintf(metric, sizeof(metric), "%s_missed_ticks", w->name);
+        print_test_case_perf(info->case_id, metric, w->src.missed, "ticks");
+    }
+
+    if (info->solo && w->solo_ops_s > 0) {
+        snprintf(metric, sizeof(metric), "%s_slowdown", w->name);
+        print_test_case_perf(info->case_id, metric,
+                             (1.0 - ops_s / w->solo_ops_s) * 100.0, "%");
+    }
+    if (info->solo && w->solo_p99) {
+        snprintf(metric, sizeof(metric), "%s_p99_growth", w->name);
+        print_test_case_perf(info->case_id, metric,
+                             (double)p99 / w->solo_p99, "x");
+    }
+
+    return bytes_s;
+}
+
+static double timeval_secs(const struct timeval *tv)
+{
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+/**
+ * @brief Print the CPU time and context switches of the whole process
+ * over the concurrent phase, the cost of driving the workers.
+ *
+ * @param info The stress info.
+ * @param elapsed Run time of the concurrent phase in seconds.
+ */
+static void report_usage(const struct stress_info *info, double elapsed)
+{
+    const struct rusage *a = &usage_start, *b = &usage_end;
+    double cpu_s;
+    long ctx;
+
+    if (elapsed <= 0) {
+        return;
+    }
+
+    cpu_s = timeval_secs(&b->ru_utime) - timeval_secs(&a->ru_utime) +
+            timeval_secs(&b->ru_stime) - timeval_secs(&a->ru_stime);
+    ctx = b->ru_nvcsw - a->ru_nvcsw + b->ru_nivcsw - a->ru_nivcsw;
+
+    print_test_case_perf(info->case_id, "process_cpu_load",
+                         cpu_s / elapsed * 100.0, "%");
+    print_test_case_perf(info->case_id, "ctx_switches_per_s", ctx / elapsed,
+                         "switches/s");
+}
+
+int main(int argc, char **argv)
+{
+    struct stress_info info;
+    struct worker *w;
+    struct sigaction sa;
+    double elapsed = 0.0, bytes_s = 0.0, solo_bytes_s = 0.0;
+    char logbuf[128];
+    int options = 0, i = 0, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    info.duration = DEFAULT_DURATION;
+    info.solo = DEFAULT_SOLO;
+    info.interval = DEFAULT_INTERVAL;
+    info.ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (info.ncpus > MAX_CPUS) {
+        info.ncpus = MAX_CPUS;
+    }
+    for (i = 0; i < info.ncpus; i++) {
+        info.cpus[i] = i;
+    }
+
+    while ((options = getopt(argc, argv, "c:C:e:i:s:t:w:")) != -1) {
+        switch (options) {
+            case 'c':
+                info.case_id = atoi(optarg);
+                break;
+            case 'C':
+                ret = parse_cpus(&info, optarg);
+                break;
+            case 'e':
+                nloops = atoi(optarg);
+                ret = nloops < 1 || nloops > MAX_LOOPS ? -EINVAL : 0;
+                break;
+            case 'i':
+                info.interval = atoi(optarg);
+                break;
+            case 's':
+                info.solo = atoi(optarg);
+                break;
+            case 't':
+                info.duration = atoi(optarg);
+                break;
+            case 'w':
+                ret = add_worker(&info, optarg);
+                break;
+            default:
+                ret = -EINVAL;
+                break;
+        }
+        if (ret) {
+            usage();
+            return -EINVAL;
+        }
+    }
+
+    if (!info.nworkers || info.duration < 1 || info.solo < 0 ||
+        info.interval < 1) {
+        usage();
+        return -EINVAL;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stress_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    for (i = 0; i < info.nworkers; i++) {
+        w = &workers[i];
+        w->case_id = info.case_id;
+        ret = sample_ring_init(&w->ring, SAMPLE_RING_SIZE);
+        if (ret) {
+            info.nworkers = i + 1;
+            goto out;
+        }
+        snprintf(logbuf, sizeof(logbuf), "%s_latency_sample", w->name);
+        w->sample_metric = results_enabled() ?
+                           results_metric_id(logbuf, "ns") : -1;
+        w->cpu = worker_param_int(w, "cpu",
+                                  info.ncpus ? info.cpus[i % info.ncpus] : -1);
+        w->rate = worker_param_int(w, "rate", 0);
+        w->event_fd = -1;
+
+        ret = w->ops->setup(w);
+        if (ret) {
+            snprintf(logbuf, sizeof(logbuf), "%s: setup failed (%s)",
+                     w->name, strerror(-ret));
+            print_test_case_log(APP_NAME, info.case_id, logbuf);
+            info.nworkers = i + 1;
+            goto out;
+        }
+        printf("%s: %s %s cpu=%d%s\n", APP_NAME, w->name, w->params, w->cpu,
+               nloops && worker_async(w) ? " async" : "");
+    }
+
+    if (info.solo) {
+        ret = run_solo(&info);
+    }
+    if (!ret && !interrupted) {
+        ret = run_concurrent(&info, &elapsed);
+    }
+    if (ret) {
+        goto out;
+    }
+
+    for (i = 0; i < info.nworkers; i++) {
+        w = &workers[i];
+        bytes_s += report_worker(&info, w, elapsed);
+        solo_bytes_s += w->solo_bytes_s;
+
+        if (w->errors || !w->last_ops) {
+            snprintf(logbuf, sizeof(logbuf), "%s: %llu errors, last %s",
+                     w->name, (unsigned long long)w->errors,
+                     w->errors ? strerror(-w->last_error) : "none");
+            print_test_case_log(APP_NAME, info.case_id, logbuf);
+            ret = -EIO;
+        }
+    }
+
+    print_test_case_perf(info.case_id, "aggregate_bytes_per_s", bytes_s,
+                         "B/s");
+    if (info.solo) {
+        print_test_case_perf(info.case_id, "aggregate_solo_bytes_per_s",
+                             solo_bytes_s, "B/s");
+    }
+    report_usage(&info, elapsed);
+
+out:
+    for (i = 0; i < info.nworkers; i++) {
+        workers[i].ops->teardown(&workers[i]);
+        free(workers[i].priv);
+        sample_ring_free(&workers[i].ring);
+    }
+
+    if (ret) {
+        print_test_case_result(APP_NAME, info.case_id, ret, strerror(-ret));
+    } else {
+        print_test_case_result_only(info.case_id, ret);
+    }
+
+    return ret;
+}
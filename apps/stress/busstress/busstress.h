@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BUSSTRESS_H__
+#define __BUSSTRESS_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "libfwtest.h"
+
+#define APP_NAME "busstress"
+
+/* Max number of concurrent workers */
+#define MAX_WORKERS 16
+/* Max length of the parameters of one worker */
+#define PARAM_LEN 128
+/* Max length of a worker name */
+#define WORKER_NAME_LEN 32
+
+struct worker;
+
+/*
+ * One protocol workload. setup() and teardown() run in the main thread,
+ * run_op() in the worker thread, back to back or at the worker rate
+ * until the phase ends.
+ *
+ * On an event loop, workers that set event_fd in setup() and have
+ * start_op() and complete_op() do not block the loop: start_op() starts
+ * an operation on a tick and complete_op() continues it each time
+ * event_fd is readable, returning -EAGAIN until it is done. The others
+ * run run_op() on each tick.
+ */
+struct worker_ops {
+    const char *type;
+    int (*setup)(struct worker *w);
+    int (*run_op)(struct worker *w, uint64_t *bytes);
+    void (*teardown)(struct worker *w);
+    int (*start_op)(struct worker *w);
+    int (*complete_op)(struct worker *w, uint64_t *bytes);
+};
+
+struct worker {
+    const struct worker_ops *ops;
+    char name[WORKER_NAME_LEN];
+    char params[PARAM_LEN];
+    int case_id;
+    int cpu;
+    /* target ops/s, 0 for back to back */
+    double rate;
+    void *priv;
+    pthread_t thread;
+
+    /* event loop mode */
+    int event_fd;
+    uint64_t op_start;
+    uint64_t retry_ns;
+    struct evloop_source src;
+
+    /* operations of the running phase, pushed by the thread running it */
+    struct sample_ring ring;
+    /* results file metric of the samples, -1 for none */
+    int sample_metric;
+
+    /* drained from the ring by the main thread */
+    uint64_t ops_count;
+    uint64_t bytes;
+    uint64_t errors;
+    int last_error;
+    struct stats_hist interval;
+
+    /* owned by the main thread */
+    uint64_t last_ops;
+    uint64_t last_bytes;
+    struct stats_hist total;
+    double worst_ops_s;
+    double solo_ops_s;
+    double solo_bytes_s;
+    uint64_t solo_p99;
+};
+
+/* implement in busstress.c */
+int worker_param_int(const struct worker *w, const char *key, int def);
+int worker_param_str(const struct worker *w, const char *key, char *value,
+                     int len);
+
+/* implement in workers.c */
+const struct worker_ops *worker_find_ops(const char *type);
+void worker_list_types(void);
+
+#endif
@@ -0,0 +1,630 @@
+/**
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/limits.h>
+#include <linux/spi/spidev.h>
+
+#include "busstress.h"
+
+/* Max bytes per I2C, SPI or UART operation */
+#define MAX_XFER_SIZE 4096
+/* Max SPI transfers per message */
+#define MAX_SPI_DEPTH 64
+/* Max SD read size */
+#define MAX_SD_BLOCK (4 * 1024 * 1024)
+/* O_DIRECT buffer and offset alignment */
+#define DIRECT_ALIGN 4096
+/* UART loopback read timeout, in ms */
+#define UART_TIMEOUT_MS 1000
+
+/*
+ * i2c: combined index write and register read, as i2ctest -m rdwr.
+ * bus=<N> addr=<decimal> index=<reg> len=<bytes>
+ */
+struct i2c_worker {
+    int fd;
+    int addr;
+    uint8_t index;
+    int len;
+    uint8_t buf[MAX_XFER_SIZE];
+};
+
+static int i2c_setup(struct worker *w)
+{
+    struct i2c_worker *p;
+    int bus = -EINVAL, ret;
+
+    p = calloc(1, sizeof(*p));
+    if (!p) {
+        return -ENOMEM;
+    }
+    w->priv = p;
+    p->fd = -1;
+
+    gb_find_i2c_adapter(0, &bus);
+    bus = worker_param_int(w, "bus", bus);
+    p->addr = worker_param_int(w, "addr", -EINVAL);
+    p->index = worker_param_int(w, "index", 0);
+    p->len = worker_param_int(w, "len", 16);
+    if (bus < 0 || p->addr < 0 || p->len < 1 || p->len > MAX_XFER_SIZE) {
+        return -EINVAL;
+    }
+
+    p->fd = open_i2c_dev(bus);
+    if (p->fd < 0) {
+        return -errno;
+    }
+
+    ret = force_set_slave_addr(p->fd, p->addr);
+    return ret;
+}
+
+static int i2c_run_op(struct worker *w, uint64_t *bytes)
+{
+    struct i2c_worker *p = w->priv;
+    int ret;
+
+    ret = i2c_rdwr_read_regs(p->fd, p->addr, p->index, p->buf, p->len);
+    if (!ret) {
+        *bytes = p->len;
+    }
+    return ret;
+}
+
+static void i2c_teardown(struct worker *w)
+{
+    struct i2c_worker *p = w->priv;
+
+    if (p && p->fd >= 0) {
+        close(p->fd);
+    }
+}
+
+/*
+ * spi: full duplex messages of depth transfers, as spi_readperf.
+ * dev=<bus>.<cs> hz=<clock> len=<bytes> depth=<transfers> mode=<0-3>
+ */
+struct spi_worker {
+    int fd;
+    int depth;
+    int len;
+    struct spi_ioc_transfer xfers[MAX_SPI_DEPTH];
+    uint8_t *tx;
+    uint8_t *rx;
+};
+
+static int spi_setup_worker(struct worker *w)
+{
+    struct spi_worker *p;
+    char dev[32];
+    int bus = -EINVAL, cs = 0, hz, mode, i;
+
+    p = calloc(1, sizeof(*p));
+    if (!p) {
+        return -ENOMEM;
+    }
+    w->priv = p;
+    p->fd = -1;
+
+    if (worker_param_str(w, "dev", dev, sizeof(dev)) ||
+        sscanf(dev, "%d.%d", &bus, &cs) != 2) {
+        gb_find_spi_dev(0, &bus, &cs);
+    }
+    hz = worker_param_int(w, "hz", 1000000);
+    mode = worker_param_int(w, "mode", 0);
+    p->len = worker_param_int(w, "len", 256);
+    p->depth = worker_param_int(w, "depth", 4);
+    if (bus < 0 || hz < 1 || mode < 0 || mode > 3 || p->len < 1 ||
+        p->len > MAX_XFER_SIZE || p->depth < 1 || p->depth > MAX_SPI_DEPTH) {
+        return -EINVAL;
+    }
+
+    p->tx = malloc(p->len * p->depth);
+    p->rx = malloc(p->len * p->depth);
+    if (!p->tx || !p->rx) {
+        return -ENOMEM;
+    }
+    for (i = 0; i < p->len * p->depth; i++) {
+        p->tx[i] = (uint8_t)i;
+    }
+    for (i = 0; i < p->depth; i++) {
+        p->xfers[i].tx_buf = (unsigned long)(p->tx + i * p->len);
+        p->xfers[i].rx_buf = (unsigned long)(p->rx + i * p->len);
+        p->xfers[i].len = p->len;
+        p->xfers[i].speed_hz = hz;
+        p->xfers[i].bits_per_word = 8;
+    }
+
+    p->fd = open_spi_dev(bus, cs);
+    if (p->fd < 0) {
+        return -errno;
+    }
+
+    return spi_setup(p->fd, mode, 8, hz);
+}
+
+static int spi_run_op(struct worker *w, uint64_t *bytes)
+{
+    struct spi_worker *p = w->priv;
+    int ret;
+
+    ret = spi_transfer_message(p->fd, p->xfers, p->depth);
+    if (!ret) {
+        *bytes = p->len * p->depth;
+    }
+    return ret;
+}
+
+static void spi_teardown(struct worker *w)
+{
+    struct spi_worker *p = w->priv;
+
+    if (!p) {
+        return;
+    }
+    if (p->fd >= 0) {
+        close(p->fd);
+    }
+    free(p->tx);
+    free(p->rx);
+}
+
+/*
+ * gpio: toggle an output line, optionally checked on a looped back input,
+ * through the gpio chardev, or sysfs when the chardev request fails.
+ * pin=<offset> in=<offset> in the first Greybus GPIO controller.
+ */
+struct gpio_worker {
+    int base;
+    int chipnum;
+    int pin;
+    int loopback;
+    int out_fd;
+    int in_fd;
+    uint8_t level;
+};
+
+static int gpio_sysfs_line(int gpio, char *direction)
+{
+    int ret;
+
+    ret = gpio_export(gpio);
+    if (ret) {
+        return ret;
+    }
+
+    return gpio_set_attr(gpio, GPIO_ATTR_DIRECTION, direction,
+                         strlen(direction));
+}
+
+static int gpio_setup(struct worker *w)
+{
+    const struct gb_discovery *disc = gb_discover(0);
+    struct gpio_worker *p;
+    int ret;
+
+    p = calloc(1, sizeof(*p));
+    if (!p) {
+        return -ENOMEM;
+    }
+    w->priv = p;
+    p->out_fd = -1;
+    p->in_fd = -1;
+
+    if (disc->ngpio_chips < 1) {
+        return -ENODEV;
+    }
+    p->base = disc->gpio_chips[0].base;
+    p->chipnum = disc->gpio_chips[0].chipnum;
+    p->pin = worker_param_int(w, "pin", 0);
+    p->loopback = worker_param_int(w, "in", -1);
+    if (p->pin < 0 || p->pin >= disc->gpio_chips[0].ngpio ||
+        p->loopback >= disc->gpio_chips[0].ngpio || p->pin == p->loopback) {
+        return -EINVAL;
+    }
+
+    /* sysfs when there is no chardev or its request fails */
+    if (p->chipnum >= 0) {
+        p->out_fd = gpio_cdev_request(p->chipnum, &p->pin, 1, 1, NULL,
+                                      APP_NAME);
+        if (p->out_fd >= 0 && p->loopback >= 0) {
+            p->in_fd = gpio_cdev_request(p->chipnum, &p->loopback, 1, 0,
+                                         NULL, APP_NAME);
+            if (p->in_fd < 0) {
+                gpio_cdev_release(p->out_fd);
+            }
+        }
+        if (p->out_fd >= 0 && (p->loopback < 0 || p->in_fd >= 0)) {
+            return 0;
+        }
+        p->out_fd = -1;
+        p->in_fd = -1;
+    }
+
+    ret = gpio_sysfs_line(p->base + p->pin, "out");
+    if (!ret && p->loopback >= 0) {
+        ret = gpio_sysfs_line(p->base + p->loopback, "in");
+    }
+    return ret;
+}
+
+static int gpio_run_op(struct worker *w, uint64_t *bytes)
+{
+    struct gpio_worker *p = w->priv;
+    char value[8] = { 0 };
+    uint8_t level = 0;
+    int ret;
+
+    p->level = !p->level;
+
+    if (p->out_fd >= 0) {
+        ret = gpio_cdev_set_values(p->out_fd, &p->level, 1);
+        if (!ret && p->in_fd >= 0) {
+            ret = gpio_cdev_get_values(p->in_fd, &level, 1);
+        }
+    } else {
+        value[0] = p->level ? '1' : '0';
+        ret = gpio_set_attr(p->base + p->pin, GPIO_ATTR_VALUE, value, 1);
+        if (!ret && p->loopback >= 0) {
+            ret = gpio_get_attr(p->base + p->loopback, GPIO_ATTR_VALUE,
+                                value, sizeof(value));
+            level = value[0] == '1';
+        }
+    }
+
+    if (!ret && p->loopback >= 0 && level != p->level) {
+        ret = -EIO;
+    }
+
+    *bytes = 0;
+    return ret;
+}
+
+static void gpio_teardown(struct worker *w)
+{
+    struct gpio_worker *p = w->priv;
+
+    if (!p) {
+        return;
+    }
+    if (p->out_fd >= 0 || p->in_fd >= 0) {
+        gpio_cdev_release(p->out_fd);
+        gpio_cdev_release(p->in_fd);
+        return;
+    }
+    gpio_unexport(p->base + p->pin);
+    if (p->loopback >= 0) {
+        gpio_unexport(p->base + p->loopback);
+    }
+}
+
+/*
+ * uart: write a block and read it back on a looped back tty.
+ * tty=<path> baud=<rate> len=<bytes> flow=<0|1>
+ * On an event loop the block is written on a tick and read back as the
+ * tty becomes readable.
+ */
+struct uart_worker {
+    int fd;
+    int len;
+    /* event loop: bytes of the block read back, block in flight */
+    int got;
+    int pending;
+    uint8_t seq;
+    uint8_t tx[MAX_XFER_SIZE];
+    uint8_t rx[MAX_XFER_SIZE];
+};
+
+static int uart_setup(struct worker *w)
+{
+    struct uart_worker *p;
+    char tty[PATH_MAX] = { 0 };
+    int baud, flow;
+
+    p = calloc(1, sizeof(*p));
+    if (!p) {
+        return -ENOMEM;
+    }
+    w->priv = p;
+    p->fd = -1;
+
+    if (worker_param_str(w, "tty", tty, sizeof(tty))) {
+        gb_find_uart_tty(0, tty, sizeof(tty));
+    }
+    baud = worker_param_int(w, "baud", 115200);
+    flow = worker_param_int(w, "flow", 0);
+    p->len = worker_param_int(w, "len", 64);
+    if (!tty[0] || p->len < 1 || p->len > MAX_XFER_SIZE) {
+        return -EINVAL;
+    }
+
+    p->fd = open_uart_tty(tty);
+    if (p->fd < 0) {
+        return -errno;
+    }
+    w->event_fd = p->fd;
+
+    return uart_set_raw(p->fd, baud, flow);
+}
+
+static int uart_run_op(struct worker *w, uint64_t *bytes)
+{
+    struct uart_worker *p = w->priv;
+    struct pollfd pfd;
+    ssize_t n;
+    int got = 0, i, ret = 0;
+
+    for (i = 0; i < p->len; i++) {
+        p->tx[i] = p->seq + i;
+    }
+    p->seq++;
+
+    n = write(p->fd, p->tx, p->len);
+    if (n != p->len) {
+        ret = n < 0 ? -errno : -EIO;
+        goto out;
+    }
+
+    pfd.fd = p->fd;
+    pfd.events = POLLIN;
+    while (got < p->len) {
+        ret = poll(&pfd, 1, UART_TIMEOUT_MS);
+        if (ret <= 0) {
+            ret = ret ? -errno : -ETIMEDOUT;
+            goto out;
+        }
+        n = read(p->fd, p->rx + got, p->len - got);
+        if (n < 0) {
+            ret = -errno;
+            goto out;
+        }
+        got += n;
+    }
+
+    ret = memcmp(p->tx, p->rx, p->len) ? -EIO : 0;
+
+out:
+    if (ret) {
+        /* drop what is left of the block so the next one starts clean */
+        tcflush(p->fd, TCIOFLUSH);
+    } else {
+        *bytes = p->len;
+    }
+    return ret;
+}
+
+static int uart_start_op(struct worker *w)
+{
+    struct uart_worker *p = w->priv;
+    ssize_t n;
+    int i;
+
+    if (p->pending) {
+        /* the last block timed out, start clean */
+        tcflush(p->fd, TCIOFLUSH);
+        p->pending = 0;
+    }
+
+    for (i = 0; i < p->len; i++) {
+        p->tx[i] = p->seq + i;
+    }
+    p->seq++;
+
+    n = write(p->fd, p->tx, p->len);
+    if (n != p->len) {
+        tcflush(p->fd, TCIOFLUSH);
+        return n < 0 ? -errno : -EIO;
+    }
+
+    p->got = 0;
+    p->pending = 1;
+    return 0;
+}
+
+static int uart_complete_op(struct worker *w, uint64_t *bytes)
+{
+    struct uart_worker *p = w->priv;
+    ssize_t n;
+
+    if (!p->pending) {
+        /* late bytes of a timed out block, drop them */
+        n = read(p->fd, p->rx, sizeof(p->rx));
+        return n < 0 && errno != EAGAIN ? -errno : -EAGAIN;
+    }
+
+    n = read(p->fd, p->rx + p->got, p->len - p->got);
+    if (n < 0) {
+        return errno == EAGAIN ? -EAGAIN : -errno;
+    }
+
+    p->got += n;
+    if (p->got < p->len) {
+        return -EAGAIN;
+    }
+    p->pending = 0;
+
+    if (memcmp(p->tx, p->rx, p->len)) {
+        tcflush(p->fd, TCIOFLUSH);
+        return -EIO;
+    }
+
+    *bytes = p->len;
+    return 0;
+}
+
+static void uart_teardown(struct worker *w)
+{
+    struct uart_worker *p = w->priv;
+
+    if (p && p->fd >= 0) {
+        close(p->fd);
+    }
+}
+
+/*
+ * sd: random O_DIRECT reads, never writes, so it is safe on a card in
+ * use. dev=<block device> bs=<bytes>
+ */
+struct sd_worker {
+    int fd;
+    int bs;
+    uint64_t nblocks;
+    uint64_t seed;
+    uint8_t *buf;
+};
+
+static int sd_setup(struct worker *w)
+{
+    struct sd_worker *p;
+    char dev[PATH_MAX] = { 0 };
+    uint64_t size = 0;
+
+    p = calloc(1, sizeof(*p));
+    if (!p) {
+        return -ENOMEM;
+    }
+    w->priv = p;
+    p->fd = -1;
+
+    if (worker_param_str(w, "dev", dev, sizeof(dev))) {
+        gb_find_sd_blockdev(0, dev, sizeof(dev));
+    }
+    p->bs = worker_param_int(w, "bs", 65536);
+    if (!dev[0] || p->bs < DIRECT_ALIGN || p->bs > MAX_SD_BLOCK ||
+        p->bs % DIRECT_ALIGN) {
+        return -EINVAL;
+    }
+
+    if (posix_memalign((void **)&p->buf, DIRECT_ALIGN, p->bs)) {
+        return -ENOMEM;
+    }
+
+    p->fd = open(dev, O_RDONLY | O_DIRECT);
+    if (p->fd < 0) {
+        return -errno;
+    }
+
+    if (ioctl(p->fd, BLKGETSIZE64, &size) < 0) {
+        return -errno;
+    }
+    p->nblocks = size / p->bs;
+    p->seed = stats_now_ns() | 1;
+
+    return p->nblocks ? 0 : -ENOSPC;
+}
+
+static int sd_run_op(struct worker *w, uint64_t *bytes)
+{
+    struct sd_worker *p = w->priv;
+    ssize_t n;
+
+    p->seed ^= p->seed << 13;
+    p->seed ^= p->seed >> 7;
+    p->seed ^= p->seed << 17;
+
+    n = pread(p->fd, p->buf, p->bs, (p->seed % p->nblocks) * p->bs);
+    if (n != p->bs) {
+        return n < 0 ? -errno : -EIO;
+    }
+
+    *bytes = p->bs;
+    return 0;
+}
+
+static void sd_teardown(struct worker *w)
+{
+    struct sd_worker *p = w->priv;
+
+    if (!p) {
+        return;
+    }
+    if (p->fd >= 0) {
+        close(p->fd);
+    }
+    free(p->buf);
+}
+
+static const struct worker_ops worker_types[] = {
+    { .type = "i2c", .setup = i2c_setup, .run_op = i2c_run_op,
+      .teardown = i2c_teardown },
+    { .type = "spi", .setup = spi_setup_worker, .run_op = spi_run_op,
+      .teardown = spi_teardown },
+    { .type = "gpio", .setup = gpio_setup, .run_op = gpio_run_op,
+      .teardown = gpio_teardown },
+    { .type = "uart", .setup = uart_setup, .run_op = uart_run_op,
+      .teardown = uart_teardown, .start_op = uart_start_op,
+      .complete_op = uart_complete_op },
+    { .type = "sd", .setup = sd_setup, .run_op = sd_run_op,
+      .teardown = sd_teardown },
+};
+
+/**
+ * @brief Look up a worker type.
+ *
+ * @param type The type name, i2c, spi, gpio, uart or sd.
+ * @return the worker ops, NULL if there is no such type.
+ */
+const struct worker_ops *worker_find_ops(const char *type)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(worker_types) / sizeof(worker_types[0]); i++) {
+        if (!strcmp(worker_types[i].type, type)) {
+            return &worker_types[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Print the worker types and their parameters for usage().
+ */
+void worker_list_types(void)
+{
+    fprintf(stdout, "    i2c:  bus=<N> addr=<decimal> index=<reg> "
+            "len=<bytes>\n");
+    fprintf(stdout, "    spi:  dev=<bus>.<cs> hz=<clock> len=<bytes> "
+            "depth=<transfers>\n          mode=<0-3>\n");
+    fprintf(stdout, "    gpio: pin=<offset> in=<loopback offset>\n");
+    fprintf(stdout, "    uart: tty=<path> baud=<rate> len=<bytes> "
+            "flow=<0|1>, TX looped\n          back to RX\n");
+    fprintf(stdout, "    sd:   dev=<block device> bs=<bytes>, random "
+            "reads only\n");
+}